@@ -20,7 +20,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <mutex>
 #include "bignum.h"
+#include "fixed_arith.h"
 #include "conversions.h"
 #include "util.h"
 
@@ -134,150 +136,15 @@ int DigitArrayCompare(int size_a, uint64_t* a, int size_b, uint64_t* b) {
 }
 
 int HighBitInDigit(uint64_t a) {
-  int i;
-
-  for (i = (NBITSINUINT64 - 1); i >= 0; i--) {
-    if (((1ULL << i) & a) != 0)
-      return i + 1;
-  }
-  return 0;
+  if (a == 0ULL)
+    return 0;
+  return NBITSINUINT64 - __builtin_clzll(a);
 }
 
 int shift_to_top_bit(uint64_t a) {
-  int i;
-
-  for (i = 0; i < NBITSINUINT64; i++) {
-    if (((a << i) & 0x8000000000000000) != 0)
-      return i;
-  }
-  return NBITSINUINT64;
-}
-
-// q= a/b. r is remainder.
-bool DigitArrayDivisionAlgorithm(int size_a, uint64_t* a, int size_b,
-                                 uint64_t* b, int* size_q, uint64_t* q,
-                                 int* size_r, uint64_t* r) {
-  int real_size_a = DigitArrayComputedSize(size_a, a);
-  int real_size_b = DigitArrayComputedSize(size_b, b);
-
-  if (real_size_b == 1) {
-    if (b[0] == 0ULL) {
-      LOG(ERROR) << "b[0]==0 DigitArrayDivisionAlgorithm failure\n";
-      return false;
-    }
-    return DigitArrayShortDivisionAlgorithm(real_size_a, a, b[0], size_q, q,
-                                            &r[0]);
-  }
-
-  int hi_quotient_digit = real_size_a - real_size_b;
-  uint64_t x;
-  int i, m, n;
-  int real_size_r;
-  int real_size_y;
-  int cmp;
-
-  DigitArrayZeroNum(*size_q, q);
-  DigitArrayZeroNum(*size_r, r);
-  if (!DigitArrayCopy(size_a, a, *size_r, r)) {
-    LOG(ERROR) << "DigitArrayCopy 1 error\n";
-    return false;
-  }
-
-  uint64_t y[real_size_a + 1];
-  int size_y = real_size_a + 1;
-
-  real_size_r = real_size_a;
-  for (i = hi_quotient_digit; i >= 0; i--) {
-    real_size_r = DigitArrayComputedSize(*size_r, r);
-    cmp = DigitArrayCompare(real_size_b, b, real_size_r, r);
-    if (cmp > 1)
-      break;
-    n = real_size_b + i;
-    if (n == real_size_a) {
-      EstimateQuotient(0ULL, r[n - 1], r[n - 2], b[real_size_b - 1],
-                       b[real_size_b - 2], &x);
-    } else if (n < 2) {
-      EstimateQuotient(r[n], r[n - 1], 0ULL, b[real_size_b - 1],
-                       b[real_size_b - 2], &x);
-    } else {
-      EstimateQuotient(r[n], r[n - 1], r[n - 2], b[real_size_b - 1],
-                       b[real_size_b - 2], &x);
-    }
-    for (;;) {
-      if (x == 0ULL)
-        break;
-      DigitArrayZeroNum(size_y, y);
-      if (DigitArrayMult(real_size_b, b, 1, &x, size_y - i, &y[i]) < 0) {
-        LOG(ERROR) << "DigitArrayMult in DigitArrayDivisionAlgorithm\n";
-      }
-      real_size_y = DigitArrayComputedSize(size_y, y);
-      m = DigitArrayCompare(real_size_y, y, real_size_r, r);
-      if (x == 0ULL || m <= 0) {
-        break;
-      }
-      x--;
-    }
-    if (x == 0) {
-      continue;
-    }
-    DigitArraySubFrom(*size_r, real_size_r, r, real_size_y, y);
-    q[i] = x;
-  }
-
-  // set quotient and remainder sizes
-  int nq = DigitArrayComputedSize(*size_q, q);
-  *size_q = nq;
-  int nr = DigitArrayComputedSize(*size_r, r);
-  *size_r = nr;
-  return true;
-}
-
-bool DigitArrayConvertToDecimal(int size_a, uint64_t* a, int* size_s, char* s) {
-  int real_size_a = DigitArrayComputedSize(size_a, a);
-  int src = 0;
-  int dst = 1;
-  uint64_t* t[2];
-  uint64_t r = 0ULL;
-  int i, m;
-  int num_dec_digits = 0;
-  char* new_s = new char[*size_s];
-  volatile uint64_t ten = (uint64_t)10;
-
-  t[0] = new uint64_t[real_size_a];
-  t[1] = new uint64_t[real_size_a];
-  DigitArrayZeroNum(real_size_a, t[0]);
-  if (!DigitArrayCopy(real_size_a, a, real_size_a, t[0])) return false;
-  for (;;) {
-    m = DigitArrayComputedSize(real_size_a, t[src]);
-    DigitArrayZeroNum(real_size_a, t[dst]);
-    if (!DigitArrayShortDivisionAlgorithm(real_size_a, t[src], ten, &m, t[dst],
-                                          &r))
-      return false;
-
-    new_s[num_dec_digits++] = (char)r + '0';
-    if (DigitArrayIsZero(real_size_a, t[dst])) {
-      break;
-    }
-    src = (src + 1) % 2;
-    dst = (dst + 1) % 2;
-  }
-
-  if (num_dec_digits == 0) {
-    new_s[num_dec_digits++] = ((char)'0');
-  }
-  new_s[num_dec_digits] = 0;
-
-  // reverse the digits now
-  m = num_dec_digits;
-  for (i = 0; i < num_dec_digits; i++) {
-    s[i] = new_s[--m];
-  }
-  s[i] = 0;
-  delete t[0];
-  delete t[1];
-  delete []new_s;
-
-  return true;
+  if (a == 0ULL)
+    return NBITSINUINT64;
+  return __builtin_clzll(a);
 }
 
 bool DigitArrayConvertToHex(int size_a, uint64_t* a, int* size_s, char* s) {
@@ -297,53 +164,80 @@ bool DigitArrayConvertToHex(int size_a, uint64_t* a, int* size_s, char* s) {
   return true;
 }
 
-int DigitArrayConvertFromDecimal(const char* s, int size_a, uint64_t* a) {
-  int n = strlen(s);
-  const char* p = s;
-  byte b;
-  uint64_t x;
-  volatile uint64_t ten = 10ULL;
-  int real_size_a;
-
-  if (30 * size_a < n)
-    return -1;
-  DigitArrayZeroNum(size_a, a);
-  while (n > 0) {
-    b = HexToValue(*(p++));
-    x = (uint64_t)b;
-    real_size_a = DigitArrayComputedSize(size_a, a);
-    DigitArrayMultBy(size_a, real_size_a, a, ten);
-    real_size_a = DigitArrayComputedSize(size_a, a);
-    DigitArrayAddTo(size_a, real_size_a, a, 1, &x);
-    n--;
-  }
-  return DigitArrayComputedSize(size_a, a);
-}
-
 int DigitArrayConvertFromHex(const char* s, int size_a, uint64_t* a) {
   int n = strlen(s);
-  const char* p = s;
-  byte b;
   uint64_t x;
-  int real_size_a;
+  int i;
 
   if (16 * size_a < n) {
     LOG(ERROR) << "number size too small for hex";
     return -1;
   }
   DigitArrayZeroNum(size_a, a);
-  while (n > 0) {
-    b = HexToValue(*(p++));
-    x = (uint64_t)b;
-    real_size_a = DigitArrayComputedSize(size_a, a);
-    DigitArrayMultBy(size_a, real_size_a, a, 16ULL);
-    real_size_a = DigitArrayComputedSize(size_a, a);
-    DigitArrayAddTo(size_a, real_size_a, a, 1, &x);
-    n--;
+  // the last character is the low nibble of a[0]
+  for (i = 0; i < n; i++) {
+    x = (uint64_t)HexToValue(s[n - 1 - i]) & 0xfULL;
+    a[i / 16] |= x << (4 * (i % 16));
   }
   return DigitArrayComputedSize(size_a, a);
 }
 
+// 1 if the unrolled kernels in fixed_arith.h are used for their sizes
+int digit_array_use_fixed = 1;
+
+#define FIXED_SIZE_CASES(op) \
+  case 4: op(4); return true; \
+  case 6: op(6); return true; \
+  case 8: op(8); return true; \
+  case 16: op(16); return true; \
+  case 32: op(32); return true; \
+  case 64: op(64); return true; \
+  default: return false;
+
+//  Each of these runs the fixed_arith.h kernel for n digits and returns
+//  true, or returns false if there is no kernel for n.
+bool FixedSizeAdd(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* carry) {
+#define FIXED_ADD(k) *carry = FixedAdd<k>(a, b, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_ADD) }
+#undef FIXED_ADD
+}
+
+bool FixedSizeSub(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* borrow) {
+#define FIXED_SUB(k) *borrow = FixedSub<k>(a, b, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_SUB) }
+#undef FIXED_SUB
+}
+
+bool FixedSizeMult(int n, uint64_t* a, uint64_t* b, uint64_t* r) {
+#define FIXED_MULT(k) FixedMult<k>(a, b, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_MULT) }
+#undef FIXED_MULT
+}
+
+bool FixedSizeSquare(int n, uint64_t* a, uint64_t* r) {
+#define FIXED_SQUARE(k) FixedSquare<k>(a, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_SQUARE) }
+#undef FIXED_SQUARE
+}
+
+bool FixedSizeMontMult(int n, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* r) {
+#define FIXED_MONT_MULT(k) FixedMontMult<k>(a, b, m, m_prime, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_MONT_MULT) }
+#undef FIXED_MONT_MULT
+}
+
+bool FixedSizeMontReduce(int n, uint64_t* t, uint64_t* m, uint64_t m_prime,
+                         uint64_t* r) {
+#define FIXED_MONT_REDUCE(k) FixedMontReduce<k>(t, m, m_prime, r)
+  switch (n) { FIXED_SIZE_CASES(FIXED_MONT_REDUCE) }
+#undef FIXED_MONT_REDUCE
+}
+
+#undef FIXED_SIZE_CASES
+
 // result = a+b.  returns size of result.  Error if <0
 int DigitArrayAdd(int size_a, uint64_t* a, int size_b, uint64_t* b,
                   int size_result, uint64_t* result) {
@@ -357,6 +251,11 @@ int DigitArrayAdd(int size_a, uint64_t* a, int size_b, uint64_t* b,
   int i;
 
   DigitArrayZeroNum(size_result, result);
+  if (size_a == size_b && size_result > size_a && digit_array_use_fixed &&
+      FixedSizeAdd(size_a, a, b, result, &carry_out)) {
+    result[size_a] = carry_out;
+    return DigitArrayComputedSize(size_result, result);
+  }
   for (i = 0; i < size_b; i++) {
     Uint64AddWithCarryStep(a[i], b[i], carry_in, &result[i], &carry_out);
     carry_in = carry_out;
@@ -387,6 +286,9 @@ int DigitArraySub(int size_a, uint64_t* a, int size_b, uint64_t* b,
     return -1;
   }
   DigitArrayZeroNum(size_result, result);
+  if (size_a == size_b && digit_array_use_fixed &&
+      FixedSizeSub(size_a, a, b, result, &borrow_out))
+    return DigitArrayComputedSize(size_result, result);
   for (i = 0; i < size_b; i++) {
     Uint64SubWithBorrowStep(a[i], b[i], borrow_in, &result[i], &borrow_out);
     borrow_in = borrow_out;
@@ -397,3 +299,764 @@ int DigitArraySub(int size_a, uint64_t* a, int size_b, uint64_t* b,
   }
   return DigitArrayComputedSize(size_result, result);
 }
+
+// ------------------------------------------------------------------------
+
+//  Subquadratic multiplication.  DigitArrayMult and DigitArraySquare hand
+//  operands at or above these sizes (in uint64_t digits) to Karatsuba or
+//  Toom-3; the pieces come back through DigitArrayMult, so the asm
+//  schoolbook loop is the base case.  Values are from mult_threshold_test.
+int karatsuba_mult_threshold = 32;
+int toom3_mult_threshold = 192;
+
+// r= a+b, n digits each, returns the carry.  r may be a or b.
+static uint64_t DigitsAdd(int n, uint64_t* a, uint64_t* b, uint64_t* r) {
+  uint64_t carry = 0ULL;
+  for (int i = 0; i < n; i++) {
+    uint128_t t = (uint128_t)a[i] + b[i] + carry;
+    r[i] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+  return carry;
+}
+
+// r= a-b, n digits each, returns the borrow.  r may be a or b.
+static uint64_t DigitsSub(int n, uint64_t* a, uint64_t* b, uint64_t* r) {
+  uint64_t borrow = 0ULL;
+  for (int i = 0; i < n; i++) {
+    uint128_t t = (uint128_t)a[i] - b[i] - borrow;
+    r[i] = (uint64_t)t;
+    borrow = (uint64_t)(t >> 64) & 1ULL;
+  }
+  return borrow;
+}
+
+// a+= b, size_b <= size_a, carries propagate through a.  returns the carry.
+static uint64_t DigitsAddTo(int size_a, uint64_t* a, int size_b, uint64_t* b) {
+  uint64_t carry = DigitsAdd(size_b, a, b, a);
+  for (int i = size_b; carry != 0ULL && i < size_a; i++) {
+    a[i]++;
+    carry = a[i] == 0ULL ? 1ULL : 0ULL;
+  }
+  return carry;
+}
+
+// a-= b, size_b <= size_a, a >= b
+static void DigitsSubFrom(int size_a, uint64_t* a, int size_b, uint64_t* b) {
+  uint64_t borrow = DigitsSub(size_b, a, b, a);
+  for (int i = size_b; borrow != 0ULL && i < size_a; i++) {
+    borrow = a[i] == 0ULL ? 1ULL : 0ULL;
+    a[i]--;
+  }
+}
+
+// r= a*b (or a*a when a == b) into a zeroed size_a+size_b digit area
+static void DigitsProduct(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                          uint64_t* r) {
+  DigitArrayZeroNum(size_a + size_b, r);
+  size_a = DigitArrayComputedSize(size_a, a);
+  size_b = DigitArrayComputedSize(size_b, b);
+  if ((size_a == 1 && a[0] == 0ULL) || (size_b == 1 && b[0] == 0ULL))
+    return;
+  if (a == b && size_a == size_b)
+    DigitArraySquare(size_a, a, 2 * size_a, r);
+  else
+    DigitArrayMult(size_a, a, size_b, b, size_a + size_b, r);
+}
+
+//  Signed magnitude helpers for Toom-3 interpolation, n digits each
+static void SignedAddTo(int n, uint64_t* a, bool* a_neg, uint64_t* b,
+                        bool b_neg) {
+  if (*a_neg == b_neg) {
+    DigitsAdd(n, a, b, a);
+    return;
+  }
+  if (DigitArrayCompare(n, a, n, b) >= 0) {
+    DigitsSub(n, a, b, a);
+  } else {
+    DigitsSub(n, b, a, a);
+    *a_neg = b_neg;
+  }
+  if (DigitArrayIsZero(n, a))
+    *a_neg = false;
+}
+
+static void ShiftRightOne(int n, uint64_t* a) {
+  for (int i = 0; i < (n - 1); i++) a[i] = (a[i] >> 1) | (a[i + 1] << 63);
+  a[n - 1] >>= 1;
+}
+
+// a/= 3, the division is exact
+static void DivideByThree(int n, uint64_t* a) {
+  uint64_t rem = 0ULL;
+  for (int i = (n - 1); i >= 0; i--) {
+    uint128_t t = ((uint128_t)rem << 64) | a[i];
+    a[i] = (uint64_t)(t / 3);
+    rem = (uint64_t)(t % 3);
+  }
+}
+
+//  result= a*b, result has size_result >= size_a+size_b digits.
+//    a= a1 B^h + a0, b= b1 B^h + b0
+//    a*b= a1 b1 B^2h + ((a0+a1)(b0+b1) - a0 b0 - a1 b1) B^h + a0 b0
+//  Unbalanced operands are cut into pieces the size of the smaller one.
+int DigitArrayKaratsubaMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                            int size_result, uint64_t* result) {
+  if (size_b > size_a)
+    return DigitArrayKaratsubaMult(size_b, b, size_a, a, size_result, result);
+  if ((size_a + size_b) > size_result) {
+    LOG(ERROR) << "DigitArrayKaratsubaMult: result is too small\n";
+    return -1;
+  }
+  DigitArrayZeroNum(size_result, result);
+  if (size_b < 2) {
+    DigitsProduct(size_a, a, size_b, b, result);
+    return DigitArrayComputedSize(size_result, result);
+  }
+
+  // scratch grows with the operands, so it comes from the thread's arena
+  // rather than the stack
+  ScratchFrame frame;
+  int h = (size_a + 1) / 2;
+  if (size_b <= h) {
+    uint64_t* t = frame.Alloc(2 * size_b);
+    for (int off = 0; off < size_a; off += size_b) {
+      int len = (size_a - off) < size_b ? (size_a - off) : size_b;
+      DigitsProduct(len, a + off, size_b, b, t);
+      DigitsAddTo(size_result - off, result + off, len + size_b, t);
+    }
+    return DigitArrayComputedSize(size_result, result);
+  }
+
+  int size_a1 = size_a - h;
+  int size_b1 = size_b - h;
+  bool square = a == b && size_a == size_b;
+  uint64_t* sa = frame.Alloc(h + 1);
+  uint64_t* sb = frame.Alloc(h + 1);
+  uint64_t* z1 = frame.Alloc(2 * h + 2);
+
+  // z0 in result[0, 2h), z2 in result[2h, size_a+size_b)
+  DigitsProduct(h, a, h, b, result);
+  DigitsProduct(size_a1, a + h, size_b1, b + h, result + 2 * h);
+
+  DigitArrayZeroNum(h + 1, sa);
+  DigitArrayCopy(h, a, h + 1, sa);
+  sa[h] = DigitsAddTo(h, sa, size_a1, a + h);
+  if (square) {
+    DigitsProduct(h + 1, sa, h + 1, sa, z1);
+  } else {
+    DigitArrayZeroNum(h + 1, sb);
+    DigitArrayCopy(h, b, h + 1, sb);
+    sb[h] = DigitsAddTo(h, sb, size_b1, b + h);
+    DigitsProduct(h + 1, sa, h + 1, sb, z1);
+  }
+  DigitsSubFrom(2 * h + 2, z1, 2 * h, result);
+  DigitsSubFrom(2 * h + 2, z1, size_a1 + size_b1, result + 2 * h);
+  DigitsAddTo(size_result - h, result + h,
+              DigitArrayComputedSize(2 * h + 2, z1), z1);
+  return DigitArrayComputedSize(size_result, result);
+}
+
+//  result= a*b by Toom-3, operands cut into three k digit pieces
+//    evaluated at 0, 1, -1, -2 and infinity and interpolated as in
+//    Bodrato, "Towards Optimal Toom-Cook Multiplication".
+int DigitArrayToom3Mult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                        int size_result, uint64_t* result) {
+  if (size_b > size_a)
+    return DigitArrayToom3Mult(size_b, b, size_a, a, size_result, result);
+  int k = (size_a + 2) / 3;
+  if (size_b <= 2 * k)
+    return DigitArrayKaratsubaMult(size_a, a, size_b, b, size_result, result);
+  if ((size_a + size_b) > size_result) {
+    LOG(ERROR) << "DigitArrayToom3Mult: result is too small\n";
+    return -1;
+  }
+
+  bool square = a == b && size_a == size_b;
+  int ke = k + 1;       // evaluated pieces
+  int kw = 2 * k + 3;   // products and interpolation
+  ScratchFrame frame;   // as in DigitArrayKaratsubaMult
+  uint64_t* pa = frame.Alloc(3 * k);
+  uint64_t* pb = frame.Alloc(3 * k);
+  uint64_t* ea = frame.Alloc(4 * ke);  // a(1), a(-1), a(-2), scratch
+  uint64_t* eb = frame.Alloc(4 * ke);
+  bool ea_neg[3] = {false, false, false};
+  bool eb_neg[3] = {false, false, false};
+  uint64_t* r = frame.Alloc(5 * kw);   // r(0), r(1), r(-1), r(-2), r(inf)
+  bool r_neg[5] = {false, false, false, false, false};
+  uint64_t* t = frame.Alloc(kw);
+  int i, j;
+
+  DigitArrayZeroNum(3 * k, pa);
+  DigitArrayCopy(size_a, a, 3 * k, pa);
+  DigitArrayZeroNum(3 * k, pb);
+  DigitArrayCopy(size_b, b, 3 * k, pb);
+
+  for (j = 0; j < (square ? 1 : 2); j++) {
+    uint64_t* p = j == 0 ? pa : pb;
+    uint64_t* e = j == 0 ? ea : eb;
+    bool* e_neg = j == 0 ? ea_neg : eb_neg;
+    uint64_t* p0 = e + 3 * ke;
+
+    DigitArrayZeroNum(4 * ke, e);
+    // scratch= p0 + p2, a(1)= scratch + p1, a(-1)= scratch - p1
+    DigitArrayCopy(k, p, ke, p0);
+    p0[k] = DigitsAdd(k, p, p + 2 * k, p0);
+    DigitArrayCopy(ke, p0, ke, e);
+    DigitsAddTo(ke, e, k, p + k);
+    DigitArrayCopy(ke, p0, ke, e + ke);
+    DigitArrayZeroNum(ke, p0);
+    DigitArrayCopy(k, p + k, ke, p0);
+    SignedAddTo(ke, e + ke, &e_neg[1], p0, true);
+    // a(-2)= 2 (a(-1) + p2) - p0
+    DigitArrayCopy(ke, e + ke, ke, e + 2 * ke);
+    e_neg[2] = e_neg[1];
+    DigitArrayZeroNum(ke, p0);
+    DigitArrayCopy(k, p + 2 * k, ke, p0);
+    SignedAddTo(ke, e + 2 * ke, &e_neg[2], p0, false);
+    DigitsAdd(ke, e + 2 * ke, e + 2 * ke, e + 2 * ke);
+    DigitArrayZeroNum(ke, p0);
+    DigitArrayCopy(k, p, ke, p0);
+    SignedAddTo(ke, e + 2 * ke, &e_neg[2], p0, true);
+  }
+  if (square) {
+    for (i = 0; i < 3; i++) eb_neg[i] = ea_neg[i];
+  }
+  uint64_t* sb = square ? ea : eb;
+
+  DigitArrayZeroNum(5 * kw, r);
+  DigitsProduct(k, pa, k, pb, r);
+  for (i = 0; i < 3; i++) {
+    if (square)
+      DigitsProduct(ke, ea + i * ke, ke, ea + i * ke, r + (i + 1) * kw);
+    else
+      DigitsProduct(ke, ea + i * ke, ke, sb + i * ke, r + (i + 1) * kw);
+    r_neg[i + 1] = ea_neg[i] != eb_neg[i];
+    if (DigitArrayIsZero(kw, r + (i + 1) * kw))
+      r_neg[i + 1] = false;
+  }
+  DigitsProduct(size_a - 2 * k, pa + 2 * k, size_b - 2 * k, pb + 2 * k,
+                r + 4 * kw);
+
+  uint64_t* r0 = r;
+  uint64_t* r1 = r + kw;
+  uint64_t* r2 = r + 2 * kw;
+  uint64_t* r3 = r + 3 * kw;
+  uint64_t* r4 = r + 4 * kw;
+  bool* n1 = &r_neg[1];
+  bool* n2 = &r_neg[2];
+  bool* n3 = &r_neg[3];
+
+  // r3= (r(-2) - r(1))/3
+  SignedAddTo(kw, r3, n3, r1, !*n1);
+  DivideByThree(kw, r3);
+  // r1= (r(1) - r(-1))/2
+  SignedAddTo(kw, r1, n1, r2, !*n2);
+  ShiftRightOne(kw, r1);
+  // r2= r(-1) - r(0)
+  SignedAddTo(kw, r2, n2, r0, true);
+  // r3= (r2 - r3)/2 + 2 r(inf)
+  DigitArrayCopy(kw, r2, kw, t);
+  bool t_neg = *n2;
+  SignedAddTo(kw, t, &t_neg, r3, !*n3);
+  ShiftRightOne(kw, t);
+  DigitArrayCopy(kw, t, kw, r3);
+  *n3 = t_neg;
+  SignedAddTo(kw, r3, n3, r4, false);
+  SignedAddTo(kw, r3, n3, r4, false);
+  // r2= r2 + r1 - r(inf)
+  SignedAddTo(kw, r2, n2, r1, *n1);
+  SignedAddTo(kw, r2, n2, r4, true);
+  // r1= r1 - r3
+  SignedAddTo(kw, r1, n1, r3, !*n3);
+
+  DigitArrayZeroNum(size_result, result);
+  for (i = 0; i < 5; i++) {
+    uint64_t* c = r + i * kw;
+    int n = DigitArrayComputedSize(kw, c);
+    if ((i * k + n) > size_result)
+      n = size_result - i * k;
+    if (n > 0)
+      DigitsAddTo(size_result - i * k, result + i * k, n, c);
+  }
+  return DigitArrayComputedSize(size_result, result);
+}
+
+// ------------------------------------------------------------------------
+
+//  Division.  Divisors below newton_division_threshold digits use Knuth's
+//  algorithm D with a Moller-Granlund 3-by-2 step per quotient digit;
+//  larger ones multiply by a Newton reciprocal, so the cost follows
+//  DigitArrayMult.  Value from div_threshold_test.
+int newton_division_threshold = 256;
+
+// Reciprocals below this size are computed by schoolbook division
+#define NEWTON_BASE_DIGITS 16
+
+// r[0, n]= a << s, 0 <= s < 64
+static void DigitsShiftLeft(int n, uint64_t* a, int s, uint64_t* r) {
+  r[n] = s == 0 ? 0ULL : a[n - 1] >> (NBITSINUINT64 - s);
+  for (int i = n - 1; i > 0; i--)
+    r[i] = s == 0 ? a[i] : (a[i] << s) | (a[i - 1] >> (NBITSINUINT64 - s));
+  r[0] = a[0] << s;
+}
+
+//  u[0, m+n]/d, d has n >= 2 digits and its top bit set, v=
+//  Uint64Reciprocal3By2(d[n-1], d[n-2]) and u[m+1, m+n] < d.  The m+1
+//  quotient digits go to q and the remainder is left in u[0, n).
+//  u - q d is computed as u + q dbar + q - q B^n with dbar= B^n-1-d, so
+//  each row is a DigitArrayMultAdd.
+static void DigitsDivNormalized(int m, int n, uint64_t* u, uint64_t* d,
+                                uint64_t v, uint64_t* q) {
+  uint64_t d1 = d[n - 1];
+  uint64_t d0 = d[n - 2];
+  uint64_t dbar[n];
+  uint64_t qhat, r1, r0, carry, c;
+  uint128_t t;
+  bool negative;
+  int i, j;
+
+  for (i = 0; i < n; i++) dbar[i] = ~d[i];
+  for (j = m; j >= 0; j--) {
+    if (u[j + n] == d1 && u[j + n - 1] == d0)
+      qhat = 0xffffffffffffffffULL;
+    else
+      Uint64DivStep3By2(u[j + n], u[j + n - 1], u[j + n - 2], d1, d0, v,
+                        &qhat, &r1, &r0);
+    carry = DigitArrayMultAdd(qhat, n, dbar, &u[j]);
+    c = qhat;
+    for (i = j; i < (j + n) && c != 0ULL; i++) {
+      u[i] += c;
+      c = u[i] < c ? 1ULL : 0ULL;
+    }
+    t = (uint128_t)u[j + n] + carry + c;
+    negative = t < (uint128_t)qhat;
+    u[j + n] = (uint64_t)(t - qhat);
+    // qhat is at most one too large, add back
+    while (negative) {
+      qhat--;
+      carry = DigitsAdd(n, &u[j], d, &u[j]);
+      u[j + n] += carry;
+      negative = !(carry != 0ULL && u[j + n] == 0ULL);
+    }
+    q[j] = qhat;
+  }
+}
+
+//  x[0, n]= B^n + x', A x < B^(2n) <= A (x+2), B= 2^64, for A= a[0, n)
+//  with its top bit set.  Brent and Zimmermann, "Modern Computer
+//  Arithmetic", algorithm 3.5: the top h digits give a reciprocal of half
+//  the precision and one Newton step doubles it.
+static void DigitsReciprocal(int n, uint64_t* a, uint64_t* x) {
+  if (n <= NEWTON_BASE_DIGITS) {
+    uint64_t u[2 * n + 1];
+    for (int i = 0; i < 2 * n; i++) u[i] = 0xffffffffffffffffULL;
+    u[2 * n] = 0ULL;
+    DigitsDivNormalized(n, n, u, a, Uint64Reciprocal3By2(a[n - 1], a[n - 2]),
+                        x);
+    return;
+  }
+
+  int l = (n - 1) / 2;
+  int h = n - l;
+  uint64_t xh[h + 1];
+  uint64_t t[n + h + 1];
+  uint64_t w[2 * h + 2];
+  uint64_t one = 1ULL;
+
+  DigitsReciprocal(h, a + l, xh);
+  DigitsProduct(n, a, h + 1, xh, t);
+  while (t[n + h] != 0ULL) {
+    DigitsSubFrom(h + 1, xh, 1, &one);
+    DigitsSubFrom(n + h + 1, t, n, a);
+  }
+  // t= B^(n+h) - t
+  for (int i = 0; i < (n + h); i++) t[i] = ~t[i];
+  DigitsAddTo(n + h, t, 1, &one);
+  // x= xh B^l + floor((t/B^l) xh / B^(2h-l))
+  DigitsProduct(h + 1, t + l, h + 1, xh, w);
+  DigitArrayZeroNum(n + 1, x);
+  DigitArrayCopy(h + 1, xh, h + 1, x + l);
+  DigitsAddTo(n + 1, x, l + 2, w + 2 * h - l);
+}
+
+//  y[0, n+len)= y/d for y < d B^len, len <= n, x= DigitsReciprocal(d).
+//  The len quotient digits go to q and the remainder to y[0, n).
+static void DigitsBarrettStep(int len, uint64_t* y, int n, uint64_t* d,
+                              uint64_t* x, uint64_t* q) {
+  uint64_t p[len + n + 2];
+  uint64_t qd[len + n + 1];
+  uint64_t est[len + 1];
+  uint64_t one = 1ULL;
+
+  // est= floor(floor(y/B^(n-1)) x / B^(n+1)), at most a few below y/d
+  DigitsProduct(len + 1, y + n - 1, n + 1, x, p);
+  DigitArrayCopy(len + 1, p + n + 1, len + 1, est);
+  DigitsProduct(len + 1, est, n, d, qd);
+  DigitsSubFrom(n + len, y, n + len, qd);
+  while (DigitArrayCompare(n + len, y, n, d) >= 0) {
+    DigitsSubFrom(n + len, y, n, d);
+    DigitsAddTo(len + 1, est, 1, &one);
+  }
+  DigitArrayCopy(len, est, len, q);
+}
+
+//  Newton division, see DigitsReciprocal.  u= a<<s has size_u digits,
+//  d= b<<s has n.  The quotient goes to q, the remainder to u[0, n).
+//  Remainders carried between chunks of at most n digits are below d, so
+//  each chunk is one DigitsBarrettStep, or a short DigitsDivNormalized
+//  when it has only a few digits.
+static void DigitsNewtonDivide(int size_u, uint64_t* u, int n, uint64_t* d,
+                               uint64_t* q) {
+  uint64_t x[n + 1];
+  uint64_t y[2 * n];
+  uint64_t v = Uint64Reciprocal3By2(d[n - 1], d[n - 2]);
+  int pos, len, i;
+
+  DigitsReciprocal(n, d, x);
+  if (DigitArrayCompare(n, u + size_u - n, n, d) < 0)
+    pos = size_u - n;
+  else
+    pos = size_u - n + 1;
+  DigitArrayZeroNum(2 * n, y);
+  for (i = pos; i < size_u; i++) y[n + i - pos] = u[i];
+  // remainder so far in y[n, 2n)
+  while (pos > 0) {
+    len = pos - n * ((pos - 1) / n);
+    pos -= len;
+    for (i = 0; i < n; i++) y[len + i] = y[n + i];
+    for (i = 0; i < len; i++) y[i] = u[pos + i];
+    if (4 * len < n)
+      DigitsDivNormalized(len - 1, n, y, d, v, q + pos);
+    else
+      DigitsBarrettStep(len, y, n, d, x, q + pos);
+    for (i = n - 1; i >= 0; i--) y[n + i] = y[i];
+  }
+  for (i = 0; i < n; i++) u[i] = y[n + i];
+}
+
+// q= a/b. r is remainder.
+bool DigitArrayDivisionAlgorithm(int size_a, uint64_t* a, int size_b,
+                                 uint64_t* b, int* size_q, uint64_t* q,
+                                 int* size_r, uint64_t* r) {
+  int real_size_a = DigitArrayComputedSize(size_a, a);
+  int real_size_b = DigitArrayComputedSize(size_b, b);
+
+  if (real_size_b == 1) {
+    if (b[0] == 0ULL) {
+      LOG(ERROR) << "b[0]==0 DigitArrayDivisionAlgorithm failure\n";
+      return false;
+    }
+    return DigitArrayShortDivisionAlgorithm(real_size_a, a, b[0], size_q, q,
+                                            &r[0]);
+  }
+
+  DigitArrayZeroNum(*size_q, q);
+  DigitArrayZeroNum(*size_r, r);
+  if (DigitArrayCompare(real_size_a, a, real_size_b, b) < 0) {
+    if (!DigitArrayCopy(real_size_a, a, *size_r, r)) {
+      LOG(ERROR) << "DigitArrayCopy 1 error\n";
+      return false;
+    }
+    *size_q = 1;
+    *size_r = DigitArrayComputedSize(*size_r, r);
+    return true;
+  }
+
+  int n = real_size_b;
+  int m = real_size_a - n;
+  int s = shift_to_top_bit(b[n - 1]);
+  uint64_t d[n + 1];
+  uint64_t u[real_size_a + 1];
+  uint64_t quot[m + 2];
+  int i;
+
+  DigitsShiftLeft(n, b, s, d);
+  DigitsShiftLeft(real_size_a, a, s, u);
+  DigitArrayZeroNum(m + 2, quot);
+  if (n >= newton_division_threshold)
+    DigitsNewtonDivide(real_size_a + 1, u, n, d, quot);
+  else
+    DigitsDivNormalized(m, n, u, d, Uint64Reciprocal3By2(d[n - 1], d[n - 2]),
+                        quot);
+
+  // remainder= u[0, n) >> s
+  uint64_t rem[n];
+  for (i = 0; i < (n - 1); i++)
+    rem[i] = s == 0 ? u[i] : (u[i] >> s) | (u[i + 1] << (NBITSINUINT64 - s));
+  rem[n - 1] = u[n - 1] >> s;
+  int nq = DigitArrayComputedSize(m + 2, quot);
+  int nr = DigitArrayComputedSize(n, rem);
+  if (!DigitArrayCopy(nq, quot, *size_q, q) ||
+      !DigitArrayCopy(nr, rem, *size_r, r)) {
+    LOG(ERROR) << "DigitArrayDivisionAlgorithm: output too small\n";
+    return false;
+  }
+  *size_q = DigitArrayComputedSize(*size_q, q);
+  *size_r = DigitArrayComputedSize(*size_r, r);
+  return true;
+}
+
+//  Radix conversion.  Decimal strings are handled as base 10^19 digits.
+//  Numbers of more than radix_conversion_threshold such digits are split
+//  at a cached power (10^19)^(2^k): ToDecimal divides by it and converts
+//  quotient and remainder, FromDecimal converts the two halves of the
+//  string and combines them with one multiplication.  With Newton division
+//  both cost O(M(n) log n) rather than O(n^2).
+int radix_conversion_threshold = 32;
+
+#define DECIMAL_CHUNK 10000000000000000000ULL
+#define DECIMAL_CHUNK_DIGITS 19
+#define MAX_DECIMAL_POWERS 40
+#define DECIMAL_FILE_BUFFER 4096
+
+static std::mutex decimal_powers_lock;
+static int num_decimal_powers = 0;
+static int decimal_power_size[MAX_DECIMAL_POWERS];
+static uint64_t* decimal_powers[MAX_DECIMAL_POWERS];
+
+// (10^19)^(2^k), computed on first use and kept
+static uint64_t* DecimalPower(int k, int* size) {
+  std::lock_guard<std::mutex> guard(decimal_powers_lock);
+
+  if (num_decimal_powers == 0) {
+    decimal_powers[0] = new uint64_t[1];
+    decimal_powers[0][0] = DECIMAL_CHUNK;
+    decimal_power_size[0] = 1;
+    num_decimal_powers = 1;
+  }
+  while (num_decimal_powers <= k) {
+    int j = num_decimal_powers;
+    int n = 2 * decimal_power_size[j - 1];
+    decimal_powers[j] = new uint64_t[n];
+    DigitsProduct(decimal_power_size[j - 1], decimal_powers[j - 1],
+                  decimal_power_size[j - 1], decimal_powers[j - 1],
+                  decimal_powers[j]);
+    decimal_power_size[j] = DigitArrayComputedSize(n, decimal_powers[j]);
+    num_decimal_powers++;
+  }
+  *size = decimal_power_size[k];
+  return decimal_powers[k];
+}
+
+//  Takes decimal digits most significant first, drops leading zeros and
+//  stores the rest in a string or, through a small buffer, a file.
+class DecimalWriter {
+ public:
+  DecimalWriter(int size_s, char* s)
+      : out_(s), size_(size_s), used_(0), count_(0), started_(false),
+        file_(nullptr) {}
+  DecimalWriter(WriteFile* file)
+      : out_(buf_), size_(DECIMAL_FILE_BUFFER), used_(0), count_(0),
+        started_(false), file_(file) {}
+
+  bool Put(int n, const char* digits) {
+    for (int i = 0; i < n; i++) {
+      if (!started_ && digits[i] == '0')
+        continue;
+      started_ = true;
+      if (!Store(digits[i]))
+        return false;
+    }
+    return true;
+  }
+
+  bool PutZeros(int n) {
+    for (int i = 0; started_ && i < n; i++) {
+      if (!Store('0'))
+        return false;
+    }
+    return true;
+  }
+
+  // *size is the number of digits
+  bool Finish(int* size) {
+    if (!started_ && !Store('0'))
+      return false;
+    *size = count_;
+    if (file_ != nullptr)
+      return file_->Write(used_, (byte*)out_);
+    out_[used_] = 0;
+    return true;
+  }
+
+ private:
+  // a string keeps one place for the terminating 0
+  bool Store(char c) {
+    if (file_ == nullptr && used_ >= (size_ - 1))
+      return false;
+    if (file_ != nullptr && used_ >= size_) {
+      if (!file_->Write(used_, (byte*)out_))
+        return false;
+      used_ = 0;
+    }
+    out_[used_++] = c;
+    count_++;
+    return true;
+  }
+
+  char* out_;
+  int size_;
+  int used_;
+  int count_;
+  bool started_;
+  WriteFile* file_;
+  char buf_[DECIMAL_FILE_BUFFER];
+};
+
+// a < (10^19)^chunks, writes exactly 19 chunks digits
+static bool DecimalLeaf(int size_a, uint64_t* a, int chunks, DecimalWriter* w) {
+  uint64_t t[size_a];
+  char digits[DECIMAL_CHUNK_DIGITS * chunks];
+  int m = DigitArrayComputedSize(size_a, a);
+  uint64_t r;
+  int i, j;
+
+  for (i = 0; i < m; i++) t[i] = a[i];
+  if (m == 1 && t[0] == 0ULL)
+    m = 0;
+  for (i = chunks - 1; i >= 0; i--) {
+    r = 0ULL;
+    if (m > 0) {
+      int size_q = m;
+      DigitArrayShortDivisionAlgorithm(m, t, DECIMAL_CHUNK, &size_q, t, &r);
+      m = t[m - 1] == 0ULL ? m - 1 : m;
+    }
+    for (j = DECIMAL_CHUNK_DIGITS - 1; j >= 0; j--) {
+      digits[DECIMAL_CHUNK_DIGITS * i + j] = (char)(r % 10ULL) + '0';
+      r /= 10ULL;
+    }
+  }
+  return w->Put(DECIMAL_CHUNK_DIGITS * chunks, digits);
+}
+
+// a < (10^19)^(2^k), writes exactly 19 (2^k) digits
+static bool DecimalConvert(int size_a, uint64_t* a, int k, DecimalWriter* w) {
+  int chunks = 1 << k;
+  int size_p;
+  uint64_t* p;
+
+  size_a = DigitArrayComputedSize(size_a, a);
+  if (chunks <= radix_conversion_threshold || (size_a == 1 && a[0] == 0ULL)) {
+    if (size_a == 1 && a[0] == 0ULL)
+      return w->PutZeros(DECIMAL_CHUNK_DIGITS * chunks);
+    return DecimalLeaf(size_a, a, chunks, w);
+  }
+  p = DecimalPower(k - 1, &size_p);
+  if (DigitArrayCompare(size_a, a, size_p, p) < 0) {
+    if (!w->PutZeros(DECIMAL_CHUNK_DIGITS * (chunks / 2)))
+      return false;
+    return DecimalConvert(size_a, a, k - 1, w);
+  }
+
+  int size_q = size_a - size_p + 2;
+  int size_r = size_p + 1;
+  uint64_t* q = new uint64_t[size_q];
+  uint64_t* r = new uint64_t[size_r];
+  bool ret = DigitArrayDivisionAlgorithm(size_a, a, size_p, p, &size_q, q,
+                                         &size_r, r) &&
+             DecimalConvert(size_q, q, k - 1, w) &&
+             DecimalConvert(size_r, r, k - 1, w);
+  delete []q;
+  delete []r;
+  return ret;
+}
+
+static bool DigitArrayToDecimalWriter(int size_a, uint64_t* a,
+                                      DecimalWriter* w, int* size_s) {
+  int k = 0;
+  int size_p;
+  uint64_t* p = DecimalPower(0, &size_p);
+
+  size_a = DigitArrayComputedSize(size_a, a);
+  while (DigitArrayCompare(size_a, a, size_p, p) >= 0)
+    p = DecimalPower(++k, &size_p);
+  if (!DecimalConvert(size_a, a, k, w))
+    return false;
+  return w->Finish(size_s);
+}
+
+//  s gets the decimal digits of a, *size_s is the size of s on entry and
+//  the number of digits on return.
+bool DigitArrayConvertToDecimal(int size_a, uint64_t* a, int* size_s,
+                                char* s) {
+  DecimalWriter w(*size_s, s);
+  return DigitArrayToDecimalWriter(size_a, a, &w, size_s);
+}
+
+//  Writes the decimal digits of a to out as they are produced, so the
+//  whole string is never held in memory.
+bool DigitArrayConvertToDecimalFile(int size_a, uint64_t* a, WriteFile* out) {
+  DecimalWriter* w = new DecimalWriter(out);
+  int n;
+  bool ret = DigitArrayToDecimalWriter(size_a, a, w, &n);
+  delete w;
+  return ret;
+}
+
+// a= s[0, len), len <= 19 (2^k), a has room for 2^k + 2 digits.  Returns size.
+static int DecimalParse(const char* s, int len, int k, uint64_t* a) {
+  int chunks = 1 << k;
+  int half = DECIMAL_CHUNK_DIGITS * (chunks / 2);
+  int i, j, m;
+
+  if (chunks > radix_conversion_threshold && len <= half)
+    return DecimalParse(s, len, k - 1, a);
+  if (chunks <= radix_conversion_threshold) {
+    m = 0;
+    i = 0;
+    while (i < len) {
+      int n = (len - i) % DECIMAL_CHUNK_DIGITS;
+      if (n == 0)
+        n = DECIMAL_CHUNK_DIGITS;
+      uint64_t x = 0ULL;
+      for (j = 0; j < n; j++)
+        x = 10ULL * x + (uint64_t)HexToValue(s[i++]);
+      uint64_t carry = x;
+      for (j = 0; j < m; j++) {
+        uint128_t t = (uint128_t)a[j] * DECIMAL_CHUNK + carry;
+        a[j] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+      }
+      if (carry != 0ULL)
+        a[m++] = carry;
+    }
+    if (m == 0)
+      a[m++] = 0ULL;
+    return m;
+  }
+
+  // a= hi (10^19)^(2^(k-1)) + lo
+  int size_p;
+  uint64_t* p = DecimalPower(k - 1, &size_p);
+  int size_half = chunks / 2 + 2;
+  uint64_t* hi = new uint64_t[size_half];
+  uint64_t* lo = new uint64_t[size_half];
+  int size_hi = DecimalParse(s, len - half, k - 1, hi);
+  int size_lo = DecimalParse(s + len - half, half, k - 1, lo);
+
+  DigitsProduct(size_hi, hi, size_p, p, a);
+  m = size_hi + size_p;
+  DigitsAddTo(m, a, size_lo, lo);
+  delete []hi;
+  delete []lo;
+  return DigitArrayComputedSize(m, a);
+}
+
+int DigitArrayConvertFromDecimal(const char* s, int size_a, uint64_t* a) {
+  int n = strlen(s);
+  int k = 0;
+
+  // a digit holds 19.26 decimal digits, the copy below checks exactly
+  if ((DECIMAL_CHUNK_DIGITS + 1) * size_a < n)
+    return -1;
+  while ((DECIMAL_CHUNK_DIGITS << k) < n) k++;
+  uint64_t* t = new uint64_t[(1 << k) + 2];
+  int m = DecimalParse(s, n, k, t);
+  DigitArrayZeroNum(size_a, a);
+  bool ok = DigitArrayCopy(m, t, size_a, a);
+  delete []t;
+  if (!ok)
+    return -1;
+  return DigitArrayComputedSize(size_a, a);
+}
@@ -57,12 +57,23 @@ string* BigConvertToDecimal(BigNum& a) {
 
 BigNum* BigConvertFromDecimal(const char* in) {
   int k = strlen(in);
-  int m = ((k + 29) / 30) + 6;
+  int m = ((k + 18) / 19) + 2;
   BigNum* n = new BigNum(m);
   n->size_ = DigitArrayConvertFromDecimal(in, n->capacity_, n->value_);
+  if (n->size_ < 0) {
+    LOG(ERROR) << "DigitArrayConvertFromDecimal failed in "
+               << "BigConvertFromDecimal";
+    delete n;
+    return nullptr;
+  }
   return n;
 }
 
+// Streams the decimal digits of a to out
+bool BigConvertToDecimalFile(BigNum& a, WriteFile* out) {
+  return DigitArrayConvertToDecimalFile(a.size_, a.value_, out);
+}
+
 string* BigConvertToHex(BigNum& a) {
   int k = 18 * a.size_;
   char* str = new char[k];
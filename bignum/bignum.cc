@@ -28,42 +28,95 @@
 //  __declspec(align(4)) uint32_t  size_;
 //  __declspec(align(8)) uint64_t* value_;
 
+//  bool      allocated_;
+//  ScratchFrame* frame_;
+//  __declspec(align(8)) uint64_t  inline_[BIGNUM_INLINE_DIGITS + 1];
+
+void BigNum::Allocate(int capacity) {
+  capacity_ = capacity;
+  allocated_ = capacity > BIGNUM_INLINE_DIGITS;
+  frame_ = nullptr;
+  if (allocated_)
+    value_ = new uint64_t[capacity + 1];  // spare digit, see bignum.h
+  else
+    value_ = inline_;
+}
+
 BigNum::BigNum(int size) {
-  value_ = new uint64_t[size];
+  Allocate(size);
+  DigitArrayZeroNum(capacity_, value_);
+  size_ = 1;
+  sign_ = false;
+}
+
+BigNum::BigNum(int size, ScratchFrame& frame) {
   capacity_ = size;
+  allocated_ = false;
+  frame_ = &frame;
+  if (size <= BIGNUM_INLINE_DIGITS)
+    value_ = inline_;
+  else
+    value_ = frame.Alloc(size + 1);
   DigitArrayZeroNum(capacity_, value_);
   size_ = 1;
   sign_ = false;
 }
 
 BigNum::BigNum(int size, uint64_t x) {
-  value_ = new uint64_t[1];
-  capacity_ = 1;
+  Allocate(1);
   size_ = 1;
   value_[0] = x;
   sign_ = false;
 }
 
 BigNum::BigNum(BigNum& n, int capacity) {
-  capacity_ = capacity;
+  Allocate(capacity);
   size_ = n.size_;
   sign_ = n.sign_;
-  value_ = new uint64_t[capacity_];
   CopyFrom(n);
 }
 
 BigNum::BigNum(BigNum& n) {
-  capacity_ = n.capacity_;
+  Allocate(n.capacity_);
   size_ = n.size_;
   sign_ = n.sign_;
-  value_ = new uint64_t[capacity_];
   CopyFrom(n);
 }
 
+//  Takes n's digits; n is left as a one digit zero.  Digits from a frame
+//  are copied, the new number may outlive the frame.
+BigNum::BigNum(BigNum&& n) {
+  size_ = n.size_;
+  sign_ = n.sign_;
+  if (n.IsInline() || n.IsBorrowed()) {
+    Allocate(n.capacity_);
+    DigitArrayCopy(capacity_, n.value_, capacity_, value_);
+    DigitArrayZeroNum(capacity_, n.value_);
+  } else {
+    capacity_ = n.capacity_;
+    allocated_ = true;
+    frame_ = nullptr;
+    value_ = n.value_;
+  }
+  n.value_ = n.inline_;
+  n.inline_[0] = 0ULL;
+  n.allocated_ = false;
+  n.capacity_ = 1;
+  n.size_ = 1;
+  n.sign_ = false;
+}
+
+//  The old value ends up in n and is cleared when n is destroyed.
+BigNum& BigNum::operator=(BigNum&& n) {
+  Swap(n);
+  return *this;
+}
+
 BigNum::~BigNum() {
   if (value_ != nullptr) {
-    DigitArrayZeroNum(capacity_, value_);
-    delete value_;
+    DigitArrayZeroNum(capacity_ + 1, value_);  // the spare digit holds carries
+    if (allocated_)
+      delete[] value_;
     value_ = nullptr;
   }
 }
@@ -130,3 +183,151 @@ bool BigNum::CopyTo(BigNum& other) {
   other.size_ = DigitArrayComputedSize(other.capacity_, other.value_);
   return true;
 }
+
+//  Frame digits only change hands between numbers made in that frame.
+//  Otherwise the values are copied, capacities stay put and each value
+//  has to fit in the other's digits.
+bool BigNum::Swap(BigNum& other) {
+  int t;
+  bool b;
+
+  if ((IsBorrowed() || other.IsBorrowed()) &&
+      (frame_ == nullptr || frame_ != other.frame_)) {
+    if (size_ > other.capacity_ || other.size_ > capacity_) {
+      LOG(ERROR) << "BigNum::Swap: value too large to copy\n";
+      return false;
+    }
+    ScratchFrame frame;
+    uint64_t* digits = frame.Alloc(size_);
+    t = size_;
+    b = sign_;
+    DigitArrayCopy(t, value_, t, digits);
+    CopyFrom(other);
+    DigitArrayZeroNum(other.capacity_, other.value_);
+    DigitArrayCopy(t, digits, other.capacity_, other.value_);
+    other.size_ = t;
+    other.sign_ = b;
+    DigitArrayZeroNum(t, digits);
+    return true;
+  }
+  if (IsInline() && other.IsInline()) {
+    uint64_t digits[BIGNUM_INLINE_DIGITS];
+    DigitArrayCopy(capacity_, inline_, capacity_, digits);
+    DigitArrayCopy(other.capacity_, other.inline_, other.capacity_, inline_);
+    DigitArrayCopy(capacity_, digits, capacity_, other.inline_);
+  } else if (IsInline()) {
+    DigitArrayCopy(capacity_, inline_, capacity_, other.inline_);
+    value_ = other.value_;
+    other.value_ = other.inline_;
+  } else if (other.IsInline()) {
+    DigitArrayCopy(other.capacity_, other.inline_, other.capacity_, inline_);
+    other.value_ = value_;
+    value_ = inline_;
+  } else {
+    uint64_t* p = value_;
+    value_ = other.value_;
+    other.value_ = p;
+  }
+  t = capacity_;
+  capacity_ = other.capacity_;
+  other.capacity_ = t;
+  t = size_;
+  size_ = other.size_;
+  other.size_ = t;
+  b = sign_;
+  sign_ = other.sign_;
+  other.sign_ = b;
+  b = allocated_;
+  allocated_ = other.allocated_;
+  other.allocated_ = b;
+  return true;
+}
+
+// ------------------------------------------------------------------------
+
+//  Default block size in digits (128KB), requests larger than this get a
+//  block of their own.
+#define SCRATCH_BLOCK_DIGITS (1 << 14)
+
+ScratchArena::ScratchArena() {
+  blocks_ = nullptr;
+  num_blocks_ = 0;
+  max_blocks_ = 0;
+  current_ = 0;
+  in_use_ = 0;
+  peak_in_use_ = 0;
+  block_digits_ = 0;
+}
+
+ScratchArena::~ScratchArena() {
+  for (int i = 0; i < num_blocks_; i++) {
+    DigitArrayZeroNum(blocks_[i].size_, blocks_[i].digits_);
+    delete[] blocks_[i].digits_;
+  }
+  delete[] blocks_;
+  blocks_ = nullptr;
+  num_blocks_ = 0;
+}
+
+uint64_t* ScratchArena::Alloc(int num_digits) {
+  // first block at or after current_ with room; blocks past current_ are
+  // empty
+  while (current_ < num_blocks_ &&
+         (blocks_[current_].size_ - blocks_[current_].used_) < num_digits)
+    current_++;
+  if (current_ >= num_blocks_) {
+    if (num_blocks_ >= max_blocks_) {
+      int new_max = max_blocks_ == 0 ? 8 : 2 * max_blocks_;
+      Block* new_blocks = new Block[new_max];
+      for (int i = 0; i < num_blocks_; i++) new_blocks[i] = blocks_[i];
+      delete[] blocks_;
+      blocks_ = new_blocks;
+      max_blocks_ = new_max;
+    }
+    int size = num_digits > SCRATCH_BLOCK_DIGITS ? num_digits
+                                                 : SCRATCH_BLOCK_DIGITS;
+    blocks_[num_blocks_].digits_ = new uint64_t[size];
+    blocks_[num_blocks_].size_ = size;
+    blocks_[num_blocks_].used_ = 0;
+    current_ = num_blocks_++;
+    block_digits_ += size;
+  }
+  uint64_t* p = blocks_[current_].digits_ + blocks_[current_].used_;
+  blocks_[current_].used_ += num_digits;
+  in_use_ += num_digits;
+  if (in_use_ > peak_in_use_)
+    peak_in_use_ = in_use_;
+  return p;
+}
+
+ScratchArena::Mark ScratchArena::GetMark() {
+  Mark mark;
+  mark.block_ = current_;
+  mark.used_ = current_ < num_blocks_ ? blocks_[current_].used_ : 0;
+  mark.in_use_ = in_use_;
+  return mark;
+}
+
+void ScratchArena::Release(Mark& mark) {
+  for (int i = mark.block_ + 1; i <= current_ && i < num_blocks_; i++)
+    blocks_[i].used_ = 0;
+  if (mark.block_ < num_blocks_)
+    blocks_[mark.block_].used_ = mark.used_;
+  current_ = mark.block_;
+  in_use_ = mark.in_use_;
+}
+
+ScratchArena& ThreadScratchArena() {
+  static thread_local ScratchArena arena;
+  return arena;
+}
+
+ScratchFrame::ScratchFrame() : arena_(ThreadScratchArena()) {
+  mark_ = arena_.GetMark();
+}
+
+ScratchFrame::~ScratchFrame() { arena_.Release(mark_); }
+
+uint64_t* ScratchFrame::Alloc(int num_digits) {
+  return arena_.Alloc(num_digits);
+}
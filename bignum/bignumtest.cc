@@ -18,12 +18,16 @@
 #include <gflags/gflags.h>
 #include <stdio.h>
 #include <string>
+#include <thread>
 #include "conversions.h"
 #include "util.h"
 #include "bignum.h"
 #include "intel64_arith.h"
+#include "fixed_arith.h"
 #include "keys.h"
 #include "ecc.h"
+#include "p256.h"
+#include "ecdsa.h"
 
 using namespace std;
 
@@ -700,6 +704,177 @@ bool basic_tests() {
   return true;
 }
 
+// Swap and move between inline and allocated digits
+bool move_tests() {
+  int sizes[] = {1, 4, BIGNUM_INLINE_DIGITS, BIGNUM_INLINE_DIGITS + 1, 64};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int i, j, k;
+
+  for (i = 0; i < num_sizes; i++) {
+    for (j = 0; j < num_sizes; j++) {
+      BigNum a(sizes[i]);
+      BigNum b(sizes[j]);
+      for (k = 0; k < sizes[i]; k++) a.value_[k] = 0x1000ULL + k;
+      for (k = 0; k < sizes[j]; k++) b.value_[k] = 0x2000ULL + k;
+      a.Normalize();
+      b.Normalize();
+      b.sign_ = true;
+      BigNum a_save(a);
+      BigNum b_save(b);
+
+      a.Swap(b);
+      if (a.Capacity() != sizes[j] || b.Capacity() != sizes[i] ||
+          !a.IsNegative() || b.IsNegative() ||
+          DigitArrayCompare(a.size_, a.value_, b_save.size_,
+                            b_save.value_) != 0 ||
+          BigCompare(b, a_save) != 0) {
+        printf("Swap %d, %d fails\n", sizes[i], sizes[j]);
+        return false;
+      }
+      a = std::move(b);
+      if (BigCompare(a, a_save) != 0) {
+        printf("move assignment %d, %d fails\n", sizes[i], sizes[j]);
+        return false;
+      }
+    }
+    BigNum c(sizes[i]);
+    for (k = 0; k < sizes[i]; k++) c.value_[k] = 0x3000ULL + k;
+    c.Normalize();
+    BigNum c_save(c);
+    BigNum d(std::move(c));
+    if (BigCompare(d, c_save) != 0 || !c.IsZero()) {
+      printf("move constructor %d fails\n", sizes[i]);
+      return false;
+    }
+  }
+
+  // frame digits stay in the frame unless both numbers were made there
+  BigNum owned(64);
+  BigNum small(4);
+  {
+    ScratchFrame frame;
+    BigNum e(64, frame);
+    BigNum f(32, frame);
+    for (k = 0; k < 64; k++) e.value_[k] = 0x4000ULL + k;
+    e.Normalize();
+    f.value_[0] = 9ULL;
+    uint64_t* e_digits = e.value_;
+    e.Swap(f);
+    if (f.value_ != e_digits || f.Capacity() != 64 || e.value_[0] != 9ULL) {
+      printf("Swap in one frame fails\n");
+      return false;
+    }
+    if (!owned.Swap(f) || owned.value_ == e_digits || owned.Capacity() != 64 ||
+        owned.value_[63] != 0x4000ULL + 63 || !f.IsZero()) {
+      printf("Swap out of a frame fails\n");
+      return false;
+    }
+    f.CopyFrom(owned);
+    if (small.Swap(f)) {
+      printf("Swap out of a frame into too few digits succeeds\n");
+      return false;
+    }
+    if (!small.Swap(e) || small.value_[0] != 9ULL || !e.IsZero()) {
+      printf("Swap of a small value out of a frame fails\n");
+      return false;
+    }
+    BigNum g(std::move(f));
+    if (g.value_ == e_digits || g.value_[63] != 0x4000ULL + 63 ||
+        !f.IsZero()) {
+      printf("move out of a frame fails\n");
+      return false;
+    }
+  }
+  if (owned.value_[63] != 0x4000ULL + 63) {
+    printf("value swapped out of a frame lost\n");
+    return false;
+  }
+
+  CurvePoint P(4);
+  CurvePoint Q(4);
+  P.x_->value_[0] = 5ULL;
+  Q.x_->value_[0] = 7ULL;
+  BigNum* px = P.x_;
+  P.Swap(Q);
+  if (P.x_->value_[0] != 7ULL || Q.x_->value_[0] != 5ULL || Q.x_ != px) {
+    printf("CurvePoint Swap fails\n");
+    return false;
+  }
+  CurvePoint R(std::move(P));
+  if (R.x_->value_[0] != 7ULL || P.x_ != nullptr) {
+    printf("CurvePoint move fails\n");
+    return false;
+  }
+  return true;
+}
+
+// Frames release in stack order and the peak counter tracks the high water
+bool scratch_arena_tests() {
+  ScratchArena& arena = ThreadScratchArena();
+  int64_t base = arena.InUse();
+  int i;
+
+  arena.ResetPeak();
+  {
+    ScratchFrame outer;
+    BigNum a(100, outer);
+    BigNum b(BIGNUM_INLINE_DIGITS, outer);  // inline, not from the arena
+    // one spare digit per number
+    if (arena.InUse() != base + 101) {
+      printf("arena in use %ld after first frame\n", (long)arena.InUse());
+      return false;
+    }
+    {
+      ScratchFrame inner;
+      // larger than a block
+      BigNum c(3 * arena.BlockDigits() + 10, inner);
+      for (i = 0; i < c.Capacity(); i++) c.value_[i] = (uint64_t)i;
+      c.Normalize();
+      if (!a.IsZero() || c.Size() != c.Capacity()) {
+        printf("arena numbers overlap\n");
+        return false;
+      }
+    }
+    if (arena.InUse() != base + 101) {
+      printf("inner frame not released\n");
+      return false;
+    }
+    BigNum d(100, outer);
+    if (d.value_ != a.value_ + 101) {
+      printf("arena does not reuse released digits\n");
+      return false;
+    }
+  }
+  if (arena.InUse() != base || arena.PeakInUse() <= base + 200) {
+    printf("arena counters wrong %ld %ld\n", (long)arena.InUse(),
+           (long)arena.PeakInUse());
+    return false;
+  }
+
+  BigNum m(16);
+  BigNum e(16);
+  BigNum x(16);
+  BigNum r(64);
+  if (!GetCryptoRand(1024, (byte*)m.value_) ||
+      !GetCryptoRand(1024, (byte*)e.value_) ||
+      !GetCryptoRand(512, (byte*)x.value_)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  m.value_[0] |= 1ULL;
+  m.Normalize();
+  e.Normalize();
+  x.Normalize();
+  arena.ResetPeak();
+  if (!BigModExp(x, e, m, r) || arena.InUse() != base) {
+    printf("BigModExp leaves arena in use\n");
+    return false;
+  }
+  printf("peak arena use for a 1024 bit BigModExp: %ld digits\n",
+         (long)(arena.PeakInUse() - base));
+  return true;
+}
+
 bool convert_tests() {
   printf("\nCONVERT_TESTS\n");
   bool ret = true;
@@ -1110,6 +1285,622 @@ bool square_test() {
   return true;
 }
 
+// mulx/adx kernels against the mulq kernels
+bool mulx_tests() {
+  if (!HaveBmi2Adx())
+    return true;
+  int save_mulx = digit_array_use_mulx;
+  uint64_t a[40];
+  uint64_t b[40];
+  uint64_t r1[80];
+  uint64_t r2[80];
+  uint64_t r3[80];
+  int size_a, size_b, j, k, n, m;
+  bool ret = true;
+
+  for (size_a = 1; size_a < 32 && ret; size_a++) {
+    for (size_b = 1; size_b < 32 && ret; size_b += 3) {
+      if (!GetCryptoRand(size_a * NBITSINUINT64, (byte*)a) ||
+          !GetCryptoRand(size_b * NBITSINUINT64, (byte*)b)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      if ((size_b % 2) == 0)
+        for (j = 0; j < size_a; j++) a[j] = 0xffffffffffffffffULL;
+      digit_array_use_mulx = 0;
+      k = DigitArrayMult(size_a, a, size_b, b, size_a + size_b, r1);
+      digit_array_use_mulx = 1;
+      n = DigitArrayMult(size_a, a, size_b, b, size_a + size_b, r2);
+      if (k != n || DigitArrayCompare(k, r1, n, r2) != 0) {
+        printf("mulx mult %d x %d fails\n", size_a, size_b);
+        ret = false;
+      }
+    }
+    for (j = 0; j < 2 && ret; j++) {
+      digit_array_use_mulx = 0;
+      k = DigitArrayMult(size_a, a, size_a, a, 2 * size_a, r1);
+      digit_array_use_mulx = j;
+      n = DigitArraySquare(size_a, a, 2 * size_a, r2);
+      m = DigitArraySquare(size_a, a, 2 * size_a + 4, r3);
+      if (k != n || k != m || DigitArrayCompare(k, r1, n, r2) != 0 ||
+          DigitArrayCompare(k, r1, m, r3) != 0) {
+        printf("square %d (mulx %d) fails\n", size_a, j);
+        ret = false;
+      }
+    }
+  }
+  // empty rows and squares stop before touching memory
+  for (j = 0; j < 2 && ret; j++) {
+    digit_array_use_mulx = j;
+    r1[0] = 5ULL;
+    if (DigitArrayMultAdd(a[0], 0, a, r1) != 0ULL || r1[0] != 5ULL ||
+        DigitArraySquare(0, a, 2, r2) != 1 || r2[0] != 0ULL) {
+      printf("empty row (mulx %d) fails\n", j);
+      ret = false;
+    }
+  }
+  digit_array_use_mulx = save_mulx;
+  return ret;
+}
+
+// fixed size kernels against the general loops
+bool fixed_kernel_tests() {
+  int sizes[] = {4, 6, 8, 16, 32, 64};
+  int save_fixed = digit_array_use_fixed;
+  uint64_t a[64];
+  uint64_t b[64];
+  uint64_t m[64];
+  uint64_t t[130];
+  uint64_t r1[130];
+  uint64_t r2[130];
+  uint64_t m_prime;
+  int i, j, n, k1, k2;
+  bool ret = true;
+
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(int)) && ret; i++) {
+    n = sizes[i];
+    for (j = 0; j < 20 && ret; j++) {
+      if (!GetCryptoRand(n * NBITSINUINT64, (byte*)a) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)b) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)m)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      if (j == 0) {
+        for (k1 = 0; k1 < n; k1++) a[k1] = 0xffffffffffffffffULL;
+      }
+      m[0] |= 1ULL;
+      m[n - 1] |= 1ULL << 63;
+      a[n - 1] &= ~(1ULL << 63);
+      b[n - 1] &= ~(1ULL << 63);
+      if (j == 0)
+        a[n - 1] = m[n - 1] - 1ULL;
+      uint64_t inv = m[0];
+      for (k1 = 0; k1 < 5; k1++) inv *= 2ULL - m[0] * inv;
+      m_prime = 0ULL - inv;
+
+      // the kernels are called directly since DigitArrayMult only
+      // dispatches to them up to FIXED_MULT_MAX_DIGITS
+      digit_array_use_fixed = 0;
+      k1 = DigitArrayMult(n, a, n, b, 2 * n + 2, r1);
+      FixedSizeMult(n, a, b, r2);
+      k2 = DigitArrayComputedSize(2 * n, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed mult %d fails\n", n);
+        ret = false;
+      }
+      k1 = DigitArraySquare(n, a, 2 * n + 2, r1);
+      FixedSizeSquare(n, a, r2);
+      k2 = DigitArrayComputedSize(2 * n, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed square %d fails\n", n);
+        ret = false;
+      }
+      k1 = DigitArrayAdd(n, a, n, b, n + 1, r1);
+      digit_array_use_fixed = 1;
+      k2 = DigitArrayAdd(n, a, n, b, n + 1, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed add %d fails\n", n);
+        ret = false;
+      }
+      digit_array_use_fixed = 0;
+      k1 = DigitArraySub(n, m, n, a, n, r1);
+      digit_array_use_fixed = 1;
+      k2 = DigitArraySub(n, m, n, a, n, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed sub %d fails\n", n);
+        ret = false;
+      }
+      digit_array_use_fixed = 0;
+      k1 = DigitArrayMontMult(n, a, b, m, m_prime, t, r1);
+      FixedSizeMontMult(n, a, b, m, m_prime, r2);
+      k2 = DigitArrayComputedSize(n, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed MontMult %d fails\n", n);
+        ret = false;
+      }
+      DigitArrayMult(n, a, n, b, 2 * n + 1, t);
+      FixedSizeMontReduce(n, t, m, m_prime, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("fixed MontReduce %d fails\n", n);
+        ret = false;
+      }
+      DigitArrayMult(n, a, n, b, 2 * n + 1, t);
+      k2 = DigitArrayMontReduce(n, t, m, m_prime, r2);
+      if (k1 != k2 || DigitArrayCompare(k1, r1, k2, r2) != 0) {
+        printf("MontReduce %d fails\n", n);
+        ret = false;
+      }
+    }
+  }
+  digit_array_use_fixed = save_fixed;
+  return ret;
+}
+
+bool fixed_kernel_time_test(int num_tests) {
+  printf("\nFIXED_KERNEL_TIME_TEST\n");
+  int sizes[] = {4, 6, 8, 16, 32, 64};
+  int save_fixed = digit_array_use_fixed;
+  uint64_t a[64];
+  uint64_t b[64];
+  uint64_t m[64];
+  uint64_t t[130];
+  uint64_t r[130];
+  uint64_t cycles[2][3];
+  uint64_t start;
+  int i, k, n;
+
+  if (!GetCryptoRand(64 * NBITSINUINT64, (byte*)a) ||
+      !GetCryptoRand(64 * NBITSINUINT64, (byte*)b) ||
+      !GetCryptoRand(64 * NBITSINUINT64, (byte*)m)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  m[0] |= 1ULL;
+  for (i = 0; i < (int)(sizeof(sizes) / sizeof(int)); i++) {
+    n = sizes[i];
+    digit_array_use_fixed = 0;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      DigitArrayMult(n, a, n, b, 2 * n, r);
+    cycles[0][0] = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      DigitArraySquare(n, a, 2 * n, r);
+    cycles[0][1] = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      DigitArrayMontMult(n, a, b, m, 3ULL, t, r);
+    cycles[0][2] = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      FixedSizeMult(n, a, b, r);
+    cycles[1][0] = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      FixedSizeSquare(n, a, r);
+    cycles[1][1] = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (k = 0; k < num_tests; k++)
+      FixedSizeMontMult(n, a, b, m, 3ULL, r);
+    cycles[1][2] = ReadRdtsc() - start;
+    printf("%2d digits, general/fixed: mult %le/%le, square %le/%le, "
+           "mont %le/%le\n", n,
+           ((double)cycles[0][0]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[1][0]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[0][1]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[1][1]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[0][2]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[1][2]) / ((double)(num_tests * cycles_per_second)));
+  }
+  digit_array_use_fixed = save_fixed;
+  printf("END_FIXED_KERNEL_TIME_TEST\n");
+  return true;
+}
+
+// Karatsuba and Toom-3 against the schoolbook loop
+bool fast_mult_tests() {
+  int sizes[] = {24, 25, 31, 32, 47, 64, 100, 144, 150, 200, 301};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int save_karatsuba = karatsuba_mult_threshold;
+  int save_toom3 = toom3_mult_threshold;
+  uint64_t a[301];
+  uint64_t b[301];
+  uint64_t r[602];
+  uint64_t s[602];
+  int64_t in_use = ThreadScratchArena().InUse();
+  int i, j, k, n;
+  bool ret = true;
+
+  for (i = 0; i < num_sizes && ret; i++) {
+    for (j = 0; j < num_sizes && ret; j++) {
+      int size_a = sizes[i];
+      int size_b = sizes[j];
+      if (!GetCryptoRand(size_a * NBITSINUINT64, (byte*)a) ||
+          !GetCryptoRand(size_b * NBITSINUINT64, (byte*)b)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      // all ones digits exercise the carries
+      if (j == 0)
+        for (k = 0; k < size_a; k++) a[k] = 0xffffffffffffffffULL;
+      karatsuba_mult_threshold = 1 << 30;
+      toom3_mult_threshold = 1 << 30;
+      k = DigitArrayMult(size_a, a, size_b, b, size_a + size_b, s);
+      karatsuba_mult_threshold = save_karatsuba;
+      toom3_mult_threshold = save_toom3;
+      n = DigitArrayKaratsubaMult(size_a, a, size_b, b, size_a + size_b, r);
+      if (k != n || DigitArrayCompare(k, s, n, r) != 0) {
+        printf("Karatsuba mult %d x %d fails\n", size_a, size_b);
+        ret = false;
+      }
+      n = DigitArrayToom3Mult(size_a, a, size_b, b, size_a + size_b, r);
+      if (k != n || DigitArrayCompare(k, s, n, r) != 0) {
+        printf("Toom-3 mult %d x %d fails\n", size_a, size_b);
+        ret = false;
+      }
+      // the recursion's scratch comes from the arena and goes back to it
+      if (ThreadScratchArena().InUse() != in_use) {
+        printf("Toom-3 mult %d x %d keeps arena digits\n", size_a, size_b);
+        ret = false;
+      }
+    }
+    karatsuba_mult_threshold = 1 << 30;
+    toom3_mult_threshold = 1 << 30;
+    k = DigitArrayMult(sizes[i], a, sizes[i], a, 2 * sizes[i], s);
+    karatsuba_mult_threshold = save_karatsuba;
+    toom3_mult_threshold = save_toom3;
+    n = DigitArraySquare(sizes[i], a, 2 * sizes[i], r);
+    if (k != n || DigitArrayCompare(k, s, n, r) != 0) {
+      printf("fast square %d fails\n", sizes[i]);
+      ret = false;
+    }
+  }
+  return ret;
+}
+
+// time one level of Karatsuba or Toom-3 over the method below it to place
+// the crossovers
+bool division_tests() {
+  printf("\nDIVISION_TESTS\n");
+  uint64_t d, d0, v, u1, u0, u2, q, r, r1, r0;
+  int save_newton = newton_division_threshold;
+  int i, j, k;
+
+  // 2-by-1 and 3-by-2 steps against 128 bit division
+  for (i = 0; i < 10000; i++) {
+    if (!GetCryptoRand(64, (byte*)&d) || !GetCryptoRand(64, (byte*)&d0) ||
+        !GetCryptoRand(64, (byte*)&u1) || !GetCryptoRand(64, (byte*)&u0) ||
+        !GetCryptoRand(64, (byte*)&u2)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    d |= 1ULL << 63;
+    if (i == 0)
+      d = 1ULL << 63;
+    if (i == 1)
+      d = 0xffffffffffffffffULL;
+    u1 %= d;
+    v = Uint64Reciprocal(d);
+    Uint64DivStep2By1(u1, u0, d, v, &q, &r);
+    uint128_t u = (((uint128_t)u1) << 64) | u0;
+    if (q != (uint64_t)(u / d) || r != (uint64_t)(u % d)) {
+      printf("Uint64DivStep2By1 fails\n");
+      return false;
+    }
+    // (u2:u1) < (d:d0)
+    if (u2 > d || (u2 == d && u1 >= d0))
+      u2 = d - 1;
+    v = Uint64Reciprocal3By2(d, d0);
+    Uint64DivStep3By2(u2, u1, u0, d, d0, v, &q, &r1, &r0);
+    uint128_t dd = (((uint128_t)d) << 64) | d0;
+    uint128_t rr = (((uint128_t)r1) << 64) | r0;
+    // q dd + rr = (u2:u1:u0), checked in 64 bit pieces
+    uint128_t lo = (uint128_t)q * d0 + r0;
+    uint128_t hi = (uint128_t)q * d + r1 + (uint64_t)(lo >> 64);
+    if (rr >= dd || (uint64_t)lo != u0 || (uint64_t)hi != u1 ||
+        (uint64_t)(hi >> 64) != u2) {
+      printf("Uint64DivStep3By2 fails\n");
+      return false;
+    }
+  }
+
+  // schoolbook and Newton division, q b + r = a and r < b
+  int sizes[] = {2, 3, 5, 17, 33, 64, 100, 150};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  for (i = 0; i < num_sizes; i++) {
+    for (j = 0; j < 6; j++) {
+      int n = sizes[i];
+      int size_a = (j % 3 == 0) ? 2 * n : (j % 3 == 1 ? n + 1 : 3 * n + 7);
+      uint64_t a[size_a];
+      uint64_t b[n];
+      uint64_t q1[size_a + 1];
+      uint64_t q2[size_a + 1];
+      uint64_t r1[n + 1];
+      uint64_t r2[n + 1];
+      uint64_t t[size_a + n + 2];
+
+      if (!GetCryptoRand(size_a * NBITSINUINT64, (byte*)a) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)b)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      if (j == 3)
+        b[n - 1] = 1ULL;
+      if (j == 4)
+        for (k = 0; k < n; k++) b[k] = 0xffffffffffffffffULL;
+      if (j == 5)
+        b[n - 1] >>= 17;
+      if (b[n - 1] == 0ULL)
+        b[n - 1] = 1ULL;
+
+      int size_q1 = size_a + 1, size_r1 = n + 1;
+      int size_q2 = size_a + 1, size_r2 = n + 1;
+      newton_division_threshold = 1 << 30;
+      bool ok1 = DigitArrayDivisionAlgorithm(size_a, a, n, b, &size_q1, q1,
+                                             &size_r1, r1);
+      newton_division_threshold = 2;
+      bool ok2 = DigitArrayDivisionAlgorithm(size_a, a, n, b, &size_q2, q2,
+                                             &size_r2, r2);
+      newton_division_threshold = save_newton;
+      if (!ok1 || !ok2 || DigitArrayCompare(size_q1, q1, size_q2, q2) != 0 ||
+          DigitArrayCompare(size_r1, r1, size_r2, r2) != 0) {
+        printf("division %d/%d digits: schoolbook and Newton differ\n",
+               size_a, n);
+        return false;
+      }
+      if (DigitArrayCompare(size_r1, r1, n, b) >= 0) {
+        printf("division %d/%d digits: remainder too large\n", size_a, n);
+        return false;
+      }
+      DigitArrayZeroNum(size_a + n + 2, t);
+      DigitArrayMult(size_q1, q1, n, b, size_a + n + 2, t);
+      DigitArrayAddTo(size_a + n + 2, DigitArrayComputedSize(size_a + n + 2, t),
+                      t, size_r1, r1);
+      if (DigitArrayCompare(size_a + n + 2, t, size_a, a) != 0) {
+        printf("division %d/%d digits: q b + r != a\n", size_a, n);
+        return false;
+      }
+    }
+  }
+  printf("END_DIVISION_TESTS\n");
+  return true;
+}
+
+bool div_threshold_test(int num_tests) {
+  printf("\nDIV_THRESHOLD_TEST\n");
+  int save_newton = newton_division_threshold;
+  uint64_t a[512];
+  uint64_t b[256];
+  uint64_t q[513];
+  uint64_t r[257];
+  uint64_t p[512];
+  uint64_t cycles[3];
+  uint64_t start;
+  uint64_t elapsed;
+  int newton_at = -1;
+  int size, i, j, k, size_q, size_r;
+
+  if (!GetCryptoRand(512 * NBITSINUINT64, (byte*)a) ||
+      !GetCryptoRand(256 * NBITSINUINT64, (byte*)b)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  for (size = 8; size <= 256; size += (size < 64 ? 8 : 32)) {
+    // 0: schoolbook divide, 1: Newton divide, 2: multiply, 2n by n digits
+    for (j = 0; j < 3; j++) {
+      newton_division_threshold = j == 0 ? 1 << 30 : 2;
+      cycles[j] = 0;
+      for (k = 0; k < 5; k++) {
+        start = ReadRdtsc();
+        for (i = 0; i < num_tests; i++) {
+          size_q = 513;
+          size_r = 257;
+          if (j == 2)
+            DigitArrayMult(size, a, size, b, 2 * size, p);
+          else
+            DigitArrayDivisionAlgorithm(2 * size, a, size, b, &size_q, q,
+                                        &size_r, r);
+        }
+        elapsed = ReadRdtsc() - start;
+        if (k == 0 || elapsed < cycles[j])
+          cycles[j] = elapsed;
+      }
+    }
+    if (cycles[1] >= cycles[0])
+      newton_at = size + 8;
+    printf("%3d digits: schoolbook %le, newton %le, mult %le\n", size,
+           ((double)cycles[0]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[1]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[2]) / ((double)(num_tests * cycles_per_second)));
+  }
+  newton_division_threshold = save_newton;
+  printf("newton wins from %d digits, threshold %d\n", newton_at,
+         newton_division_threshold);
+  printf("END_DIV_THRESHOLD_TEST\n");
+  return true;
+}
+
+bool radix_conversion_tests() {
+  printf("\nRADIX_CONVERSION_TESTS\n");
+  int save_radix = radix_conversion_threshold;
+  int sizes[] = {1, 2, 5, 31, 32, 33, 64, 100, 257, 1000, 3000};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int big = 16384;
+  uint64_t* a = new uint64_t[big];
+  uint64_t* b = new uint64_t[big + 2];
+  char* s1 = new char[20 * big + 20];
+  char* s2 = new char[20 * big + 20];
+  bool ret = true;
+  int i, j, m, size_a;
+
+  if (!GetCryptoRand(big * NBITSINUINT64, (byte*)a)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  for (i = 0; ret && i <= num_sizes; i++) {
+    // last case is 10^(19 * 64) - 1, the boundary of a cached power
+    size_a = i < num_sizes ? sizes[i] : 64;
+    if (i == num_sizes) {
+      for (j = 0; j < (19 * 64); j++) s1[j] = '9';
+      s1[j] = 0;
+      size_a = DigitArrayConvertFromDecimal(s1, big, a);
+    }
+    radix_conversion_threshold = 1 << 30;
+    m = 20 * big + 20;
+    if (!DigitArrayConvertToDecimal(size_a, a, &m, s1)) {
+      printf("DigitArrayConvertToDecimal fails\n");
+      ret = false;
+      break;
+    }
+    radix_conversion_threshold = save_radix;
+    m = 20 * big + 20;
+    if (!DigitArrayConvertToDecimal(size_a, a, &m, s2) || strcmp(s1, s2) != 0 ||
+        m != (int)strlen(s1)) {
+      printf("%d digits: subquadratic decimal differs\n", size_a);
+      ret = false;
+      break;
+    }
+    m = DigitArrayConvertFromDecimal(s2, big + 2, b);
+    if (DigitArrayCompare(size_a, a, m, b) != 0) {
+      printf("%d digits: decimal round trip fails\n", size_a);
+      ret = false;
+      break;
+    }
+    m = 20 * big + 20;
+    DigitArrayConvertToHex(size_a, a, &m, s1);
+    m = DigitArrayConvertFromHex(s1, big + 2, b);
+    if (DigitArrayCompare(size_a, a, m, b) != 0) {
+      printf("%d digits: hex round trip fails\n", size_a);
+      ret = false;
+      break;
+    }
+  }
+  if (!GetCryptoRand(big * NBITSINUINT64, (byte*)a)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+
+  // zero
+  b[0] = 0ULL;
+  m = 20;
+  if (ret && (!DigitArrayConvertToDecimal(1, b, &m, s1) ||
+              strcmp(s1, "0") != 0)) {
+    printf("zero converts to %s\n", s1);
+    ret = false;
+  }
+
+  // a megabit number, and the streaming version
+  if (ret) {
+    uint64_t start = ReadRdtsc();
+    m = 20 * big + 20;
+    if (!DigitArrayConvertToDecimal(big, a, &m, s1)) {
+      printf("DigitArrayConvertToDecimal fails\n");
+      ret = false;
+    }
+    double to_time = (double)(ReadRdtsc() - start) / (double)cycles_per_second;
+    start = ReadRdtsc();
+    m = DigitArrayConvertFromDecimal(s1, big + 2, b);
+    double from_time =
+        (double)(ReadRdtsc() - start) / (double)cycles_per_second;
+    if (DigitArrayCompare(big, a, m, b) != 0) {
+      printf("megabit decimal round trip fails\n");
+      ret = false;
+    }
+    printf("%d bits: to decimal %le, from decimal %le seconds\n",
+           big * NBITSINUINT64, to_time, from_time);
+  }
+  if (ret) {
+    WriteFile out;
+    int size = 0;
+    byte* in = nullptr;
+    if (!out.Init("radix_test.dec") ||
+        !DigitArrayConvertToDecimalFile(big, a, &out)) {
+      printf("DigitArrayConvertToDecimalFile fails\n");
+      ret = false;
+    }
+    out.Close();
+    if (ret && (!ReadaFile("radix_test.dec", &size, &in) ||
+                size != (int)strlen(s1) || memcmp(in, s1, size) != 0)) {
+      printf("streamed decimal differs\n");
+      ret = false;
+    }
+    if (in != nullptr)
+      delete []in;
+  }
+  radix_conversion_threshold = save_radix;
+  delete []a;
+  delete []b;
+  delete []s1;
+  delete []s2;
+  printf("END_RADIX_CONVERSION_TESTS\n");
+  return ret;
+}
+
+bool mult_threshold_test(int num_tests) {
+  printf("\nMULT_THRESHOLD_TEST\n");
+  int save_karatsuba = karatsuba_mult_threshold;
+  int save_toom3 = toom3_mult_threshold;
+  uint64_t a[256];
+  uint64_t b[256];
+  uint64_t r[512];
+  uint64_t cycles[4];
+  uint64_t start;
+  uint64_t elapsed;
+  int karatsuba_at = -1;
+  int toom3_at = -1;
+  int size, i, j, k;
+
+  if (!GetCryptoRand(256 * NBITSINUINT64, (byte*)a) ||
+      !GetCryptoRand(256 * NBITSINUINT64, (byte*)b)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  for (size = 8; size <= 256; size += 8) {
+    // 0: schoolbook, 1: Karatsuba over schoolbook,
+    // 2: Karatsuba, 3: Toom-3 over Karatsuba
+    for (j = 0; j < 4; j++) {
+      karatsuba_mult_threshold = j < 2 ? 1 << 30 : save_karatsuba;
+      toom3_mult_threshold = 1 << 30;
+      // best of five runs, to ride out interruptions
+      cycles[j] = 0;
+      for (k = 0; k < 5; k++) {
+        start = ReadRdtsc();
+        for (i = 0; i < num_tests; i++) {
+          if (j == 1)
+            DigitArrayKaratsubaMult(size, a, size, b, 2 * size, r);
+          else if (j == 3)
+            DigitArrayToom3Mult(size, a, size, b, 2 * size, r);
+          else
+            DigitArrayMult(size, a, size, b, 2 * size, r);
+        }
+        elapsed = ReadRdtsc() - start;
+        if (k == 0 || elapsed < cycles[j])
+          cycles[j] = elapsed;
+      }
+    }
+    // the crossover is just past the last size where the method loses
+    if (cycles[1] >= cycles[0])
+      karatsuba_at = size + 8;
+    if (cycles[3] >= cycles[2])
+      toom3_at = size + 8;
+    if (FLAGS_printall) {
+      printf("%3d digits: schoolbook %le, karatsuba %le, toom3 %le\n", size,
+             ((double)cycles[0]) / ((double)(num_tests * cycles_per_second)),
+             ((double)cycles[2]) / ((double)(num_tests * cycles_per_second)),
+             ((double)cycles[3]) / ((double)(num_tests * cycles_per_second)));
+    }
+  }
+  karatsuba_mult_threshold = save_karatsuba;
+  toom3_mult_threshold = save_toom3;
+  printf("karatsuba wins from %d digits, threshold %d\n", karatsuba_at,
+         karatsuba_mult_threshold);
+  printf("toom3 wins from %d digits, threshold %d\n", toom3_at,
+         toom3_mult_threshold);
+  printf("END_MULT_THRESHOLD_TEST\n");
+  return true;
+}
+
 bool addto_subfrom_and_compare(BigNum& a, BigNum& b) {
   BigNum c(a.capacity_ + 1);
 
@@ -2596,6 +3387,66 @@ bool ecc_double_time_test(const char* filename, EccKey* ecc_key,
   return true;
 }
 
+//  Time per point operation for each coordinate system, generic BigNum
+//  arithmetic and the P-256 field.  Inputs have z != 1.
+bool ecc_formula_time_test(int num_tests) {
+  printf("\nECC_FORMULA_TIME_TEST\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccCurve& c = P256_Key.c_;
+  CurvePoint P(8);
+  CurvePoint Q(8);
+  CurvePoint J(8);
+  CurvePoint K(8);
+  CurvePoint R(8);
+  BigNum x(8);
+  P256Point pp, pq, pj, pk, pr;
+  uint64_t start, cycles;
+  int i;
+
+  x.value_[0] = 0x123456789ULL;
+  x.Normalize();
+  P.CopyFrom(P256_Key.g_);
+  FasterEccMult(c, P256_Key.g_, x, Q);
+  ProjectiveDouble(c, P, P);
+  ProjectiveDouble(c, Q, Q);
+  JacobianDouble(c, P256_Key.g_, J);
+  JacobianDouble(c, J, K);
+  P256PointFromCurvePoint(P, pp);
+  P256PointFromCurvePoint(Q, pq);
+  P256PointFromCurvePoint(P256_Key.g_, pr);
+  P256JacobianDouble(pr, pj);
+  P256JacobianDouble(pj, pk);
+
+#define ECC_FORMULA_TIME(name, op)                                      \
+  start = ReadRdtsc();                                                  \
+  for (i = 0; i < num_tests; i++) {                                     \
+    op;                                                                 \
+  }                                                                     \
+  cycles = ReadRdtsc() - start;                                         \
+  printf("%-22s %le seconds\n", name,                                   \
+         (double)cycles / (double)(num_tests * cycles_per_second));
+
+  ECC_FORMULA_TIME("ProjectiveAdd", ProjectiveAdd(c, P, Q, R));
+  ECC_FORMULA_TIME("ProjectiveDouble", ProjectiveDouble(c, P, R));
+  ECC_FORMULA_TIME("JacobianAdd", JacobianAdd(c, J, K, R));
+  ECC_FORMULA_TIME("JacobianMixedAdd",
+                   JacobianMixedAdd(c, J, P256_Key.g_, R));
+  ECC_FORMULA_TIME("JacobianDouble", JacobianDouble(c, J, R));
+  ECC_FORMULA_TIME("P256PointAdd", P256PointAdd(pp, pq, pr));
+  ECC_FORMULA_TIME("P256PointDouble", P256PointDouble(pp, pr));
+  ECC_FORMULA_TIME("P256JacobianAdd", P256JacobianAdd(pj, pk, pr));
+  ECC_FORMULA_TIME("P256JacobianMixedAdd", P256JacobianMixedAdd(pj, pq, pr));
+  ECC_FORMULA_TIME("P256JacobianDouble", P256JacobianDouble(pj, pr));
+#undef ECC_FORMULA_TIME
+
+  printf("END_ECC_FORMULA_TIME_TEST\n");
+  return true;
+}
+
 bool ecc_projective_compare_tests(EccKey* ecc_key, int n) {
   CurvePoint P(9);
   CurvePoint Q(9);
@@ -2658,78 +3509,1135 @@ bool ecc_projective_compare_tests(EccKey* ecc_key, int n) {
   return true;
 }
 
-CurvePoint extP(16);
+bool ecc_projective_batch_tests(EccKey* ecc_key, int n) {
+  printf("\nECC_PROJECTIVE_BATCH_TEST\n");
+  CurvePoint** P = new CurvePoint*[n];
+  CurvePoint** Q = new CurvePoint*[n];
+  BigNum x(9);
+  bool ret = true;
+  int i;
 
-bool ecc_mult_time_test(const char* filename, EccKey* ecc_key, int num_tests) {
-  printf("\nECC_MULT_TIME_TEST\n");
-  if (ecc_key == nullptr) return false;
-  CurvePoint P(8);
-  CurvePoint R(8);
-  BigNum x(8);
-  P.MakeZero();
-  R.MakeZero();
+  for (i = 0; i < n; i++) {
+    P[i] = new CurvePoint(9);
+    Q[i] = new CurvePoint(9);
+    x.ZeroNum();
+    x.value_[0] = 0x1234567ULL * (i + 1);
+    x.value_[1] = 0x89abcdefULL + i;
+    x.Normalize();
+    if (i == 3) {
+      P[i]->MakeZero();
+    } else if (i == 5) {
+      P[i]->CopyFrom(ecc_key->g_);
+    } else if (!ProjectivePointMult(ecc_key->c_, x, ecc_key->g_, *P[i])) {
+      printf("ProjectivePointMult fails\n");
+      ret = false;
+      goto done;
+    }
+    Q[i]->CopyFrom(*P[i]);
+    if (!ProjectiveToAffine(ecc_key->c_, *Q[i])) {
+      ret = false;
+      goto done;
+    }
+  }
+  if (!ProjectiveToAffineBatch(ecc_key->c_, n, P)) {
+    printf("ProjectiveToAffineBatch fails\n");
+    ret = false;
+    goto done;
+  }
+  for (i = 0; i < n; i++) {
+    if (BigCompare(*P[i]->x_, *Q[i]->x_) != 0 ||
+        BigCompare(*P[i]->y_, *Q[i]->y_) != 0 ||
+        BigCompare(*P[i]->z_, *Q[i]->z_) != 0) {
+      printf("ProjectiveToAffineBatch point %d differs\n", i);
+      ret = false;
+      goto done;
+    }
+  }
+  printf("END_ECC_PROJECTIVE_BATCH_TEST\n");
 
-  P.x_->value_[0] = 0x7ULL;
-  P.y_->value_[0] = 0x9ULL;
+done:
+  for (i = 0; i < n; i++) {
+    delete P[i];
+    delete Q[i];
+  }
+  delete []P;
+  delete []Q;
+  return ret;
+}
 
-  int i;
-  for (i = 0; i < 3; i++) x.value_[i] = T1;
-  x.Normalize();
+bool p256_field_tests(int n) {
+  printf("\nP256_FIELD_TESTS\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  BigNum& p = *P256_Key.c_.p_;
+  BigNum a(10);
+  BigNum b(10);
+  BigNum t(10);
+  BigNum check(10);
+  BigNum out(10);
+  uint64_t fa[P256_DIGITS];
+  uint64_t fb[P256_DIGITS];
+  uint64_t fr[P256_DIGITS];
 
-  uint64_t cycles_start_test = ReadRdtsc();
-  int num_tests_executed;
-  for (num_tests_executed = 0; num_tests_executed < num_tests;
-       num_tests_executed++) {
-    if (!EccMult(ecc_key->c_, P, x, R)) {
+  for (int i = 0; i < n; i++) {
+    // random, zero, one and p-1
+    t.ZeroNum();
+    GetCryptoRand(4 * NBITSINUINT64, (byte*)t.value_);
+    t.Normalize();
+    BigMod(t, p, a);
+    t.ZeroNum();
+    GetCryptoRand(4 * NBITSINUINT64, (byte*)t.value_);
+    t.Normalize();
+    BigMod(t, p, b);
+    if (i == 1)
+      a.ZeroNum();
+    if (i == 2)
+      a.CopyFrom(Big_One);
+    if (i == 3)
+      BigSub(p, Big_One, a);
+    if (i == 4)
+      BigSub(p, Big_One, b);
+    if (!P256FromBigNum(a, fa) || !P256FromBigNum(b, fb)) {
+      printf("P256FromBigNum fails\n");
       return false;
     }
-  }
-  uint64_t cycles_end_test = ReadRdtsc();
-  uint64_t cycles_diff = cycles_end_test - cycles_start_test;
-  printf("ecc_mult__time_test number of successful tests: %d\n",
-         num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per mult %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
 
-  cycles_start_test = ReadRdtsc();
-  for (num_tests_executed = 0; num_tests_executed < num_tests;
-       num_tests_executed++) {
-    if (!FasterEccMult(ecc_key->c_, P, x, R)) {
+    P256Mult(fa, fb, fr);
+    P256ToBigNum(fr, out);
+    BigModMult(a, b, p, check);
+    if (BigCompare(out, check) != 0) {
+      printf("P256Mult mismatch, test %d\n", i);
+      return false;
+    }
+    P256Square(fa, fr);
+    P256ToBigNum(fr, out);
+    BigModMult(a, a, p, check);
+    if (BigCompare(out, check) != 0) {
+      printf("P256Square mismatch, test %d\n", i);
+      return false;
+    }
+    P256Add(fa, fb, fr);
+    P256ToBigNum(fr, out);
+    BigModAdd(a, b, p, check);
+    if (BigCompare(out, check) != 0) {
+      printf("P256Add mismatch, test %d\n", i);
+      return false;
+    }
+    P256Sub(fa, fb, fr);
+    P256ToBigNum(fr, out);
+    BigModSub(a, b, p, check);
+    if (BigCompare(out, check) != 0) {
+      printf("P256Sub mismatch, test %d\n", i);
+      return false;
+    }
+    if (a.IsZero())
+      continue;
+    P256Inv(fa, fr);
+    P256ToBigNum(fr, out);
+    t.CopyFrom(a);
+    BigModInv(t, p, check);
+    if (BigCompare(out, check) != 0) {
+      printf("P256Inv mismatch, test %d\n", i);
       return false;
     }
   }
-  cycles_end_test = ReadRdtsc();
-  cycles_diff = cycles_end_test - cycles_start_test;
-  printf("ecc_mult__time_test number of successful fast tests: %d\n",
-         num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per faster mult %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
-  printf("END ECC_MULT_TIME_TEST\n");
+  printf("END_P256_FIELD_TESTS\n");
   return true;
 }
 
-bool ecc_projective_mult_time_test(const char* filename, EccKey* ecc_key,
-                                   int num_tests) {
-  printf("\nECC_PROJECTIVE_MULT_TIME_TEST\n");
-  if (ecc_key == nullptr) return false;
+bool p256_mult_tests(int n) {
+  printf("\nP256_MULT_TESTS\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccCurve& c = P256_Key.c_;
   CurvePoint P(8);
   CurvePoint R(8);
+  CurvePoint check(8);
   BigNum x(8);
-  P.MakeZero();
-  R.MakeZero();
-
-  P.x_->value_[0] = 0x7ULL;
-  P.y_->value_[0] = 0x9ULL;
 
-  int i;
-  for (i = 0; i < 3; i++) x.value_[i] = T1;
-  x.Normalize();
+  if (!IsP256Curve(c)) {
+    printf("P-256 not recognized\n");
+    return false;
+  }
+  P.CopyFrom(P256_Key.g_);
+  for (int i = 0; i < n; i++) {
+    x.ZeroNum();
+    GetCryptoRand((1 + i % 4) * NBITSINUINT64, (byte*)x.value_);
+    x.Normalize();
+    if (i == 1)
+      x.CopyFrom(*P256_Key.order_of_g_);
+    if (i == 2)
+      BigSub(*P256_Key.order_of_g_, Big_One, x);
+    // every signed window carries
+    if (i == 3) {
+      for (int j = 0; j < 4; j++)
+        x.value_[j] = 0xffffffffffffffffULL;
+      x.Normalize();
+    }
+    if (x.IsZero())
+      continue;
+    if (!P256PointMult(P, x, R)) {
+      printf("P256PointMult fails\n");
+      return false;
+    }
+    if (!ProjectivePointMult(c, x, P, check) ||
+        !ProjectiveToAffine(c, check)) {
+      printf("ProjectivePointMult fails\n");
+      return false;
+    }
+    if (BigCompare(*R.x_, *check.x_) != 0 ||
+        BigCompare(*R.y_, *check.y_) != 0 ||
+        BigCompare(*R.z_, *check.z_) != 0) {
+      printf("P256PointMult mismatch, test %d\n", i);
+      R.PrintPoint();
+      check.PrintPoint();
+      return false;
+    }
+    // next base is not the generator
+    if (!R.IsZero())
+      P.CopyFrom(R);
+  }
+  printf("END_P256_MULT_TESTS\n");
+  return true;
+}
+
+static bool SameAffinePoint(CurvePoint& P, CurvePoint& Q) {
+  if (P.IsZero() || Q.IsZero())
+    return P.IsZero() && Q.IsZero();
+  return BigCompare(*P.x_, *Q.x_) == 0 && BigCompare(*P.y_, *Q.y_) == 0;
+}
+
+// k G for the built-in P-256, affine
+static bool P256Multiple(BigNum& k, CurvePoint& R) {
+  extern EccKey P256_Key;
+  return P256PointMult(P256_Key.g_, k, R);
+}
+
+bool jacobian_tests() {
+  printf("\nJACOBIAN_TESTS\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  int i;
+
+  // y^2= x^3+4x+4 (mod 65537), a != -3
+  BigNum a(1, 4ULL);
+  BigNum b(1, 4ULL);
+  BigNum q(1, 65537ULL);
+  EccCurve small_curve(a, b, q);
+  BigNum x1(1, 1ULL);
+  BigNum y1(1, 3ULL);
+  CurvePoint P1(x1, y1);
+  CurvePoint R(9);
+  CurvePoint check(9);
+  for (i = 1; i < 64; i++) {
+    BigNum k(1, (uint64_t)(i * i * 97));
+    if (!JacobianPointMult(small_curve, k, P1, R) ||
+        !JacobianToAffine(small_curve, R) ||
+        !EccMult(small_curve, P1, k, check)) {
+      printf("JacobianPointMult fails\n");
+      return false;
+    }
+    if (!SameAffinePoint(R, check)) {
+      printf("JacobianPointMult mismatch on small curve, k= %d\n",
+             i * i * 97);
+      return false;
+    }
+  }
+
+  EccCurve& c = P256_Key.c_;
+  BigNum ka(8);
+  BigNum kb(8);
+  BigNum k(8);
+  BigNum t(8);
+  CurvePoint A(8);
+  CurvePoint B(8);
+  CurvePoint A2(8);
+  CurvePoint B2(8);
+  CurvePoint minus_2A(8);
+  CurvePoint S(8);
+  P256Point pa, pb, pa2, pb2, pm, ps;
+
+  for (i = 0; i < 10; i++) {
+    ka.ZeroNum();
+    kb.ZeroNum();
+    GetCryptoRand(2 * NBITSINUINT64, (byte*)ka.value_);
+    GetCryptoRand(2 * NBITSINUINT64, (byte*)kb.value_);
+    ka.Normalize();
+    kb.Normalize();
+    if (!P256Multiple(ka, A) || !P256Multiple(kb, B)) {
+      printf("P256PointMult fails\n");
+      return false;
+    }
+    if (!JacobianPointMult(c, ka, P256_Key.g_, R) ||
+        !JacobianToAffine(c, R) || !SameAffinePoint(R, A)) {
+      printf("JacobianPointMult mismatch on P-256\n");
+      return false;
+    }
+
+    // 2A, 2B in Jacobian coordinates with z != 1
+    if (!JacobianDouble(c, A, A2) || !JacobianDouble(c, B, B2)) {
+      printf("JacobianDouble fails\n");
+      return false;
+    }
+    P256PointFromCurvePoint(A, pa);
+    P256PointFromCurvePoint(B, pb);
+    P256JacobianDouble(pa, pa2);
+    P256JacobianDouble(pb, pb2);
+
+    // 2a
+    BigShift(ka, 1, k);
+    P256Multiple(k, check);
+    S.CopyFrom(A2);
+    JacobianToAffine(c, S);
+    P256JacobianToAffine(pa2, R);
+    if (!SameAffinePoint(S, check) || !SameAffinePoint(R, check)) {
+      printf("JacobianDouble mismatch\n");
+      return false;
+    }
+    // 32a
+    BigShift(ka, 5, k);
+    P256Multiple(k, check);
+    JacobianDoubleN(c, A, 5, S);
+    JacobianToAffine(c, S);
+    P256JacobianDoubleN(pa, 5, ps);
+    P256JacobianToAffine(ps, R);
+    if (!SameAffinePoint(S, check) || !SameAffinePoint(R, check)) {
+      printf("JacobianDoubleN mismatch\n");
+      return false;
+    }
+    // 2a+b
+    t.ZeroNum();
+    k.ZeroNum();
+    BigShift(ka, 1, t);
+    BigAdd(t, kb, k);
+    P256Multiple(k, check);
+    JacobianMixedAdd(c, A2, B, S);
+    JacobianToAffine(c, S);
+    P256JacobianMixedAdd(pa2, pb, ps);
+    P256JacobianToAffine(ps, R);
+    if (!SameAffinePoint(S, check) || !SameAffinePoint(R, check)) {
+      printf("JacobianMixedAdd mismatch\n");
+      return false;
+    }
+    // 2a+2b
+    k.ZeroNum();
+    BigAdd(ka, kb, t);
+    BigShift(t, 1, k);
+    P256Multiple(k, check);
+    JacobianAdd(c, A2, B2, S);
+    JacobianToAffine(c, S);
+    P256JacobianAdd(pa2, pb2, ps);
+    P256JacobianToAffine(ps, R);
+    if (!SameAffinePoint(S, check) || !SameAffinePoint(R, check)) {
+      printf("JacobianAdd mismatch\n");
+      return false;
+    }
+    // 2A+2A
+    BigShift(ka, 2, k);
+    P256Multiple(k, check);
+    JacobianAdd(c, A2, A2, S);
+    JacobianToAffine(c, S);
+    P256JacobianAdd(pa2, pa2, ps);
+    P256JacobianToAffine(ps, R);
+    if (!SameAffinePoint(S, check) || !SameAffinePoint(R, check)) {
+      printf("JacobianAdd doubling mismatch\n");
+      return false;
+    }
+    // 2A-2A, and infinity as either input
+    minus_2A.CopyFrom(A2);
+    JacobianToAffine(c, minus_2A);
+    BigSub(*c.p_, *minus_2A.y_, t);
+    minus_2A.y_->CopyFrom(t);
+    JacobianMixedAdd(c, A2, minus_2A, S);
+    P256PointFromCurvePoint(minus_2A, pm);
+    P256JacobianMixedAdd(pa2, pm, ps);
+    P256JacobianToAffine(ps, R);
+    if (!S.z_->IsZero() || !R.IsZero()) {
+      printf("JacobianMixedAdd of inverses is not infinity\n");
+      return false;
+    }
+    ps.MakeZero();
+    P256JacobianMixedAdd(ps, pb, ps);
+    P256JacobianToAffine(ps, R);
+    S.MakeZero();
+    JacobianMixedAdd(c, S, B, S);
+    if (!SameAffinePoint(R, B) || !SameAffinePoint(S, B)) {
+      printf("JacobianMixedAdd of infinity mismatch\n");
+      return false;
+    }
+    ps.MakeZero();
+    P256JacobianAdd(pa2, ps, ps);
+    P256JacobianToAffine(ps, R);
+    S.CopyFrom(A2);
+    JacobianToAffine(c, S);
+    if (!SameAffinePoint(R, S)) {
+      printf("JacobianAdd of infinity mismatch\n");
+      return false;
+    }
+  }
+  printf("END_JACOBIAN_TESTS\n");
+  return true;
+}
+
+bool wnaf_tests() {
+  printf("\nWNAF_TESTS\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  BigNum x(8);
+  BigNum acc(10);
+  BigNum t(10);
+  int naf[8 * NBITSINUINT64 + 1];
+  int i, j, w;
+
+  for (i = 0; i < 40; i++) {
+    x.ZeroNum();
+    GetCryptoRand((1 + i % 4) * NBITSINUINT64, (byte*)x.value_);
+    x.Normalize();
+    for (w = 2; w <= 7; w++) {
+      int len = WNafRecode(x, w, 8 * NBITSINUINT64 + 1, naf);
+      if (len < 0 || len > BigHighBit(x) + 1) {
+        printf("WNafRecode length %d, %d bits\n", len, BigHighBit(x));
+        return false;
+      }
+      acc.ZeroNum();
+      int last = len + w;
+      for (j = len - 1; j >= 0; j--) {
+        t.ZeroNum();
+        BigShift(acc, 1, t);
+        acc.ZeroNum();
+        BigNum d(1, (uint64_t)(naf[j] < 0 ? -naf[j] : naf[j]));
+        if (naf[j] < 0)
+          BigSub(t, d, acc);
+        else
+          BigAdd(t, d, acc);
+        if (naf[j] == 0)
+          continue;
+        if ((naf[j] & 1) == 0 || naf[j] >= (1 << (w - 1)) ||
+            -naf[j] >= (1 << (w - 1)) || (last - j) < w) {
+          printf("WNafRecode bad digit %d at %d, w= %d\n", naf[j], j, w);
+          return false;
+        }
+        last = j;
+      }
+      if (BigCompare(acc, x) != 0) {
+        printf("WNafRecode does not sum to x, w= %d\n", w);
+        return false;
+      }
+    }
+  }
+
+  // y^2= x^3+4x+4 (mod 65537) and generic arithmetic on P-256
+  BigNum a(1, 4ULL);
+  BigNum q(1, 65537ULL);
+  EccCurve small_curve(a, a, q);
+  BigNum x1(1, 1ULL);
+  BigNum y1(1, 3ULL);
+  CurvePoint P1(x1, y1);
+  CurvePoint R(9);
+  CurvePoint check(9);
+  EccCurve* curves[2] = {&small_curve, &P256_Key.c_};
+  CurvePoint* points[2] = {&P1, &P256_Key.g_};
+  for (int c = 0; c < 2; c++) {
+    for (i = 0; i < 20; i++) {
+      x.ZeroNum();
+      GetCryptoRand((1 + i % 4) * NBITSINUINT64, (byte*)x.value_);
+      x.Normalize();
+      if (!JacobianPointMult(*curves[c], x, *points[c], check) ||
+          !JacobianToAffine(*curves[c], check)) {
+        printf("JacobianPointMult fails\n");
+        return false;
+      }
+      for (w = 0; w <= 6; w++) {
+        if (w == 1)
+          continue;
+        if (!JacobianWNafMult(*curves[c], x, *points[c], R, w) ||
+            !JacobianToAffine(*curves[c], R)) {
+          printf("JacobianWNafMult fails\n");
+          return false;
+        }
+        if (BigCompare(*R.x_, *check.x_) != 0 ||
+            BigCompare(*R.y_, *check.y_) != 0 ||
+            BigCompare(*R.z_, *check.z_) != 0) {
+          printf("JacobianWNafMult mismatch, curve %d, w= %d\n", c, w);
+          return false;
+        }
+      }
+    }
+  }
+  printf("END_WNAF_TESTS\n");
+  return true;
+}
+
+bool wnaf_time_test(int num_tests) {
+  printf("\nWNAF_TIME_TEST\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccCurve& c = P256_Key.c_;
+  CurvePoint R(8);
+  BigNum x(8);
+  uint64_t start, elapsed;
+  uint64_t binary_cycles = 0;
+  uint64_t wnaf_cycles = 0;
+
+  GetCryptoRand(4 * NBITSINUINT64, (byte*)x.value_);
+  x.Normalize();
+  // fastest single multiply of each, interleaved, the machine is noisy
+  for (int i = 0; i < num_tests; i++) {
+    start = ReadRdtsc();
+    JacobianPointMult(c, x, P256_Key.g_, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < binary_cycles)
+      binary_cycles = elapsed;
+    start = ReadRdtsc();
+    JacobianWNafMult(c, x, P256_Key.g_, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < wnaf_cycles)
+      wnaf_cycles = elapsed;
+  }
+  double binary_time = (double)binary_cycles / (double)cycles_per_second;
+  double wnaf_time = (double)wnaf_cycles / (double)cycles_per_second;
+  printf("256 bit multiply: JacobianPointMult %le, JacobianWNafMult %le "
+         "seconds each\n", binary_time, wnaf_time);
+  printf("END_WNAF_TIME_TEST\n");
+  return wnaf_cycles < binary_cycles;
+}
+
+bool p256_mult_time_test(int num_tests) {
+  printf("\nP256_MULT_TIME_TEST\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccCurve& c = P256_Key.c_;
+  CurvePoint R(8);
+  BigNum x(8);
+  uint64_t start, elapsed;
+  uint64_t generic_cycles = 0;
+  uint64_t p256_cycles = 0;
+
+  GetCryptoRand(4 * NBITSINUINT64, (byte*)x.value_);
+  x.Normalize();
+  // fastest single multiply of each, interleaved, the machine is noisy
+  for (int i = 0; i < num_tests; i++) {
+    start = ReadRdtsc();
+    ProjectivePointMult(c, x, P256_Key.g_, R);
+    ProjectiveToAffine(c, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < generic_cycles)
+      generic_cycles = elapsed;
+    start = ReadRdtsc();
+    P256PointMult(P256_Key.g_, x, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < p256_cycles)
+      p256_cycles = elapsed;
+  }
+  double generic_time = (double)generic_cycles / (double)cycles_per_second;
+  double p256_time = (double)p256_cycles / (double)cycles_per_second;
+  printf("P-256 multiply: ProjectivePointMult %le, P256PointMult %le "
+         "seconds each, %.1lfx\n", generic_time, p256_time,
+         generic_time / p256_time);
+  printf("END_P256_MULT_TIME_TEST\n");
+  return p256_cycles < generic_cycles;
+}
+
+bool base_table_tests() {
+  printf("\nBASE_TABLE_TESTS\n");
+  extern EccKey P256_Key;
+  extern EccKey P384_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccBaseTable table;
+  BigNum x(8);
+  CurvePoint R(9);
+  CurvePoint check(9);
+  int i, w;
+
+  // P-256, against P256PointMult, including 2^256-1 and negative x
+  for (w = 2; w <= 7; w++) {
+    if (!table.Init(P256_Key.c_, P256_Key.g_, 256, w)) {
+      printf("EccBaseTable::Init fails, w= %d\n", w);
+      return false;
+    }
+    for (i = 0; i < 12; i++) {
+      x.ZeroNum();
+      GetCryptoRand((1 + i % 4) * NBITSINUINT64, (byte*)x.value_);
+      if (i == 0)
+        memset((byte*)x.value_, 0xff, 4 * sizeof(uint64_t));
+      x.Normalize();
+      if (!table.Mult(P256_Key.c_, x, R) || !P256Multiple(x, check)) {
+        printf("EccBaseTable::Mult fails\n");
+        return false;
+      }
+      if (!SameAffinePoint(R, check)) {
+        printf("EccBaseTable::Mult mismatch on P-256, w= %d\n", w);
+        return false;
+      }
+    }
+    // both give y < 0; BigCompare won't match equal negative numbers
+    x.ToggleSign();
+    if (!table.Mult(P256_Key.c_, x, R) ||
+        !FasterEccMult(P256_Key.c_, P256_Key.g_, x, check) ||
+        !R.y_->IsNegative()) {
+      printf("EccBaseTable::Mult fails for negative x\n");
+      return false;
+    }
+    R.y_->ToggleSign();
+    check.y_->ToggleSign();
+    if (!SameAffinePoint(R, check)) {
+      printf("EccBaseTable::Mult mismatch for negative x\n");
+      return false;
+    }
+  }
+
+  // generic arithmetic: y^2= x^3+4x+4 (mod 65537) and P-384
+  BigNum a(1, 4ULL);
+  BigNum q(1, 65537ULL);
+  EccCurve small_curve(a, a, q);
+  BigNum x1(1, 1ULL);
+  BigNum y1(1, 3ULL);
+  CurvePoint P1(x1, y1);
+  EccCurve* curves[2] = {&small_curve, &P384_Key.c_};
+  CurvePoint* points[2] = {&P1, &P384_Key.g_};
+  int sizes[2] = {64, 384};
+  for (int c = 0; c < 2; c++) {
+    for (w = 3; w <= 5; w++) {
+      if (!table.Init(*curves[c], *points[c], sizes[c], w)) {
+        printf("EccBaseTable::Init fails, curve %d\n", c);
+        return false;
+      }
+      for (i = 0; i < 8; i++) {
+        x.ZeroNum();
+        GetCryptoRand(sizes[c] - 8 * i, (byte*)x.value_);
+        x.Normalize();
+        if (!table.Mult(*curves[c], x, R) ||
+            !FasterEccMult(*curves[c], *points[c], x, check)) {
+          printf("EccBaseTable::Mult fails\n");
+          return false;
+        }
+        if (!SameAffinePoint(R, check)) {
+          printf("EccBaseTable::Mult mismatch, curve %d, w= %d\n", c, w);
+          return false;
+        }
+      }
+    }
+  }
+
+  // keys share the curve's generator table and build their own for base_
+  string name("P-256");
+  EccKey key;
+  if (!key.GenerateEccKey(name, "test-key", "test", "test", 3600.0)) {
+    printf("GenerateEccKey fails\n");
+    return false;
+  }
+  if (key.GeneratorTable() == nullptr ||
+      key.GeneratorTable() != P256_Key.g_table_ || key.g_table_ != nullptr ||
+      key.BaseTable() == nullptr) {
+    printf("EccKey tables wrong\n");
+    return false;
+  }
+  byte plain[16];
+  byte recovered[32];
+  int size = 32;
+  CurvePoint pt1(9), pt2(9);
+  CurvePoint no_table(9);
+  GetCryptoRand(16 * NBITSINBYTE, plain);
+  plain[15] = 1;
+  x.ZeroNum();
+  GetCryptoRand(256, (byte*)x.value_);
+  x.Normalize();
+  if (!key.Encrypt(16, plain, x, pt1, pt2) ||
+      !key.Decrypt(pt1, pt2, &size, recovered) || size != 16 ||
+      memcmp(plain, recovered, 16) != 0) {
+    printf("Encrypt/Decrypt with tables fails\n");
+    return false;
+  }
+
+  // a loaded key builds its tables, a reused key rebuilds them
+  crypto_ecc_key_message key_msg;
+  EccKey restored;
+  if (!key.SerializeKeyToMessage(key_msg) ||
+      !restored.DeserializeKeyFromMessage(key_msg) ||
+      restored.GeneratorTable() != P256_Key.g_table_ ||
+      restored.BaseTable() == nullptr ||
+      !restored.Encrypt(16, plain, x, pt1, pt2) ||
+      !key.Decrypt(pt1, pt2, &size, recovered) || size != 16 ||
+      memcmp(plain, recovered, 16) != 0) {
+    printf("Deserialized EccKey tables wrong\n");
+    return false;
+  }
+  if (!key.GenerateEccKey(name, "test-key", "test", "test", 3600.0) ||
+      !key.Encrypt(16, plain, x, pt1, pt2) ||
+      !key.Decrypt(pt1, pt2, &size, recovered) || size != 16 ||
+      memcmp(plain, recovered, 16) != 0) {
+    printf("Reused EccKey tables wrong\n");
+    return false;
+  }
+  if (!key.SetTableWindowBits(0) || key.GeneratorTable() != nullptr ||
+      !key.Encrypt(16, plain, x, no_table, pt2) ||
+      !SameAffinePoint(pt1, no_table)) {
+    printf("Encrypt without tables differs\n");
+    return false;
+  }
+  // keys share the built-in tables, so those can't be rebuilt
+  EccBaseTable* p256_table = P256_Key.g_table_;
+  if (P256_Key.SetTableWindowBits(3) || P256_Key.InitBaseTables() ||
+      P256_Key.g_table_ != p256_table ||
+      restored.GeneratorTable() != p256_table) {
+    printf("built-in EccKey tables changed\n");
+    return false;
+  }
+  printf("END_BASE_TABLE_TESTS\n");
+  return true;
+}
+
+bool base_table_time_test(int num_tests) {
+  printf("\nBASE_TABLE_TIME_TEST\n");
+  extern EccKey P256_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccBaseTable table;
+  CurvePoint R(8);
+  BigNum x(8);
+  uint64_t start, elapsed;
+  uint64_t build_cycles;
+  uint64_t p256_cycles = 0;
+  uint64_t table_cycles = 0;
+  uint64_t default_cycles = 0;
+
+  GetCryptoRand(4 * NBITSINUINT64, (byte*)x.value_);
+  x.Normalize();
+  for (int w = 4; w <= 7; w++) {
+    start = ReadRdtsc();
+    if (!table.Init(P256_Key.c_, P256_Key.g_, 256, w)) {
+      printf("EccBaseTable::Init fails\n");
+      return false;
+    }
+    build_cycles = ReadRdtsc() - start;
+    // fastest single multiply of each, interleaved, the machine is noisy
+    for (int i = 0; i < num_tests; i++) {
+      start = ReadRdtsc();
+      P256PointMult(P256_Key.g_, x, R);
+      elapsed = ReadRdtsc() - start;
+      if ((w == 4 && i == 0) || elapsed < p256_cycles)
+        p256_cycles = elapsed;
+      start = ReadRdtsc();
+      table.Mult(P256_Key.c_, x, R);
+      elapsed = ReadRdtsc() - start;
+      if (i == 0 || elapsed < table_cycles)
+        table_cycles = elapsed;
+    }
+    if (w == ECC_BASE_TABLE_BITS)
+      default_cycles = table_cycles;
+    printf("w= %d: %6d bytes, built in %le, multiply %le seconds\n", w,
+           table.TableBytes(),
+           (double)build_cycles / (double)cycles_per_second,
+           (double)table_cycles / (double)cycles_per_second);
+  }
+  double p256_time = (double)p256_cycles / (double)cycles_per_second;
+  double table_time = (double)default_cycles / (double)cycles_per_second;
+  printf("P-256 fixed base: P256PointMult %le, EccBaseTable::Mult %le "
+         "seconds each, %.1lfx\n", p256_time, table_time,
+         p256_time / table_time);
+  printf("END_BASE_TABLE_TIME_TEST\n");
+  return default_cycles < p256_cycles;
+}
+
+// R= uP+vQ by two separate multiplies
+static bool SeparateJointMult(EccCurve& c, BigNum& u, CurvePoint& P, BigNum& v,
+                              CurvePoint& Q, CurvePoint& R) {
+  CurvePoint uP(9), vQ(9);
+  if (!FasterEccMult(c, P, u, uP) || !FasterEccMult(c, Q, v, vQ))
+    return false;
+  return JacobianAdd(c, uP, vQ, R) && JacobianToAffine(c, R);
+}
+
+bool ecdsa_tests() {
+  printf("\nECDSA_TESTS\n");
+  extern EccKey P256_Key;
+  extern EccKey P384_Key;
+  extern EccKey P521_Key;
+  if (!InitEccCurves()) {
+    printf("InitEccCurves failed\n");
+    return false;
+  }
+  EccKey* curves[3] = {&P256_Key, &P384_Key, &P521_Key};
+  string names[3] = {"P-256", "P-384", "P-521"};
+  BigNum u(9);
+  BigNum v(9);
+  BigNum t(10);
+  BigNum acc(10);
+  CurvePoint R(9);
+  CurvePoint check(9);
+  int du[9 * NBITSINUINT64 + 1];
+  int dv[9 * NBITSINUINT64 + 1];
+  int i, j, c;
+
+  // n G is infinity on every built-in curve
+  for (c = 0; c < 3; c++) {
+    if (!JacobianPointMult(curves[c]->c_, *curves[c]->order_of_g_,
+                           curves[c]->g_, R) || !R.z_->IsZero()) {
+      printf("%s generator does not have order n\n", names[c].c_str());
+      return false;
+    }
+  }
+
+  // joint sparse form
+  for (i = 0; i < 40; i++) {
+    u.ZeroNum();
+    v.ZeroNum();
+    GetCryptoRand((1 + i % 4) * NBITSINUINT64, (byte*)u.value_);
+    GetCryptoRand((1 + (i / 4) % 4) * NBITSINUINT64, (byte*)v.value_);
+    u.Normalize();
+    v.Normalize();
+    int len = JsfRecode(u, v, 9 * NBITSINUINT64 + 1, du, dv);
+    int bits = BigHighBit(u) > BigHighBit(v) ? BigHighBit(u) : BigHighBit(v);
+    if (len < 0 || len > bits + 1) {
+      printf("JsfRecode length %d, %d bits\n", len, bits);
+      return false;
+    }
+    for (j = 0; j < len; j++) {
+      if (du[j] < -1 || du[j] > 1 || dv[j] < -1 || dv[j] > 1 ||
+          (j + 2 < len && (du[j] | dv[j]) != 0 &&
+           (du[j + 1] | dv[j + 1]) != 0 && (du[j + 2] | dv[j + 2]) != 0)) {
+        printf("JsfRecode bad digits at %d\n", j);
+        return false;
+      }
+    }
+    BigNum* x[2] = {&u, &v};
+    int* d[2] = {du, dv};
+    for (int k = 0; k < 2; k++) {
+      acc.ZeroNum();
+      for (j = len - 1; j >= 0; j--) {
+        t.ZeroNum();
+        BigShift(acc, 1, t);
+        acc.ZeroNum();
+        if (d[k][j] < 0)
+          BigSub(t, Big_One, acc);
+        else if (d[k][j] > 0)
+          BigAdd(t, Big_One, acc);
+        else
+          acc.CopyFrom(t);
+      }
+      if (BigCompare(acc, *x[k]) != 0) {
+        printf("JsfRecode does not sum to the scalar\n");
+        return false;
+      }
+    }
+  }
+
+  // EccJointMult against two multiplies: y^2= x^3+4x+4 (mod 65537),
+  // P-256 and P-384
+  BigNum a(1, 4ULL);
+  BigNum q(1, 65537ULL);
+  EccCurve small_curve(a, a, q);
+  BigNum x1(1, 1ULL);
+  BigNum y1(1, 3ULL);
+  BigNum three(1, 3ULL);
+  CurvePoint P1(x1, y1);
+  CurvePoint Q1(9);
+  CurvePoint Q2(9);
+  CurvePoint Q3(9);
+  FasterEccMult(small_curve, P1, three, Q1);
+  FasterEccMult(P256_Key.c_, P256_Key.g_, three, Q2);
+  FasterEccMult(P384_Key.c_, P384_Key.g_, three, Q3);
+  EccCurve* joint_curves[3] = {&small_curve, &P256_Key.c_, &P384_Key.c_};
+  CurvePoint* joint_P[3] = {&P1, &P256_Key.g_, &P384_Key.g_};
+  CurvePoint* joint_Q[3] = {&Q1, &Q2, &Q3};
+  int sizes[3] = {1, 4, 6};
+  for (c = 0; c < 3; c++) {
+    for (i = 0; i < 12; i++) {
+      u.ZeroNum();
+      v.ZeroNum();
+      GetCryptoRand(sizes[c] * NBITSINUINT64, (byte*)u.value_);
+      GetCryptoRand(sizes[c] * NBITSINUINT64, (byte*)v.value_);
+      if (i == 1)
+        u.ZeroNum();
+      if (i == 2)
+        v.ZeroNum();
+      u.Normalize();
+      v.Normalize();
+      CurvePoint& Q = i == 3 ? *joint_P[c] : *joint_Q[c];
+      if (!EccJointMult(*joint_curves[c], u, *joint_P[c], v, Q, R) ||
+          !SeparateJointMult(*joint_curves[c], u, *joint_P[c], v, Q, check)) {
+        printf("EccJointMult fails\n");
+        return false;
+      }
+      if (!SameAffinePoint(R, check)) {
+        printf("EccJointMult mismatch, curve %d, test %d\n", c, i);
+        return false;
+      }
+    }
+  }
+
+  // RFC 6979 A.2.5, P-256 with SHA-256, message "sample"
+  BigNum* x = BigConvertFromHex(
+      "c9afa9d845ba75166b5c215767b1d6934e50c3db36e89b127b8a622b120f6721");
+  BigNum* ux = BigConvertFromHex(
+      "60fed4ba255a9d31c961eb74c6356d68c049b8923b61fa6ce669622e60f29fb6");
+  BigNum* k_expected = BigConvertFromHex(
+      "a6e3c57dd01abe90086538398355dd4c3b17aa873382b0f24d6129493d8aad60");
+  BigNum* r_expected = BigConvertFromHex(
+      "efd48b2aacb6a8fd1140dd9cd45e81d69d2c877b56aaf991c34d0ea84eaf3716");
+  BigNum* s_expected = BigConvertFromHex(
+      "f7cb1c942d657c41d436c7a1b6e29f65f3e900dbb9aff4064dc4ab2f843acda8");
+  byte hash[32];
+  HexToByteLeftToRight((char*)
+      "af2bdbe1aa9b6ec1e2ade1d694f41fc71a831d0268e9891562113d8a62add1bf",
+      32, hash);
+  EccKey rfc_key;
+  BigNum k(20);
+  BigNum r(9);
+  BigNum s(9);
+  if (!rfc_key.MakeEccKey("rfc6979", "test", "test", 3600.0, &P256_Key.c_,
+                          &P256_Key.g_, nullptr, P256_Key.order_of_g_, x) ||
+      BigCompare(*rfc_key.base_.x_, *ux) != 0) {
+    printf("RFC 6979 key wrong\n");
+    return false;
+  }
+  if (!EcdsaNonce(*P256_Key.order_of_g_, *x, 32, hash, 0, k) ||
+      BigCompare(k, *k_expected) != 0) {
+    printf("RFC 6979 nonce wrong\n");
+    return false;
+  }
+  if (!EcdsaSign(rfc_key, 32, hash, r, s) || BigCompare(r, *r_expected) != 0 ||
+      BigCompare(s, *s_expected) != 0) {
+    printf("RFC 6979 signature wrong\n");
+    return false;
+  }
+  if (!EcdsaVerify(rfc_key, 32, hash, r, s)) {
+    printf("RFC 6979 signature does not verify\n");
+    return false;
+  }
+  delete x;
+  delete ux;
+  delete k_expected;
+  delete r_expected;
+  delete s_expected;
+
+  // sign, verify and reject changes on every curve, through Signature
+  for (c = 0; c < 3; c++) {
+    EccKey key;
+    if (!key.GenerateEccKey(names[c], "ecdsa-key", "test", "test", 3600.0)) {
+      printf("GenerateEccKey fails\n");
+      return false;
+    }
+    GetCryptoRand(256, hash);
+    r.ZeroNum();
+    s.ZeroNum();
+    if (!EcdsaSign(key, 32, hash, r, s) || !EcdsaVerify(key, 32, hash, r, s)) {
+      printf("%s signature does not verify\n", names[c].c_str());
+      return false;
+    }
+    // with no generator table kG comes from a table built for the call,
+    // not FasterEccMult, and the signature is the same
+    BigNum r_no_table(9);
+    BigNum s_no_table(9);
+    if (!key.SetTableWindowBits(0) || key.GeneratorTable() != nullptr ||
+        !EcdsaSign(key, 32, hash, r_no_table, s_no_table) ||
+        BigCompare(r, r_no_table) != 0 || BigCompare(s, s_no_table) != 0) {
+      printf("%s signature without tables differs\n", names[c].c_str());
+      return false;
+    }
+    hash[5] ^= 1;
+    if (EcdsaVerify(key, 32, hash, r, s)) {
+      printf("%s verifies a changed hash\n", names[c].c_str());
+      return false;
+    }
+    hash[5] ^= 1;
+    if (EcdsaVerify(key, 32, hash, s, r) ||
+        EcdsaVerify(key, 32, hash, r, *key.order_of_g_)) {
+      printf("%s verifies a bad signature\n", names[c].c_str());
+      return false;
+    }
+
+    Signature sig_obj;
+    Signature parsed_obj;
+    crypto_signature sig;
+    crypto_signature parsed;
+    string serialized;
+    if (!EcdsaSignToSignature(key, "sha-256", 32, hash, sig_obj) ||
+        !sig_obj.Serialize(sig) || !sig.SerializeToString(&serialized) ||
+        !parsed.ParseFromString(serialized) ||
+        !parsed_obj.Deserialize(parsed) ||
+        !EcdsaVerifySignature(key, "sha-256", 32, hash, parsed_obj)) {
+      printf("%s Signature round trip fails\n", names[c].c_str());
+      return false;
+    }
+    parsed_obj.signature_[3] ^= 0x10;
+    if (EcdsaVerifySignature(key, "sha-256", 32, hash, parsed_obj)) {
+      printf("%s verifies a changed Signature\n", names[c].c_str());
+      return false;
+    }
+    if (EcdsaSignToSignature(key, "sha-256", 32, hash, sig_obj)) {
+      printf("%s signs into a filled in Signature\n", names[c].c_str());
+      return false;
+    }
+  }
+  printf("END_ECDSA_TESTS\n");
+  return true;
+}
+
+bool ecdsa_time_test(int num_tests) {
+  printf("\nECDSA_TIME_TEST\n");
+  EccKey key;
+  string name("P-256");
+  if (!key.GenerateEccKey(name, "ecdsa-key", "test", "test", 3600.0)) {
+    printf("GenerateEccKey fails\n");
+    return false;
+  }
+  BigNum& n = *key.order_of_g_;
+  BigNum r(9);
+  BigNum s(9);
+  BigNum u1(9);
+  BigNum u2(9);
+  CurvePoint R(9);
+  byte hash[32];
+  uint64_t start;
+  uint64_t sign_cycles = 0;
+  uint64_t verify_cycles = 0;
+  uint64_t joint_cycles = 0;
+  uint64_t separate_cycles = 0;
+  uint64_t elapsed;
+  bool ok = true;
+
+  GetCryptoRand(256, hash);
+  for (int i = 0; i < num_tests; i++) {
+    hash[0] = (byte)i;
+    start = ReadRdtsc();
+    ok = EcdsaSign(key, 32, hash, r, s) && ok;
+    sign_cycles += ReadRdtsc() - start;
+    start = ReadRdtsc();
+    ok = EcdsaVerify(key, 32, hash, r, s) && ok;
+    verify_cycles += ReadRdtsc() - start;
+  }
+  if (!ok) {
+    printf("ECDSA sign or verify fails\n");
+    return false;
+  }
+
+  // the verification products, fastest single one of each
+  GetCryptoRand(256, (byte*)u1.value_);
+  GetCryptoRand(256, (byte*)u2.value_);
+  u1.Normalize();
+  u2.Normalize();
+  BigModNormalize(u1, n);
+  BigModNormalize(u2, n);
+  for (int i = 0; i < num_tests; i++) {
+    start = ReadRdtsc();
+    EccJointMult(key.c_, u1, key.g_, u2, key.base_, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < joint_cycles)
+      joint_cycles = elapsed;
+    start = ReadRdtsc();
+    SeparateJointMult(key.c_, u1, key.g_, u2, key.base_, R);
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < separate_cycles)
+      separate_cycles = elapsed;
+  }
+  double sign_time = (double)sign_cycles / (double)cycles_per_second;
+  double verify_time = (double)verify_cycles / (double)cycles_per_second;
+  printf("P-256 ECDSA, %d each: %.0lf signs, %.0lf verifies per second\n",
+         num_tests, (double)num_tests / sign_time,
+         (double)num_tests / verify_time);
+  printf("u1 G + u2 Q: EccJointMult %le, two multiplies %le seconds\n",
+         (double)joint_cycles / (double)cycles_per_second,
+         (double)separate_cycles / (double)cycles_per_second);
+  printf("END_ECDSA_TIME_TEST\n");
+  return joint_cycles < separate_cycles;
+}
+
+CurvePoint extP(16);
+
+bool ecc_mult_time_test(const char* filename, EccKey* ecc_key, int num_tests) {
+  printf("\nECC_MULT_TIME_TEST\n");
+  if (ecc_key == nullptr) return false;
+  CurvePoint P(8);
+  CurvePoint R(8);
+  BigNum x(8);
+  P.MakeZero();
+  R.MakeZero();
+
+  P.x_->value_[0] = 0x7ULL;
+  P.y_->value_[0] = 0x9ULL;
+
+  int i;
+  for (i = 0; i < 3; i++) x.value_[i] = T1;
+  x.Normalize();
+
+  uint64_t cycles_start_test = ReadRdtsc();
+  int num_tests_executed;
+  for (num_tests_executed = 0; num_tests_executed < num_tests;
+       num_tests_executed++) {
+    if (!EccMult(ecc_key->c_, P, x, R)) {
+      return false;
+    }
+  }
+  uint64_t cycles_end_test = ReadRdtsc();
+  uint64_t cycles_diff = cycles_end_test - cycles_start_test;
+  printf("ecc_mult__time_test number of successful tests: %d\n",
+         num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per mult %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+
+  cycles_start_test = ReadRdtsc();
+  for (num_tests_executed = 0; num_tests_executed < num_tests;
+       num_tests_executed++) {
+    if (!FasterEccMult(ecc_key->c_, P, x, R)) {
+      return false;
+    }
+  }
+  cycles_end_test = ReadRdtsc();
+  cycles_diff = cycles_end_test - cycles_start_test;
+  printf("ecc_mult__time_test number of successful fast tests: %d\n",
+         num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per faster mult %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+  printf("END ECC_MULT_TIME_TEST\n");
+  return true;
+}
+
+bool ecc_projective_mult_time_test(const char* filename, EccKey* ecc_key,
+                                   int num_tests) {
+  printf("\nECC_PROJECTIVE_MULT_TIME_TEST\n");
+  if (ecc_key == nullptr) return false;
+  CurvePoint P(8);
+  CurvePoint R(8);
+  BigNum x(8);
+  P.MakeZero();
+  R.MakeZero();
+
+  P.x_->value_[0] = 0x7ULL;
+  P.y_->value_[0] = 0x9ULL;
+
+  int i;
+  for (i = 0; i < 3; i++) x.value_[i] = T1;
+  x.Normalize();
 
   uint64_t cycles_start_test = ReadRdtsc();
   int num_tests_executed;
@@ -3412,84 +5320,1013 @@ bool rsa_speed_tests(RsaKey* key1, RsaKey* key2, const char* filename, int size,
       goto done;
     }
   }
-  cycles_end_test = ReadRdtsc();
-  cycles_diff = cycles_end_test - cycles_start_test;
-  printf("rsa2048 encrypt, speed 2, number of tests: %d\n", num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per encrypt %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
+  cycles_end_test = ReadRdtsc();
+  cycles_diff = cycles_end_test - cycles_start_test;
+  printf("rsa2048 encrypt, speed 2, number of tests: %d\n", num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per encrypt %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+
+  // 2048, speed 2, Decrypt
+  cycles_start_test = ReadRdtsc();
+  for (num_tests_executed = 0; num_tests_executed < num_tests;
+       num_tests_executed++) {
+    n = 256;
+    if (!key2->Decrypt(256, M, &n, C, 2)) {
+      printf("rsa 2048 bit decrypt test %d failed\n", num_tests_executed);
+      ret = false;
+      goto done;
+    }
+  }
+  cycles_end_test = ReadRdtsc();
+  cycles_diff = cycles_end_test - cycles_start_test;
+  printf("rsa2048 decrypt, speed 2, number of tests: %d\n", num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per decrypt %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+  printf("\n");
+
+  // need to calculate p_prime_ and q_prime_
+  // 2048, speed 3, Encrypt
+  cycles_start_test = ReadRdtsc();
+  for (num_tests_executed = 0; num_tests_executed < num_tests;
+       num_tests_executed++) {
+    n = 256;
+    if (!key2->Encrypt(256, M, &n, C, 3)) {
+      printf("rsa 2048 bit encrypt test %d failed\n", num_tests_executed);
+      ret = false;
+      goto done;
+    }
+  }
+  cycles_end_test = ReadRdtsc();
+  cycles_diff = cycles_end_test - cycles_start_test;
+  printf("rsa2048 encrypt, speed 3, number of tests: %d\n", num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per encrypt %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+
+  // 2048, speed 0, Decrypt
+  cycles_start_test = ReadRdtsc();
+  for (num_tests_executed = 0; num_tests_executed < num_tests;
+       num_tests_executed++) {
+    n = 256;
+    if (!key2->Decrypt(256, M, &n, C, 3)) {
+      printf("rsa 2048 bit decrypt test %d failed\n", num_tests_executed);
+      ret = false;
+      goto done;
+    }
+  }
+  cycles_end_test = ReadRdtsc();
+  cycles_diff = cycles_end_test - cycles_start_test;
+  printf("rsa2048 encrypt, speed 3, number of tests: %d\n", num_tests_executed);
+  printf("total ellapsed time %le\n",
+         ((double)cycles_diff) / ((double)cycles_per_second));
+  printf("time per decrypt %le\n",
+         ((double)cycles_diff) /
+             ((double)(num_tests_executed * cycles_per_second)));
+  printf("\n");
+
+done:
+  delete []buf;
+  printf("END_RSA_SPEED_TESTS\n");
+  return ret;
+}
+
+//  One private key operation at a time, sequential CRT (speed 3) against
+//  the two thread CRT (speed 4).  On a single core the two are the same.
+bool rsa_parallel_crt_time_test(int num_bits, int num_tests) {
+  printf("\nRSA_PARALLEL_CRT_TIME_TEST\n");
+  RsaKey key;
+  byte M[512];
+  byte C[512];
+  uint64_t start, elapsed;
+  uint64_t sequential_cycles = 0;
+  uint64_t parallel_cycles = 0;
+  int size = num_bits / NBITSINBYTE;
+  int i, k, n;
+
+  if (!key.GenerateRsaKey("test-key", "test", "test", num_bits,
+                          COMMON_YEAR_SECONDS)) {
+    printf("Cant generate %d bit key\n", num_bits);
+    return false;
+  }
+  memset(M, 0, 512);
+  GetCryptoRand(size * NBITSINBYTE, M);
+  M[0] &= 0x7f;
+
+  // best of 5
+  for (k = 0; k < 5; k++) {
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) {
+      n = 512;
+      if (!key.Decrypt(size, M, &n, C, 3))
+        return false;
+    }
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < sequential_cycles)
+      sequential_cycles = elapsed;
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) {
+      n = 512;
+      if (!key.Decrypt(size, M, &n, C, 4))
+        return false;
+    }
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < parallel_cycles)
+      parallel_cycles = elapsed;
+  }
+  double sequential_time =
+      (double)sequential_cycles / (double)(num_tests * cycles_per_second);
+  double parallel_time =
+      (double)parallel_cycles / (double)(num_tests * cycles_per_second);
+  printf("rsa%d decrypt, %d cores: speed 3 %le, speed 4 %le seconds, "
+         "speedup %.2lf\n", num_bits,
+         (int)std::thread::hardware_concurrency(), sequential_time,
+         parallel_time, sequential_time / parallel_time);
+  printf("END_RSA_PARALLEL_CRT_TIME_TEST\n");
+  return true;
+}
+
+// BarrettContext reductions against the long division in BigMod
+bool barrett_tests() {
+  printf("\nBARRETT_TESTS\n");
+  int sizes[] = {1, 2, 4, 6, 9, 16, 32};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int i, j, k, n;
+
+  for (i = 0; i < num_sizes; i++) {
+    n = sizes[i];
+    for (j = 0; j < 20; j++) {
+      BigNum m(n + 1);
+      BigNum a(n + 1);
+      BigNum b(n + 1);
+      BigNum x(2 * n + 1);
+      BigNum r1(4 * n + 4);
+      BigNum r2(4 * n + 4);
+      BarrettContext ctx;
+
+      if (!GetCryptoRand(n * NBITSINUINT64, (byte*)m.value_) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)a.value_) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)b.value_) ||
+          !GetCryptoRand(2 * n * NBITSINUINT64, (byte*)x.value_)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      if (j == 0) {
+        // power of 2^64, mu needs an extra digit
+        m.ZeroNum();
+        m.value_[n - 1] = 1ULL;
+      } else if (j == 1) {
+        for (k = 0; k < n; k++) m.value_[k] = 0xffffffffffffffffULL;
+        for (k = 0; k < 2 * n; k++) x.value_[k] = 0xffffffffffffffffULL;
+      } else if ((j % 2) == 0) {
+        m.value_[0] &= ~1ULL;
+      }
+      if (m.value_[n - 1] == 0ULL)
+        m.value_[n - 1] = 1ULL;
+      m.Normalize();
+      a.Normalize();
+      b.Normalize();
+      x.Normalize();
+      if (!ctx.Init(m)) {
+        printf("BarrettContext::Init fails\n");
+        return false;
+      }
+
+      // a, b may exceed m
+      BigNum a2(a, 2 * n + 2);
+      BigNum b2(b, 2 * n + 2);
+      if (!BigModMult(a, b, m, r1) || !BigModMult(a2, b2, ctx, r2) ||
+          BigCompare(r1, r2) != 0) {
+        printf("Barrett mult %d fails\n", n);
+        return false;
+      }
+      r1.ZeroNum();
+      if (!BigModSquare(a, m, r1) || !BigModSquare(a, ctx, r2) ||
+          BigCompare(r1, r2) != 0) {
+        printf("Barrett square %d fails\n", n);
+        return false;
+      }
+      r1.ZeroNum();
+      if (!BigMod(x, m, r1) || !BigMod(x, ctx, r2) ||
+          BigCompare(r1, r2) != 0) {
+        printf("Barrett reduce %d fails\n", n);
+        return false;
+      }
+    }
+  }
+  printf("END_BARRETT_TESTS\n");
+  return true;
+}
+
+bool barrett_time_test(int num_tests) {
+  printf("\nBARRETT_TIME_TEST\n");
+  int sizes[] = {4, 6, 9, 16, 32};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  uint64_t start, div_cycles, barrett_cycles;
+  int i, j, n;
+
+  for (i = 0; i < num_sizes; i++) {
+    n = sizes[i];
+    BigNum m(n + 1);
+    BigNum a(n + 1);
+    BigNum b(n + 1);
+    BigNum r(4 * n + 4);
+    BarrettContext ctx;
+
+    if (!GetCryptoRand(n * NBITSINUINT64, (byte*)m.value_) ||
+        !GetCryptoRand(n * NBITSINUINT64, (byte*)a.value_) ||
+        !GetCryptoRand(n * NBITSINUINT64, (byte*)b.value_)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    m.value_[n - 1] |= 1ULL << 63;
+    m.Normalize();
+    a.Normalize();
+    b.Normalize();
+    if (!ctx.Init(m))
+      return false;
+    BigModNormalize(a, m);
+    BigModNormalize(b, m);
+
+    start = ReadRdtsc();
+    for (j = 0; j < num_tests; j++) BigModMult(a, b, m, r);
+    div_cycles = ReadRdtsc() - start;
+    start = ReadRdtsc();
+    for (j = 0; j < num_tests; j++) BigModMult(a, b, ctx, r);
+    barrett_cycles = ReadRdtsc() - start;
+    printf("%2d digits, BigModMult division/Barrett: %le/%le\n", n,
+           ((double)div_cycles) / ((double)(num_tests * cycles_per_second)),
+           ((double)barrett_cycles) /
+               ((double)(num_tests * cycles_per_second)));
+  }
+  printf("END_BARRETT_TIME_TEST\n");
+  return true;
+}
+
+bool prime_gen_tests() {
+  printf("\nPRIME_GEN_TESTS\n");
+  int bits[] = {64, 65, 128, 512, 1024};
+  int num_bits = sizeof(bits) / sizeof(int);
+  int threads[] = {1, 3};
+  uint64_t start, cycles;
+  int i, j, k;
+
+  for (i = 0; i < num_bits; i++) {
+    for (j = 0; j < 2; j++) {
+      BigNum p(bits[i] / NBITSINUINT64 + 2);
+      BigNum p_minus_1(bits[i] / NBITSINUINT64 + 2);
+      BigNum t(2 * (bits[i] / NBITSINUINT64) + 4);
+
+      start = ReadRdtsc();
+      if (!BigGenPrime(p, bits[i], threads[j])) {
+        printf("BigGenPrime %d bits fails\n", bits[i]);
+        return false;
+      }
+      cycles = ReadRdtsc() - start;
+      if (BigHighBit(p) != bits[i] || !BigBitPositionOn(p, bits[i] - 1)) {
+        printf("BigGenPrime %d bits, wrong size\n", bits[i]);
+        return false;
+      }
+      // Fermat, bases 2, 3, 5
+      BigSub(p, Big_One, p_minus_1);
+      for (k = 2; k <= 5; k++) {
+        BigNum a(1, (uint64_t)k);
+        t.ZeroNum();
+        if (k == 4)
+          continue;
+        if (!BigModExp(a, p_minus_1, p, t) || !t.IsOne()) {
+          printf("BigGenPrime %d bits, not prime\n", bits[i]);
+          return false;
+        }
+      }
+      printf("%4d bits, %d threads: %le\n", bits[i], threads[j],
+             ((double)cycles) / ((double)cycles_per_second));
+    }
+  }
+
+  std::atomic<bool> cancel(true);
+  BigNum p(10);
+  if (BigGenPrime(p, 512, 2, &cancel)) {
+    printf("BigGenPrime ignores cancel\n");
+    return false;
+  }
+  printf("END_PRIME_GEN_TESTS\n");
+  return true;
+}
+
+bool bpsw_tests() {
+  printf("\nBPSW_TESTS\n");
+  // strong pseudoprimes to base 2, then strong Lucas pseudoprimes
+  uint64_t spsp2[] = {2047, 3277, 4033, 4681, 8321, 15841, 29341, 42799};
+  uint64_t slpsp[] = {5459, 5777, 10877, 16109, 18971, 22499, 24569};
+  int i, j;
+
+  for (i = 0; i < (int)(sizeof(spsp2) / sizeof(uint64_t)); i++) {
+    BigNum n(1, spsp2[i]);
+    if (!BigStrongProbablePrime(n, Big_Two) || BigBailliePSW(n)) {
+      printf("BPSW fails on base 2 pseudoprime %lld\n", (long long)spsp2[i]);
+      return false;
+    }
+  }
+  for (i = 0; i < (int)(sizeof(slpsp) / sizeof(uint64_t)); i++) {
+    BigNum n(1, slpsp[i]);
+    if (!BigStrongLucasProbablePrime(n) || BigBailliePSW(n)) {
+      printf("BPSW fails on Lucas pseudoprime %lld\n", (long long)slpsp[i]);
+      return false;
+    }
+  }
+  BigNum square(1, 1009ULL * 1009ULL);
+  if (BigStrongLucasProbablePrime(square)) {
+    printf("Lucas test accepts a square\n");
+    return false;
+  }
+
+  // every odd n below 20000 against trial division
+  for (i = 5; i < 20000; i += 2) {
+    bool prime = true;
+    for (j = 3; j * j <= i; j += 2) {
+      if ((i % j) == 0) {
+        prime = false;
+        break;
+      }
+    }
+    BigNum n(1, (uint64_t)i);
+    if (BigBailliePSW(n) != prime) {
+      printf("BPSW wrong on %d\n", i);
+      return false;
+    }
+  }
+
+  // Mersenne primes 2^127-1, 2^521-1 and the composite 2^128-1
+  BigNum m127(3);
+  BigNum m521(10);
+  BigNum m128(3);
+  BigShift(Big_One, 127, m127);
+  BigUnsignedDec(m127);
+  BigShift(Big_One, 521, m521);
+  BigUnsignedDec(m521);
+  BigShift(Big_One, 128, m128);
+  BigUnsignedDec(m128);
+  if (!BigIsPrime(m127, BIG_PRIME_BPSW) || !BigIsPrime(m521, BIG_PRIME_BPSW) ||
+      !BigIsPrime(m521, BIG_PRIME_BPSW, 3) ||
+      BigIsPrime(m128, BIG_PRIME_BPSW)) {
+    printf("BPSW wrong on 2^k-1\n");
+    return false;
+  }
+
+  // odd numbers that survive trial division, Miller-Rabin vs BPSW
+  uint64_t start, mr_cycles = 0, bpsw_cycles = 0;
+  int composites = 0;
+  for (i = 0; i < 200; i++) {
+    BigNum n(9);
+    if (!GetCryptoRand(512, (byte*)n.value_)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    n.value_[0] |= 1ULL;
+    n.value_[7] |= 1ULL << 63;
+    n.Normalize();
+    start = ReadRdtsc();
+    bool mr = BigIsPrime(n);
+    mr_cycles += ReadRdtsc() - start;
+    start = ReadRdtsc();
+    bool bpsw = BigIsPrime(n, BIG_PRIME_BPSW);
+    bpsw_cycles += ReadRdtsc() - start;
+    if (mr != bpsw) {
+      printf("Miller-Rabin and BPSW disagree\n");
+      return false;
+    }
+    if (!bpsw)
+      composites++;
+  }
+  printf("512 bits, %d composites, BigIsPrime Miller-Rabin/BPSW: %le/%le\n",
+         composites, ((double)mr_cycles) / ((double)(200 * cycles_per_second)),
+         ((double)bpsw_cycles) / ((double)(200 * cycles_per_second)));
+
+  BigNum p(9);
+  if (!BigGenPrime(p, 512)) {
+    printf("BigGenPrime fails\n");
+    return false;
+  }
+  start = ReadRdtsc();
+  for (i = 0; i < 10; i++) BigIsPrime(p);
+  mr_cycles = ReadRdtsc() - start;
+  start = ReadRdtsc();
+  for (i = 0; i < 10; i++) BigIsPrime(p, BIG_PRIME_BPSW);
+  bpsw_cycles = ReadRdtsc() - start;
+  printf("512 bit prime, BigIsPrime Miller-Rabin/BPSW: %le/%le\n",
+         ((double)mr_cycles) / ((double)(10 * cycles_per_second)),
+         ((double)bpsw_cycles) / ((double)(10 * cycles_per_second)));
+  printf("END_BPSW_TESTS\n");
+  return true;
+}
+
+bool modinv_tests() {
+  printf("\nMODINV_TESTS\n");
+  int sizes[] = {1, 2, 4, 6, 9, 16, 32};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int modes[] = {BIG_MODINV_LEHMER, BIG_MODINV_CONSTTIME};
+  int i, j, k, n;
+
+  for (i = 0; i < num_sizes; i++) {
+    n = sizes[i];
+    for (j = 0; j < 20; j++) {
+      BigNum m(n + 1);
+      BigNum a(n + 1);
+      BigNum r1(2 * n + 2);
+      BigNum r2(2 * n + 2);
+      BigNum t(2 * n + 2);
+
+      if (!GetCryptoRand(n * NBITSINUINT64, (byte*)m.value_) ||
+          !GetCryptoRand(n * NBITSINUINT64, (byte*)a.value_)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      if (m.value_[n - 1] == 0ULL)
+        m.value_[n - 1] = 1ULL;
+      if (j == 0)
+        a.value_[0] = 1ULL;
+      m.value_[0] |= 1ULL;
+      m.Normalize();
+      a.Normalize();
+      BigModNormalize(a, m);
+      if (!BigModInv(a, m, r1, BIG_MODINV_EUCLID))
+        continue;
+      if (!BigModMult(a, r1, m, t) || !t.IsOne())
+        continue;  // a not invertible
+      for (k = 0; k < 2; k++) {
+        r2.ZeroNum();
+        if (!BigModInv(a, m, r2, modes[k]) || BigCompare(r1, r2) != 0) {
+          printf("BigModInv mode %d, %d digits fails\n", modes[k], n);
+          return false;
+        }
+      }
+
+      // even modulus, Lehmer only
+      m.value_[0] &= ~1ULL;
+      m.Normalize();
+      a.value_[0] |= 1ULL;
+      BigModNormalize(a, m);
+      r1.ZeroNum();
+      r2.ZeroNum();
+      if (!BigModInv(a, m, r1, BIG_MODINV_EUCLID) ||
+          !BigModMult(a, r1, m, t) || !t.IsOne())
+        continue;
+      if (!BigModInv(a, m, r2, BIG_MODINV_LEHMER) || BigCompare(r1, r2) != 0) {
+        printf("BigModInv Lehmer, even modulus, %d digits fails\n", n);
+        return false;
+      }
+      if (BigModInv(a, m, r2, BIG_MODINV_CONSTTIME)) {
+        printf("BigModInv constant time accepts an even modulus\n");
+        return false;
+      }
+    }
+  }
+
+  // gcd(6, 15)= 3
+  BigNum m(1, 15ULL);
+  BigNum a(1, 6ULL);
+  BigNum r(2);
+  if (BigModInv(a, m, r, BIG_MODINV_LEHMER) ||
+      BigModInv(a, m, r, BIG_MODINV_CONSTTIME)) {
+    printf("BigModInv inverts a non-unit\n");
+    return false;
+  }
+  printf("END_MODINV_TESTS\n");
+  return true;
+}
+
+bool modinv_batch_tests() {
+  printf("\nMODINV_BATCH_TESTS\n");
+  int sizes[] = {1, 4, 6, 16};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int counts[] = {1, 2, 7, 33};
+  int num_counts = sizeof(counts) / sizeof(int);
+  int i, j, k, n, num;
+
+  for (i = 0; i < num_sizes; i++) {
+    n = sizes[i];
+    BigNum m(n + 1);
+
+    // prime, so every nonzero input is invertible
+    if (!BigGenPrime(m, n * NBITSINUINT64)) {
+      printf("BigGenPrime fails\n");
+      return false;
+    }
+    for (j = 0; j < num_counts; j++) {
+      num = counts[j];
+      BigNum** in = new BigNum*[num];
+      BigNum** out = new BigNum*[num];
+      BigNum r(2 * n + 2);
+      bool ok = true;
+
+      for (k = 0; k < num; k++) {
+        in[k] = new BigNum(n + 1);
+        out[k] = new BigNum(2 * n + 2);
+        if (!GetCryptoRand(n * NBITSINUINT64, (byte*)in[k]->value_))
+          ok = false;
+        in[k]->Normalize();
+        BigModNormalize(*in[k], m);
+        if (in[k]->IsZero())
+          in[k]->CopyFrom(Big_One);
+      }
+      if (ok && !BigModInvBatch(num, in, m, out))
+        ok = false;
+      for (k = 0; ok && k < num; k++) {
+        r.ZeroNum();
+        if (!BigModInv(*in[k], m, r) || BigCompare(r, *out[k]) != 0)
+          ok = false;
+      }
+      // in place
+      if (ok && (!BigModInvBatch(num, out, m, out) ||
+                 BigCompare(*in[num - 1], *out[num - 1]) != 0))
+        ok = false;
+      for (k = 0; k < num; k++) {
+        delete in[k];
+        delete out[k];
+      }
+      delete []in;
+      delete []out;
+      if (!ok) {
+        printf("BigModInvBatch %d digits, %d elements fails\n", n, num);
+        return false;
+      }
+    }
+  }
 
-  // 2048, speed 2, Decrypt
-  cycles_start_test = ReadRdtsc();
-  for (num_tests_executed = 0; num_tests_executed < num_tests;
-       num_tests_executed++) {
-    n = 256;
-    if (!key2->Decrypt(256, M, &n, C, 2)) {
-      printf("rsa 2048 bit decrypt test %d failed\n", num_tests_executed);
-      ret = false;
-      goto done;
+  // a zero element fails the whole batch
+  BigNum m(1, 101ULL);
+  BigNum a(1, 3ULL);
+  BigNum b(1);
+  BigNum r1(2);
+  BigNum r2(2);
+  BigNum* in[2] = {&a, &b};
+  BigNum* out[2] = {&r1, &r2};
+  if (BigModInvBatch(2, in, m, out)) {
+    printf("BigModInvBatch inverts 0\n");
+    return false;
+  }
+  printf("END_MODINV_BATCH_TESTS\n");
+  return true;
+}
+
+bool modinv_time_test(int num_tests) {
+  printf("\nMODINV_TIME_TEST\n");
+  int sizes[] = {4, 6, 16, 32};
+  int num_sizes = sizeof(sizes) / sizeof(int);
+  int modes[] = {BIG_MODINV_EUCLID, BIG_MODINV_LEHMER, BIG_MODINV_CONSTTIME};
+  uint64_t start, cycles[3];
+  int i, j, k, n;
+
+  for (i = 0; i < num_sizes; i++) {
+    n = sizes[i];
+    BigNum m(n + 1);
+    BigNum a(n + 1);
+    BigNum r(2 * n + 2);
+
+    if (!GetCryptoRand(n * NBITSINUINT64, (byte*)m.value_) ||
+        !GetCryptoRand(n * NBITSINUINT64, (byte*)a.value_)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    m.value_[n - 1] |= 1ULL << 63;
+    m.value_[0] |= 1ULL;
+    m.Normalize();
+    a.Normalize();
+    BigModNormalize(a, m);
+    for (k = 0; k < 3; k++) {
+      start = ReadRdtsc();
+      for (j = 0; j < num_tests; j++) BigModInv(a, m, r, modes[k]);
+      cycles[k] = ReadRdtsc() - start;
     }
+    printf("%2d digits, BigModInv Euclid/Lehmer/constant time: %le/%le/%le\n",
+           n, ((double)cycles[0]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[1]) / ((double)(num_tests * cycles_per_second)),
+           ((double)cycles[2]) / ((double)(num_tests * cycles_per_second)));
   }
-  cycles_end_test = ReadRdtsc();
-  cycles_diff = cycles_end_test - cycles_start_test;
-  printf("rsa2048 decrypt, speed 2, number of tests: %d\n", num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per decrypt %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
-  printf("\n");
+  printf("END_MODINV_TIME_TEST\n");
+  return true;
+}
 
-  // need to calculate p_prime_ and q_prime_
-  // 2048, speed 3, Encrypt
-  cycles_start_test = ReadRdtsc();
-  for (num_tests_executed = 0; num_tests_executed < num_tests;
-       num_tests_executed++) {
-    n = 256;
-    if (!key2->Encrypt(256, M, &n, C, 3)) {
-      printf("rsa 2048 bit encrypt test %d failed\n", num_tests_executed);
-      ret = false;
-      goto done;
+bool mont_batch_tests() {
+  printf("\nMONT_BATCH_TESTS\n");
+  int save_avx2 = digit_array_use_avx2;
+  int sizes[] = {1, 8, 16, 32, 48};
+  int num = 9;
+  bool ret = true;
+  int i, j, pass;
+
+  for (pass = 0; ret && pass < 2; pass++) {
+    digit_array_use_avx2 = pass == 0 ? -1 : 0;
+    for (i = 0; ret && i < (int)(sizeof(sizes) / sizeof(int)); i++) {
+      int size = sizes[i];
+      BigNum m(size);
+      BigNum check(size + 1);
+      BigNum* b[num];
+      BigNum* e[num];
+      BigNum* out[num];
+      MontgomeryContext ctx;
+
+      if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      m.value_[0] |= 1ULL;
+      m.value_[size - 1] |= 1ULL << 63;
+      m.Normalize();
+      if (!ctx.Init(m)) {
+        printf("MontgomeryContext::Init fails\n");
+        return false;
+      }
+      for (j = 0; j < num; j++) {
+        b[j] = new BigNum(size);
+        e[j] = new BigNum(size);
+        out[j] = new BigNum(size);
+        GetCryptoRand(size * NBITSINUINT64, (byte*)b[j]->value_);
+        GetCryptoRand((1 + j % size) * NBITSINUINT64, (byte*)e[j]->value_);
+        b[j]->Normalize();
+        e[j]->Normalize();
+      }
+      b[1]->ZeroNum();
+      b[1]->Normalize();
+      e[2]->ZeroNum();
+      e[2]->Normalize();
+      if (!BigMontExpBatch(num, b, e, ctx, out)) {
+        printf("BigMontExpBatch fails\n");
+        ret = false;
+      }
+      for (j = 0; ret && j < num; j++) {
+        check.ZeroNum();
+        if (!BigModExp(*b[j], *e[j], m, check) ||
+            BigCompare(check, *out[j]) != 0) {
+          printf("%d digits, operand %d, avx2 %d: batch exp differs\n", size,
+                 j, digit_array_use_avx2);
+          ret = false;
+        }
+      }
+      for (j = 0; j < num; j++) {
+        delete b[j];
+        delete e[j];
+        delete out[j];
+      }
     }
   }
-  cycles_end_test = ReadRdtsc();
-  cycles_diff = cycles_end_test - cycles_start_test;
-  printf("rsa2048 encrypt, speed 3, number of tests: %d\n", num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per encrypt %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
+  digit_array_use_avx2 = save_avx2;
+  printf("END_MONT_BATCH_TESTS\n");
+  return ret;
+}
 
-  // 2048, speed 0, Decrypt
-  cycles_start_test = ReadRdtsc();
-  for (num_tests_executed = 0; num_tests_executed < num_tests;
-       num_tests_executed++) {
-    n = 256;
-    if (!key2->Decrypt(256, M, &n, C, 3)) {
-      printf("rsa 2048 bit decrypt test %d failed\n", num_tests_executed);
-      ret = false;
-      goto done;
+bool ct_exp_tests() {
+  printf("\nCT_EXP_TESTS\n");
+  int sizes[] = {1, 4, 16, 32};
+  bool ret = true;
+  int i, j;
+
+  for (i = 0; ret && i < (int)(sizeof(sizes) / sizeof(int)); i++) {
+    int size = sizes[i];
+    BigNum m(size);
+    MontgomeryContext ctx;
+
+    if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    m.value_[0] |= 1ULL;
+    m.value_[size - 1] |= 1ULL << 63;
+    m.Normalize();
+    if (!ctx.Init(m)) {
+      printf("ctx.Init fails\n");
+      return false;
+    }
+    for (j = 0; ret && j < 20; j++) {
+      BigNum b(2 * size + 1);
+      BigNum e(size + 1);
+      BigNum base(2 * size + 1);
+      BigNum check(2 * size + 2);
+      BigNum out(size + 1);
+
+      // longer than m, shorter than m, zero and one
+      GetCryptoRand((1 + j % (2 * size + 1)) * NBITSINUINT64,
+                    (byte*)b.value_);
+      GetCryptoRand((1 + j % (size + 1)) * NBITSINUINT64, (byte*)e.value_);
+      if (j == 1)
+        b.ZeroNum();
+      if (j == 2)
+        e.ZeroNum();
+      if (j == 3) {
+        e.ZeroNum();
+        e.value_[0] = 1ULL;
+      }
+      b.Normalize();
+      e.Normalize();
+      BigMod(b, m, base);
+      if (!BigModExp(base, e, m, check)) {
+        printf("BigModExp fails\n");
+        return false;
+      }
+      if (!BigMontExpConstantTime(b, e, ctx, out) ||
+          BigCompare(out, check) != 0) {
+        printf("BigMontExpConstantTime mismatch, size %d, test %d\n", size, j);
+        printf("out: ");
+        PrintNumToConsole(out, 16ULL);
+        printf("\ncheck: ");
+        PrintNumToConsole(check, 16ULL);
+        printf("\n");
+        ret = false;
+      }
+      for (int w = 1; ret && w <= 7; w += 3) {
+        if (!BigMontExpConstantTime(b, e, ctx, out, w) ||
+            BigCompare(out, check) != 0) {
+          printf("BigMontExpConstantTime mismatch, width %d\n", w);
+          ret = false;
+        }
+      }
+      // base and check are both below m
+      BigNum product(2 * size + 2);
+      out.ZeroNum();
+      if (!BigModMult(base, check, m, product) ||
+          !BigModMultConstantTime(base, check, ctx, out) ||
+          BigCompare(out, product) != 0) {
+        printf("BigModMultConstantTime mismatch, size %d, test %d\n", size,
+               j);
+        ret = false;
+      }
     }
   }
-  cycles_end_test = ReadRdtsc();
-  cycles_diff = cycles_end_test - cycles_start_test;
-  printf("rsa2048 encrypt, speed 3, number of tests: %d\n", num_tests_executed);
-  printf("total ellapsed time %le\n",
-         ((double)cycles_diff) / ((double)cycles_per_second));
-  printf("time per decrypt %le\n",
-         ((double)cycles_diff) /
-             ((double)(num_tests_executed * cycles_per_second)));
-  printf("\n");
+  printf("END_CT_EXP_TESTS\n");
+  return ret;
+}
 
-done:
-  delete []buf;
-  printf("END_RSA_SPEED_TESTS\n");
+bool multiexp_tests() {
+  printf("\nMULTIEXP_TESTS\n");
+  int sizes[] = {1, 4, 16, 32};
+  int counts[] = {1, 2, 3, 8, 40};
+  int modes[] = {BIG_MULTIEXP_AUTO, BIG_MULTIEXP_STRAUS,
+                 BIG_MULTIEXP_PIPPENGER};
+  bool ret = true;
+  int i, j, l, mode, odd;
+
+  for (i = 0; ret && i < (int)(sizeof(sizes) / sizeof(int)); i++) {
+    for (odd = 0; ret && odd < 2; odd++) {
+      int size = sizes[i];
+      BigNum m(size);
+      BigNum check(2 * size + 2);
+      BigNum t(2 * size + 2);
+      BigNum p(2 * size + 2);
+      BigNum r(size + 1);
+
+      if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_)) {
+        printf("GetCryptoRand fails\n");
+        return false;
+      }
+      m.value_[size - 1] |= 1ULL << 63;
+      if (odd == 1)
+        m.value_[0] |= 1ULL;
+      else
+        m.value_[0] &= ~1ULL;
+      m.Normalize();
+      for (j = 0; ret && j < (int)(sizeof(counts) / sizeof(int)); j++) {
+        int n = counts[j];
+        BigNum* b[n];
+        BigNum* e[n];
+
+        for (l = 0; l < n; l++) {
+          b[l] = new BigNum(size + 1);
+          e[l] = new BigNum(size);
+          GetCryptoRand((size + 1) * NBITSINUINT64, (byte*)b[l]->value_);
+          GetCryptoRand((1 + l % size) * NBITSINUINT64, (byte*)e[l]->value_);
+          b[l]->Normalize();
+          e[l]->Normalize();
+        }
+        if (n > 2) {
+          e[1]->ZeroNum();
+          e[1]->Normalize();
+          b[2]->ZeroNum();
+          b[2]->Normalize();
+        }
+
+        // product of separate exponentiations
+        check.ZeroNum();
+        check.CopyFrom(Big_One);
+        BigModNormalize(check, m);
+        for (l = 0; ret && l < n; l++) {
+          t.ZeroNum();
+          p.ZeroNum();
+          BigNum base(size + 1);
+          BigMod(*b[l], m, base);
+          if (!BigModExp(base, *e[l], m, t) || !BigModMult(check, t, m, p)) {
+            printf("BigModExp fails\n");
+            ret = false;
+          }
+          check.ZeroNum();
+          check.CopyFrom(p);
+        }
+        for (mode = 0; ret && mode < 3; mode++) {
+          r.ZeroNum();
+          if (!BigModMultiExp(n, b, e, m, r, modes[mode]) ||
+              BigCompare(r, check) != 0) {
+            printf("%d digits, %s modulus, %d bases, mode %d: "
+                   "BigModMultiExp differs\n",
+                   size, odd == 1 ? "odd" : "even", n, modes[mode]);
+            ret = false;
+          }
+        }
+        for (l = 0; l < n; l++) {
+          delete b[l];
+          delete e[l];
+        }
+      }
+    }
+  }
+  printf("END_MULTIEXP_TESTS\n");
   return ret;
 }
 
+bool multiexp_time_test(int size, int num_tests) {
+  printf("\nMULTIEXP_TIME_TEST\n");
+  BigNum m(size);
+  BigNum a(size);
+  BigNum b(size);
+  BigNum x(size);
+  BigNum y(size);
+  BigNum t1(size + 1);
+  BigNum t2(size + 1);
+  BigNum r(size + 1);
+  BigNum* bases[2] = {&a, &b};
+  BigNum* exps[2] = {&x, &y};
+  uint64_t start, separate_cycles, multi_cycles;
+  int i;
+
+  if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)a.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)b.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)x.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)y.value_)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  m.value_[0] |= 1ULL;
+  m.value_[size - 1] |= 1ULL << 63;
+  a.value_[size - 1] >>= 1;
+  b.value_[size - 1] >>= 1;
+  m.Normalize();
+  a.Normalize();
+  b.Normalize();
+  x.Normalize();
+  y.Normalize();
+
+  start = ReadRdtsc();
+  for (i = 0; i < num_tests; i++) {
+    BigModExp(a, x, m, t1);
+    BigModExp(b, y, m, t2);
+    BigModMult(t1, t2, m, r);
+  }
+  separate_cycles = ReadRdtsc() - start;
+  start = ReadRdtsc();
+  for (i = 0; i < num_tests; i++) BigModMultiExp(2, bases, exps, m, r);
+  multi_cycles = ReadRdtsc() - start;
+  printf("%d bit a^x b^y: two BigModExp %le, BigModMultiExp %le seconds\n",
+         size * NBITSINUINT64,
+         (double)separate_cycles / (double)(num_tests * cycles_per_second),
+         (double)multi_cycles / (double)(num_tests * cycles_per_second));
+  printf("END_MULTIEXP_TIME_TEST\n");
+  return true;
+}
+
+//  The constant time exponentiation against the variable time windowed
+//  one it replaces for secret exponents.
+bool ct_exp_time_test(int size, int num_tests) {
+  printf("\nCT_EXP_TIME_TEST\n");
+  BigNum m(size);
+  BigNum b(size);
+  BigNum e(size);
+  BigNum out(size + 1);
+  BigNum check(size + 1);
+  MontgomeryContext ctx;
+  uint64_t start, elapsed;
+  uint64_t windowed_cycles = 0;
+  uint64_t ct_cycles = 0;
+  int i, k;
+
+  if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)b.value_) ||
+      !GetCryptoRand(size * NBITSINUINT64, (byte*)e.value_)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  m.value_[0] |= 1ULL;
+  m.value_[size - 1] |= 1ULL << 63;
+  m.Normalize();
+  b.value_[size - 1] >>= 1;
+  b.Normalize();
+  e.value_[size - 1] |= 1ULL << 63;
+  e.Normalize();
+  if (!ctx.Init(m))
+    return false;
+  if (!BigMontExpWindowed(b, e, ctx, check) ||
+      !BigMontExpConstantTime(b, e, ctx, out) || BigCompare(check, out) != 0) {
+    printf("BigMontExpConstantTime does not match BigMontExpWindowed\n");
+    return false;
+  }
+
+  // best of 5
+  for (k = 0; k < 5; k++) {
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) BigMontExpWindowed(b, e, ctx, out);
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < windowed_cycles)
+      windowed_cycles = elapsed;
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) BigMontExpConstantTime(b, e, ctx, out);
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < ct_cycles)
+      ct_cycles = elapsed;
+  }
+
+  double windowed_time =
+      (double)windowed_cycles / (double)(num_tests * cycles_per_second);
+  double ct_time = (double)ct_cycles / (double)(num_tests * cycles_per_second);
+  double overhead = 100.0 * (ct_time - windowed_time) / windowed_time;
+  printf("%d bit exponentiations: BigMontExpWindowed %le, "
+         "BigMontExpConstantTime %le seconds each, overhead %.1lf%%\n",
+         size * NBITSINUINT64, windowed_time, ct_time, overhead);
+  printf("END_CT_EXP_TIME_TEST\n");
+  return true;
+}
+
+bool mont_batch_time_test(int size, int num_tests) {
+  printf("\nMONT_BATCH_TIME_TEST\n");
+  int num = 8;
+  BigNum m(size);
+  BigNum* b[num];
+  BigNum* e[num];
+  BigNum* out[num];
+  MontgomeryContext ctx;
+  uint64_t start, elapsed;
+  uint64_t scalar_cycles = 0;
+  uint64_t batch_cycles = 0;
+  int i, j, k;
+
+  if (!GetCryptoRand(size * NBITSINUINT64, (byte*)m.value_)) {
+    printf("GetCryptoRand fails\n");
+    return false;
+  }
+  m.value_[0] |= 1ULL;
+  m.value_[size - 1] |= 1ULL << 63;
+  m.Normalize();
+  if (!ctx.Init(m))
+    return false;
+  for (j = 0; j < num; j++) {
+    b[j] = new BigNum(size);
+    e[j] = new BigNum(size);
+    out[j] = new BigNum(size + 1);
+    GetCryptoRand(size * NBITSINUINT64, (byte*)b[j]->value_);
+    GetCryptoRand(size * NBITSINUINT64, (byte*)e[j]->value_);
+    b[j]->value_[size - 1] >>= 1;
+    b[j]->Normalize();
+    e[j]->Normalize();
+  }
+
+  // best of 3
+  for (k = 0; k < 3; k++) {
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) {
+      for (j = 0; j < num; j++) BigMontExp(*b[j], *e[j], ctx, *out[j]);
+    }
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < scalar_cycles)
+      scalar_cycles = elapsed;
+    start = ReadRdtsc();
+    for (i = 0; i < num_tests; i++) BigMontExpBatch(num, b, e, ctx, out);
+    elapsed = ReadRdtsc() - start;
+    if (k == 0 || elapsed < batch_cycles)
+      batch_cycles = elapsed;
+  }
+
+  double scalar_time = (double)scalar_cycles /
+                       (double)(num_tests * num * cycles_per_second);
+  double batch_time = (double)batch_cycles /
+                      (double)(num_tests * num * cycles_per_second);
+  printf("%d bit exponentiations, avx2 %d: BigMontExp %le, "
+         "BigMontExpBatch %le seconds each, speedup %.2lf\n",
+         size * NBITSINUINT64, DigitArrayUseAvx2() ? 1 : 0, scalar_time,
+         batch_time, scalar_time / batch_time);
+  for (j = 0; j < num; j++) {
+    delete b[j];
+    delete e[j];
+    delete out[j];
+  }
+  printf("END_MONT_BATCH_TIME_TEST\n");
+  return true;
+}
+
 bool mont_arith_tests() {
   printf("\nMONT_ARITH_TESTS\n");
   BigNum a(8);
@@ -3563,6 +6400,84 @@ bool mont_arith_tests() {
     printf("\n");
   }
 
+  // word-level context against the generic routines
+  BigNum big_m(16);
+  BigNum big_a(16);
+  BigNum big_e(16);
+  BigNum big_out1(32);
+  BigNum big_out2(32);
+  BigNum big_aR(16);
+  BigNum big_aaR(16);
+  MontgomeryContext ctx;
+
+  for (int j = 0; j < 10; j++) {
+    big_m.ZeroNum();
+    big_a.ZeroNum();
+    big_e.ZeroNum();
+    big_out1.ZeroNum();
+    big_out2.ZeroNum();
+    if (!GetCryptoRand(1024, (byte*)big_m.value_) ||
+        !GetCryptoRand(1000, (byte*)big_a.value_) ||
+        !GetCryptoRand(1024, (byte*)big_e.value_)) {
+      printf("GetCryptoRand fails\n");
+      return false;
+    }
+    big_m.value_[0] |= 1ULL;
+    big_m.Normalize();
+    big_a.Normalize();
+    big_e.Normalize();
+    if (!ctx.Init(big_m)) {
+      printf("MontgomeryContext::Init fails\n");
+      return false;
+    }
+    if (!BigMontExp(big_a, big_e, ctx, big_out1)) {
+      printf("BigMontExp (context) fails\n");
+      return false;
+    }
+    if (!BigModExp(big_a, big_e, big_m, big_out2)) {
+      printf("BigModExp fails\n");
+      return false;
+    }
+    if (BigCompare(big_out1, big_out2) != 0) {
+      printf("BigMontExp (context) compare fails\n");
+      return false;
+    }
+    // every window width and mode against the binary ladder
+    for (int w = 1; w <= 6; w++) {
+      for (int sliding = 0; sliding < 2; sliding++) {
+        big_out1.ZeroNum();
+        if (!BigMontExpWindowed(big_a, big_e, ctx, big_out1, w, sliding == 1) ||
+            BigCompare(big_out1, big_out2) != 0) {
+          printf("BigMontExpWindowed(%d, %d) fails\n", w, sliding);
+          return false;
+        }
+        big_out1.ZeroNum();
+        if (!BigModExpWindowed(big_a, big_e, big_m, big_out1, w, sliding == 1) ||
+            BigCompare(big_out1, big_out2) != 0) {
+          printf("BigModExpWindowed(%d, %d) fails\n", w, sliding);
+          return false;
+        }
+      }
+    }
+    big_aR.ZeroNum();
+    big_aaR.ZeroNum();
+    big_out1.ZeroNum();
+    big_out2.ZeroNum();
+    if (!ctx.ToMont(big_a, big_aR) || !ctx.MontSquare(big_aR, big_aaR) ||
+        !ctx.FromMont(big_aaR, big_out1)) {
+      printf("MontgomeryContext square fails\n");
+      return false;
+    }
+    if (!BigModMult(big_a, big_a, big_m, big_out2)) {
+      printf("BigModMult fails\n");
+      return false;
+    }
+    if (BigCompare(big_out1, big_out2) != 0) {
+      printf("MontgomeryContext square compare fails\n");
+      return false;
+    }
+  }
+
   printf("END_MONT_ARITH_TESTS\n");
   return true;
 }
@@ -3846,10 +6761,193 @@ bool rsa_tests() {
     printf("RSA-1024 input does not match decrypted encrypted version\n");
     return false;
   }
+
+  // full size inputs through every private key path
+  for (int j = 0; j < 10; j++) {
+    GetCryptoRand(128 * NBITSINBYTE, in);
+    in[0] &= 0x7f;
+    size_out = 256;
+    if (!rsa_key2->Encrypt(128, in, &size_out, out, 0)) {
+      printf("rsa Encrypt failed\n");
+      return false;
+    }
+    for (int speed = 0; speed < 5; speed++) {
+      size_out = 256;
+      memset(new_out, 0, 256);
+      if (!rsa_key2->Decrypt(128, out, &size_out, new_out, speed) ||
+          memcmp(in, new_out, size_out) != 0) {
+        printf("RSA-1024 decrypt speed %d does not match\n", speed);
+        return false;
+      }
+    }
+  }
+
+  // q_inv survives serialization and the restored key decrypts
+  crypto_rsa_key_message rsa_msg;
+  RsaKey restored;
+  if (!rsa_key2->SerializeKeyToMessage(rsa_msg) || !rsa_msg.has_q_inv() ||
+      !restored.DeserializeKeyFromMessage(rsa_msg) ||
+      restored.q_inv_ == nullptr ||
+      BigCompare(*restored.q_inv_, *rsa_key2->q_inv_) != 0) {
+    printf("RSA q_inv not serialized\n");
+    return false;
+  }
+  // the contexts are built on load, Decrypt only reads them
+  for (int speed = 0; speed < 5; speed++) {
+    size_out = 256;
+    memset(new_out, 0, 256);
+    if (!restored.Decrypt(128, out, &size_out, new_out, speed) ||
+        memcmp(in, new_out, size_out) != 0) {
+      printf("restored RSA key does not decrypt at speed %d\n", speed);
+      return false;
+    }
+  }
   printf("END RSA_TESTS\n");
   return true;
 }
 
+bool rsa_multi_prime_tests() {
+  printf("\nRSA_MULTI_PRIME_TESTS\n");
+  byte in[256];
+  byte out[256];
+  byte new_out[256];
+  int size_out;
+  int num_primes, i, j, speed;
+
+  for (num_primes = 3; num_primes <= 4; num_primes++) {
+    RsaKey key;
+    if (!key.GenerateRsaKey("test-key", "test", "test", 1024,
+                            COMMON_YEAR_SECONDS, num_primes)) {
+      printf("GenerateRsaKey failed, %d primes\n", num_primes);
+      return false;
+    }
+
+    // m is the product of all the primes and has exactly 1024 bits
+    BigNum prod(33);
+    BigNum t(33);
+    if (BigHighBit(*key.m_) != 1024 ||
+        (int)key.other_primes_.size() != (num_primes - 2) ||
+        !BigMult(*key.p_, *key.q_, prod)) {
+      printf("bad %d prime key\n", num_primes);
+      return false;
+    }
+    for (i = 0; i < (int)key.other_primes_.size(); i++) {
+      t.ZeroNum();
+      BigMult(prod, *key.other_primes_[i], t);
+      prod.ZeroNum();
+      prod.CopyFrom(t);
+    }
+    if (BigCompare(prod, *key.m_) != 0) {
+      printf("m is not the product of the primes\n");
+      return false;
+    }
+
+    for (j = 0; j < 5; j++) {
+      memset(in, 0, 256);
+      GetCryptoRand(128 * NBITSINBYTE, in);
+      in[0] &= 0x7f;
+      if (j == 0) {
+        memset(in, 0, 128);
+        in[127] = 2;
+      }
+      size_out = 256;
+      if (!key.Encrypt(128, in, &size_out, out, 0)) {
+        printf("rsa Encrypt failed\n");
+        return false;
+      }
+      for (speed = 0; speed < 5; speed++) {
+        size_out = 256;
+        memset(new_out, 0, 256);
+        if (!key.Decrypt(128, out, &size_out, new_out, speed) ||
+            memcmp(in, new_out, size_out) != 0) {
+          printf("%d prime decrypt speed %d does not match\n", num_primes,
+                 speed);
+          return false;
+        }
+        if (speed > 3)
+          continue;
+        size_out = 256;
+        memset(new_out, 0, 256);
+        if (!key.Encrypt(128, in, &size_out, new_out, speed) ||
+            memcmp(out, new_out, size_out) != 0) {
+          printf("%d prime encrypt speed %d does not match\n", num_primes,
+                 speed);
+          return false;
+        }
+      }
+    }
+
+    // the other primes survive serialization
+    crypto_rsa_key_message msg;
+    RsaKey restored;
+    if (!key.SerializeKeyToMessage(msg) ||
+        msg.other_primes_size() != (num_primes - 2) ||
+        !restored.DeserializeKeyFromMessage(msg) ||
+        restored.other_primes_.size() != key.other_primes_.size()) {
+      printf("%d prime key not serialized\n", num_primes);
+      return false;
+    }
+    size_out = 256;
+    memset(new_out, 0, 256);
+    if (!restored.Decrypt(128, out, &size_out, new_out) ||
+        memcmp(in, new_out, size_out) != 0) {
+      printf("restored %d prime key does not decrypt\n", num_primes);
+      return false;
+    }
+  }
+  printf("END_RSA_MULTI_PRIME_TESTS\n");
+  return true;
+}
+
+//  Private key operations with two and three primes at the same size
+bool rsa_multi_prime_time_test(int num_bits, int num_tests) {
+  printf("\nRSA_MULTI_PRIME_TIME_TEST\n");
+  RsaKey key2;
+  RsaKey key3;
+  byte M[512];
+  byte C[512];
+  uint64_t start, elapsed;
+  uint64_t cycles2 = 0;
+  uint64_t cycles3 = 0;
+  int size = num_bits / NBITSINBYTE;
+  int i, n;
+
+  if (!key2.GenerateRsaKey("test-key", "test", "test", num_bits,
+                           COMMON_YEAR_SECONDS, 2) ||
+      !key3.GenerateRsaKey("test-key", "test", "test", num_bits,
+                           COMMON_YEAR_SECONDS, 3)) {
+    printf("Cant generate %d bit keys\n", num_bits);
+    return false;
+  }
+  memset(M, 0, 512);
+  GetCryptoRand(size * NBITSINBYTE, M);
+  M[0] &= 0x3f;
+
+  // fastest single operation of each, interleaved
+  for (i = 0; i < num_tests; i++) {
+    n = 512;
+    start = ReadRdtsc();
+    if (!key2.Decrypt(size, M, &n, C, 3))
+      return false;
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < cycles2)
+      cycles2 = elapsed;
+    n = 512;
+    start = ReadRdtsc();
+    if (!key3.Decrypt(size, M, &n, C, 3))
+      return false;
+    elapsed = ReadRdtsc() - start;
+    if (i == 0 || elapsed < cycles3)
+      cycles3 = elapsed;
+  }
+  double time2 = (double)cycles2 / (double)cycles_per_second;
+  double time3 = (double)cycles3 / (double)cycles_per_second;
+  printf("rsa%d decrypt: two primes %le, three primes %le seconds, "
+         "speedup %.2lf\n", num_bits, time2, time3, time2 / time3);
+  printf("END_RSA_MULTI_PRIME_TIME_TEST\n");
+  return true;
+}
+
 bool simple_ecc_tests() {
   if (FLAGS_printall) {
     printf("\nSIMPLE_ECC_TESTS\n");
@@ -4333,6 +7431,22 @@ TEST(BigNum, SquareTest) {
   EXPECT_TRUE(square_test());
 }
 
+TEST(BigNum, MulxTest) {
+  EXPECT_TRUE(mulx_tests());
+}
+
+TEST(BigNum, FixedKernelTest) {
+  EXPECT_TRUE(fixed_kernel_tests());
+}
+
+TEST(BigNum, FixedKernelTimeTest) {
+  EXPECT_TRUE(fixed_kernel_time_test(2000));
+}
+
+TEST(BigNum, FastMultTest) {
+  EXPECT_TRUE(fast_mult_tests());
+}
+
 TEST(BigNum, PrintTest) {
   EXPECT_TRUE(print_tests());
 }
@@ -4341,6 +7455,14 @@ TEST(BigNum, BasicTest) {
   EXPECT_TRUE(basic_tests());
 }
 
+TEST(BigNum, MoveTest) {
+  EXPECT_TRUE(move_tests());
+}
+
+TEST(BigNum, ScratchArenaTest) {
+  EXPECT_TRUE(scratch_arena_tests());
+}
+
 TEST(BigNum, ConvertTest) {
   EXPECT_TRUE(convert_tests());
 }
@@ -4373,10 +7495,50 @@ TEST(BigNum, KeyStoreTest) {
   EXPECT_TRUE(key_store_tests());
 }
 
+TEST(BigNum, BarrettTest) {
+  EXPECT_TRUE(barrett_tests());
+}
+
+TEST(BigNum, BarrettTimeTest) {
+  EXPECT_TRUE(barrett_time_test(2000));
+}
+
+TEST(BigNum, PrimeGenTest) {
+  EXPECT_TRUE(prime_gen_tests());
+}
+
+TEST(BigNum, BPSWTest) {
+  EXPECT_TRUE(bpsw_tests());
+}
+
+TEST(BigNum, ModInvTest) {
+  EXPECT_TRUE(modinv_tests());
+}
+
+TEST(BigNum, ModInvBatchTest) {
+  EXPECT_TRUE(modinv_batch_tests());
+}
+
+TEST(BigNum, ModInvTimeTest) {
+  EXPECT_TRUE(modinv_time_test(1000));
+}
+
 TEST(BigNum, MontTest) {
   EXPECT_TRUE(mont_arith_tests());
 }
 
+TEST(BigNum, MontBatchTest) {
+  EXPECT_TRUE(mont_batch_tests());
+}
+
+TEST(BigNum, CtExpTest) {
+  EXPECT_TRUE(ct_exp_tests());
+}
+
+TEST(BigNum, MultiExpTest) {
+  EXPECT_TRUE(multiexp_tests());
+}
+
 TEST(BigNum, SimpleMultTest) {
   EXPECT_TRUE(simple_mult_time_test("test_data", TESTBUFSIZE, 1000000));
 }
@@ -4394,6 +7556,22 @@ TEST(BigNum, MultTimeTest) {
   EXPECT_TRUE(mult_time_test("test_data", 64, 5000));
 }
 
+TEST(BigNum, MultThresholdTest) {
+  EXPECT_TRUE(mult_threshold_test(100));
+}
+
+TEST(BigNum, DivisionTest) {
+  EXPECT_TRUE(division_tests());
+}
+
+TEST(BigNum, DivThresholdTest) {
+  EXPECT_TRUE(div_threshold_test(200));
+}
+
+TEST(BigNum, RadixConversionTest) {
+  EXPECT_TRUE(radix_conversion_tests());
+}
+
 TEST(BigNum, DivTimeTest) {
   EXPECT_TRUE(div_time_test("test_data", 32, 5000));
 }
@@ -4406,6 +7584,21 @@ TEST(BigNum, MontTimeTest) {
   EXPECT_TRUE(mont_exp_time_test("test_data", 16, 50));
 }
 
+TEST(BigNum, CtExpTimeTest) {
+  EXPECT_TRUE(ct_exp_time_test(16, 50));
+  EXPECT_TRUE(ct_exp_time_test(32, 10));
+}
+
+TEST(BigNum, MultiExpTimeTest) {
+  EXPECT_TRUE(multiexp_time_test(16, 50));
+  EXPECT_TRUE(multiexp_time_test(32, 10));
+}
+
+TEST(BigNum, MontBatchTimeTest) {
+  EXPECT_TRUE(mont_batch_time_test(16, 20));
+  EXPECT_TRUE(mont_batch_time_test(32, 5));
+}
+
 TEST(BigNum, SimpleEccTest) {
   EXPECT_TRUE(simple_ecc_tests());
 }
@@ -4426,6 +7619,10 @@ TEST(BigNum, EccDoubleTimeTest) {
   EXPECT_TRUE(ecc_double_time_test("test_data", ext_ecc_key, 200));
 }
 
+TEST(BigNum, EccFormulaTimeTest) {
+  EXPECT_TRUE(ecc_formula_time_test(1000));
+}
+
 TEST(BigNum, EccMultTimeTest) {
   EXPECT_TRUE(ecc_mult_time_test("test_data", ext_ecc_key, 200));
 }
@@ -4446,10 +7643,54 @@ TEST(BigNum, EccProjectiveCompareTimeTest) {
   EXPECT_TRUE(ecc_projective_compare_tests(ext_ecc_key, 200));
 }
 
+TEST(BigNum, EccProjectiveBatchTest) {
+  EXPECT_TRUE(ecc_projective_batch_tests(ext_ecc_key, 12));
+}
+
+TEST(BigNum, P256FieldTest) {
+  EXPECT_TRUE(p256_field_tests(200));
+}
+
+TEST(BigNum, P256MultTest) {
+  EXPECT_TRUE(p256_mult_tests(20));
+}
+
+TEST(BigNum, JacobianTest) {
+  EXPECT_TRUE(jacobian_tests());
+}
+
+TEST(BigNum, WNafTest) {
+  EXPECT_TRUE(wnaf_tests());
+}
+
+TEST(BigNum, BaseTableTest) {
+  EXPECT_TRUE(base_table_tests());
+}
+
+TEST(BigNum, EcdsaTest) {
+  EXPECT_TRUE(ecdsa_tests());
+}
+
 TEST(BigNum, EccSpeedTest) {
   EXPECT_TRUE(ecc_speed_tests(nullptr, "test_data", 0, 200));
 }
 
+TEST(BigNum, P256MultTimeTest) {
+  EXPECT_TRUE(p256_mult_time_test(10));
+}
+
+TEST(BigNum, WNafTimeTest) {
+  EXPECT_TRUE(wnaf_time_test(10));
+}
+
+TEST(BigNum, BaseTableTimeTest) {
+  EXPECT_TRUE(base_table_time_test(10));
+}
+
+TEST(BigNum, EcdsaTimeTest) {
+  EXPECT_TRUE(ecdsa_time_test(100));
+}
+
 TEST(BigNum, SquareRootTest) {
   EXPECT_TRUE(square_root_time_test("test_data", 10, *(ext_ecc_key->c_.p_), 200));
 }
@@ -4458,6 +7699,10 @@ TEST(BigNum, RsaTest) {
   EXPECT_TRUE(rsa_tests());
 }
 
+TEST(BigNum, RsaMultiPrimeTest) {
+  EXPECT_TRUE(rsa_multi_prime_tests());
+}
+
 TEST(BigNum, RsaGen1024Test) {
   EXPECT_TRUE(rsa1024_gen_time_test("test_data", 4));
 }
@@ -4470,6 +7715,14 @@ TEST(BigNum, RsaSpeedTest) {
   EXPECT_TRUE(rsa_speed_tests(nullptr, nullptr, "test_data", 0, 500));
 }
 
+TEST(BigNum, RsaParallelCrtTimeTest) {
+  EXPECT_TRUE(rsa_parallel_crt_time_test(2048, 20));
+}
+
+TEST(BigNum, RsaMultiPrimeTimeTest) {
+  EXPECT_TRUE(rsa_multi_prime_time_test(3072, 10));
+}
+
 TEST_F(BigNumTest, RunTestSuite) {
   EXPECT_TRUE(RunTestSuite());
 }
@@ -56,7 +56,8 @@ endif
 
 dobj=	$(O)/bignumtest.o $(O)/bignum.o $(O)/basic_arith.o $(O)/number_theory.o \
 	$(O)/arith64.o $(O)/intel64_arith.o $(O)/globals.o $(O)/util.o $(O)/conversions.o \
-	$(O)/smallprimes.o $(O)/ecc.o $(O)/rsa.o $(O)/keys.o $(O)/keys.pb.o 
+	$(O)/smallprimes.o $(O)/ecc.o $(O)/p256.o $(O)/rsa.o $(O)/keys.o $(O)/keys.pb.o \
+	$(O)/ecdsa.o $(O)/hash.o $(O)/sha256.o $(O)/hmac_sha256.o
 
 all:	bignumtest.exe
 clean:
@@ -124,6 +125,26 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -I$(SRC_DIR)/keys -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -I$(SRC_DIR)/keys -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
+$(O)/ecdsa.o: $(SRC_DIR)/ecc/ecdsa.cc
+	@echo "compiling ecdsa.cc"
+	$(CC) $(CFLAGS) -I$(SRC_DIR)/keys -c -o $(O)/ecdsa.o $(SRC_DIR)/ecc/ecdsa.cc
+
+$(O)/hash.o: $(SRC_DIR)/hash/hash.cc
+	@echo "compiling hash.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/hash.o $(SRC_DIR)/hash/hash.cc
+
+$(O)/sha256.o: $(SRC_DIR)/hash/sha256.cc
+	@echo "compiling sha256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/sha256.o $(SRC_DIR)/hash/sha256.cc
+
+$(O)/hmac_sha256.o: $(SRC_DIR)/hash/hmac_sha256.cc
+	@echo "compiling hmac_sha256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/hmac_sha256.o $(SRC_DIR)/hash/hmac_sha256.cc
+
 $(O)/rsa.o: $(SRC_DIR)/rsa/rsa.cc
 	@echo "compiling rsa.cc"
 	$(CC) $(CFLAGS) -I$(SRC_DIR)/keys -c -o $(O)/rsa.o $(SRC_DIR)/rsa/rsa.cc
@@ -20,7 +20,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <immintrin.h>
 #include "bignum.h"
+#include "fixed_arith.h"
 #include "conversions.h"
 #include "util.h"
 
@@ -116,6 +118,94 @@ void Uint64DivStep(uint64_t a, uint64_t b, uint64_t c, uint64_t* result,
       : "cc", "memory", "%rax", "%rbx", "%rcx", "%rdx");
 }
 
+//  Division by an invariant normalized divisor (Moller and Granlund,
+//  "Improved division by invariant integers").  Once the reciprocal v of
+//  d is known, each quotient digit takes two multiplies and a few
+//  adjustments instead of a divq.
+
+// v= floor((2^128-1)/d) - 2^64, d >= 2^63
+uint64_t Uint64Reciprocal(uint64_t d) {
+  uint64_t v, r;
+
+  asm("\tdivq   %[d]\n"
+      : "=a"(v), "=d"(r)
+      : "0"(~0ULL), "1"(~d), [d] "rm"(d)
+      : "cc");
+  return v;
+}
+
+// v= floor((2^192-1)/(d1:d0)) - 2^64, d1 >= 2^63
+uint64_t Uint64Reciprocal3By2(uint64_t d1, uint64_t d0) {
+  uint64_t v = Uint64Reciprocal(d1);
+  uint64_t p = d1 * v + d0;
+
+  if (p < d0) {
+    v--;
+    if (p >= d1) {
+      v--;
+      p -= d1;
+    }
+    p -= d1;
+  }
+  uint128_t t = (uint128_t)v * d0;
+  uint64_t t1 = (uint64_t)(t >> 64);
+  uint64_t t0 = (uint64_t)t;
+  p += t1;
+  if (p < t1) {
+    v--;
+    if (p > d1 || (p == d1 && t0 >= d0))
+      v--;
+  }
+  return v;
+}
+
+//  q= (u1:u0)/d, r remainder.  d >= 2^63, u1 < d, v= Uint64Reciprocal(d)
+void Uint64DivStep2By1(uint64_t u1, uint64_t u0, uint64_t d, uint64_t v,
+                       uint64_t* q, uint64_t* r) {
+  uint128_t t = (uint128_t)v * u1 + (((uint128_t)(u1 + 1)) << 64) + u0;
+  uint64_t q1 = (uint64_t)(t >> 64);
+  uint64_t q0 = (uint64_t)t;
+  uint64_t rem = u0 - q1 * d;
+
+  if (rem > q0) {
+    q1--;
+    rem += d;
+  }
+  if (rem >= d) {
+    q1++;
+    rem -= d;
+  }
+  *q = q1;
+  *r = rem;
+}
+
+//  q= (u2:u1:u0)/(d1:d0), (r1:r0) remainder.  d1 >= 2^63,
+//  (u2:u1) < (d1:d0), v= Uint64Reciprocal3By2(d1, d0)
+void Uint64DivStep3By2(uint64_t u2, uint64_t u1, uint64_t u0, uint64_t d1,
+                       uint64_t d0, uint64_t v, uint64_t* q, uint64_t* r1,
+                       uint64_t* r0) {
+  uint128_t d = ((uint128_t)d1 << 64) | d0;
+  uint128_t t = (uint128_t)v * u2 + (((uint128_t)u2) << 64) + u1;
+  uint64_t q1 = (uint64_t)(t >> 64);
+  uint64_t q0 = (uint64_t)t;
+  uint128_t rem = ((uint128_t)(u1 - q1 * d1) << 64) | u0;
+
+  rem -= d;
+  rem -= (uint128_t)d0 * q1;
+  q1++;
+  if ((uint64_t)(rem >> 64) >= q0) {
+    q1--;
+    rem += d;
+  }
+  if (rem >= d) {
+    q1++;
+    rem -= d;
+  }
+  *q = q1;
+  *r1 = (uint64_t)(rem >> 64);
+  *r0 = (uint64_t)rem;
+}
+
 //  carry_out:result= a+b+carry_in
 void Uint64AddWithCarryStep(uint64_t a, uint64_t b, uint64_t carry_in,
                             uint64_t* result, uint64_t* carry_out) {
@@ -184,7 +274,142 @@ void Uint64MultWithCarryStep(uint64_t a, uint64_t b, uint64_t carry1,
       : "cc", "memory", "%rax", "%rbx", "%rcx", "%rdx");
 }
 
+// 1 forces the mulx/adcx/adox kernels, 0 the mulq ones, -1 follows cpuid.
+// Only tests set it; the cpuid answer is kept apart so threads never write
+// shared state from the multiply path.
+int digit_array_use_mulx = -1;
+
+static bool UseMulx() {
+  static const bool have_mulx = HaveBmi2Adx();
+
+  if (digit_array_use_mulx < 0)
+    return have_mulx;
+  return digit_array_use_mulx == 1;
+}
+
+//  r[0, n)+= x*a[0, n), returns the carry out of r[n-1].
+//  One mulq per digit, carries propagate through rdx.
+static uint64_t DigitArrayMultAddRow(uint64_t x, int n, uint64_t* a,
+                                     uint64_t* r) {
+  uint64_t len = (uint64_t)n;
+  uint64_t carry;
+
+  asm volatile(
+      "\tmovq   %[x], %%r11\n"
+      "\tmovq   %[a], %%r8\n"
+      "\tmovq   %[r], %%r9\n"
+      "\tmovq   %[len], %%rcx\n"
+      "\txorq   %%r10, %%r10\n"  // carry
+      "1:\n"
+      "\tmovq   (%%r8), %%rax\n"
+      "\tmulq   %%r11\n"
+      "\taddq   %%r10, %%rax\n"
+      "\tadcq   $0, %%rdx\n"
+      "\taddq   (%%r9), %%rax\n"
+      "\tadcq   $0, %%rdx\n"
+      "\tmovq   %%rax, (%%r9)\n"
+      "\tmovq   %%rdx, %%r10\n"
+      "\taddq   $8, %%r8\n"
+      "\taddq   $8, %%r9\n"
+      "\tsubq   $1, %%rcx\n"
+      "\tjnz    1b\n"
+      "\tmovq   %%r10, %[carry]\n"
+      : [carry] "=m"(carry)
+      : [x] "m"(x), [a] "m"(a), [r] "m"(r), [len] "m"(len)
+      : "memory", "cc", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r10", "%r11");
+  return carry;
+}
+
+//  Same as DigitArrayMultAddRow with mulx, which leaves the flags alone, so
+//  adding in the previous high word (adcx, CF) and the old r[j] (adox, OF)
+//  run as two independent carry chains.  Loop control uses lea and jrcxz to
+//  keep both flags intact.
+static uint64_t DigitArrayMultAddRowMulx(uint64_t x, int n, uint64_t* a,
+                                         uint64_t* r) {
+  uint64_t len = (uint64_t)n;
+  uint64_t carry;
+
+  asm volatile(
+      "\tmovq   %[x], %%rdx\n"
+      "\tmovq   %[a], %%r8\n"
+      "\tmovq   %[r], %%r9\n"
+      "\tmovq   %[len], %%rcx\n"
+      "\txorq   %%r10, %%r10\n"  // previous high word, clears CF and OF
+      "1:\n"
+      "\tmulxq  (%%r8), %%rax, %%r11\n"
+      "\tadcxq  %%r10, %%rax\n"
+      "\tadoxq  (%%r9), %%rax\n"
+      "\tmovq   %%rax, (%%r9)\n"
+      "\tmovq   %%r11, %%r10\n"
+      "\tleaq   8(%%r8), %%r8\n"
+      "\tleaq   8(%%r9), %%r9\n"
+      "\tleaq   -1(%%rcx), %%rcx\n"
+      "\tjrcxz  2f\n"
+      "\tjmp    1b\n"
+      "2:\n"
+      "\tmovq   $0, %%rax\n"
+      "\tadcxq  %%rax, %%r10\n"
+      "\tadoxq  %%rax, %%r10\n"
+      "\tmovq   %%r10, %[carry]\n"
+      : [carry] "=m"(carry)
+      : [x] "m"(x), [a] "m"(a), [r] "m"(r), [len] "m"(len)
+      : "memory", "cc", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r10", "%r11");
+  return carry;
+}
+
+//  r[0, 2n)= 2*r[0, 2n) + a[i]^2 at position 2i, finishes a square
+//  whose cross products are already in r.
+static void DigitArrayDoubleAddDiagonal(int n, uint64_t* a, uint64_t* r) {
+  uint64_t len = (uint64_t)n;
+
+  // the loops test the count after the first pass
+  if (n <= 0)
+    return;
+  asm volatile(
+      // r+= r, dec leaves CF alone
+      "\tmovq   %[r], %%r9\n"
+      "\tmovq   %[len], %%rcx\n"
+      "\tshlq   $1, %%rcx\n"
+      "\tclc\n"
+      "1:\n"
+      "\tmovq   (%%r9), %%rax\n"
+      "\tadcq   %%rax, (%%r9)\n"
+      "\tleaq   8(%%r9), %%r9\n"
+      "\tdecq   %%rcx\n"
+      "\tjnz    1b\n"
+
+      // r[2i, 2i+1]+= a[i]^2, carry kept in r10 across the mulq
+      "\tmovq   %[a], %%r8\n"
+      "\tmovq   %[r], %%r9\n"
+      "\tmovq   %[len], %%rcx\n"
+      "\txorq   %%r10, %%r10\n"
+      "2:\n"
+      "\tmovq   (%%r8), %%rax\n"
+      "\tmulq   %%rax\n"
+      "\taddq   %%r10, %%rax\n"
+      "\tadcq   $0, %%rdx\n"
+      "\taddq   %%rax, (%%r9)\n"
+      "\tadcq   %%rdx, 8(%%r9)\n"
+      "\tmovq   $0, %%r10\n"
+      "\tadcq   $0, %%r10\n"
+      "\taddq   $8, %%r8\n"
+      "\taddq   $16, %%r9\n"
+      "\tsubq   $1, %%rcx\n"
+      "\tjnz    2b\n"
+      ::[a] "m"(a), [r] "m"(r), [len] "m"(len)
+      : "memory", "cc", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r10");
+}
+
 #define FASTMULT
+//  r[0, n)+= x*a[0, n), returns the carry out of r[n-1]
+uint64_t DigitArrayMultAdd(uint64_t x, int n, uint64_t* a, uint64_t* r) {
+  // the row kernels test the count after the first pass
+  if (n <= 0)
+    return 0ULL;
+  return UseMulx() ? DigitArrayMultAddRowMulx(x, n, a, r)
+                   : DigitArrayMultAddRow(x, n, a, r);
+}
+
 // result = a*b.  returns size of result.  Error if <0
 int DigitArrayMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
                    int size_result, uint64_t* result) {
@@ -193,9 +418,26 @@ int DigitArrayMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
     LOG(ERROR) << "DigitArrayMult: result is too small\n";
     return -1;
   }
+  if (size_a == size_b && size_a <= FIXED_MULT_MAX_DIGITS &&
+      digit_array_use_fixed && FixedSizeMult(size_a, a, b, result)) {
+    DigitArrayZeroNum(size_result - 2 * size_a, &result[2 * size_a]);
+    return DigitArrayComputedSize(size_result, result);
+  }
+  if (size_a >= karatsuba_mult_threshold &&
+      size_b >= karatsuba_mult_threshold) {
+    if (size_a >= toom3_mult_threshold && size_b >= toom3_mult_threshold)
+      return DigitArrayToom3Mult(size_a, a, size_b, b, size_result, result);
+    return DigitArrayKaratsubaMult(size_a, a, size_b, b, size_result, result);
+  }
   DigitArrayZeroNum(size_result, result);
 
 #ifdef FASTMULT
+  if (UseMulx()) {
+    for (int i = 0; i < size_a; i++)
+      result[i + size_b] = DigitArrayMultAddRowMulx(a[i], size_b, b,
+                                                    &result[i]);
+    return DigitArrayComputedSize(size_result, result);
+  }
   uint64_t carry = 0;
   uint64_t size_A = (uint64_t)size_a;
   uint64_t size_B = (uint64_t)size_b;
@@ -265,108 +507,41 @@ int DigitArrayMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
 
 #define FASTSQUARE
 // result = a*a.  returns size of result.  Error if <0
+//   Each cross product a[i]a[j], i<j, is formed once, the sum is doubled
+//   and the squares a[i]^2 are added on the diagonal.
 int DigitArraySquare(int size_a, uint64_t* a, int size_result,
                      uint64_t* result) {
   if ((size_a + size_a) > size_result) {
     LOG(ERROR) << "DigitArraySquare: result is too small\n";
     return -1;
   }
+  if (size_a <= FIXED_MULT_MAX_DIGITS && digit_array_use_fixed &&
+      FixedSizeSquare(size_a, a, result)) {
+    DigitArrayZeroNum(size_result - 2 * size_a, &result[2 * size_a]);
+    return DigitArrayComputedSize(size_result, result);
+  }
+  if (size_a >= karatsuba_mult_threshold) {
+    if (size_a >= toom3_mult_threshold)
+      return DigitArrayToom3Mult(size_a, a, size_a, a, size_result, result);
+    return DigitArrayKaratsubaMult(size_a, a, size_a, a, size_result, result);
+  }
 
 #ifdef FASTSQUARE
-  uint64_t cur_in = 0ULL;
-  uint64_t cur_out = 0ULL;
+  bool mulx = UseMulx();
+  int i;
 
-  asm volatile(
-      "\tmovq   %[result], %%r15\n"  // %%r15 <-- address of output place
-      "\tmovq   %[a], %%r8\n"        // %%r8 <-- address of low input digit
-      "\txorq   %%rax,%%rax\n"
-      "\tmovl   %[size_a], %%eax\n"  // number of output words
-      "\tmovq   %%rax, %%r12\n"      // number of output words
-      "\tshlq   $3, %%r12\n"
-      "\taddq   %%r8, %%r12\n"  // %%r12>address of last input digit
-
-      // a[i]*a[i]
-      "1:\n"
-      "\tmovq   (%%r8), %%rax\n"
-      "\tmulq   (%%r8)\n"  // a[i]**2 result in rdx:rax
-      "\tmovq   %%rax, (%%r15)\n"
-      "\tmovq   %%rdx, 8(%%r15)\n"
-      "\taddq   $16, %%r15\n"
-      "\taddq   $8, %%r8\n"
-      "\tcmpq   %%r8, %%r12\n"
-      "\tjg     1b\n"
-
-      "\tmovq   %[a], %%r9\n"       // input
-      "\tmovq   %%r9, %[cur_in]\n"  // input
-      "\tsubq   $8, %[cur_in]\n"
-      "\tmovq   %[result], %%r9\n"
-      "\tmovq   %%r9, %[cur_out]\n"
-      "\tsubq   $8, %[cur_out]\n"
-
-      "\t.balign 16\n"
-      "2:\n"
-      "\tmovq   %[cur_in], %%r8\n"
-      "\taddq   $8, %%r8\n"
-      "\tmovq   %%r8, %[cur_in]\n"
-      "\tmovq   %[cur_out], %%r15\n"
-      "\taddq   $16, %%r15\n"
-      "\tmovq   %%r15, %[cur_out]\n"
-      "\tmovq   %%r8, %%r9\n"
-      "\taddq   $8, %%r9\n"
-      "\tcmpq   %%r9, %%r12\n"
-      "\tjle    11f\n"
-
-      // loop on %%r9
-      "3:\n"
-      "\tmovq   (%%r8), %%rax\n"
-      "\tmulq   (%%r9)\n"
-      "\tmovq   %%r15, %%r11\n"
-
-      // shift by 1, top bit in %%r14
-      "\txorq   %%r14, %%r14\n"
-      "\tshlq   $1, %%rax\n"
-      "\tjnc    4f\n"
-      "\tmovq   $1, %%r14\n"
-
-      "4:\n"
-      "\tshlq   $1,%%rdx\n"
-      "\tjnc    8f\n"
-      "\torq    %%r14, %%rdx\n"
-      "\txorq   %%r14,%%r14\n"
-      "\taddq   $24, %%r11\n"
-      "\taddq   %%rax, (%%r15)\n"
-      "\tadcq   %%rdx, 8(%%r15)\n"
-      "\tadcq   $1, 16(%%r15)\n"
-      "\tjnc    10f\n"
-      "\tjmp    9f\n"
-
-      "8:\n"
-      "\torq    %%r14, %%rdx\n"
-      "\txorq   %%r14,%%r14\n"
-      "\taddq   $16, %%r11\n"
-      "\taddq   %%rax, (%%r15)\n"
-      "\tadcq   %%rdx, 8(%%r15)\n"
-      "\tjnc    10f\n"
-
-      "9:\n"
-      "\taddq   $1, (%%r11)\n"
-      "\tjnc    10f\n"
-      "\taddq   $8, %%r11\n"
-      "\tjmp    9b\n"
-
-      "10:\n"
-      "\taddq   $8, %%r9\n"
-      "\taddq   $8, %%r15\n"
-      "\tcmpq   %%r9, %%r12\n"
-      "\tjg     3b\n"
-      "\tjmp    2b\n"
-      "\t.balign 16\n"
-      "11:\n"
-      : [cur_in] "=m"(cur_in), [cur_out] "=m"(cur_out)
-      : [a] "m"(a), [result] "m"(result), [size_a] "m"(size_a),
-        [size_result] "m"(size_result)
-      : "memory", "cc", "%rax", "%rdx", "%r8", "%r9", "%r12", "%r11", "%r14",
-        "%r15");
+  DigitArrayZeroNum(size_result, result);
+  for (i = 0; i < (size_a - 1); i++) {
+    if (mulx)
+      result[i + size_a] = DigitArrayMultAddRowMulx(a[i], size_a - 1 - i,
+                                                    &a[i + 1],
+                                                    &result[2 * i + 1]);
+    else
+      result[i + size_a] = DigitArrayMultAddRow(a[i], size_a - 1 - i,
+                                                &a[i + 1],
+                                                &result[2 * i + 1]);
+  }
+  DigitArrayDoubleAddDiagonal(size_a, a, result);
   return DigitArrayComputedSize(size_result, result);
 #else
   return DigitArrayMult(size_a, a, size_a, a, size_result, result);
@@ -410,6 +585,137 @@ int DigitArrayMultBy(int capacity_a, int size_a, uint64_t* a, uint64_t x) {
   return DigitArrayComputedSize(size_a, a);
 }
 
+//  Montgomery product (CIOS): result= a*b*R^(-1) (mod m), R= 2^(64*size_m)
+//    a, b < m, m odd, m_prime= -m^(-1) (mod 2^64)
+//    t is scratch space of at least 2*size_m+2 digits
+//  Each pass adds a*b[i] and then u*m into the window t[i..i+size_m+1],
+//  u chosen so that t[i] becomes 0; the answer is left in t[size_m..2*size_m].
+int DigitArrayMontMult(int size_m, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* t, uint64_t* result) {
+  if (size_m <= 0) {
+    LOG(ERROR) << "DigitArrayMontMult: bad modulus size\n";
+    return -1;
+  }
+  if (size_m <= FIXED_MULT_MAX_DIGITS && digit_array_use_fixed &&
+      FixedSizeMontMult(size_m, a, b, m, m_prime, result))
+    return DigitArrayComputedSize(size_m, result);
+  uint64_t len = (uint64_t)size_m;
+
+  DigitArrayZeroNum(2 * size_m + 2, t);
+
+  //    r8 : a or m
+  //    r9 : b
+  //    r11: current window, t+i
+  //    r12: i
+  //    r13: j
+  //    r14: carry
+  //    r15: b[i] or u
+  //    rcx: size_m
+  asm volatile(
+      "\tmovq   %[t], %%r11\n"
+      "\tmovq   %[b], %%r9\n"
+      "\tmovq   %[len], %%rcx\n"
+      "\txorq   %%r12, %%r12\n"
+
+      // outer loop
+      "1:\n"
+      "\tmovq   (%%r9, %%r12, 8), %%r15\n"
+      "\tmovq   %[a], %%r8\n"
+      "\txorq   %%r13, %%r13\n"
+      "\txorq   %%r14, %%r14\n"
+
+      // t[i..i+n-1]+= a*b[i]
+      "2:\n"
+      "\tmovq   (%%r8, %%r13, 8), %%rax\n"
+      "\tmulq   %%r15\n"
+      "\taddq   %%r14, %%rax\n"
+      "\tadcq   $0, %%rdx\n"
+      "\taddq   %%rax, (%%r11, %%r13, 8)\n"
+      "\tadcq   $0, %%rdx\n"
+      "\tmovq   %%rdx, %%r14\n"
+      "\taddq   $1, %%r13\n"
+      "\tcmpq   %%rcx, %%r13\n"
+      "\tjl     2b\n"
+      "\taddq   %%r14, (%%r11, %%rcx, 8)\n"
+      "\tadcq   $0, 8(%%r11, %%rcx, 8)\n"
+
+      // u= t[i]*m' (mod 2^64)
+      "\tmovq   (%%r11), %%r15\n"
+      "\timulq  %[m_prime], %%r15\n"
+      "\tmovq   %[m], %%r8\n"
+      "\txorq   %%r13, %%r13\n"
+      "\txorq   %%r14, %%r14\n"
+
+      // t[i..i+n-1]+= u*m, t[i] becomes 0
+      "3:\n"
+      "\tmovq   (%%r8, %%r13, 8), %%rax\n"
+      "\tmulq   %%r15\n"
+      "\taddq   %%r14, %%rax\n"
+      "\tadcq   $0, %%rdx\n"
+      "\taddq   %%rax, (%%r11, %%r13, 8)\n"
+      "\tadcq   $0, %%rdx\n"
+      "\tmovq   %%rdx, %%r14\n"
+      "\taddq   $1, %%r13\n"
+      "\tcmpq   %%rcx, %%r13\n"
+      "\tjl     3b\n"
+      "\taddq   %%r14, (%%r11, %%rcx, 8)\n"
+      "\tadcq   $0, 8(%%r11, %%rcx, 8)\n"
+
+      "\taddq   $8, %%r11\n"
+      "\taddq   $1, %%r12\n"
+      "\tcmpq   %%rcx, %%r12\n"
+      "\tjl     1b\n"
+      ::[a] "m"(a), [b] "m"(b), [m] "m"(m), [t] "m"(t), [len] "m"(len),
+        [m_prime] "m"(m_prime)
+      : "cc", "memory", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r11", "%r12",
+        "%r13", "%r14", "%r15");
+
+  // t[size_m..2*size_m] < 2m, one subtraction is enough
+  uint64_t* u = &t[size_m];
+  if (u[size_m] != 0ULL ||
+      DigitArrayCompare(size_m, u, size_m, m) >= 0) {
+    DigitArraySubFrom(size_m + 1, size_m + 1, u, size_m, m);
+  }
+  for (int i = 0; i < size_m; i++) result[i] = u[i];
+  return DigitArrayComputedSize(size_m, result);
+}
+
+//  Montgomery reduction: result= t*R^(-1) (mod m), R= 2^(64*size_m)
+//    t < m*R has 2*size_m+1 digits and is destroyed, m_prime= -m^(-1)
+//  Used after DigitArraySquare so squarings keep their savings.
+int DigitArrayMontReduce(int size_m, uint64_t* t, uint64_t* m,
+                         uint64_t m_prime, uint64_t* result) {
+  if (size_m <= 0) {
+    LOG(ERROR) << "DigitArrayMontReduce: bad modulus size\n";
+    return -1;
+  }
+  if (size_m <= FIXED_MULT_MAX_DIGITS && digit_array_use_fixed &&
+      FixedSizeMontReduce(size_m, t, m, m_prime, result))
+    return DigitArrayComputedSize(size_m, result);
+  bool mulx = UseMulx();
+  int top = 2 * size_m + 1;
+  int i, j;
+
+  for (i = 0; i < size_m; i++) {
+    uint64_t u = t[i] * m_prime;
+    uint64_t carry = mulx ? DigitArrayMultAddRowMulx(u, size_m, m, &t[i])
+                          : DigitArrayMultAddRow(u, size_m, m, &t[i]);
+    for (j = i + size_m; j < top && carry != 0ULL; j++) {
+      t[j] += carry;
+      carry = t[j] < carry ? 1ULL : 0ULL;
+    }
+  }
+
+  // t[size_m..2*size_m] < 2m, one subtraction is enough
+  uint64_t* u = &t[size_m];
+  if (u[size_m] != 0ULL ||
+      DigitArrayCompare(size_m, u, size_m, m) >= 0) {
+    DigitArraySubFrom(size_m + 1, size_m + 1, u, size_m, m);
+  }
+  for (i = 0; i < size_m; i++) result[i] = u[i];
+  return DigitArrayComputedSize(size_m, result);
+}
+
 // a+= b
 int DigitArrayAddTo(int capacity_a, int size_a, uint64_t* a, int size_b,
                     uint64_t* b) {
@@ -511,31 +817,272 @@ int DigitArraySubFrom(int capacity_a, int size_a, uint64_t* a, int size_b,
   return DigitArrayComputedSize(capacity_a, a);
 }
 
+//  Divides a<<s by b<<s so the divisor is normalized, one
+//  Uint64DivStep2By1 per digit.  q may be a.
 bool DigitArrayShortDivisionAlgorithm(int size_a, uint64_t* a, uint64_t b,
                                       int* size_q, uint64_t* q, uint64_t* r) {
-  int64_t len_a = (int64_t)size_a;
-  uint64_t* a_high = a + size_a - 1;
-  uint64_t* q_high = q + size_a - 1;
+  int s = NBITSINUINT64 - HighBitInDigit(b);
+  uint64_t d = b << s;
+  uint64_t v = Uint64Reciprocal(d);
+  uint64_t rem = s == 0 ? 0ULL : a[size_a - 1] >> (NBITSINUINT64 - s);
+  uint64_t u0;
+  int i;
 
-  asm volatile(
-      "\txorq   %%rdx, %%rdx\n"
-      "\tmovq   %[len_a], %%r8\n"
-      "\tmovq   %[a_high], %%rbx\n"
-      "\tmovq   %[q_high], %%rcx\n"
-      "\t1:\n"
-      "\tmovq   (%%rbx), %%rax\n"
-      "\tdivq   %[b]\n"
-      "\tmovq   %%rax, (%%rcx)\n"
-      "\tsubq   $8, %%rbx\n"
-      "\tsubq   $8, %%rcx\n"
-      "\tsubq   $1, %%r8\n"
-      "\tcmpq   $0, %%r8\n"
-      "\tjg     1b\n"
-      "\tmovq   %[r],%%rbx\n"
-      "\tmovq   %%rdx, (%%rbx)\n"
-      ::[r] "g"(r), [len_a] "g"(len_a), [a_high] "g"(a_high), [b] "g"(b),
-        [q_high] "g"(q_high)
-      : "cc", "memory", "%rax", "%rbx", "%rcx", "%rdx", "%r8");
+  for (i = size_a - 1; i >= 0; i--) {
+    u0 = a[i] << s;
+    if (s != 0 && i > 0)
+      u0 |= a[i - 1] >> (NBITSINUINT64 - s);
+    Uint64DivStep2By1(rem, u0, d, v, &q[i], &rem);
+  }
+  *r = rem >> s;
   *size_q = DigitArrayComputedSize(*size_q, q);
   return true;
 }
+
+//  Four lane Montgomery exponentiation.  Each 64 bit lane of a ymm
+//  register holds a digit of a different operand.  Digits are 28 bits and
+//  R= 2^(28n) with 4m < R: a product of digits is below 2^56, so a lane
+//  takes all 2n products of a CIOS column without carrying, and results
+//  stay below 2m with no final subtraction.  A vector is stored as 4
+//  consecutive uint64_t, lane k is operand k.
+
+#define BATCH_LANES 4
+#define BATCH_DIGIT_BITS 28
+#define BATCH_DIGIT_MASK 0xfffffffULL
+#define BATCH_MAX_DIGITS 128
+#define BATCH_WINDOW 5
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define LOAD4(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE4(p, x) _mm256_storeu_si256((__m256i*)(p), (x))
+
+// 1 if the AVX2 batch kernels are used, 0 if not, -1 to ask cpuid
+int digit_array_use_avx2 = -1;
+
+bool DigitArrayUseAvx2() {
+  if (digit_array_use_avx2 < 0)
+    digit_array_use_avx2 = HaveAvx2() ? 1 : 0;
+  return digit_array_use_avx2 == 1;
+}
+
+// r= a b R^(-1) (mod m), a, b < 2m gives r < 2m.  m has every digit of
+// the modulus in all four lanes, t is n vectors of scratch.  r may be a or
+// b.  Each pass over t takes two digits of a:
+//   t= (t + a[i] b + q m)/2^28, then (t + a[i+1] b + q' m)/2^28
+AVX2_TARGET static void MontMultBatch4(int n, const uint64_t* a,
+                                       const uint64_t* b, const uint64_t* m,
+                                       uint64_t m_prime, uint64_t* t,
+                                       uint64_t* r) {
+  const __m256i mask = _mm256_set1_epi64x(BATCH_DIGIT_MASK);
+  const __m256i mp = _mm256_set1_epi64x(m_prime);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i a0, a1, q0, q1, x, y, c;
+  int i, j;
+
+  for (j = 0; j < n; j++)
+    STORE4(t + 4 * j, zero);
+  for (i = 0; (i + 1) < n; i += 2) {
+    a0 = LOAD4(a + 4 * i);
+    a1 = LOAD4(a + 4 * (i + 1));
+    x = _mm256_add_epi64(LOAD4(t), _mm256_mul_epu32(a0, LOAD4(b)));
+    q0 = _mm256_and_si256(_mm256_mul_epu32(x, mp), mask);
+    x = _mm256_add_epi64(x, _mm256_mul_epu32(q0, LOAD4(m)));
+    c = _mm256_srli_epi64(x, BATCH_DIGIT_BITS);
+    // low digit after the first step
+    y = _mm256_add_epi64(LOAD4(t + 4), _mm256_mul_epu32(a0, LOAD4(b + 4)));
+    y = _mm256_add_epi64(y, _mm256_mul_epu32(q0, LOAD4(m + 4)));
+    y = _mm256_add_epi64(y, c);
+    y = _mm256_add_epi64(y, _mm256_mul_epu32(a1, LOAD4(b)));
+    q1 = _mm256_and_si256(_mm256_mul_epu32(y, mp), mask);
+    y = _mm256_add_epi64(y, _mm256_mul_epu32(q1, LOAD4(m)));
+    c = _mm256_srli_epi64(y, BATCH_DIGIT_BITS);
+    for (j = 1; (j + 1) < n; j++) {
+      x = _mm256_add_epi64(LOAD4(t + 4 * (j + 1)),
+                           _mm256_mul_epu32(a0, LOAD4(b + 4 * (j + 1))));
+      x = _mm256_add_epi64(x, _mm256_mul_epu32(q0, LOAD4(m + 4 * (j + 1))));
+      x = _mm256_add_epi64(x, _mm256_mul_epu32(a1, LOAD4(b + 4 * j)));
+      x = _mm256_add_epi64(x, _mm256_mul_epu32(q1, LOAD4(m + 4 * j)));
+      STORE4(t + 4 * (j - 1), x);
+    }
+    x = _mm256_mul_epu32(a1, LOAD4(b + 4 * (n - 1)));
+    x = _mm256_add_epi64(x, _mm256_mul_epu32(q1, LOAD4(m + 4 * (n - 1))));
+    STORE4(t + 4 * (n - 2), x);
+    STORE4(t + 4 * (n - 1), zero);
+    STORE4(t, _mm256_add_epi64(LOAD4(t), c));
+  }
+  if (i < n) {
+    a0 = LOAD4(a + 4 * i);
+    x = _mm256_add_epi64(LOAD4(t), _mm256_mul_epu32(a0, LOAD4(b)));
+    q0 = _mm256_and_si256(_mm256_mul_epu32(x, mp), mask);
+    x = _mm256_add_epi64(x, _mm256_mul_epu32(q0, LOAD4(m)));
+    c = _mm256_srli_epi64(x, BATCH_DIGIT_BITS);
+    for (j = 1; j < n; j++) {
+      x = _mm256_add_epi64(LOAD4(t + 4 * j),
+                           _mm256_mul_epu32(a0, LOAD4(b + 4 * j)));
+      x = _mm256_add_epi64(x, _mm256_mul_epu32(q0, LOAD4(m + 4 * j)));
+      STORE4(t + 4 * (j - 1), x);
+    }
+    STORE4(t + 4 * (n - 1), zero);
+    STORE4(t, _mm256_add_epi64(LOAD4(t), c));
+  }
+  c = zero;
+  for (j = 0; j < n; j++) {
+    x = _mm256_add_epi64(LOAD4(t + 4 * j), c);
+    STORE4(r + 4 * j, _mm256_and_si256(x, mask));
+    c = _mm256_srli_epi64(x, BATCH_DIGIT_BITS);
+  }
+}
+
+// r= table[idx] lane by lane, every entry is read
+AVX2_TARGET static void SelectBatch4(int n, int num_entries,
+                                     const uint64_t* table,
+                                     const uint64_t* idx, uint64_t* r) {
+  const __m256i want = LOAD4(idx);
+  __m256i mask;
+  int i, j;
+
+  for (j = 0; j < n; j++)
+    STORE4(r + 4 * j, _mm256_setzero_si256());
+  for (i = 0; i < num_entries; i++) {
+    mask = _mm256_cmpeq_epi64(want, _mm256_set1_epi64x(i));
+    for (j = 0; j < n; j++)
+      STORE4(r + 4 * j,
+             _mm256_or_si256(LOAD4(r + 4 * j),
+                             _mm256_and_si256(mask,
+                                              LOAD4(table + 4 * (i * n + j)))));
+  }
+}
+
+// lane of r[0, n)= a in 28 bit digits
+static void ToBatchDigits(int size_a, const uint64_t* a, int n, int lane,
+                          uint64_t* r) {
+  for (int j = 0; j < n; j++) {
+    int w = (BATCH_DIGIT_BITS * j) / NBITSINUINT64;
+    int s = (BATCH_DIGIT_BITS * j) % NBITSINUINT64;
+    uint64_t v = w < size_a ? a[w] >> s : 0ULL;
+    if (s > (NBITSINUINT64 - BATCH_DIGIT_BITS) && (w + 1) < size_a)
+      v |= a[w + 1] << (NBITSINUINT64 - s);
+    r[4 * j + lane] = v & BATCH_DIGIT_MASK;
+  }
+}
+
+// r[0, size_r)= lane of a[0, n)
+static void FromBatchDigits(int n, const uint64_t* a, int lane, int size_r,
+                            uint64_t* r) {
+  DigitArrayZeroNum(size_r, r);
+  for (int j = 0; j < n; j++) {
+    int w = (BATCH_DIGIT_BITS * j) / NBITSINUINT64;
+    int s = (BATCH_DIGIT_BITS * j) % NBITSINUINT64;
+    uint64_t v = a[4 * j + lane];
+    if (w < size_r)
+      r[w] |= v << s;
+    if (s > (NBITSINUINT64 - BATCH_DIGIT_BITS) && (w + 1) < size_r)
+      r[w + 1] |= v >> (NBITSINUINT64 - s);
+  }
+}
+
+// bits [pos, pos + BATCH_WINDOW) of e
+static uint64_t ExpWindowBits(int size_e, const uint64_t* e, int pos) {
+  int w = pos / NBITSINUINT64;
+  int s = pos % NBITSINUINT64;
+  uint64_t v = w < size_e ? e[w] >> s : 0ULL;
+  if (s > (NBITSINUINT64 - BATCH_WINDOW) && (w + 1) < size_e)
+    v |= e[w + 1] << (NBITSINUINT64 - s);
+  return v & ((1ULL << BATCH_WINDOW) - 1);
+}
+
+//  out[k]= b[k]^e[k] (mod m), k < 4, m odd.  b[k] < m and out[k] have
+//  size_m digits, e[k] has size_e[k].  Fixed windows, and the table entry
+//  for each window is picked by masking every entry, so neither the
+//  sequence of operations nor the memory addresses depend on e.
+bool DigitArrayMontExpBatch4(int size_m, uint64_t* m, uint64_t** b,
+                             int* size_e, uint64_t** e, uint64_t** out) {
+  size_m = DigitArrayComputedSize(size_m, m);
+  int bits = NBITSINUINT64 * (size_m - 1) + HighBitInDigit(m[size_m - 1]);
+  int n = (bits + 2 + BATCH_DIGIT_BITS - 1) / BATCH_DIGIT_BITS;
+  int num_entries = 1 << BATCH_WINDOW;
+  int i, k, pos;
+
+  if ((m[0] & 1ULL) == 0ULL || n > BATCH_MAX_DIGITS) {
+    LOG(ERROR) << "DigitArrayMontExpBatch4: bad modulus\n";
+    return false;
+  }
+
+  // m_prime= -m^(-1) (mod 2^28), Newton from 3 correct bits
+  uint64_t inv = m[0];
+  for (i = 0; i < 5; i++) inv *= 2ULL - m[0] * inv;
+  uint64_t m_prime = (0ULL - inv) & BATCH_DIGIT_MASK;
+
+  // R^2 (mod m)
+  int size_big = (2 * BATCH_DIGIT_BITS * n) / NBITSINUINT64 + 1;
+  uint64_t big[size_big];
+  uint64_t quot[size_big];
+  uint64_t rem[size_m + 1];
+  int size_q = size_big;
+  int size_rem = size_m + 1;
+  DigitArrayZeroNum(size_big, big);
+  big[size_big - 1] = 1ULL << ((2 * BATCH_DIGIT_BITS * n) % NBITSINUINT64);
+  if (!DigitArrayDivisionAlgorithm(size_big, big, size_m, m, &size_q, quot,
+                                   &size_rem, rem))
+    return false;
+
+  // one block, vectors on 32 byte boundaries
+  uint64_t* block = new uint64_t[4 * n * (7 + num_entries) + 4];
+  uint64_t* mv = block + ((4 - ((uintptr_t)block / sizeof(uint64_t)) % 4) % 4);
+  uint64_t* r2 = mv + 4 * n;
+  uint64_t* one = r2 + 4 * n;
+  uint64_t* x = one + 4 * n;
+  uint64_t* acc = x + 4 * n;
+  uint64_t* sel = acc + 4 * n;
+  uint64_t* t = sel + 4 * n;
+  uint64_t* table = t + 4 * n;
+  uint64_t idx[BATCH_LANES];
+  int max_bits = 0;
+
+  DigitArrayZeroNum(4 * n, one);
+  for (k = 0; k < BATCH_LANES; k++) {
+    ToBatchDigits(size_m, m, n, k, mv);
+    ToBatchDigits(size_rem, rem, n, k, r2);
+    ToBatchDigits(size_m, b[k], n, k, x);
+    one[k] = 1ULL;
+    if (NBITSINUINT64 * size_e[k] > max_bits)
+      max_bits = NBITSINUINT64 * size_e[k];
+  }
+
+  // table[i]= x^i R
+  MontMultBatch4(n, x, r2, mv, m_prime, t, x);
+  MontMultBatch4(n, r2, one, mv, m_prime, t, table);
+  for (i = 1; i < num_entries; i++)
+    MontMultBatch4(n, table + 4 * n * (i - 1), x, mv, m_prime, t,
+                   table + 4 * n * i);
+
+  pos = ((max_bits + BATCH_WINDOW - 1) / BATCH_WINDOW) * BATCH_WINDOW;
+  DigitArrayCopy(4 * n, table, 4 * n, acc);
+  while (pos > 0) {
+    pos -= BATCH_WINDOW;
+    for (k = 0; k < BATCH_LANES; k++)
+      idx[k] = ExpWindowBits(size_e[k], e[k], pos);
+    for (i = 0; i < BATCH_WINDOW; i++)
+      MontMultBatch4(n, acc, acc, mv, m_prime, t, acc);
+    SelectBatch4(n, num_entries, table, idx, sel);
+    MontMultBatch4(n, acc, sel, mv, m_prime, t, acc);
+  }
+  // out of Montgomery form, acc <= m, then subtract m if acc == m
+  MontMultBatch4(n, acc, one, mv, m_prime, t, acc);
+  for (k = 0; k < BATCH_LANES; k++) {
+    uint64_t d[size_m];
+    uint64_t borrow = 0ULL;
+    FromBatchDigits(n, acc, k, size_m, out[k]);
+    for (i = 0; i < size_m; i++) {
+      uint128_t s = (uint128_t)out[k][i] - m[i] - borrow;
+      d[i] = (uint64_t)s;
+      borrow = (uint64_t)(s >> 64) & 1ULL;
+    }
+    uint64_t keep = 0ULL - borrow;
+    for (i = 0; i < size_m; i++)
+      out[k][i] = (out[k][i] & keep) | (d[i] & ~keep);
+  }
+
+  delete []block;
+  return true;
+}
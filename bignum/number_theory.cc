@@ -19,8 +19,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "bignum.h"
 #include "intel64_arith.h"
+#include "fixed_arith.h"
 
 bool BigExtendedGCD(BigNum& a, BigNum& b, BigNum& x, BigNum& y, BigNum& g) {
   BigNum* a_coeff[3] = {nullptr, nullptr, nullptr};
@@ -92,6 +96,361 @@ done:
   return ret;
 }
 
+// r= A u + B v, u and v signed
+static bool LehmerCombine(int128_t A, BigNum& u, int128_t B, BigNum& v,
+                          BigNum& t1, BigNum& t2, BigNum& r) {
+  BigNum a(1, (uint64_t)(A < 0 ? -A : A));
+  BigNum b(1, (uint64_t)(B < 0 ? -B : B));
+
+  t1.ZeroNum();
+  t2.ZeroNum();
+  r.ZeroNum();
+  if (A != 0) {
+    if (!BigUnsignedMult(a, u, t1))
+      return false;
+    t1.sign_ = (A < 0) != u.sign_;
+  }
+  if (B != 0) {
+    if (!BigUnsignedMult(b, v, t2))
+      return false;
+    t2.sign_ = (B < 0) != v.sign_;
+  }
+  if (!BigAdd(t1, t2, r))
+    return false;
+  r.Normalize();
+  return true;
+}
+
+/*
+ *  Lehmer's extended gcd, Knuth 4.5.2 algorithm L, with 63 bit leading
+ *  parts so each round of single precision steps replaces up to about
+ *  62 bits of quotients.  Only the cofactor of a is carried; at the end
+ *  y= (g - a x)/b.  a, b >= 0.
+ */
+bool BigLehmerExtendedGCD(BigNum& a, BigNum& b, BigNum& x, BigNum& y,
+                          BigNum& g) {
+  int n = a.size_ > b.size_ ? a.size_ : b.size_;
+  ScratchFrame frame;
+  BigNum u(2 * n + 2, frame);
+  BigNum v(2 * n + 2, frame);
+  BigNum x0(2 * n + 2, frame);
+  BigNum x1(2 * n + 2, frame);
+  BigNum nu(2 * n + 2, frame);
+  BigNum nv(2 * n + 2, frame);
+  BigNum t1(2 * n + 2, frame);
+  BigNum t2(2 * n + 2, frame);
+  BigNum q(2 * n + 2, frame);
+  BigNum w(4 * n + 4, frame);
+  bool swapped = false;
+
+  if (a.IsNegative() || b.IsNegative())
+    return false;
+  u.CopyFrom(a);
+  v.CopyFrom(b);
+  x0.CopyFrom(Big_One);
+  if (BigCompare(u, v) < 0) {
+    u.Swap(v);
+    swapped = true;
+  }
+  // u = x0 a (mod b), v = x1 a (mod b), with the roles of x0, x1 set so
+  // that the cofactor of a ends in x0
+  if (swapped) {
+    x0.ZeroNum();
+    x1.CopyFrom(Big_One);
+  }
+
+  while (!v.IsZero()) {
+    int nb = BigHighBit(u);
+    int shift = nb > 63 ? nb - 63 : 0;
+    int128_t uh;
+    int128_t vh;
+    int128_t A = 1, B = 0, C = 0, D = 1;
+    int128_t q1, q2, t;
+
+    if (!BigShift(u, -shift, t1) || !BigShift(v, -shift, t2))
+      return false;
+    uh = (int128_t)t1.value_[0];
+    vh = t2.size_ > 1 ? 0 : (int128_t)t2.value_[0];
+
+    for (;;) {
+      if ((vh + C) <= 0 || (vh + D) <= 0)
+        break;
+      q1 = (uh + A) / (vh + C);
+      q2 = (uh + B) / (vh + D);
+      if (q1 != q2)
+        break;
+      t = A - q1 * C;
+      A = C;
+      C = t;
+      t = B - q1 * D;
+      B = D;
+      D = t;
+      t = uh - q1 * vh;
+      uh = vh;
+      vh = t;
+    }
+
+    if (B == 0) {
+      // leading parts gave nothing, one full division step
+      q.ZeroNum();
+      nv.ZeroNum();
+      if (!BigUnsignedEuclid(u, v, q, nv))
+        return false;
+      nv.Normalize();
+      w.ZeroNum();
+      if (!BigMult(q, x1, w))
+        return false;
+      w.sign_ = !q.IsZero() && x1.sign_;
+      nu.ZeroNum();
+      if (!BigSub(x0, w, nu))
+        return false;
+      u.Swap(v);
+      v.Swap(nv);
+      x0.Swap(x1);
+      x1.Swap(nu);
+    } else {
+      if (!LehmerCombine(A, u, B, v, t1, t2, nu) ||
+          !LehmerCombine(C, u, D, v, t1, t2, nv))
+        return false;
+      u.Swap(nu);
+      v.Swap(nv);
+      if (!LehmerCombine(A, x0, B, x1, t1, t2, nu) ||
+          !LehmerCombine(C, x0, D, x1, t1, t2, nv))
+        return false;
+      x0.Swap(nu);
+      x1.Swap(nv);
+    }
+  }
+
+  g.ZeroNum();
+  g.CopyFrom(u);
+  x.ZeroNum();
+  x.CopyFrom(x0);
+  // y= (g - a x)/b
+  y.ZeroNum();
+  if (b.IsZero())
+    return true;
+  w.ZeroNum();
+  if (!BigMult(a, x0, w))
+    return false;
+  w.sign_ = !w.IsZero() && x0.sign_;
+  nu.ZeroNum();
+  if (!BigSub(u, w, nu))
+    return false;
+  q.ZeroNum();
+  t1.ZeroNum();
+  if (!BigUnsignedEuclid(nu, b, q, t1))
+    return false;
+  q.Normalize();
+  q.sign_ = !q.IsZero() && nu.sign_;
+  return y.CopyFrom(q);
+}
+
+/*
+ *  Constant time inverse, Bernstein and Yang, "Fast constant-time gcd
+ *  computation and modular inversion", in the form used by
+ *  libsecp256k1's modinv64: numbers are held in signed 62 bit limbs and
+ *  divsteps run in batches of 59 on the low bits of f and g, producing a
+ *  2x2 matrix scaled by 2^62 that is then applied to f, g and to the
+ *  cofactors d, e (mod m).  The number of divsteps depends only on the
+ *  size of m.
+ */
+#define M62 (0xffffffffffffffffULL >> 2)
+
+struct DivstepMatrix {
+  int64_t u_, v_, q_, r_;
+};
+
+static int64_t Divsteps59(int64_t zeta, uint64_t f0, uint64_t g0,
+                          DivstepMatrix* t) {
+  uint64_t u = 8, v = 0, q = 0, r = 8;
+  uint64_t c1, c2, mask1, mask2, f = f0, g = g0, x, y, z;
+
+  for (int i = 3; i < 62; i++) {
+    c1 = (uint64_t)(zeta >> 63);
+    mask1 = c1;
+    c2 = g & 1;
+    mask2 = 0ULL - c2;
+    x = (f ^ mask1) - mask1;
+    y = (u ^ mask1) - mask1;
+    z = (v ^ mask1) - mask1;
+    g += x & mask2;
+    q += y & mask2;
+    r += z & mask2;
+    mask1 &= mask2;
+    zeta = (zeta ^ (int64_t)mask1) - 1;
+    f += g & mask1;
+    u += q & mask1;
+    v += r & mask1;
+    g >>= 1;
+    u <<= 1;
+    v <<= 1;
+  }
+  t->u_ = (int64_t)u;
+  t->v_ = (int64_t)v;
+  t->q_ = (int64_t)q;
+  t->r_ = (int64_t)r;
+  return zeta;
+}
+
+// [f, g]= t [f, g] / 2^62
+static void DivstepUpdateFG(int n, int64_t* f, int64_t* g,
+                            DivstepMatrix& t) {
+  int128_t cf = (int128_t)t.u_ * f[0] + (int128_t)t.v_ * g[0];
+  int128_t cg = (int128_t)t.q_ * f[0] + (int128_t)t.r_ * g[0];
+  cf >>= 62;
+  cg >>= 62;
+  for (int i = 1; i < n; i++) {
+    cf += (int128_t)t.u_ * f[i] + (int128_t)t.v_ * g[i];
+    cg += (int128_t)t.q_ * f[i] + (int128_t)t.r_ * g[i];
+    f[i - 1] = (int64_t)((uint64_t)cf & M62);
+    g[i - 1] = (int64_t)((uint64_t)cg & M62);
+    cf >>= 62;
+    cg >>= 62;
+  }
+  f[n - 1] = (int64_t)cf;
+  g[n - 1] = (int64_t)cg;
+}
+
+//  [d, e]= (t [d, e] + m [md, me]) / 2^62 with md, me chosen to clear the
+//  low 62 bits.  d, e stay in (-2m, m).
+static void DivstepUpdateDE(int n, int64_t* d, int64_t* e, DivstepMatrix& t,
+                            int64_t* m, uint64_t m_inv62) {
+  int64_t sd = d[n - 1] >> 63;
+  int64_t se = e[n - 1] >> 63;
+  int64_t md = (t.u_ & sd) + (t.v_ & se);
+  int64_t me = (t.q_ & sd) + (t.r_ & se);
+  int128_t cd = (int128_t)t.u_ * d[0] + (int128_t)t.v_ * e[0];
+  int128_t ce = (int128_t)t.q_ * d[0] + (int128_t)t.r_ * e[0];
+
+  md -= (int64_t)((m_inv62 * (uint64_t)cd + (uint64_t)md) & M62);
+  me -= (int64_t)((m_inv62 * (uint64_t)ce + (uint64_t)me) & M62);
+  cd += (int128_t)m[0] * md;
+  ce += (int128_t)m[0] * me;
+  cd >>= 62;
+  ce >>= 62;
+  for (int i = 1; i < n; i++) {
+    cd += (int128_t)t.u_ * d[i] + (int128_t)t.v_ * e[i] + (int128_t)m[i] * md;
+    ce += (int128_t)t.q_ * d[i] + (int128_t)t.r_ * e[i] + (int128_t)m[i] * me;
+    d[i - 1] = (int64_t)((uint64_t)cd & M62);
+    e[i - 1] = (int64_t)((uint64_t)ce & M62);
+    cd >>= 62;
+    ce >>= 62;
+  }
+  d[n - 1] = (int64_t)cd;
+  e[n - 1] = (int64_t)ce;
+}
+
+static void Signed62Propagate(int n, int64_t* r) {
+  for (int i = 0; i < (n - 1); i++) {
+    r[i + 1] += r[i] >> 62;
+    r[i] &= (int64_t)M62;
+  }
+}
+
+static void ToSigned62(int size_a, uint64_t* a, int n, int64_t* r) {
+  for (int i = 0; i < n; i++) {
+    int bit = 62 * i;
+    int k = bit / NBITSINUINT64;
+    int s = bit % NBITSINUINT64;
+    uint64_t lo = k < size_a ? a[k] : 0ULL;
+    uint64_t hi = (k + 1) < size_a ? a[k + 1] : 0ULL;
+    uint64_t w = s == 0 ? lo : ((lo >> s) | (hi << (NBITSINUINT64 - s)));
+    r[i] = (int64_t)(w & M62);
+  }
+}
+
+// r has size_r digits, a in [0, 2^(62n)) with non-negative limbs
+static void FromSigned62(int n, int64_t* a, int size_r, uint64_t* r) {
+  DigitArrayZeroNum(size_r, r);
+  for (int i = 0; i < n; i++) {
+    int bit = 62 * i;
+    int k = bit / NBITSINUINT64;
+    int s = bit % NBITSINUINT64;
+    uint64_t w = (uint64_t)a[i];
+    if (k < size_r)
+      r[k] |= w << s;
+    if (s > 2 && (k + 1) < size_r)
+      r[k + 1] |= w >> (NBITSINUINT64 - s);
+  }
+}
+
+//  r= a^(-1) (mod m), m odd.  Time depends only on the size of m.
+bool BigModInvConstantTime(BigNum& a, BigNum& m, BigNum& r) {
+  m.Normalize();
+  if (m.IsNegative() || m.IsZero() || (m.value_[0] & 1ULL) == 0ULL) {
+    LOG(ERROR) << "BigModInvConstantTime: modulus must be odd\n";
+    return false;
+  }
+  if (!BigModNormalize(a, m))
+    return false;
+  int k = m.size_;
+  if (k <= 0)
+    return false;
+  int bits = NBITSINUINT64 * k;
+  int n = bits / 62 + 2;
+  int64_t f[n];
+  int64_t g[n];
+  int64_t d[n];
+  int64_t e[n];
+  int64_t mm[n];
+  uint64_t out[k + 2];
+  DivstepMatrix t;
+  int64_t zeta = -1;
+  int i;
+
+  // divsteps needed for inputs below 2^bits (Bernstein-Yang, Theorem 11.2)
+  int num_divsteps = (49 * bits + (bits < 46 ? 80 : 57)) / 17;
+  int batches = (num_divsteps + 58) / 59;
+
+  uint64_t m0 = m.value_[0];
+  uint64_t inv = m0;
+  for (i = 0; i < 5; i++) inv *= 2ULL - m0 * inv;
+  uint64_t m_inv62 = inv & M62;
+
+  ToSigned62(k, m.value_, n, mm);
+  ToSigned62(k, m.value_, n, f);
+  ToSigned62(a.size_ < k ? a.size_ : k, a.value_, n, g);
+  for (i = 0; i < n; i++) {
+    d[i] = 0;
+    e[i] = 0;
+  }
+  e[0] = 1;
+
+  for (i = 0; i < batches; i++) {
+    zeta = Divsteps59(zeta, (uint64_t)f[0], (uint64_t)g[0], &t);
+    DivstepUpdateDE(n, d, e, t, mm, m_inv62);
+    DivstepUpdateFG(n, f, g, t);
+  }
+
+  // f= +-1 iff gcd(a, m)= 1
+  int64_t sign = f[n - 1] >> 63;
+  for (i = 0; i < n; i++) f[i] = (f[i] ^ sign) - sign;
+  Signed62Propagate(n, f);
+  uint64_t check = (uint64_t)f[0] ^ 1ULL;
+  for (i = 1; i < n; i++) check |= (uint64_t)f[i];
+
+  // d in (-2m, m): add m if negative, negate if f < 0, add m if negative
+  int64_t cond = d[n - 1] >> 63;
+  for (i = 0; i < n; i++) d[i] += mm[i] & cond;
+  for (i = 0; i < n; i++) d[i] = (d[i] ^ sign) - sign;
+  Signed62Propagate(n, d);
+  cond = d[n - 1] >> 63;
+  for (i = 0; i < n; i++) d[i] += mm[i] & cond;
+  Signed62Propagate(n, d);
+
+  if (check != 0ULL) {
+    LOG(ERROR) << "BigModInvConstantTime: not invertible\n";
+    return false;
+  }
+  FromSigned62(n, d, k + 2, out);
+  r.ZeroNum();
+  if (!DigitArrayCopy(k, out, r.capacity_, r.value_))
+    return false;
+  r.Normalize();
+  return true;
+}
+
 bool BigCRT(BigNum& s1, BigNum& s2, BigNum& m1, BigNum& m2, BigNum& r) {
   int m = m1.size_ > m2.size_ ? m1.size_ : m2.size_;
   if (s1.size_ > m)
@@ -128,6 +487,38 @@ bool BigCRT(BigNum& s1, BigNum& s2, BigNum& m1, BigNum& m2, BigNum& r) {
   return true;
 }
 
+//  Garner recombination with m2_inv= m2^(-1) (mod m1) computed once:
+//  r= s2 + m2 ((s1 - s2) m2_inv (mod m1)), no inverse per call.
+bool BigCRTGarner(BigNum& s1, BigNum& s2, BigNum& m1, BigNum& m2,
+                  BigNum& m2_inv, BigNum& r) {
+  int m = m1.size_ > m2.size_ ? m1.size_ : m2.size_;
+  if (s1.size_ > m)
+    m = s1.size_;
+  if (s2.size_ > m)
+    m = s2.size_;
+  if (m2_inv.size_ > m)
+    m = m2_inv.size_;
+  ScratchFrame frame;
+  BigNum u1(2 * m + 2, frame);
+  BigNum u2(2 * m + 2, frame);
+  BigNum h(2 * m + 2, frame);
+
+  if (!BigMod(s1, m1, u1))
+    return false;
+  if (!BigMod(s2, m1, u2))
+    return false;
+  if (!BigModSub(u1, u2, m1, h))
+    return false;
+  u1.ZeroNum();
+  if (!BigModMult(h, m2_inv, m1, u1))
+    return false;
+  u2.ZeroNum();
+  if (!BigMult(u1, m2, u2))
+    return false;
+  r.ZeroNum();
+  return BigAdd(u2, s2, r);
+}
+
 bool BigMod(BigNum& a, BigNum& m, BigNum& r) {
   if (!r.CopyFrom(a))
     return false;
@@ -141,8 +532,9 @@ bool BigModNormalize(BigNum& a, BigNum& m) {
     return true;
 
   int n = a.Capacity() > m.Capacity() ? a.Capacity() : m.Capacity();
-  BigNum t1(1 + 2 * n);
-  BigNum t2(1 + 2 * n);
+  ScratchFrame frame;
+  BigNum t1(1 + 2 * n, frame);
+  BigNum t2(1 + 2 * n, frame);
 
   if (a.sign_) {
     if (!BigUnsignedEuclid(a, m, t1, t2))
@@ -245,7 +637,8 @@ bool BigModMult(BigNum& a, BigNum& b, BigNum& m, BigNum& r) {
     return false;
   if (!BigModNormalize(b, m))
     return false;
-  BigNum t(2 * n + 2);
+  ScratchFrame frame;
+  BigNum t(2 * n + 2, frame);
   if (!BigUnsignedMult(a, b, t))
     return false;
   return BigMod(t, m, r);
@@ -255,15 +648,27 @@ bool BigModSquare(BigNum& a, BigNum& m, BigNum& r) {
   return BigModMult(a, a, m, r);
 }
 
-bool BigModInv(BigNum& a, BigNum& m, BigNum& r) {
-  BigNum x(2 * m.capacity_ + 1);
-  BigNum y(2 * m.capacity_ + 1);
-  BigNum g(2 * m.capacity_ + 1);
+bool BigModInv(BigNum& a, BigNum& m, BigNum& r, int mode) {
+  if (mode == BIG_MODINV_CONSTTIME)
+    return BigModInvConstantTime(a, m, r);
+
+  ScratchFrame frame;
+  BigNum x(2 * m.capacity_ + 1, frame);
+  BigNum y(2 * m.capacity_ + 1, frame);
+  BigNum g(2 * m.capacity_ + 1, frame);
 
   if (!BigModNormalize(a, m))
     return false;
-  if (!BigExtendedGCD(a, m, x, y, g))
+  if (mode == BIG_MODINV_LEHMER) {
+    if (!BigLehmerExtendedGCD(a, m, x, y, g))
+      return false;
+    if (!g.IsOne()) {
+      LOG(ERROR) << "BigModInv: not invertible\n";
+      return false;
+    }
+  } else if (!BigExtendedGCD(a, m, x, y, g)) {
     return false;
+  }
   r.CopyFrom(x);
   return BigModNormalize(r, m);
 }
@@ -273,7 +678,8 @@ bool BigModDiv(BigNum& a, BigNum& b, BigNum& m, BigNum& r) {
   int n = a.size_ > b.size_ ? a.size_ : b.size_;
   if (m.size_ > n)
     n = m.size_;
-  BigNum x(3 * n + 1);
+  ScratchFrame frame;
+  BigNum x(3 * n + 1, frame);
 
   if (!BigModInv(b, m, x))
     return false;
@@ -282,9 +688,76 @@ bool BigModDiv(BigNum& a, BigNum& b, BigNum& m, BigNum& r) {
   return BigModNormalize(r, m);
 }
 
+//  out[i]= in[i]^(-1) (mod m), i= 0, ..., n-1, by Montgomery's trick:
+//  with c[i]= in[0] in[1] ... in[i], one inversion of c[n-1] and then,
+//  walking down, out[i]= c[i-1] (c[i])^(-1) and (c[i-1])^(-1)=
+//  in[i] (c[i])^(-1).  3(n-1) multiplications.  out[i] may be in[i].
+//  Fails if any in[i] is not invertible.
+bool BigModInvBatch(int n, BigNum** in, BigNum& m, BigNum** out, int mode) {
+  if (n <= 0)
+    return true;
+
+  int size = 2 * m.Capacity() + 2;
+  BigNum** c = new BigNum*[n];
+  BarrettContext ctx;
+  ScratchFrame frame;
+  BigNum inv(size, frame);
+  BigNum next(size, frame);
+  BigNum t(size, frame);
+  bool ret = true;
+  int i;
+
+  for (i = 0; i < n; i++)
+    c[i] = new BigNum(size, frame);
+  if (!ctx.Init(m)) {
+    ret = false;
+    goto done;
+  }
+  for (i = 0; i < n; i++) {
+    if (!BigModNormalize(*in[i], m)) {
+      ret = false;
+      goto done;
+    }
+  }
+  c[0]->CopyFrom(*in[0]);
+  for (i = 1; i < n; i++) {
+    if (!BigModMult(*c[i - 1], *in[i], ctx, *c[i])) {
+      ret = false;
+      goto done;
+    }
+  }
+  if (!BigModInv(*c[n - 1], m, inv, mode)) {
+    ret = false;
+    goto done;
+  }
+  for (i = n - 1; i > 0; i--) {
+    t.ZeroNum();
+    next.ZeroNum();
+    if (!BigModMult(inv, *c[i - 1], ctx, t) ||
+        !BigModMult(inv, *in[i], ctx, next)) {
+      ret = false;
+      goto done;
+    }
+    out[i]->ZeroNum();
+    if (!out[i]->CopyFrom(t)) {
+      ret = false;
+      goto done;
+    }
+    inv.Swap(next);
+  }
+  out[0]->ZeroNum();
+  ret = out[0]->CopyFrom(inv);
+
+done:
+  if (!ret)
+    LOG(ERROR) << "BigModInvBatch failed\n";
+  for (i = 0; i < n; i++)
+    delete c[i];
+  delete []c;
+  return ret;
+}
+
 bool BigModExp(BigNum& a, BigNum& e, BigNum& m, BigNum& r) {
-  BigNum* accum[2] = {nullptr, nullptr};
-  BigNum* doubled[2] = {nullptr, nullptr};
   int accum_current = 0;
   int accum_next = 1;
   int doubler_current = 0;
@@ -300,18 +773,27 @@ bool BigModExp(BigNum& a, BigNum& e, BigNum& m, BigNum& r) {
   k = BigHighBit(e);
   if (k == 0) {
     Big_One.CopyTo(r);
-    goto done;
-  }
-  for (i = 0; i < 2; i++) {
-    accum[i] = new BigNum(4 * m.Capacity() + 1);
-    doubled[i] = new BigNum(4 * m.Capacity() + 1);
+    return true;
   }
+  if (BigExpWindowWidth(k) > 1)
+    return BigModExpWindowed(b, e, m, r, 0, true);
+
+  BarrettContext ctx;
+  if (!ctx.Init(m))
+    return false;
+  ScratchFrame frame;
+  BigNum accum0(4 * m.Capacity() + 1, frame);
+  BigNum accum1(4 * m.Capacity() + 1, frame);
+  BigNum doubled0(4 * m.Capacity() + 1, frame);
+  BigNum doubled1(4 * m.Capacity() + 1, frame);
+  BigNum* accum[2] = {&accum0, &accum1};
+  BigNum* doubled[2] = {&doubled0, &doubled1};
   accum[accum_current]->CopyFrom(Big_One);
   doubled[doubler_current]->CopyFrom(b);
   for (i = 1; i < k; i++) {
     if (BigBitPositionOn(e, i)) {
       accum[accum_next]->ZeroNum();
-      if (!BigModMult(*accum[accum_current], *doubled[doubler_current], m,
+      if (!BigModMult(*accum[accum_current], *doubled[doubler_current], ctx,
                       *accum[accum_next])) {
         LOG(ERROR) << "BigModMult 1 failed in BigModExp\n";
         ret = false;
@@ -321,7 +803,7 @@ bool BigModExp(BigNum& a, BigNum& e, BigNum& m, BigNum& r) {
       accum_next = (accum_next + 1) % 2;
     }
     doubled[doubler_next]->ZeroNum();
-    if (!BigModSquare(*doubled[doubler_current], m, *doubled[doubler_next])) {
+    if (!BigModSquare(*doubled[doubler_current], ctx, *doubled[doubler_next])) {
       LOG(ERROR) << "BigModSquare failed in BigModExp\n";
       ret = false;
       goto done;
@@ -331,7 +813,7 @@ bool BigModExp(BigNum& a, BigNum& e, BigNum& m, BigNum& r) {
   }
   if (BigBitPositionOn(e, i)) {
     accum[accum_next]->ZeroNum();
-    BigModMult(*accum[accum_current], *doubled[doubler_current], m,
+    BigModMult(*accum[accum_current], *doubled[doubler_current], ctx,
                *accum[accum_next]);
     accum_current = (accum_current + 1) % 2;
     accum_next = (accum_next + 1) % 2;
@@ -345,42 +827,282 @@ bool BigModExp(BigNum& a, BigNum& e, BigNum& m, BigNum& r) {
   }
 
 done:
-  for (i = 0; i < 2; i++) {
-    if (accum[i] != nullptr) {
-      delete accum[i];
+  return ret;
+}
+
+// Window width minimizing squarings plus table and window multiplications
+int BigExpWindowWidth(int num_bits) {
+  if (num_bits <= 24)
+    return 1;
+  if (num_bits <= 80)
+    return 3;
+  if (num_bits <= 240)
+    return 4;
+  if (num_bits <= 672)
+    return 5;
+  return 6;
+}
+
+/*
+ *  Next window of e, scanning down from bit position i (positions start at 1).
+ *  Sliding windows start and end on a one bit and are at most width long,
+ *  fixed windows are the width aligned digits of e.  Returns the low position
+ *  of the window and sets *val to its value.
+ */
+static int ExpNextWindow(BigNum& e, int i, int width, bool sliding, int* val) {
+  int low;
+
+  if (sliding) {
+    low = i - width + 1;
+    if (low < 1)
+      low = 1;
+    while (!BigBitPositionOn(e, low))
+      low++;
+  } else {
+    low = ((i - 1) / width) * width + 1;
+  }
+  *val = 0;
+  for (int j = i; j >= low; j--)
+    *val = (*val << 1) | (BigBitPositionOn(e, j) ? 1 : 0);
+  return low;
+}
+
+/*
+ *  Windowed left to right exponentiation.
+ *    sliding: table holds b, b^3, ..., b^(2^width-1), zero bits cost one
+ *             squaring each and every window one multiplication.
+ *    fixed:   table holds b^0, ..., b^(2^width-1), every width bits cost
+ *             width squarings and a multiplication.
+ *  width= 0 picks the width from the size of e.
+ */
+bool BigModExpWindowed(BigNum& a, BigNum& e, BigNum& m, BigNum& r, int width,
+                       bool sliding) {
+  int k = BigHighBit(e);
+  if (k == 0) {
+    r.ZeroNum();
+    return r.CopyFrom(Big_One) && BigModNormalize(r, m);
+  }
+  if (width <= 0)
+    width = BigExpWindowWidth(k);
+  if (width > 8) {
+    LOG(ERROR) << "BigModExpWindowed: window too wide\n";
+    return false;
+  }
+
+  int n = 2 * m.Capacity() + 2;
+  int table_size = sliding ? (1 << (width - 1)) : (1 << width);
+  BigNum** table = new BigNum*[table_size];
+  BigNum b(a, a.Capacity() > n ? a.Capacity() : n);
+  BarrettContext ctx;
+  ScratchFrame frame;
+  BigNum sq(n, frame);
+  BigNum t1(n, frame);
+  BigNum t2(n, frame);
+  BigNum* cur = &t1;
+  BigNum* next = &t2;
+  BigNum* swap;
+  bool started = false;
+  bool ret = true;
+  int i, j, low, val;
+
+  for (j = 0; j < table_size; j++)
+    table[j] = new BigNum(n, frame);
+  if (!ctx.Init(m) || !BigModNormalize(b, m)) {
+    ret = false;
+    goto done;
+  }
+  if (sliding) {
+    table[0]->CopyFrom(b);
+    if (table_size > 1 && !BigModSquare(b, ctx, sq)) {
+      ret = false;
+      goto done;
+    }
+    for (j = 1; j < table_size; j++) {
+      if (!BigModMult(*table[j - 1], sq, ctx, *table[j])) {
+        ret = false;
+        goto done;
+      }
+    }
+  } else {
+    table[0]->CopyFrom(Big_One);
+    table[1]->CopyFrom(b);
+    for (j = 2; j < table_size; j++) {
+      if (!BigModMult(*table[j - 1], b, ctx, *table[j])) {
+        ret = false;
+        goto done;
+      }
+    }
+  }
+
+  i = k;
+  while (i >= 1) {
+    if (sliding && !BigBitPositionOn(e, i)) {
+      next->ZeroNum();
+      if (!BigModSquare(*cur, ctx, *next)) {
+        ret = false;
+        goto done;
+      }
+      swap = cur; cur = next; next = swap;
+      i--;
+      continue;
     }
-    if (doubled[i] != nullptr) {
-      delete doubled[i];
+    low = ExpNextWindow(e, i, width, sliding, &val);
+    if (started) {
+      for (j = i; j >= low; j--) {
+        next->ZeroNum();
+        if (!BigModSquare(*cur, ctx, *next)) {
+          ret = false;
+          goto done;
+        }
+        swap = cur; cur = next; next = swap;
+      }
+      if (val != 0) {
+        next->ZeroNum();
+        if (!BigModMult(*cur, *table[sliding ? (val >> 1) : val], ctx,
+                        *next)) {
+          ret = false;
+          goto done;
+        }
+        swap = cur; cur = next; next = swap;
+      }
+    } else {
+      cur->CopyFrom(*table[sliding ? (val >> 1) : val]);
+      started = true;
     }
+    i = low - 1;
   }
+  r.ZeroNum();
+  ret = r.CopyFrom(*cur);
+
+done:
+  if (!ret)
+    LOG(ERROR) << "BigModExpWindowed failed\n";
+  for (j = 0; j < table_size; j++)
+    delete table[j];
+  delete []table;
   return ret;
 }
 
 #define MAXPRIMETRYS 25000
 
-bool BigGenPrime(BigNum& p, uint64_t num_bits) {
-  int i, j;
+//  Incremental prime search.  Each worker draws a random odd start s with
+//  the top two bits set (so a product of two such primes has exactly
+//  twice the bits), sieves the PRIME_SIEVE_WINDOW odd numbers s, s+2, ...
+//  against smallest_primes and runs Baillie-PSW only on the survivors,
+//  with PRIME_EXTRA_ROUNDS random base Miller-Rabin rounds on top.
+//  Workers stop when one of them succeeds or the caller's cancel flag is
+//  set.
+#define PRIME_SIEVE_WINDOW 2048
+#define PRIME_EXTRA_ROUNDS 0
+
+class PrimeSearch {
+ public:
+  uint64_t num_bits_;
+  std::atomic<bool>* cancel_;
+  std::atomic<bool> found_;
+  std::mutex lock_;
+  BigNum* result_;
+
+  PrimeSearch(BigNum& p, uint64_t num_bits, std::atomic<bool>* cancel)
+      : num_bits_(num_bits), cancel_(cancel), found_(false), result_(&p) {}
+  bool Stopped() {
+    return found_.load() || (cancel_ != nullptr && cancel_->load());
+  }
+  void Worker();
+};
+
+void PrimeSearch::Worker() {
+  extern uint64_t smallest_primes[];
+  extern int num_smallest_primes;
+  int n = (int)((num_bits_ + NBITSINUINT64 - 1) / NBITSINUINT64);
+  int top = (int)((num_bits_ - 1) % NBITSINUINT64);
+  BigNum start(n + 1);
+  BigNum candidate(n + 2);
+  BigNum offset(1);
+  uint64_t q[n + 1];
+  uint64_t r;
+  byte composite[PRIME_SIEVE_WINDOW];
+  int tries = 0;
+  int i, j, k;
 
-  for (i = 0; i < MAXPRIMETRYS; i++) {
-    p.ZeroNum();
-    if (!GetCryptoRand(num_bits, (byte*)p.value_)) {
+  while (tries < MAXPRIMETRYS && !Stopped()) {
+    start.ZeroNum();
+    if (!GetCryptoRand((int)num_bits_, (byte*)start.value_)) {
       LOG(ERROR) << "GetCryptoRand in BigGenPrime fails\n";
-      return false;
+      return;
     }
-    p.value_[p.size_ - 1] |= (1ULL) << 63;
-    p.value_[0] |= 1ULL;
-    p.Normalize();
-    for (j = 0; j < 250; j++, i++) {
-      if (BigIsPrime(p)) {
-        return true;
+    if (top < (NBITSINUINT64 - 1))
+      start.value_[n - 1] &= (1ULL << (top + 1)) - 1ULL;
+    start.value_[n - 1] |= 1ULL << top;
+    if (top > 0)
+      start.value_[n - 1] |= 1ULL << (top - 1);
+    else
+      start.value_[n - 2] |= 1ULL << (NBITSINUINT64 - 1);
+    start.value_[0] |= 1ULL;
+    start.Normalize();
+
+    // composite[j] if some small prime divides start + 2j.  Primes that
+    // could equal a candidate are skipped.
+    memset(composite, 0, PRIME_SIEVE_WINDOW);
+    for (i = 1; i < num_smallest_primes; i++) {
+      uint64_t p = smallest_primes[i];
+      if (num_bits_ < 14 && p >= (1ULL << (num_bits_ - 2)))
+        break;
+      k = start.size_;
+      if (!DigitArrayShortDivisionAlgorithm(start.size_, start.value_, p, &k,
+                                            q, &r)) {
+        LOG(ERROR) << "DigitArrayShortDivisionAlgorithm failed in BigGenPrime\n";
+        return;
       }
-      if (!BigUnsignedAddTo(p, Big_Two)) {
-        LOG(ERROR) << "BigUnsignedAddTo failed in BigGenPrime\n";
-        return false;
+      // start + 2j = 0 (mod p) iff j = (p - r)(p + 1)/2 (mod p)
+      uint64_t first = (uint64_t)(((uint128_t)((p - r) % p) * ((p + 1) / 2)) % p);
+      for (j = (int)first; j < PRIME_SIEVE_WINDOW; j += (int)p)
+        composite[j] = 1;
+    }
+
+    for (j = 0; j < PRIME_SIEVE_WINDOW && tries < MAXPRIMETRYS; j++, tries++) {
+      if (composite[j])
+        continue;
+      if (Stopped())
+        return;
+      offset.value_[0] = 2ULL * (uint64_t)j;
+      offset.Normalize();
+      candidate.ZeroNum();
+      if (!BigUnsignedAdd(start, offset, candidate))
+        return;
+      candidate.Normalize();
+      if ((uint64_t)BigHighBit(candidate) > num_bits_)
+        break;
+      if (!BigBailliePSW(candidate, PRIME_EXTRA_ROUNDS))
+        continue;
+      std::lock_guard<std::mutex> guard(lock_);
+      if (!found_.load()) {
+        result_->ZeroNum();
+        if (result_->CopyFrom(candidate))
+          found_.store(true);
       }
+      return;
     }
   }
-  return false;
+}
+
+bool BigGenPrime(BigNum& p, uint64_t num_bits, int num_threads,
+                 std::atomic<bool>* cancel) {
+  if (num_bits < 3 ||
+      p.Capacity() < (int)((num_bits + NBITSINUINT64 - 1) / NBITSINUINT64)) {
+    LOG(ERROR) << "BigGenPrime: bad size\n";
+    return false;
+  }
+  PrimeSearch search(p, num_bits, cancel);
+  std::vector<std::thread> workers;
+  int i;
+
+  for (i = 1; i < num_threads; i++)
+    workers.push_back(std::thread(&PrimeSearch::Worker, &search));
+  search.Worker();
+  for (i = 0; i < (int)workers.size(); i++)
+    workers[i].join();
+  return search.found_.load();
 }
 
 bool rands_avail = false;
@@ -407,73 +1129,325 @@ bool FillRandom(int n, BigNum** random_array) {
   return true;
 }
 
-bool BigMillerRabin(BigNum& n, BigNum** random_a, int trys) {
-  BigNum n_minus_1(2 * n.size_);
-  BigNum odd_part_n_minus_1(2 * n.size_);
-  BigNum y(4 * n.size_ + 1);
-  BigNum z(4 * n.size_ + 1);
-  int i;
-  int j;
-  int shift;
-
-  if (!BigSub(n, Big_One, n_minus_1))
+//  n-1= d 2^s, d odd.  n passes to base a if a^d = 1 or
+//  a^(d 2^r) = -1 (mod n) for some 0 <= r < s.  n odd, n > 2.
+bool BigStrongProbablePrime(BigNum& n, BigNum& a) {
+  ScratchFrame frame;
+  BigNum n_minus_1(n.size_ + 1, frame);
+  BigNum d(n.size_ + 1, frame);
+  BigNum y(2 * n.size_ + 2, frame);
+  BigNum z(2 * n.size_ + 2, frame);
+  BarrettContext ctx;
+  int s, r;
+
+  if (!BigUnsignedSub(n, Big_One, n_minus_1))
+    return false;
+  n_minus_1.Normalize();
+  s = BigMaxPowerOfTwoDividing(n_minus_1);
+  if (!BigShift(n_minus_1, -s, d))
+    return false;
+  d.Normalize();
+  if (!ctx.Init(n) || !BigModExp(a, d, n, y))
     return false;
-  shift = BigMaxPowerOfTwoDividing(n_minus_1);
-  if (shift > 0) {
-    if (!BigShift(n_minus_1, -shift, odd_part_n_minus_1))
+  if (y.IsOne() || BigCompare(y, n_minus_1) == 0)
+    return true;
+  for (r = 1; r < s; r++) {
+    z.ZeroNum();
+    if (!BigModSquare(y, ctx, z))
+      return false;
+    if (BigCompare(z, n_minus_1) == 0)
+      return true;
+    if (z.IsOne())
       return false;
+    y.Swap(z);
   }
+  return false;
+}
+
+bool BigMillerRabin(BigNum& n, BigNum** random_a, int trys) {
+  int i;
+
   for (i = 0; i < trys; i++) {
-    y.ZeroNum();
-    if (!BigModExp(*random_a[i], odd_part_n_minus_1, n, y))
+    if (!BigStrongProbablePrime(n, *random_a[i]))
       return false;
-    if (BigCompare(y, Big_One) == 0 || BigCompare(y, n_minus_1) == 0)
-      continue;
-    for (j = 0; j < shift; j++) {
-      z.ZeroNum();
-      if (!BigModMult(y, y, n, z))
-        return false;
-      if (BigCompare(z, Big_One) == 0)
-        return false;
-    }
-    y.CopyFrom(z);
-    if (BigCompare(y, n_minus_1) == 0)
-      break;
   }
-  if (BigCompare(y, n_minus_1) != 0)
-    return false;
   return true;
 }
 
-bool BigIsPrime(BigNum& n) {
-  extern uint64_t smallest_primes[];
-  extern int num_smallest_primes;
-  int i, k, m;
+// Jacobi symbol (a/n), n odd
+static int JacobiSmall(uint64_t a, uint64_t n) {
+  uint64_t t;
+  int j = 1;
+
+  a %= n;
+  while (a != 0ULL) {
+    while ((a & 1ULL) == 0ULL) {
+      a >>= 1;
+      if ((n & 7ULL) == 3ULL || (n & 7ULL) == 5ULL)
+        j = -j;
+    }
+    t = a;
+    a = n;
+    n = t;
+    if ((a & 3ULL) == 3ULL && (n & 3ULL) == 3ULL)
+      j = -j;
+    a %= n;
+  }
+  return n == 1ULL ? j : 0;
+}
+
+// (D/n), D odd, n odd
+static int JacobiOfSmall(int64_t D, BigNum& n) {
+  uint64_t k = (uint64_t)(D < 0 ? -D : D);
   uint64_t q[n.size_];
   uint64_t r;
-  BigNum** random_a = new BigNum* [20];
+  int size_q = n.size_;
+  int j;
 
-  for (i = 0; i < num_smallest_primes; i++) {
-    if (n.size_ == 1 && smallest_primes[i] >= n.value_[0])
-      return true;
-    k = n.size_;
-    m = DigitArrayShortDivisionAlgorithm(
-        n.size_, n.value_, (uint64_t)smallest_primes[i], &k, q, &r);
-    if (m < 0) {
-      LOG(ERROR) << "DigitArrayShortDivisionAlgorithm failed in BigIsPrime\n";
+  if (!DigitArrayShortDivisionAlgorithm(n.size_, n.value_, k, &size_q, q, &r))
+    return 0;
+  // reciprocity, (k/n)= (n/k) unless both are 3 (mod 4)
+  j = JacobiSmall(r, k);
+  if ((k & 3ULL) == 3ULL && (n.value_[0] & 3ULL) == 3ULL)
+    j = -j;
+  // (-1/n)= -1 iff n= 3 (mod 4)
+  if (D < 0 && (n.value_[0] & 3ULL) == 3ULL)
+    j = -j;
+  return j;
+}
+
+// n is a perfect square, Newton's method from above
+static bool BigIsPerfectSquare(BigNum& n) {
+  ScratchFrame frame;
+  BigNum x(n.size_ + 2, frame);
+  BigNum y(n.size_ + 2, frame);
+  BigNum q(n.size_ + 2, frame);
+  BigNum r(n.size_ + 2, frame);
+  BigNum t(2 * n.size_ + 4, frame);
+
+  if (!BigShift(Big_One, (BigHighBit(n) + 1) / 2, x))
+    return false;
+  for (;;) {
+    q.ZeroNum();
+    r.ZeroNum();
+    y.ZeroNum();
+    t.ZeroNum();
+    if (!BigUnsignedEuclid(n, x, q, r) || !BigUnsignedAdd(x, q, t))
       return false;
-    }
-    if (r == 0ULL)
+    t.Normalize();
+    if (!BigShift(t, -1, y))
       return false;
+    y.Normalize();
+    if (BigCompare(y, x) >= 0)
+      break;
+    x.Swap(y);
   }
-  if (!FillRandom(20, random_a)) {
-    LOG(ERROR) << "Couldnt FillRandom in BigIsPrime\n";
+  t.ZeroNum();
+  if (!BigUnsignedSquare(x, t))
+    return false;
+  t.Normalize();
+  return BigCompare(t, n) == 0;
+}
+
+// r= x/2 (mod n), x < n, n odd
+static bool BigModHalf(BigNum& x, BigNum& n, BigNum& t, BigNum& r) {
+  t.ZeroNum();
+  if ((x.value_[0] & 1ULL) != 0ULL) {
+    if (!BigUnsignedAdd(x, n, t))
+      return false;
+  } else if (!t.CopyFrom(x)) {
     return false;
   }
-  return BigMillerRabin(n, random_a);
+  t.Normalize();
+  r.ZeroNum();
+  if (!BigShift(t, -1, r))
+    return false;
+  r.Normalize();
+  return true;
 }
 
-bool BigModIsSquare(BigNum& n, BigNum& p) {
+//  Strong Lucas test with Selfridge's parameters: D the first of 5, -7,
+//  9, -11, ... with (D/n)= -1, P= 1, Q= (1-D)/4.  n+1= d 2^s, d odd.
+//  n passes if U_d= 0 or V_(d 2^r)= 0 (mod n) for some 0 <= r < s.
+//  n odd, n > 2.
+bool BigStrongLucasProbablePrime(BigNum& n) {
+  int64_t D = 5;
+  int j, k;
+
+  for (k = 0;; k++) {
+    j = JacobiOfSmall(D, n);
+    if (j == -1)
+      break;
+    if (j == 0 && (n.size_ > 1 || n.value_[0] > (uint64_t)(D < 0 ? -D : D)))
+      return false;
+    // squares have no such D
+    if (k == 10 && BigIsPerfectSquare(n))
+      return false;
+    D = D < 0 ? 2 - D : -D - 2;
+  }
+
+  int64_t Q = (1 - D) / 4;
+  int size = 2 * n.size_ + 2;
+  ScratchFrame frame;
+  BigNum d(n.size_ + 1, frame);
+  BigNum n_plus_1(n.size_ + 1, frame);
+  BigNum Dn(size, frame);
+  BigNum Qn(size, frame);
+  BigNum U(size, frame);
+  BigNum V(size, frame);
+  BigNum Qk(size, frame);
+  BigNum t1(size, frame);
+  BigNum t2(size, frame);
+  BigNum t3(size, frame);
+  BarrettContext ctx;
+  BigNum Dabs(1, (uint64_t)(D < 0 ? -D : D));
+  BigNum Qabs(1, (uint64_t)(Q < 0 ? -Q : Q));
+  int s, i;
+
+  if (!ctx.Init(n))
+    return false;
+  // D, Q as residues
+  Dn.CopyFrom(Dabs);
+  BigModNormalize(Dn, n);
+  if (D < 0 && !Dn.IsZero()) {
+    t1.ZeroNum();
+    BigUnsignedSub(n, Dn, t1);
+    t1.Normalize();
+    Dn.ZeroNum();
+    Dn.CopyFrom(t1);
+  }
+  Qn.CopyFrom(Qabs);
+  BigModNormalize(Qn, n);
+  if (Q < 0 && !Qn.IsZero()) {
+    t1.ZeroNum();
+    BigUnsignedSub(n, Qn, t1);
+    t1.Normalize();
+    Qn.ZeroNum();
+    Qn.CopyFrom(t1);
+  }
+
+  if (!BigUnsignedAdd(n, Big_One, n_plus_1))
+    return false;
+  n_plus_1.Normalize();
+  s = BigMaxPowerOfTwoDividing(n_plus_1);
+  if (!BigShift(n_plus_1, -s, d))
+    return false;
+  d.Normalize();
+
+  // U_1= 1, V_1= P= 1, Q^1
+  U.CopyFrom(Big_One);
+  V.CopyFrom(Big_One);
+  Qk.CopyFrom(Qn);
+  for (i = BigHighBit(d) - 1; i >= 1; i--) {
+    // U_2k= U_k V_k, V_2k= V_k^2 - 2Q^k, Q^2k
+    t1.ZeroNum();
+    if (!BigModMult(U, V, ctx, t1))
+      return false;
+    U.Swap(t1);
+    t1.ZeroNum();
+    t2.ZeroNum();
+    t3.ZeroNum();
+    if (!BigModSquare(V, ctx, t1) || !BigModAdd(Qk, Qk, n, t2) ||
+        !BigModSub(t1, t2, n, t3))
+      return false;
+    V.Swap(t3);
+    t1.ZeroNum();
+    if (!BigModSquare(Qk, ctx, t1))
+      return false;
+    Qk.Swap(t1);
+    if (BigBitPositionOn(d, i)) {
+      // U_2k+1= (P U_2k + V_2k)/2, V_2k+1= (D U_2k + P V_2k)/2, Q^2k+1
+      t1.ZeroNum();
+      t2.ZeroNum();
+      if (!BigModAdd(U, V, n, t1) || !BigModMult(Dn, U, ctx, t2))
+        return false;
+      t3.ZeroNum();
+      if (!BigModAdd(t2, V, n, t3))
+        return false;
+      if (!BigModHalf(t1, n, t2, U) || !BigModHalf(t3, n, t2, V))
+        return false;
+      t1.ZeroNum();
+      if (!BigModMult(Qk, Qn, ctx, t1))
+        return false;
+      Qk.Swap(t1);
+    }
+  }
+  if (U.IsZero() || V.IsZero())
+    return true;
+  for (i = 1; i < s; i++) {
+    t1.ZeroNum();
+    t2.ZeroNum();
+    t3.ZeroNum();
+    if (!BigModSquare(V, ctx, t1) || !BigModAdd(Qk, Qk, n, t2) ||
+        !BigModSub(t1, t2, n, t3))
+      return false;
+    V.Swap(t3);
+    if (V.IsZero())
+      return true;
+    t1.ZeroNum();
+    if (!BigModSquare(Qk, ctx, t1))
+      return false;
+    Qk.Swap(t1);
+  }
+  return false;
+}
+
+//  Baillie-PSW: a strong test to base 2 and a strong Lucas test, then
+//  extra_rounds Miller-Rabin rounds with random bases.  No trial division.
+//  n odd, n > 2.
+bool BigBailliePSW(BigNum& n, int extra_rounds) {
+  if (!BigStrongProbablePrime(n, Big_Two))
+    return false;
+  if (!BigStrongLucasProbablePrime(n))
+    return false;
+
+  BigNum a(n.size_ + 1);
+  int i;
+  for (i = 0; i < extra_rounds; i++) {
+    a.ZeroNum();
+    if (!GetCryptoRand(n.size_ * NBITSINUINT64, (byte*)a.value_))
+      return false;
+    a.Normalize();
+    BigModNormalize(a, n);
+    if (BigCompare(a, Big_Two) < 0)
+      a.CopyFrom(Big_Two);
+    if (!BigStrongProbablePrime(n, a))
+      return false;
+  }
+  return true;
+}
+
+bool BigIsPrime(BigNum& n, int mode, int extra_rounds) {
+  extern uint64_t smallest_primes[];
+  extern int num_smallest_primes;
+  int i, k, m;
+  uint64_t q[n.size_];
+  uint64_t r;
+  BigNum* random_a[20];
+
+  for (i = 0; i < num_smallest_primes; i++) {
+    if (n.size_ == 1 && smallest_primes[i] >= n.value_[0])
+      return true;
+    k = n.size_;
+    m = DigitArrayShortDivisionAlgorithm(
+        n.size_, n.value_, (uint64_t)smallest_primes[i], &k, q, &r);
+    if (m < 0) {
+      LOG(ERROR) << "DigitArrayShortDivisionAlgorithm failed in BigIsPrime\n";
+      return false;
+    }
+    if (r == 0ULL)
+      return false;
+  }
+  if (mode == BIG_PRIME_BPSW)
+    return BigBailliePSW(n, extra_rounds);
+  if (!FillRandom(20, random_a)) {
+    LOG(ERROR) << "Couldnt FillRandom in BigIsPrime\n";
+    return false;
+  }
+  return BigMillerRabin(n, random_a);
+}
+
+bool BigModIsSquare(BigNum& n, BigNum& p) {
   BigNum p_minus_1(n.Size());
   BigNum e(n.Size());
   int m = (n.Capacity() > p.Capacity()) ? n.Capacity() : p.Capacity();
@@ -836,10 +1810,11 @@ bool BigMontReduce(BigNum& a, int r, BigNum& m, BigNum& m_prime,
     n = m.size_;
   if (a.size_ > n)
     n = a.size_;
-  BigNum t(4 * n + 1);
-  BigNum v(4 * n + 1);
-  BigNum w(4 * n + 1);
-  BigNum R(4 * n + 1);
+  ScratchFrame frame;
+  BigNum t(4 * n + 1, frame);
+  BigNum v(4 * n + 1, frame);
+  BigNum w(4 * n + 1, frame);
+  BigNum R(4 * n + 1, frame);
   int i;
 
   if (!BigMult(a, m_prime, t))
@@ -931,9 +1906,18 @@ bool BigMontExp(BigNum& b, BigNum& e, int r, BigNum& m, BigNum& m_prime,
   if (e.size_ > n)
     n = e.size_;
 
-  BigNum square(4 * n + 1);
-  BigNum accum(4 * n + 1);
-  BigNum t(4 * n + 1);
+  // odd moduli go through the word level kernel, the answer does not
+  // depend on r
+  if ((m.value_[0] & 1ULL) != 0ULL) {
+    MontgomeryContext ctx;
+    if (ctx.Init(m))
+      return BigMontExp(b, e, ctx, out);
+  }
+
+  ScratchFrame frame;
+  BigNum square(4 * n + 1, frame);
+  BigNum accum(4 * n + 1, frame);
+  BigNum t(4 * n + 1, frame);
   int k = BigHighBit(e);
   int i;
 
@@ -953,7 +1937,7 @@ bool BigMontExp(BigNum& b, BigNum& e, int r, BigNum& m, BigNum& m_prime,
                    << square.size_ << "\n";
         return false;
       }
-      accum.CopyFrom(t);
+      accum.Swap(t);
     }
     t.ZeroNum();
     if (i != k) {
@@ -965,8 +1949,1044 @@ bool BigMontExp(BigNum& b, BigNum& e, int r, BigNum& m, BigNum& m_prime,
                    << m.size_ << ", " << square.size_ << "\n";
         return false;
       }
-      square.CopyFrom(t);
+      square.Swap(t);
     }
   }
   return BigMontReduce(accum, r, m, m_prime, out);
 }
+
+MontgomeryContext::MontgomeryContext() {
+  size_ = 0;
+  m_prime_ = 0ULL;
+  m_ = nullptr;
+  r_mod_m_ = nullptr;
+  r2_mod_m_ = nullptr;
+}
+
+MontgomeryContext::~MontgomeryContext() {
+  Clear();
+}
+
+void MontgomeryContext::Clear() {
+  if (m_ != nullptr) {
+    delete m_;
+    m_ = nullptr;
+  }
+  if (r_mod_m_ != nullptr) {
+    delete r_mod_m_;
+    r_mod_m_ = nullptr;
+  }
+  if (r2_mod_m_ != nullptr) {
+    delete r2_mod_m_;
+    r2_mod_m_ = nullptr;
+  }
+  size_ = 0;
+  m_prime_ = 0ULL;
+}
+
+bool MontgomeryContext::IsValid() {
+  return m_ != nullptr && size_ > 0;
+}
+
+//  m' = -m^(-1) (mod 2^64) by Newton iteration: each step doubles the
+//  number of correct low bits and m*m = 1 (mod 8) for odd m.
+bool MontgomeryContext::Init(BigNum& m) {
+  Clear();
+  m.Normalize();
+  if (m.IsNegative() || m.IsZero() || (m.value_[0] & 1ULL) == 0ULL) {
+    LOG(ERROR) << "MontgomeryContext::Init: modulus must be odd and positive\n";
+    return false;
+  }
+  size_ = m.size_;
+  m_ = new BigNum(m, size_ + 1);
+
+  uint64_t m0 = m.value_[0];
+  uint64_t inv = m0;
+  for (int i = 0; i < 5; i++) inv *= 2ULL - m0 * inv;
+  m_prime_ = (uint64_t)0 - inv;
+
+  BigNum R(2 * size_ + 2);
+  r_mod_m_ = new BigNum(size_ + 1);
+  r2_mod_m_ = new BigNum(size_ + 1);
+  if (!BigShift(Big_One, NBITSINUINT64 * size_, R)) {
+    LOG(ERROR) << "BigShift fails in MontgomeryContext::Init\n";
+    Clear();
+    return false;
+  }
+  if (!BigMod(R, m, *r_mod_m_)) {
+    LOG(ERROR) << "BigMod fails in MontgomeryContext::Init\n";
+    Clear();
+    return false;
+  }
+  // BigModMult reduces in place in its output, so it needs the wide temporary
+  R.ZeroNum();
+  if (!BigModMult(*r_mod_m_, *r_mod_m_, m, R)) {
+    LOG(ERROR) << "BigModMult fails in MontgomeryContext::Init\n";
+    Clear();
+    return false;
+  }
+  r2_mod_m_->CopyFrom(R);
+  return true;
+}
+
+// abR= aR*bR*R^(-1) (mod m).  aR, bR < m
+bool MontgomeryContext::MontMult(BigNum& aR, BigNum& bR, BigNum& abR) {
+  if (!IsValid())
+    return false;
+  if (aR.size_ > size_ || bR.size_ > size_ || abR.capacity_ < size_) {
+    LOG(ERROR) << "MontgomeryContext::MontMult: operand too large\n";
+    return false;
+  }
+  uint64_t a[size_];
+  uint64_t b[size_];
+  uint64_t t[2 * size_ + 2];
+
+  DigitArrayZeroNum(size_, a);
+  DigitArrayZeroNum(size_, b);
+  DigitArrayCopy(aR.size_, aR.value_, size_, a);
+  DigitArrayCopy(bR.size_, bR.value_, size_, b);
+  DigitArrayZeroNum(abR.capacity_, abR.value_);
+  int k = DigitArrayMontMult(size_, a, b, m_->value_, m_prime_, t,
+                             abR.value_);
+  if (k < 0)
+    return false;
+  abR.size_ = k;
+  abR.sign_ = false;
+  return true;
+}
+
+// aaR= aR*aR*R^(-1) (mod m), a dedicated square then a separate reduction
+bool MontgomeryContext::MontSquare(BigNum& aR, BigNum& aaR) {
+  if (!IsValid())
+    return false;
+  if (aR.size_ > size_ || aaR.capacity_ < size_) {
+    LOG(ERROR) << "MontgomeryContext::MontSquare: operand too large\n";
+    return false;
+  }
+  uint64_t a[size_];
+  uint64_t t[2 * size_ + 1];
+
+  DigitArrayZeroNum(size_, a);
+  DigitArrayCopy(aR.size_, aR.value_, size_, a);
+  DigitArrayZeroNum(2 * size_ + 1, t);
+  if (DigitArraySquare(size_, a, 2 * size_ + 1, t) < 0)
+    return false;
+  DigitArrayZeroNum(aaR.capacity_, aaR.value_);
+  int k = DigitArrayMontReduce(size_, t, m_->value_, m_prime_, aaR.value_);
+  if (k < 0)
+    return false;
+  aaR.size_ = k;
+  aaR.sign_ = false;
+  return true;
+}
+
+// aR= a R (mod m)
+bool MontgomeryContext::ToMont(BigNum& a, BigNum& aR) {
+  if (!IsValid())
+    return false;
+  if (a.IsNegative() || BigCompare(a, *m_) >= 0) {
+    int n = a.capacity_ > size_ ? a.capacity_ : size_;
+    BigNum t(n + 1);
+    if (!BigMod(a, *m_, t))
+      return false;
+    return MontMult(t, *r2_mod_m_, aR);
+  }
+  return MontMult(a, *r2_mod_m_, aR);
+}
+
+// a= aR R^(-1) (mod m)
+bool MontgomeryContext::FromMont(BigNum& aR, BigNum& a) {
+  BigNum one(1, 1ULL);
+  return MontMult(aR, one, a);
+}
+
+/*
+ *  MontExp with cached parameters, left to right
+ *    A= R (mod m), X= xR (mod m)
+ *    for(i=t; i>=0; i--) {
+ *      A= Mont(A,A)
+ *      if(e[i]==1) A= Mont(A,X)
+ *    }
+ *    return Mont(A,1)
+ */
+bool BigMontExp(BigNum& b, BigNum& e, MontgomeryContext& ctx, BigNum& out) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigMontExp: invalid MontgomeryContext\n";
+    return false;
+  }
+  int n = ctx.size_ + 1;
+  ScratchFrame frame;
+  BigNum x(n, frame);
+  BigNum accum(n, frame);
+  BigNum t(n, frame);
+  int k = BigHighBit(e);
+  int i;
+
+  if (BigExpWindowWidth(k) > 1)
+    return BigMontExpWindowed(b, e, ctx, out, 0, true);
+
+  if (!ctx.ToMont(b, x)) {
+    LOG(ERROR) << "ToMont fails in BigMontExp\n";
+    return false;
+  }
+  accum.CopyFrom(*ctx.r_mod_m_);
+  for (i = k; i >= 1; i--) {
+    if (!ctx.MontSquare(accum, t)) {
+      LOG(ERROR) << "MontSquare fails in BigMontExp\n";
+      return false;
+    }
+    if (BigBitPositionOn(e, i)) {
+      if (!ctx.MontMult(t, x, accum)) {
+        LOG(ERROR) << "MontMult fails in BigMontExp\n";
+        return false;
+      }
+    } else {
+      accum.Swap(t);
+    }
+  }
+  if (!ctx.FromMont(accum, t)) {
+    LOG(ERROR) << "FromMont fails in BigMontExp\n";
+    return false;
+  }
+  return out.CopyFrom(t);
+}
+
+// Windowed BigMontExp, see BigModExpWindowed
+bool BigMontExpWindowed(BigNum& b, BigNum& e, MontgomeryContext& ctx,
+                        BigNum& out, int width, bool sliding) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigMontExpWindowed: invalid MontgomeryContext\n";
+    return false;
+  }
+  int k = BigHighBit(e);
+  if (k == 0) {
+    out.ZeroNum();
+    return out.CopyFrom(Big_One) && BigModNormalize(out, *ctx.m_);
+  }
+  if (width <= 0)
+    width = BigExpWindowWidth(k);
+  if (width > 8) {
+    LOG(ERROR) << "BigMontExpWindowed: window too wide\n";
+    return false;
+  }
+
+  int n = ctx.size_ + 1;
+  int table_size = sliding ? (1 << (width - 1)) : (1 << width);
+  BigNum** table = new BigNum*[table_size];
+  ScratchFrame frame;
+  BigNum x(n, frame);
+  BigNum sq(n, frame);
+  BigNum t1(n, frame);
+  BigNum t2(n, frame);
+  BigNum* cur = &t1;
+  BigNum* next = &t2;
+  BigNum* swap;
+  bool started = false;
+  bool ret = true;
+  int i, j, low, val;
+
+  for (j = 0; j < table_size; j++)
+    table[j] = new BigNum(n, frame);
+  if (!ctx.ToMont(b, x)) {
+    ret = false;
+    goto done;
+  }
+  if (sliding) {
+    table[0]->CopyFrom(x);
+    if (table_size > 1 && !ctx.MontSquare(x, sq)) {
+      ret = false;
+      goto done;
+    }
+    for (j = 1; j < table_size; j++) {
+      if (!ctx.MontMult(*table[j - 1], sq, *table[j])) {
+        ret = false;
+        goto done;
+      }
+    }
+  } else {
+    table[0]->CopyFrom(*ctx.r_mod_m_);
+    table[1]->CopyFrom(x);
+    for (j = 2; j < table_size; j++) {
+      if (!ctx.MontMult(*table[j - 1], x, *table[j])) {
+        ret = false;
+        goto done;
+      }
+    }
+  }
+
+  i = k;
+  while (i >= 1) {
+    if (sliding && !BigBitPositionOn(e, i)) {
+      if (!ctx.MontSquare(*cur, *next)) {
+        ret = false;
+        goto done;
+      }
+      swap = cur; cur = next; next = swap;
+      i--;
+      continue;
+    }
+    low = ExpNextWindow(e, i, width, sliding, &val);
+    if (started) {
+      for (j = i; j >= low; j--) {
+        if (!ctx.MontSquare(*cur, *next)) {
+          ret = false;
+          goto done;
+        }
+        swap = cur; cur = next; next = swap;
+      }
+      if (val != 0) {
+        if (!ctx.MontMult(*cur, *table[sliding ? (val >> 1) : val], *next)) {
+          ret = false;
+          goto done;
+        }
+        swap = cur; cur = next; next = swap;
+      }
+    } else {
+      cur->CopyFrom(*table[sliding ? (val >> 1) : val]);
+      started = true;
+    }
+    i = low - 1;
+  }
+  if (!ctx.FromMont(*cur, *next)) {
+    ret = false;
+    goto done;
+  }
+  out.ZeroNum();
+  ret = out.CopyFrom(*next);
+
+done:
+  if (!ret)
+    LOG(ERROR) << "BigMontExpWindowed failed\n";
+  for (j = 0; j < table_size; j++)
+    delete table[j];
+  delete []table;
+  return ret;
+}
+
+//  Constant time pieces for BigMontExpConstantTime.  Loop counts depend
+//  only on n, carries are kept in a top digit instead of being rippled,
+//  and the final subtraction is selected with a mask.
+
+// r= t R^(-1) (mod m), t < mR has 2n digits and is destroyed, r < m
+static void MontReduceConstantTime(int n, uint64_t* t, uint64_t* m,
+                                   uint64_t m_prime, uint64_t* r) {
+  uint64_t top = 0ULL;
+  uint64_t borrow = 0ULL;
+  uint64_t d[n];
+  int i;
+
+  for (i = 0; i < n; i++) {
+    uint64_t c = DigitArrayMultAdd(t[i] * m_prime, n, m, &t[i]);
+    uint128_t s = (uint128_t)t[i + n] + c + top;
+    t[i + n] = (uint64_t)s;
+    top = (uint64_t)(s >> 64);
+  }
+  for (i = 0; i < n; i++) {
+    uint128_t s = (uint128_t)t[i + n] - m[i] - borrow;
+    d[i] = (uint64_t)s;
+    borrow = (uint64_t)(s >> 64) & 1ULL;
+  }
+  // keep t+n only if it is below m: no top carry and a borrow
+  uint64_t keep = 0ULL - (borrow & (top ^ 1ULL));
+  for (i = 0; i < n; i++) r[i] = (t[i + n] & keep) | (d[i] & ~keep);
+}
+
+// r= a b R^(-1) (mod m), t has 2n digits of scratch.  r may be a or b.
+static void MontMultConstantTime(int n, uint64_t* a, uint64_t* b, uint64_t* m,
+                                 uint64_t m_prime, uint64_t* t, uint64_t* r) {
+  DigitArrayZeroNum(2 * n, t);
+  for (int i = 0; i < n; i++) t[i + n] = DigitArrayMultAdd(a[i], n, b, &t[i]);
+  MontReduceConstantTime(n, t, m, m_prime, r);
+}
+
+// r= a a R^(-1) (mod m), cross products once, doubled, then the diagonal
+static void MontSquareConstantTime(int n, uint64_t* a, uint64_t* m,
+                                   uint64_t m_prime, uint64_t* t,
+                                   uint64_t* r) {
+  uint64_t high = 0ULL;
+  uint64_t carry = 0ULL;
+  int i;
+
+  DigitArrayZeroNum(2 * n, t);
+  for (i = 0; i < (n - 1); i++)
+    t[i + n] = DigitArrayMultAdd(a[i], n - i - 1, &a[i + 1], &t[2 * i + 1]);
+  for (i = 0; i < 2 * n; i++) {
+    uint64_t next = t[i] >> 63;
+    t[i] = (t[i] << 1) | high;
+    high = next;
+  }
+  for (i = 0; i < n; i++) {
+    uint128_t sq = (uint128_t)a[i] * a[i];
+    uint128_t s = (uint128_t)t[2 * i] + (uint64_t)sq + carry;
+    t[2 * i] = (uint64_t)s;
+    s = (uint128_t)t[2 * i + 1] + (uint64_t)(sq >> 64) + (uint64_t)(s >> 64);
+    t[2 * i + 1] = (uint64_t)s;
+    carry = (uint64_t)(s >> 64);
+  }
+  MontReduceConstantTime(n, t, m, m_prime, r);
+}
+
+//  The table keeps digit j of entry k at table[j * num_entries + k], so a
+//  cache line holds the same digit of 8 entries and every lookup touches
+//  the same lines.
+static void TableScatter(int n, int num_entries, uint64_t* table, int k,
+                         uint64_t* a) {
+  for (int j = 0; j < n; j++) table[j * num_entries + k] = a[j];
+}
+
+// r= entry idx, every entry is read and all but one masked off
+static void TableGather(int n, int num_entries, uint64_t* table, uint64_t idx,
+                        uint64_t* r) {
+  uint64_t mask[num_entries];
+  int j, k;
+
+  for (k = 0; k < num_entries; k++)
+    mask[k] = 0ULL - ((((uint64_t)k ^ idx) - 1ULL) >> 63);
+  for (j = 0; j < n; j++) {
+    uint64_t* row = &table[j * num_entries];
+    uint64_t x = 0ULL;
+    for (k = 0; k < num_entries; k++) x |= row[k] & mask[k];
+    r[j] = x;
+  }
+}
+
+// bits [pos, pos + width) of e, pos from 0
+static uint64_t ExpWindowValue(BigNum& e, int pos, int width) {
+  int w = pos / NBITSINUINT64;
+  int s = pos % NBITSINUINT64;
+  uint64_t v = w < e.size_ ? e.value_[w] >> s : 0ULL;
+  if (s > (NBITSINUINT64 - width) && (w + 1) < e.size_)
+    v |= e.value_[w + 1] << (NBITSINUINT64 - s);
+  return v & ((1ULL << width) - 1ULL);
+}
+
+/*
+ *  Constant time BigMontExp for secret exponents.  Fixed windows cover
+ *  all 64*size_ bits of the modulus, every window costs width squarings
+ *  and one multiplication (by R for a zero window), and the table is read
+ *  by TableGather.  Neither the instructions executed nor the addresses
+ *  touched depend on e, only on the sizes of m and e.
+ */
+bool BigMontExpConstantTime(BigNum& b, BigNum& e, MontgomeryContext& ctx,
+                            BigNum& out, int width) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigMontExpConstantTime: invalid MontgomeryContext\n";
+    return false;
+  }
+  int n = ctx.size_;
+  if (e.IsNegative() || out.capacity_ < n) {
+    LOG(ERROR) << "BigMontExpConstantTime: bad exponent or output\n";
+    return false;
+  }
+  int bits = NBITSINUINT64 * (e.size_ > n ? e.size_ : n);
+  if (width <= 0)
+    width = bits > 1024 ? 6 : 5;
+  if (width > 8) {
+    LOG(ERROR) << "BigMontExpConstantTime: window too wide\n";
+    return false;
+  }
+
+  int num_entries = 1 << width;
+  int nb = b.capacity_ > n ? b.capacity_ : n;
+  uint64_t* m = ctx.m_->value_;
+  uint64_t* table = new uint64_t[n * num_entries];
+  uint64_t x[n];
+  uint64_t acc[n];
+  uint64_t sel[n];
+  uint64_t t[2 * n];
+  uint64_t r2[n];
+  int i, k, pos;
+  BigNum base(nb + 1);
+
+  // x= b R (mod m)
+  if (!BigMod(b, *ctx.m_, base)) {
+    delete []table;
+    return false;
+  }
+  DigitArrayZeroNum(n, x);
+  DigitArrayZeroNum(n, r2);
+  DigitArrayCopy(base.size_, base.value_, n, x);
+  DigitArrayCopy(ctx.r2_mod_m_->size_, ctx.r2_mod_m_->value_, n, r2);
+  MontMultConstantTime(n, x, r2, m, ctx.m_prime_, t, x);
+
+  // table[k]= x^k R
+  DigitArrayZeroNum(n, acc);
+  DigitArrayCopy(ctx.r_mod_m_->size_, ctx.r_mod_m_->value_, n, acc);
+  TableScatter(n, num_entries, table, 0, acc);
+  TableScatter(n, num_entries, table, 1, x);
+  DigitArrayCopy(n, x, n, acc);
+  for (k = 2; k < num_entries; k++) {
+    MontMultConstantTime(n, acc, x, m, ctx.m_prime_, t, acc);
+    TableScatter(n, num_entries, table, k, acc);
+  }
+
+  pos = ((bits + width - 1) / width) * width - width;
+  TableGather(n, num_entries, table, ExpWindowValue(e, pos, width), acc);
+  while (pos > 0) {
+    pos -= width;
+    for (i = 0; i < width; i++)
+      MontSquareConstantTime(n, acc, m, ctx.m_prime_, t, acc);
+    TableGather(n, num_entries, table, ExpWindowValue(e, pos, width), sel);
+    MontMultConstantTime(n, acc, sel, m, ctx.m_prime_, t, acc);
+  }
+
+  // out of Montgomery form
+  DigitArrayZeroNum(n, sel);
+  sel[0] = 1ULL;
+  MontMultConstantTime(n, acc, sel, m, ctx.m_prime_, t, acc);
+  out.ZeroNum();
+  DigitArrayCopy(n, acc, out.capacity_, out.value_);
+  out.size_ = DigitArrayComputedSize(n, out.value_);
+  out.sign_ = false;
+
+  // the table held powers of a secret
+  for (i = 0; i < n * num_entries; i++) table[i] = 0ULL;
+  delete []table;
+  return true;
+}
+
+//  r= a b (mod m) for a, b in [0, m) as (a b R^(-1)) R^2 R^(-1), both
+//  multiplications constant time.  For secret operands.
+bool BigModMultConstantTime(BigNum& a, BigNum& b, MontgomeryContext& ctx,
+                            BigNum& r) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigModMultConstantTime: invalid MontgomeryContext\n";
+    return false;
+  }
+  int n = ctx.size_;
+  if (a.IsNegative() || b.IsNegative() || a.size_ > n || b.size_ > n ||
+      r.capacity_ < n) {
+    LOG(ERROR) << "BigModMultConstantTime: bad operand size\n";
+    return false;
+  }
+  uint64_t* m = ctx.m_->value_;
+  uint64_t x[n];
+  uint64_t y[n];
+  uint64_t t[2 * n];
+  int i;
+
+  DigitArrayZeroNum(n, x);
+  DigitArrayZeroNum(n, y);
+  DigitArrayCopy(a.size_, a.value_, n, x);
+  DigitArrayCopy(b.size_, b.value_, n, y);
+  MontMultConstantTime(n, x, y, m, ctx.m_prime_, t, x);
+  DigitArrayZeroNum(n, y);
+  DigitArrayCopy(ctx.r2_mod_m_->size_, ctx.r2_mod_m_->value_, n, y);
+  MontMultConstantTime(n, x, y, m, ctx.m_prime_, t, x);
+  r.ZeroNum();
+  DigitArrayCopy(n, x, r.capacity_, r.value_);
+  r.size_ = DigitArrayComputedSize(n, r.value_);
+  r.sign_ = false;
+  for (i = 0; i < n; i++) x[i] = 0ULL;
+  for (i = 0; i < 2 * n; i++) t[i] = 0ULL;
+  return true;
+}
+
+//  out[i]= b[i]^e[i] (mod m), i < num.  With AVX2 four exponentiations
+//  run together, one per lane, see DigitArrayMontExpBatch4; otherwise
+//  each is a fixed window BigMontExpWindowed.  out[i] may be b[i].
+bool BigMontExpBatch(int num, BigNum** b, BigNum** e, MontgomeryContext& ctx,
+                     BigNum** out) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigMontExpBatch: invalid MontgomeryContext\n";
+    return false;
+  }
+  int n = ctx.size_;
+  int i, j, k;
+
+  for (i = 0; i < num; i++) {
+    if (e[i]->IsNegative() || out[i]->capacity_ < n) {
+      LOG(ERROR) << "BigMontExpBatch: bad exponent or output\n";
+      return false;
+    }
+  }
+  if (!DigitArrayUseAvx2()) {
+    for (i = 0; i < num; i++) {
+      if (!BigMontExpWindowed(*b[i], *e[i], ctx, *out[i], 0, false))
+        return false;
+    }
+    return true;
+  }
+
+  uint64_t zero = 0ULL;
+  uint64_t bases[4 * n];
+  uint64_t results[4 * n];
+  uint64_t* lane_b[4];
+  uint64_t* lane_e[4];
+  uint64_t* lane_out[4];
+  int lane_size_e[4];
+  BigNum t(n + 1);
+
+  for (i = 0; i < num; i += 4) {
+    for (k = 0; k < 4; k++) {
+      j = i + k;
+      lane_b[k] = &bases[k * n];
+      lane_out[k] = &results[k * n];
+      DigitArrayZeroNum(n, lane_b[k]);
+      if (j >= num) {
+        lane_e[k] = &zero;
+        lane_size_e[k] = 1;
+        continue;
+      }
+      if (b[j]->IsNegative() || BigCompare(*b[j], *ctx.m_) >= 0) {
+        t.ZeroNum();
+        if (!BigMod(*b[j], *ctx.m_, t))
+          return false;
+        DigitArrayCopy(t.size_, t.value_, n, lane_b[k]);
+      } else {
+        DigitArrayCopy(b[j]->size_, b[j]->value_, n, lane_b[k]);
+      }
+      lane_e[k] = e[j]->value_;
+      lane_size_e[k] = e[j]->size_;
+    }
+    if (!DigitArrayMontExpBatch4(n, ctx.m_->value_, lane_b, lane_size_e,
+                                 lane_e, lane_out))
+      return false;
+    for (k = 0; k < 4 && (i + k) < num; k++) {
+      BigNum* r = out[i + k];
+      r->ZeroNum();
+      DigitArrayCopy(n, lane_out[k], r->capacity_, r->value_);
+      r->size_ = DigitArrayComputedSize(n, r->value_);
+      r->sign_ = false;
+    }
+  }
+  return true;
+}
+
+BarrettContext::BarrettContext() {
+  size_ = 0;
+  mu_size_ = 0;
+  m_ = nullptr;
+  mu_ = nullptr;
+}
+
+BarrettContext::~BarrettContext() {
+  Clear();
+}
+
+void BarrettContext::Clear() {
+  if (m_ != nullptr) {
+    delete m_;
+    m_ = nullptr;
+  }
+  if (mu_ != nullptr) {
+    delete mu_;
+    mu_ = nullptr;
+  }
+  size_ = 0;
+  mu_size_ = 0;
+}
+
+bool BarrettContext::IsValid() {
+  return m_ != nullptr && size_ > 0;
+}
+
+//  mu= floor(b^(2k)/m), b= 2^64, k= digits in m.  Since m >= b^(k-1),
+//  mu has k+1 digits, k+2 only when m is a power of b.
+bool BarrettContext::Init(BigNum& m) {
+  Clear();
+  m.Normalize();
+  if (m.IsNegative() || m.IsZero()) {
+    LOG(ERROR) << "BarrettContext::Init: modulus must be positive\n";
+    return false;
+  }
+  size_ = m.size_;
+  m_ = new BigNum(m, size_ + 2);
+  mu_ = new BigNum(size_ + 3);
+
+  BigNum B(2 * size_ + 2);
+  BigNum rem(2 * size_ + 2);
+  if (!BigShift(Big_One, 2 * NBITSINUINT64 * size_, B)) {
+    LOG(ERROR) << "BigShift fails in BarrettContext::Init\n";
+    Clear();
+    return false;
+  }
+  if (!BigUnsignedEuclid(B, m, *mu_, rem)) {
+    LOG(ERROR) << "BigUnsignedEuclid fails in BarrettContext::Init\n";
+    Clear();
+    return false;
+  }
+  mu_->Normalize();
+  mu_size_ = mu_->size_;
+  return true;
+}
+
+//  r= x (mod m) for 0 <= x < b^(2k), HAC 14.42
+//    q= floor(floor(x/b^(k-1)) mu / b^(k+1))
+//    r= (x - q m) (mod b^(k+1)), then at most two subtractions of m
+bool BarrettContext::Reduce(int size_x, uint64_t* x, BigNum& r) {
+  if (!IsValid())
+    return false;
+  int k = size_;
+  size_x = DigitArrayComputedSize(size_x, x);
+  if (size_x > 2 * k || r.capacity_ < k) {
+    LOG(ERROR) << "BarrettContext::Reduce: operand too large\n";
+    return false;
+  }
+  uint64_t xx[2 * k + 1];
+  uint64_t q[2 * k + 5];
+  uint64_t t[2 * k + 5];
+  uint64_t rr[k + 1];
+  uint64_t borrow;
+  int i;
+
+  DigitArrayZeroNum(2 * k + 1, xx);
+  DigitArrayCopy(size_x, x, 2 * k + 1, xx);
+  if (size_x < k || (size_x == k && DigitArrayCompare(k, xx, k,
+                                                      m_->value_) < 0)) {
+    r.ZeroNum();
+    DigitArrayCopy(size_x, xx, r.capacity_, r.value_);
+    r.Normalize();
+    return true;
+  }
+
+  DigitArrayZeroNum(2 * k + 5, q);
+  if (DigitArrayMult(k + 1, xx + k - 1, mu_size_, mu_->value_, 2 * k + 5,
+                     q) < 0)
+    return false;
+  DigitArrayZeroNum(2 * k + 5, t);
+  if (DigitArrayMult(k + 1, q + k + 1, k, m_->value_, 2 * k + 5, t) < 0)
+    return false;
+
+  borrow = 0ULL;
+  for (i = 0; i <= k; i++) {
+    uint64_t d = xx[i] - t[i];
+    uint64_t b1 = xx[i] < t[i];
+    rr[i] = d - borrow;
+    borrow = b1 | (d < borrow);
+  }
+  while (DigitArrayCompare(k + 1, rr, k, m_->value_) >= 0) {
+    borrow = 0ULL;
+    for (i = 0; i <= k; i++) {
+      uint64_t mi = i < k ? m_->value_[i] : 0ULL;
+      uint64_t d = rr[i] - mi;
+      uint64_t b1 = rr[i] < mi;
+      rr[i] = d - borrow;
+      borrow = b1 | (d < borrow);
+    }
+  }
+  r.ZeroNum();
+  DigitArrayCopy(k, rr, r.capacity_, r.value_);
+  r.Normalize();
+  return true;
+}
+
+// r= a (mod m)
+bool BigMod(BigNum& a, BarrettContext& ctx, BigNum& r) {
+  if (!ctx.IsValid())
+    return false;
+  if (a.IsNegative() || a.size_ > 2 * ctx.size_)
+    return BigMod(a, *ctx.m_, r);
+  return ctx.Reduce(a.size_, a.value_, r);
+}
+
+// r= ab (mod m).  Like BigModMult, a and b are normalized in place.
+bool BigModMult(BigNum& a, BigNum& b, BarrettContext& ctx, BigNum& r) {
+  if (!ctx.IsValid())
+    return false;
+  if (!BigModNormalize(a, *ctx.m_))
+    return false;
+  if (!BigModNormalize(b, *ctx.m_))
+    return false;
+  int k = ctx.size_;
+  uint64_t t[2 * k + 1];
+  DigitArrayZeroNum(2 * k + 1, t);
+  if (DigitArrayMult(a.size_, a.value_, b.size_, b.value_, 2 * k + 1, t) < 0)
+    return false;
+  return ctx.Reduce(2 * k, t, r);
+}
+
+// r= a^2 (mod m)
+bool BigModSquare(BigNum& a, BarrettContext& ctx, BigNum& r) {
+  if (!ctx.IsValid())
+    return false;
+  if (!BigModNormalize(a, *ctx.m_))
+    return false;
+  int k = ctx.size_;
+  uint64_t t[2 * k + 1];
+  DigitArrayZeroNum(2 * k + 1, t);
+  if (DigitArraySquare(a.size_, a.value_, 2 * k + 1, t) < 0)
+    return false;
+  return ctx.Reduce(2 * k, t, r);
+}
+
+//  Arithmetic for the multi-exponentiations: Montgomery form for odd
+//  moduli, Barrett reduction for the rest.  r may be a or b.
+class MultiExpDomain {
+ public:
+  MontgomeryContext* mont_;
+  BarrettContext* barrett_;
+  BigNum* m_;
+
+  MultiExpDomain(MontgomeryContext* mont, BarrettContext* barrett)
+      : mont_(mont), barrett_(barrett) {
+    m_ = mont != nullptr ? mont->m_ : barrett->m_;
+  }
+  int Size() { return m_->size_ + 1; }
+  bool Mult(BigNum& a, BigNum& b, BigNum& r) {
+    if (mont_ != nullptr)
+      return mont_->MontMult(a, b, r);
+    return BigModMult(a, b, *barrett_, r);
+  }
+  bool Square(BigNum& a, BigNum& r) {
+    if (mont_ != nullptr)
+      return mont_->MontSquare(a, r);
+    return BigModSquare(a, *barrett_, r);
+  }
+  // r= a (mod m) in the domain representation
+  bool Enter(BigNum& a, BigNum& r) {
+    int n = a.capacity_ > Size() ? a.capacity_ : Size();
+    BigNum t(n + 1);
+    if (!BigMod(a, *m_, t))
+      return false;
+    if (mont_ != nullptr)
+      return mont_->ToMont(t, r);
+    r.ZeroNum();
+    return r.CopyFrom(t);
+  }
+  bool Leave(BigNum& a, BigNum& r) {
+    r.ZeroNum();
+    if (mont_ != nullptr)
+      return mont_->FromMont(a, r);
+    return r.CopyFrom(a);
+  }
+  bool One(BigNum& r) {
+    r.ZeroNum();
+    if (mont_ != nullptr)
+      return r.CopyFrom(*mont_->r_mod_m_);
+    return r.CopyFrom(Big_One) && BigModNormalize(r, *m_);
+  }
+};
+
+// bits [low, low + width) of e, positions start at 1
+static int ExpDigit(BigNum& e, int low, int width) {
+  int val = 0;
+  for (int j = low + width - 1; j >= low; j--)
+    val = (val << 1) | (BigBitPositionOn(e, j) ? 1 : 0);
+  return val;
+}
+
+// Multiplications for n bases, k bit exponents, width w tables
+static double StrausCost(int n, int k, int w) {
+  return (double)n * ((1 << w) - 2) + (double)k +
+         (double)n * ((double)k / w) * (1.0 - 1.0 / (1 << w));
+}
+
+// Multiplications for n bases, k bit exponents, c bit buckets
+static double PippengerCost(int n, int k, int c) {
+  return ((double)k / c) * ((double)n + (2 << c)) + (double)k;
+}
+
+//  acc= prod x[i]^e[i], the x[i] in domain form.  One table of
+//  x[i]^0, ..., x[i]^(2^w-1) per base, and for each w bit digit w shared
+//  squarings and a multiplication per base with a nonzero digit.
+static bool MultiExpStraus(MultiExpDomain& d, int n, BigNum** x, BigNum** e,
+                           int k, int w, BigNum& acc) {
+  int table_size = 1 << w;
+  BigNum** table = new BigNum*[n * table_size];
+  bool started = false;
+  bool ret = true;
+  int i, j, pos, val;
+
+  for (i = 0; i < n * table_size; i++)
+    table[i] = nullptr;
+  for (i = 0; ret && i < n; i++) {
+    table[i * table_size + 1] = new BigNum(d.Size());
+    table[i * table_size + 1]->CopyFrom(*x[i]);
+    for (j = 2; ret && j < table_size; j++) {
+      table[i * table_size + j] = new BigNum(d.Size());
+      ret = d.Mult(*table[i * table_size + j - 1], *x[i],
+                   *table[i * table_size + j]);
+    }
+  }
+  for (pos = ((k + w - 1) / w) - 1; ret && pos >= 0; pos--) {
+    for (j = 0; ret && started && j < w; j++)
+      ret = d.Square(acc, acc);
+    for (i = 0; ret && i < n; i++) {
+      val = ExpDigit(*e[i], pos * w + 1, w);
+      if (val == 0)
+        continue;
+      if (started) {
+        ret = d.Mult(acc, *table[i * table_size + val], acc);
+      } else {
+        acc.ZeroNum();
+        ret = acc.CopyFrom(*table[i * table_size + val]);
+        started = true;
+      }
+    }
+  }
+  if (ret && !started)
+    ret = d.One(acc);
+  for (i = 0; i < n * table_size; i++) {
+    if (table[i] != nullptr)
+      delete table[i];
+  }
+  delete []table;
+  return ret;
+}
+
+//  acc= prod x[i]^e[i], the x[i] in domain form.  For each c bit digit
+//  the bases go into bucket[digit], then with running products
+//  s= bucket[2^c-1] ... bucket[j] and t= s_(2^c-1) ... s_1,
+//  t= prod bucket[j]^j.  2^(c+1) multiplications per digit, not per base.
+static bool MultiExpPippenger(MultiExpDomain& d, int n, BigNum** x,
+                              BigNum** e, int k, int c, BigNum& acc) {
+  int num_buckets = 1 << c;
+  BigNum** bucket = new BigNum*[num_buckets];
+  bool* used = new bool[num_buckets];
+  BigNum s(d.Size());
+  BigNum t(d.Size());
+  bool started = false;
+  bool s_started, t_started;
+  bool ret = true;
+  int i, j, pos, val;
+
+  for (j = 0; j < num_buckets; j++)
+    bucket[j] = new BigNum(d.Size());
+  for (pos = ((k + c - 1) / c) - 1; ret && pos >= 0; pos--) {
+    for (j = 0; ret && started && j < c; j++)
+      ret = d.Square(acc, acc);
+    for (j = 0; j < num_buckets; j++)
+      used[j] = false;
+    for (i = 0; ret && i < n; i++) {
+      val = ExpDigit(*e[i], pos * c + 1, c);
+      if (val == 0)
+        continue;
+      if (used[val]) {
+        ret = d.Mult(*bucket[val], *x[i], *bucket[val]);
+      } else {
+        bucket[val]->ZeroNum();
+        ret = bucket[val]->CopyFrom(*x[i]);
+        used[val] = true;
+      }
+    }
+    s_started = false;
+    t_started = false;
+    for (j = num_buckets - 1; ret && j >= 1; j--) {
+      if (used[j]) {
+        if (s_started) {
+          ret = d.Mult(s, *bucket[j], s);
+        } else {
+          s.ZeroNum();
+          ret = s.CopyFrom(*bucket[j]);
+          s_started = true;
+        }
+      }
+      if (!ret || !s_started)
+        continue;
+      if (t_started) {
+        ret = d.Mult(t, s, t);
+      } else {
+        t.ZeroNum();
+        ret = t.CopyFrom(s);
+        t_started = true;
+      }
+    }
+    if (!ret || !t_started)
+      continue;
+    if (started) {
+      ret = d.Mult(acc, t, acc);
+    } else {
+      acc.ZeroNum();
+      ret = acc.CopyFrom(t);
+      started = true;
+    }
+  }
+  if (ret && !started)
+    ret = d.One(acc);
+  for (j = 0; j < num_buckets; j++)
+    delete bucket[j];
+  delete []bucket;
+  delete []used;
+  return ret;
+}
+
+static bool MultiExp(MultiExpDomain& d, int n, BigNum** b, BigNum** e,
+                     BigNum& r, int mode) {
+  int k = 0;
+  int i, w;
+
+  if (r.capacity_ < d.m_->size_) {
+    LOG(ERROR) << "MultiExp: result too small\n";
+    return false;
+  }
+  for (i = 0; i < n; i++) {
+    if (e[i]->IsNegative()) {
+      LOG(ERROR) << "MultiExp: negative exponent\n";
+      return false;
+    }
+    if (BigHighBit(*e[i]) > k)
+      k = BigHighBit(*e[i]);
+  }
+
+  // pick the cheaper evaluation and width
+  int best_w = 1;
+  int best_c = 1;
+  for (w = 2; w <= 6; w++) {
+    if (StrausCost(n, k, w) < StrausCost(n, k, best_w))
+      best_w = w;
+  }
+  for (w = 2; w <= 16; w++) {
+    if (PippengerCost(n, k, w) < PippengerCost(n, k, best_c))
+      best_c = w;
+  }
+  if (mode == BIG_MULTIEXP_AUTO)
+    mode = StrausCost(n, k, best_w) <= PippengerCost(n, k, best_c)
+               ? BIG_MULTIEXP_STRAUS
+               : BIG_MULTIEXP_PIPPENGER;
+
+  BigNum** x = new BigNum*[n];
+  BigNum acc(d.Size());
+  bool ret = true;
+  for (i = 0; i < n; i++) {
+    x[i] = new BigNum(d.Size());
+    if (ret && !d.Enter(*b[i], *x[i]))
+      ret = false;
+  }
+  if (ret) {
+    if (mode == BIG_MULTIEXP_PIPPENGER)
+      ret = MultiExpPippenger(d, n, x, e, k, best_c, acc);
+    else
+      ret = MultiExpStraus(d, n, x, e, k, best_w, acc);
+  }
+  if (ret)
+    ret = d.Leave(acc, r);
+  for (i = 0; i < n; i++)
+    delete x[i];
+  delete []x;
+  if (!ret)
+    LOG(ERROR) << "MultiExp failed\n";
+  return ret;
+}
+
+// r= b[0]^e[0] ... b[n-1]^e[n-1] (mod m), with Montgomery multiplication
+bool BigMontMultiExp(int n, BigNum** b, BigNum** e, MontgomeryContext& ctx,
+                     BigNum& r, int mode) {
+  if (!ctx.IsValid()) {
+    LOG(ERROR) << "BigMontMultiExp: invalid MontgomeryContext\n";
+    return false;
+  }
+  MultiExpDomain d(&ctx, nullptr);
+  return MultiExp(d, n, b, e, r, mode);
+}
+
+//  r= b[0]^e[0] ... b[n-1]^e[n-1] (mod m).  Montgomery multiplication when
+//  m is odd, Barrett reduction otherwise.
+bool BigModMultiExp(int n, BigNum** b, BigNum** e, BigNum& m, BigNum& r,
+                    int mode) {
+  if (m.IsZero() || m.IsNegative()) {
+    LOG(ERROR) << "BigModMultiExp: bad modulus\n";
+    return false;
+  }
+  if ((m.value_[0] & 1ULL) != 0ULL) {
+    MontgomeryContext ctx;
+    if (!ctx.Init(m))
+      return false;
+    return BigMontMultiExp(n, b, e, ctx, r, mode);
+  }
+  BarrettContext ctx;
+  if (!ctx.Init(m))
+    return false;
+  MultiExpDomain d(nullptr, &ctx);
+  return MultiExp(d, n, b, e, r, mode);
+}
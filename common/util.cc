@@ -23,6 +23,53 @@
 #include <fstream>
 #include <time.h>
 #include <sys/types.h>
+// AVX2 is leaf 7, ebx bit 5.  The OS must also save the ymm registers:
+// leaf 1, ecx bit 27 (OSXSAVE) and XCR0 bits 1 and 2.
+bool HaveAvx2() {
+  uint32_t arg = 1;
+  uint32_t max_leaf;
+  uint32_t features;
+  uint32_t xcr0;
+
+  asm volatile(
+      "\txorl    %%eax, %%eax\n"
+      "\tcpuid\n"
+      "\tmovl    %%eax, %[max_leaf]\n"
+      : [max_leaf] "=m"(max_leaf)
+      :
+      : "%eax", "%ebx", "%ecx", "%edx");
+  if (max_leaf < 7)
+    return false;
+  asm volatile(
+      "\tmovl    %[arg], %%eax\n"
+      "\tcpuid\n"
+      "\tmovl    %%ecx, %[features]\n"
+      : [features] "=m"(features)
+      : [arg] "m"(arg)
+      : "%eax", "%ebx", "%ecx", "%edx");
+  if (((features >> 27) & 1) == 0)
+    return false;
+  asm volatile(
+      "\txorl    %%ecx, %%ecx\n"
+      "\txgetbv\n"
+      "\tmovl    %%eax, %[xcr0]\n"
+      : [xcr0] "=m"(xcr0)
+      :
+      : "%eax", "%ecx", "%edx");
+  if ((xcr0 & 6) != 6)
+    return false;
+  arg = 7;
+  asm volatile(
+      "\tmovl    %[arg], %%eax\n"
+      "\txorl    %%ecx, %%ecx\n"
+      "\tcpuid\n"
+      "\tmovl    %%ebx, %[features]\n"
+      : [features] "=m"(features)
+      : [arg] "m"(arg)
+      : "%eax", "%ebx", "%ecx", "%edx");
+  return ((features >> 5) & 1) != 0;
+}
+
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -95,6 +142,36 @@ bool HaveAesNi() {
   return false;
 }
 
+// mulx (BMI2) and adcx/adox (ADX) are leaf 7, ebx bits 8 and 19
+bool HaveBmi2Adx() {
+  uint32_t arg = 7;
+  uint32_t max_leaf;
+  uint32_t extended_features;
+
+  asm volatile(
+      "\txorl    %%eax, %%eax\n"
+      "\tcpuid\n"
+      "\tmovl    %%eax, %[max_leaf]\n"
+      : [max_leaf] "=m"(max_leaf)
+      :
+      : "%eax", "%ebx", "%ecx", "%edx");
+  if (max_leaf < 7)
+    return false;
+  asm volatile(
+      "\tmovl    %[arg], %%eax\n"
+      "\txorl    %%ecx, %%ecx\n"
+      "\tcpuid\n"
+      "\tmovl    %%ebx, %[extended_features]\n"
+      : [extended_features] "=m"(extended_features)
+      : [arg] "m"(arg)
+      : "%eax", "%ebx", "%ecx", "%edx");
+  if (((extended_features >> 8) & 1) != 0 &&
+      ((extended_features >> 19) & 1) != 0) {
+    return true;
+  }
+  return false;
+}
+
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
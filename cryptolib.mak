@@ -53,8 +53,8 @@ endif
 
 dobj=	$(O)/bignum.o $(O)/basic_arith.o $(O)/number_theory.o $(O)/arith64.o \
 	$(O)/intel64_arith.o $(O)/globals.o $(O)/util.o $(O)/conversions.o \
-	$(O)/smallprimes.o $(O)/ecc.o $(O)/rsa.o $(O)/keys.o $(O)/keys.pb.o \
-	$(O)/symmetric_cipher.o $(O)/aes.o $(O)/sha1.o $(O)/sha256.o \
+	$(O)/smallprimes.o $(O)/ecc.o $(O)/p256.o $(O)/ecdsa.o $(O)/rsa.o $(O)/keys.o \
+	$(O)/keys.pb.o $(O)/symmetric_cipher.o $(O)/aes.o $(O)/sha1.o $(O)/sha256.o \
 	$(O)/aesni.o $(O)/hash.o $(O)/hmac_sha256.o $(O)/sha3.o $(O)/twofish.o \
 	$(O)/encryption_algorithm.o $(O)/sha256.o $(O)/aescbchmac256sympad.o \
         $(O)/aesgcm.o $(O)/aesctrhmac256sympad.o $(O)/pkcs.o $(O)/pbkdf2.o \
@@ -127,6 +127,14 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
+$(O)/ecdsa.o: $(SRC_DIR)/ecc/ecdsa.cc
+	@echo "compiling ecdsa.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/ecdsa.o $(SRC_DIR)/ecc/ecdsa.cc
+
 $(O)/rsa.o: $(SRC_DIR)/rsa/rsa.cc
 	@echo "compiling rsa.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/rsa.o $(SRC_DIR)/rsa/rsa.cc
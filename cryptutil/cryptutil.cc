@@ -146,6 +146,7 @@ DEFINE_string(pass, "password", "password");
 DEFINE_string(purpose, "channel-encryption", "purpose");
 DEFINE_string(owner, "NoOne", "purpose");
 DEFINE_int32(size, 128, "size");
+DEFINE_int32(num_primes, 2, "number of RSA primes");
 DEFINE_string(hash_file, "", "file to hash");
 DEFINE_string(hash_alg, "sha-256", "hash alg");
 DEFINE_string(sig_file, "", "signature");
@@ -611,7 +612,7 @@ RsaKey* GenRsaKey(int num_bits, const char* durationStr, const char* keyName,
   double duration = convertDuration(durationStr);
   RsaKey* new_key = new RsaKey();
   if (!new_key->GenerateRsaKey(keyName, purposeStr, ownerStr, num_bits,
-                               duration)) {
+                               duration, FLAGS_num_primes)) {
     return nullptr;
   }
   crypto_key_message* message = new crypto_key_message;
@@ -1787,10 +1788,21 @@ int main(int an, char** av) {
     BigNum a(2 + size / sizeof(uint64_t));
     memcpy(a.value_, out, size);
     a.Normalize();
-    string* str = BigConvertToDecimal(a);
-    printf("Decimal: %s\n", str->c_str());
+    if (FLAGS_output_file != "") {
+      WriteFile writer;
+      if (!writer.Init(FLAGS_output_file.c_str()) ||
+          !BigConvertToDecimalFile(a, &writer)) {
+        printf("Can't write %s\n", FLAGS_output_file.c_str());
+        delete out;
+        return 1;
+      }
+      writer.Close();
+    } else {
+      string* str = BigConvertToDecimal(a);
+      printf("Decimal: %s\n", str->c_str());
+      if (str != nullptr) delete str;
+    }
     delete out;
-    if (str != nullptr) delete str;
   } else if ("ToHex" == FLAGS_operation) {
     int size = 0;
     byte* out = nullptr;
@@ -17,6 +17,7 @@
 #include "cryptotypes.h"
 #include "bignum.h"
 #include "ecc.h"
+#include "p256.h"
 #include "keys.h"
 #include "keys.pb.h"
 #include "intel64_arith.h"
@@ -117,10 +118,38 @@ CurvePoint::CurvePoint(CurvePoint& P, int capacity) {
   z_->CopyFrom(*P.z_);
 }
 
+CurvePoint::CurvePoint(CurvePoint&& P) {
+  x_ = P.x_;
+  y_ = P.y_;
+  z_ = P.z_;
+  P.x_ = nullptr;
+  P.y_ = nullptr;
+  P.z_ = nullptr;
+}
+
+CurvePoint& CurvePoint::operator=(CurvePoint&& P) {
+  Swap(P);
+  return *this;
+}
+
+void CurvePoint::Swap(CurvePoint& P) {
+  BigNum* t;
+
+  t = x_;
+  x_ = P.x_;
+  P.x_ = t;
+  t = y_;
+  y_ = P.y_;
+  P.y_ = t;
+  t = z_;
+  z_ = P.z_;
+  P.z_ = t;
+}
+
 void CurvePoint::Clear() {
   if (x_ != nullptr) x_->ZeroNum();
   if (y_ != nullptr) y_->ZeroNum();
-  if (x_ != nullptr) z_->ZeroNum();
+  if (z_ != nullptr) z_->ZeroNum();
 }
 
 bool CurvePoint::Normalize(BigNum& p) {
@@ -145,12 +174,16 @@ EccCurve::EccCurve() {
   a_ = nullptr;
   b_ = nullptr;
   p_ = nullptr;
+  mont_ = nullptr;
+  barrett_ = nullptr;
 }
 
 EccCurve::EccCurve(int size) {
   a_ = new BigNum(size);
   b_ = new BigNum(size);
   p_ = new BigNum(size);
+  mont_ = nullptr;
+  barrett_ = nullptr;
 }
 
 EccCurve::EccCurve(BigNum& a, BigNum& b, BigNum& p) {
@@ -160,6 +193,9 @@ EccCurve::EccCurve(BigNum& a, BigNum& b, BigNum& p) {
   b_->CopyFrom(b);
   p_ = new BigNum(p.capacity_);
   p_->CopyFrom(p);
+  mont_ = nullptr;
+  barrett_ = nullptr;
+  InitContexts();
 }
 
 EccCurve::~EccCurve() {
@@ -185,6 +221,55 @@ void EccCurve::Clear() {
   if (a_ != nullptr) a_->ZeroNum();
   if (b_ != nullptr) b_->ZeroNum();
   if (p_ != nullptr) p_->ZeroNum();
+  ClearContexts();
+}
+
+void EccCurve::ClearContexts() {
+  if (mont_ != nullptr) {
+    delete mont_;
+    mont_ = nullptr;
+  }
+  if (barrett_ != nullptr) {
+    delete barrett_;
+    barrett_ = nullptr;
+  }
+}
+
+// Rebuilds the contexts for p_, call whenever p_ is set.  The accessors
+// below only read them, so a shared curve needs no lock.
+bool EccCurve::InitContexts() {
+  ClearContexts();
+  if (p_ == nullptr || p_->IsZero())
+    return false;
+  barrett_ = new BarrettContext();
+  if (!barrett_->Init(*p_)) {
+    LOG(ERROR) << "EccCurve::InitContexts: can't build BarrettContext\n";
+    ClearContexts();
+    return false;
+  }
+  // Montgomery needs p odd
+  if ((p_->value_[0] & 1ULL) != 0ULL) {
+    mont_ = new MontgomeryContext();
+    if (!mont_->Init(*p_)) {
+      delete mont_;
+      mont_ = nullptr;
+    }
+  }
+  return true;
+}
+
+// Montgomery context for p, shared by every operation on this curve
+MontgomeryContext* EccCurve::MontContext() {
+  if (mont_ == nullptr || !mont_->IsValid())
+    return nullptr;
+  return mont_;
+}
+
+// Barrett context for p, for the affine and projective formulas
+BarrettContext* EccCurve::BarrettCtx() {
+  if (barrett_ == nullptr || !barrett_->IsValid())
+    return nullptr;
+  return barrett_;
 }
 
 void EccCurve::PrintCurve() {
@@ -212,8 +297,23 @@ bool EccEmbed(EccCurve& c, BigNum& m, CurvePoint& P, int shift, int trys) {
   BigNum t1(2 * c.p_->capacity_);
   BigNum t2(2 * c.p_->capacity_);
   BigNum t3(2 * c.p_->capacity_);
+  BigNum root_exp(2 * c.p_->capacity_);
   int i;
 
+  // p= 3 (mod 4): y= t^((p+1)/4) is a root of t exactly when t is a square,
+  // so one exponentiation replaces the residue test and the square root.
+  MontgomeryContext* mont = nullptr;
+  if ((c.p_->value_[0] & 3ULL) == 3ULL) {
+    mont = c.MontContext();
+    if (mont != nullptr) {
+      if (!BigUnsignedAdd(*c.p_, Big_One, t1) || !BigShift(t1, -2, root_exp)) {
+        LOG(ERROR) << "can't compute root exponent in EccEmbed\n";
+        return false;
+      }
+      t1.ZeroNum();
+    }
+  }
+
   if (!BigShift(m, shift, m_x)) {
     LOG(ERROR) << "BigShift failed in EccEmbed\n";
     return false;
@@ -246,7 +346,25 @@ bool EccEmbed(EccCurve& c, BigNum& m, CurvePoint& P, int shift, int trys) {
       LOG(ERROR) << "BigModAdd failed in EccEmbed\n";
       return false;
     }
-    if (BigModIsSquare(t1, *c.p_)) {
+    if (mont != nullptr) {
+      t2.ZeroNum();
+      t3.ZeroNum();
+      if (!BigMontExp(t1, root_exp, *mont, t2)) {
+        LOG(ERROR) << "BigMontExp failed in EccEmbed\n";
+        return false;
+      }
+      if (!BigModMult(t2, t2, *c.p_, t3)) {
+        LOG(ERROR) << "BigModMult failed in EccEmbed\n";
+        return false;
+      }
+      if (BigCompare(t3, t1) == 0) {
+        P.y_->CopyFrom(t2);
+        P.x_->CopyFrom(m_x);
+        P.z_->ZeroNum();
+        P.z_->value_[0] = 1ULL;
+        break;
+      }
+    } else if (BigModIsSquare(t1, *c.p_)) {
       if (!BigModSquareRoot(t1, *c.p_, *P.y_)) {
         LOG(ERROR) << "BigModSquareRoot failed in EccEmbed\n";
         return false;
@@ -342,10 +460,14 @@ bool EccAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
   if (Q.IsZero()) {
     return P.CopyTo(R);
   }
-  BigNum m(2 * c.p_->size_);
-  BigNum t1(2 * c.p_->size_);
-  BigNum t2(2 * c.p_->size_);
-  BigNum t3(2 * c.p_->size_);
+  ScratchFrame frame;
+  BigNum m(2 * c.p_->size_, frame);
+  BigNum t1(2 * c.p_->size_, frame);
+  BigNum t2(2 * c.p_->size_, frame);
+  BigNum t3(2 * c.p_->size_, frame);
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
 
   R.z_->CopyFrom(Big_One);
   if (BigCompare(*P.x_, *Q.x_) != 0) {
@@ -366,10 +488,10 @@ bool EccAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
       R.MakeZero();
       return true;
     }
-    if (!BigModMult(*P.x_, *P.x_, *c.p_, t3)) {
+    if (!BigModMult(*P.x_, *P.x_, *barrett, t3)) {
       return false;
     }
-    if (!BigModMult(Big_Three, t3, *c.p_, t2)) {
+    if (!BigModMult(Big_Three, t3, *barrett, t2)) {
       return false;
     }
     t3.ZeroNum();
@@ -382,7 +504,7 @@ bool EccAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
   }
   t1.ZeroNum();
   t2.ZeroNum();
-  if (!BigModMult(m, m, *c.p_, t1)) {
+  if (!BigModMult(m, m, *barrett, t1)) {
     return false;
   }
   if (!BigModSub(t1, *P.x_, *c.p_, t2)) {
@@ -397,7 +519,7 @@ bool EccAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
   if (!BigModSub(*P.x_, *R.x_, *c.p_, t1)) {
     return false;
   }
-  if (!BigModMult(m, t1, *c.p_, t2)) {
+  if (!BigModMult(m, t1, *barrett, t2)) {
     return false;
   }
   if (!BigModSub(t2, *P.y_, *c.p_, *R.y_)) {
@@ -444,6 +566,9 @@ bool EccDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
 //
 
 bool ProjectiveToAffine(EccCurve& c, CurvePoint& P) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
   BigNum x(1 + 2 * c.p_->size_);
   BigNum y(1 + 2 * c.p_->size_);
   BigNum zinv(1 + 2 * c.p_->size_);
@@ -453,15 +578,16 @@ bool ProjectiveToAffine(EccCurve& c, CurvePoint& P) {
     return true;
   }
   if (P.z_->IsOne()) return true;
-  if (!BigModInv(*P.z_, *c.p_, zinv)) {
+  // z depends on the scalar in ProjectivePointMult
+  if (!BigModInv(*P.z_, *c.p_, zinv, BIG_MODINV_CONSTTIME)) {
     LOG(ERROR) << "ProjectiveToAffine can't BigModInv\n";
     return false;
   }
-  if (!BigModMult(*P.x_, zinv, *c.p_, x)) {
+  if (!BigModMult(*P.x_, zinv, *barrett, x)) {
     LOG(ERROR) << "ProjectiveToAffine BigModMult(2) failed\n";
     return false;
   }
-  if (!BigModMult(*P.y_, zinv, *c.p_, y)) {
+  if (!BigModMult(*P.y_, zinv, *barrett, y)) {
     LOG(ERROR) << "ProjectiveToAffine BigModMult(3) failed\n";
     return false;
   }
@@ -471,22 +597,86 @@ bool ProjectiveToAffine(EccCurve& c, CurvePoint& P) {
   return true;
 }
 
+//  ProjectiveToAffine on n points with one inversion, see BigModInvBatch
+bool ProjectiveToAffineBatch(EccCurve& c, int n, CurvePoint** P) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
+  if (n <= 0)
+    return true;
+
+  int size = 1 + 2 * c.p_->size_;
+  BigNum** z = new BigNum*[n];
+  BigNum** zinv = new BigNum*[n];
+  int* index = new int[n];
+  ScratchFrame frame;
+  BigNum x(size, frame);
+  BigNum y(size, frame);
+  bool ret = true;
+  int i;
+  int k = 0;
+
+  for (i = 0; i < n; i++) {
+    if (P[i]->z_->IsZero()) {
+      P[i]->MakeZero();
+      continue;
+    }
+    if (P[i]->z_->IsOne())
+      continue;
+    z[k] = P[i]->z_;
+    zinv[k] = new BigNum(size, frame);
+    index[k++] = i;
+  }
+  // z depends on the scalar in ProjectivePointMult
+  if (!BigModInvBatch(k, z, *c.p_, zinv, BIG_MODINV_CONSTTIME)) {
+    LOG(ERROR) << "ProjectiveToAffineBatch can't BigModInvBatch\n";
+    ret = false;
+    goto done;
+  }
+  for (i = 0; i < k; i++) {
+    CurvePoint* Q = P[index[i]];
+    x.ZeroNum();
+    y.ZeroNum();
+    if (!BigModMult(*Q->x_, *zinv[i], *barrett, x) ||
+        !BigModMult(*Q->y_, *zinv[i], *barrett, y)) {
+      LOG(ERROR) << "ProjectiveToAffineBatch BigModMult failed\n";
+      ret = false;
+      goto done;
+    }
+    Q->x_->CopyFrom(x);
+    Q->y_->CopyFrom(y);
+    Q->z_->CopyFrom(Big_One);
+  }
+
+done:
+  for (i = 0; i < k; i++)
+    delete zinv[i];
+  delete []zinv;
+  delete []z;
+  delete []index;
+  return ret;
+}
+
 bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
-  BigNum u(1 + 2 * c.p_->size_);
-  BigNum v(1 + 2 * c.p_->size_);
-  BigNum A(1 + 2 * c.p_->size_);
-  BigNum u_squared(1 + 2 * c.p_->size_);
-  BigNum v_squared(1 + 2 * c.p_->size_);
-  BigNum w(1 + 2 * c.p_->size_);
-  BigNum t(1 + 2 * c.p_->size_);
-  BigNum t1(1 + 2 * c.p_->size_);
-  BigNum t2(1 + 2 * c.p_->size_);
-  BigNum t3(1 + 2 * c.p_->size_);
-  BigNum t4(1 + 2 * c.p_->size_);
-  BigNum a1(1 + 2 * c.p_->size_);
-  BigNum a2(1 + 2 * c.p_->size_);
-  BigNum b1(1 + 2 * c.p_->size_);
-  BigNum b2(1 + 2 * c.p_->size_);
+  ScratchFrame frame;
+  BigNum u(1 + 2 * c.p_->size_, frame);
+  BigNum v(1 + 2 * c.p_->size_, frame);
+  BigNum A(1 + 2 * c.p_->size_, frame);
+  BigNum u_squared(1 + 2 * c.p_->size_, frame);
+  BigNum v_squared(1 + 2 * c.p_->size_, frame);
+  BigNum w(1 + 2 * c.p_->size_, frame);
+  BigNum t(1 + 2 * c.p_->size_, frame);
+  BigNum t1(1 + 2 * c.p_->size_, frame);
+  BigNum t2(1 + 2 * c.p_->size_, frame);
+  BigNum t3(1 + 2 * c.p_->size_, frame);
+  BigNum t4(1 + 2 * c.p_->size_, frame);
+  BigNum a1(1 + 2 * c.p_->size_, frame);
+  BigNum a2(1 + 2 * c.p_->size_, frame);
+  BigNum b1(1 + 2 * c.p_->size_, frame);
+  BigNum b2(1 + 2 * c.p_->size_, frame);
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
 
   // If P=O, Q
   if (P.z_->IsZero()) {
@@ -498,19 +688,19 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
     R.CopyFrom(P);
     return true;
   }
-  if (!BigModMult(*P.x_, *Q.z_, *c.p_, a1)) {
+  if (!BigModMult(*P.x_, *Q.z_, *barrett, a1)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*P.y_, *Q.z_, *c.p_, a2)) {
+  if (!BigModMult(*P.y_, *Q.z_, *barrett, a2)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*Q.x_, *P.z_, *c.p_, b1)) {
+  if (!BigModMult(*Q.x_, *P.z_, *barrett, b1)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*Q.y_, *P.z_, *c.p_, b2)) {
+  if (!BigModMult(*Q.y_, *P.z_, *barrett, b2)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -529,11 +719,11 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
   }
 
   // u= y2z1-y1z2
-  if (!BigModMult(*Q.y_, *P.z_, *c.p_, t)) {
+  if (!BigModMult(*Q.y_, *P.z_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*P.y_, *Q.z_, *c.p_, w)) {
+  if (!BigModMult(*P.y_, *Q.z_, *barrett, w)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -542,11 +732,11 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
     return false;
   }
   // v=x2z1-x1z2
-  if (!BigModMult(*Q.x_, *P.z_, *c.p_, t)) {
+  if (!BigModMult(*Q.x_, *P.z_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*P.x_, *Q.z_, *c.p_, w)) {
+  if (!BigModMult(*P.x_, *Q.z_, *barrett, w)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -555,31 +745,31 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
     return false;
   }
   // A= u^2z1z2-v^3-2v^2x1z2
-  if (!BigModMult(u, u, *c.p_, u_squared)) {
+  if (!BigModMult(u, u, *barrett, u_squared)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(v, v, *c.p_, v_squared)) {
+  if (!BigModMult(v, v, *barrett, v_squared)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(u_squared, *P.z_, *c.p_, t)) {
+  if (!BigModMult(u_squared, *P.z_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(t, *Q.z_, *c.p_, t1)) {
+  if (!BigModMult(t, *Q.z_, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(v_squared, v, *c.p_, t2)) {
+  if (!BigModMult(v_squared, v, *barrett, t2)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(v_squared, *P.x_, *c.p_, t)) {
+  if (!BigModMult(v_squared, *P.x_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(t, *Q.z_, *c.p_, t4)) {
+  if (!BigModMult(t, *Q.z_, *barrett, t4)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -598,16 +788,16 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
     return false;
   }
   // x3= vA
-  if (!BigModMult(v, A, *c.p_, *R.x_)) {
+  if (!BigModMult(v, A, *barrett, *R.x_)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
   // z3= v^3z1z2
-  if (!BigModMult(*P.z_, *Q.z_, *c.p_, t)) {
+  if (!BigModMult(*P.z_, *Q.z_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(t, t2, *c.p_, *R.z_)) {
+  if (!BigModMult(t, t2, *barrett, *R.z_)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -617,15 +807,15 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
     LOG(ERROR) << "ProjectiveAdd BigModSub(x) failed\n";
     return false;
   }
-  if (!BigModMult(t, u, *c.p_, w)) {
+  if (!BigModMult(t, u, *barrett, w)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(t2, *P.y_, *c.p_, t)) {
+  if (!BigModMult(t2, *P.y_, *barrett, t)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(t, *Q.z_, *c.p_, t4)) {
+  if (!BigModMult(t, *Q.z_, *barrett, t4)) {
     LOG(ERROR) << "ProjectiveAdd BigModMult(x) failed\n";
     return false;
   }
@@ -637,33 +827,37 @@ bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
 }
 
 bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
-  BigNum w(1 + 2 * c.p_->size_);
-  BigNum w_squared(1 + 2 * c.p_->size_);
-  BigNum s(1 + 2 * c.p_->size_);
-  BigNum s_squared(1 + 2 * c.p_->size_);
-  BigNum h(1 + 2 * c.p_->size_);
-  BigNum B(1 + 2 * c.p_->size_);
-  BigNum t1(1 + 2 * c.p_->size_);
-  BigNum t2(1 + 2 * c.p_->size_);
-  BigNum t3(1 + 2 * c.p_->size_);
-  BigNum z1_squared(1 + 2 * c.p_->size_);
-  BigNum x1_squared(1 + 2 * c.p_->size_);
-  BigNum y1_squared(1 + 2 * c.p_->size_);
+  ScratchFrame frame;
+  BigNum w(1 + 2 * c.p_->size_, frame);
+  BigNum w_squared(1 + 2 * c.p_->size_, frame);
+  BigNum s(1 + 2 * c.p_->size_, frame);
+  BigNum s_squared(1 + 2 * c.p_->size_, frame);
+  BigNum h(1 + 2 * c.p_->size_, frame);
+  BigNum B(1 + 2 * c.p_->size_, frame);
+  BigNum t1(1 + 2 * c.p_->size_, frame);
+  BigNum t2(1 + 2 * c.p_->size_, frame);
+  BigNum t3(1 + 2 * c.p_->size_, frame);
+  BigNum z1_squared(1 + 2 * c.p_->size_, frame);
+  BigNum x1_squared(1 + 2 * c.p_->size_, frame);
+  BigNum y1_squared(1 + 2 * c.p_->size_, frame);
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
 
   // w=az1^2+3x1^2
-  if (!BigModMult(*P.z_, *P.z_, *c.p_, z1_squared)) {
+  if (!BigModMult(*P.z_, *P.z_, *barrett, z1_squared)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*P.x_, *P.x_, *c.p_, x1_squared)) {
+  if (!BigModMult(*P.x_, *P.x_, *barrett, x1_squared)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(*c.a_, z1_squared, *c.p_, t1)) {
+  if (!BigModMult(*c.a_, z1_squared, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(Big_Three, x1_squared, *c.p_, t2)) {
+  if (!BigModMult(Big_Three, x1_squared, *barrett, t2)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -672,21 +866,21 @@ bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
     return false;
   }
   // s=y1z1
-  if (!BigModMult(*P.y_, *P.z_, *c.p_, s)) {
+  if (!BigModMult(*P.y_, *P.z_, *barrett, s)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
   // B= x1y1s
-  if (!BigModMult(*P.x_, *P.y_, *c.p_, t1)) {
+  if (!BigModMult(*P.x_, *P.y_, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(s, t1, *c.p_, B)) {
+  if (!BigModMult(s, t1, *barrett, B)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
   // h= w^2-8B
-  if (!BigModMult(w, w, *c.p_, w_squared)) {
+  if (!BigModMult(w, w, *barrett, w_squared)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -703,7 +897,7 @@ bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
 
   // x3=2hs
   t1.ZeroNum();
-  if (!BigModMult(h, s, *c.p_, t1)) {
+  if (!BigModMult(h, s, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -716,11 +910,11 @@ bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
   R.x_->CopyFrom(t2);
 
   // z3= 8s^3
-  if (!BigModMult(s, s, *c.p_, s_squared)) {
+  if (!BigModMult(s, s, *barrett, s_squared)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(s_squared, s, *c.p_, t1)) {
+  if (!BigModMult(s_squared, s, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -733,7 +927,7 @@ bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
   R.z_->CopyFrom(t2);
 
   // y3= w(4B-h) -8y1^2s^2
-  if (!BigModMult(*P.y_, *P.y_, *c.p_, y1_squared)) {
+  if (!BigModMult(*P.y_, *P.y_, *barrett, y1_squared)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -749,11 +943,11 @@ bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
     return false;
   }
   t1.ZeroNum();
-  if (!BigModMult(w, t2, *c.p_, t1)) {
+  if (!BigModMult(w, t2, *barrett, t1)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
-  if (!BigModMult(s_squared, y1_squared, *c.p_, t2)) {
+  if (!BigModMult(s_squared, y1_squared, *barrett, t2)) {
     LOG(ERROR) << "ProjectiveDouble BigModMult(x) failed\n";
     return false;
   }
@@ -792,19 +986,16 @@ bool ProjectivePointMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R) {
   for (i = 1; i < k; i++) {
     if (BigBitPositionOn(x, i)) {
       ProjectiveAdd(c, accum_point, double_point, t1);
-      t1.CopyTo(accum_point);
-      t1.MakeZero();
+      accum_point.Swap(t1);
     }
     if (!ProjectiveDouble(c, double_point, t1)) {
       return false;
     }
-    t1.CopyTo(double_point);
-    t1.MakeZero();
+    double_point.Swap(t1);
   }
   if (BigBitPositionOn(x, i)) {
     ProjectiveAdd(c, accum_point, double_point, t1);
-    t1.CopyTo(accum_point);
-    t1.MakeZero();
+    accum_point.Swap(t1);
   }
 
   accum_point.CopyTo(R);
@@ -814,6 +1005,863 @@ bool ProjectivePointMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R) {
   return true;
 }
 
+//  Jacobian coordinates, x= X/Z^2, y= Y/Z^3, Z= 0 is the point at
+//  infinity.  Formulas from the explicit formula database,
+//  hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html:
+//    dbl-2001-b when a= -3, dbl-2007-bl otherwise,
+//    add-2007-bl, and madd-2007-bl when the second point is affine.
+
+// True if a= -3 (mod p), as on the NIST curves
+static bool CurveAIsMinusThree(EccCurve& c) {
+  BigNum t(1 + c.p_->size_);
+  if (!BigSub(*c.p_, Big_Three, t))
+    return false;
+  return BigCompare(t, *c.a_) == 0;
+}
+
+bool JacobianDouble(EccCurve& c, CurvePoint& P, CurvePoint& R) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
+  if (P.z_->IsZero() || P.y_->IsZero()) {
+    R.MakeZero();
+    return true;
+  }
+
+  ScratchFrame frame;
+  int size = 1 + 2 * c.p_->size_;
+  BigNum& p = *c.p_;
+  BigNum zz(size, frame);
+  BigNum yy(size, frame);
+  BigNum beta(size, frame);
+  BigNum m(size, frame);
+  BigNum t1(size, frame);
+  BigNum t2(size, frame);
+  BigNum t3(size, frame);
+
+  // zz= Z^2, yy= Y^2, beta= XY^2
+  if (!BigModSquare(*P.z_, *barrett, zz) ||
+      !BigModSquare(*P.y_, *barrett, yy) ||
+      !BigModMult(*P.x_, yy, *barrett, beta)) {
+    LOG(ERROR) << "JacobianDouble BigModMult failed\n";
+    return false;
+  }
+  if (CurveAIsMinusThree(c)) {
+    // m= 3(X-zz)(X+zz)
+    if (!BigModSub(*P.x_, zz, p, t1) || !BigModAdd(*P.x_, zz, p, t2) ||
+        !BigModMult(t1, t2, *barrett, t3) || !BigModAdd(t3, t3, p, t1) ||
+        !BigModAdd(t1, t3, p, m)) {
+      LOG(ERROR) << "JacobianDouble m failed\n";
+      return false;
+    }
+  } else {
+    // m= 3X^2+a zz^2
+    if (!BigModSquare(*P.x_, *barrett, t1) || !BigModAdd(t1, t1, p, t2) ||
+        !BigModAdd(t2, t1, p, t3) || !BigModSquare(zz, *barrett, t1) ||
+        !BigModMult(*c.a_, t1, *barrett, t2) ||
+        !BigModAdd(t3, t2, p, m)) {
+      LOG(ERROR) << "JacobianDouble m failed\n";
+      return false;
+    }
+  }
+  // Z3= (Y+Z)^2-yy-zz, before X and Y since R may be P
+  if (!BigModAdd(*P.y_, *P.z_, p, t1) ||
+      !BigModSquare(t1, *barrett, t2) || !BigModSub(t2, yy, p, t3) ||
+      !BigModSub(t3, zz, p, *R.z_)) {
+    LOG(ERROR) << "JacobianDouble Z failed\n";
+    return false;
+  }
+  // X3= m^2-8 beta
+  if (!BigModAdd(beta, beta, p, t1) || !BigModAdd(t1, t1, p, t2) ||
+      !BigModAdd(t2, t2, p, zz) || !BigModSquare(m, *barrett, t1) ||
+      !BigModSub(t1, zz, p, *R.x_)) {
+    LOG(ERROR) << "JacobianDouble X failed\n";
+    return false;
+  }
+  // Y3= m(4 beta-X3)-8 yy^2
+  if (!BigModSub(t2, *R.x_, p, t1) || !BigModMult(m, t1, *barrett, t3) ||
+      !BigModSquare(yy, *barrett, t1) || !BigModAdd(t1, t1, p, t2) ||
+      !BigModAdd(t2, t2, p, t1) || !BigModAdd(t1, t1, p, t2) ||
+      !BigModSub(t3, t2, p, *R.y_)) {
+    LOG(ERROR) << "JacobianDouble Y failed\n";
+    return false;
+  }
+  return true;
+}
+
+//  R= 2^n P, all in Jacobian coordinates
+bool JacobianDoubleN(EccCurve& c, CurvePoint& P, int n, CurvePoint& R) {
+  if (!R.CopyFrom(P))
+    return false;
+  for (int i = 0; i < n; i++) {
+    if (!JacobianDouble(c, R, R))
+      return false;
+  }
+  return true;
+}
+
+//  R= P+Q.  Q is affine if mixed is true, which saves 4 multiplies.
+static bool JacobianAddInternal(EccCurve& c, CurvePoint& P, CurvePoint& Q,
+                                bool mixed, CurvePoint& R) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
+  // R may be P or Q
+  if (Q.z_->IsZero())
+    return &R == &P || R.CopyFrom(P);
+  if (P.z_->IsZero())
+    return &R == &Q || R.CopyFrom(Q);
+
+  ScratchFrame frame;
+  int size = 1 + 2 * c.p_->size_;
+  BigNum& p = *c.p_;
+  BigNum z1z1(size, frame);
+  BigNum z2z2(size, frame);
+  BigNum u1(size, frame);
+  BigNum u2(size, frame);
+  BigNum s1(size, frame);
+  BigNum s2(size, frame);
+  BigNum h(size, frame);
+  BigNum r(size, frame);
+  BigNum i(size, frame);
+  BigNum j(size, frame);
+  BigNum v(size, frame);
+  BigNum t1(size, frame);
+  BigNum t2(size, frame);
+
+  // u1= X1 Z2^2, u2= X2 Z1^2, s1= Y1 Z2^3, s2= Y2 Z1^3
+  if (!BigModSquare(*P.z_, *barrett, z1z1) ||
+      !BigModMult(*Q.x_, z1z1, *barrett, u2) ||
+      !BigModMult(*P.z_, z1z1, *barrett, t1) ||
+      !BigModMult(*Q.y_, t1, *barrett, s2)) {
+    LOG(ERROR) << "JacobianAdd BigModMult failed\n";
+    return false;
+  }
+  if (mixed) {
+    u1.CopyFrom(*P.x_);
+    s1.CopyFrom(*P.y_);
+  } else if (!BigModSquare(*Q.z_, *barrett, z2z2) ||
+             !BigModMult(*P.x_, z2z2, *barrett, u1) ||
+             !BigModMult(*Q.z_, z2z2, *barrett, t1) ||
+             !BigModMult(*P.y_, t1, *barrett, s1)) {
+    LOG(ERROR) << "JacobianAdd BigModMult failed\n";
+    return false;
+  }
+  if (!BigModSub(u2, u1, p, h) || !BigModSub(s2, s1, p, t1) ||
+      !BigModAdd(t1, t1, p, r)) {
+    LOG(ERROR) << "JacobianAdd BigModSub failed\n";
+    return false;
+  }
+  if (h.IsZero()) {
+    if (r.IsZero())
+      return JacobianDouble(c, P, R);
+    R.MakeZero();
+    return true;
+  }
+  // Z3= ((Z1+Z2)^2-z1z1-z2z2)h, 2 Z1 h if Z2= 1
+  if (mixed) {
+    if (!BigModAdd(*P.z_, *P.z_, p, t1) ||
+        !BigModMult(t1, h, *barrett, *R.z_)) {
+      LOG(ERROR) << "JacobianAdd Z failed\n";
+      return false;
+    }
+  } else if (!BigModAdd(*P.z_, *Q.z_, p, t1) ||
+             !BigModSquare(t1, *barrett, t2) ||
+             !BigModSub(t2, z1z1, p, t1) || !BigModSub(t1, z2z2, p, t2) ||
+             !BigModMult(t2, h, *barrett, *R.z_)) {
+    LOG(ERROR) << "JacobianAdd Z failed\n";
+    return false;
+  }
+  // i= (2h)^2, j= hi, v= u1 i
+  if (!BigModAdd(h, h, p, t1) || !BigModSquare(t1, *barrett, i) ||
+      !BigModMult(h, i, *barrett, j) || !BigModMult(u1, i, *barrett, v)) {
+    LOG(ERROR) << "JacobianAdd BigModMult failed\n";
+    return false;
+  }
+  // X3= r^2-j-2v
+  if (!BigModSquare(r, *barrett, t1) || !BigModSub(t1, j, p, t2) ||
+      !BigModSub(t2, v, p, t1) || !BigModSub(t1, v, p, *R.x_)) {
+    LOG(ERROR) << "JacobianAdd X failed\n";
+    return false;
+  }
+  // Y3= r(v-X3)-2 s1 j
+  if (!BigModSub(v, *R.x_, p, t1) || !BigModMult(r, t1, *barrett, t2) ||
+      !BigModMult(s1, j, *barrett, t1) || !BigModAdd(t1, t1, p, v) ||
+      !BigModSub(t2, v, p, *R.y_)) {
+    LOG(ERROR) << "JacobianAdd Y failed\n";
+    return false;
+  }
+  return true;
+}
+
+bool JacobianAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R) {
+  return JacobianAddInternal(c, P, Q, false, R);
+}
+
+//  R= P+Q, Q affine (Q.z_ is 1 or 0)
+bool JacobianMixedAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q,
+                      CurvePoint& R) {
+  return JacobianAddInternal(c, P, Q, !Q.z_->IsZero(), R);
+}
+
+bool JacobianToAffine(EccCurve& c, CurvePoint& P) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
+  if (P.z_->IsZero()) {
+    P.MakeZero();
+    return true;
+  }
+  if (P.z_->IsOne())
+    return true;
+
+  ScratchFrame frame;
+  int size = 1 + 2 * c.p_->size_;
+  BigNum zinv(size, frame);
+  BigNum zinv2(size, frame);
+  BigNum t(size, frame);
+
+  // z depends on the scalar in JacobianPointMult
+  if (!BigModInv(*P.z_, *c.p_, zinv, BIG_MODINV_CONSTTIME)) {
+    LOG(ERROR) << "JacobianToAffine can't BigModInv\n";
+    return false;
+  }
+  if (!BigModSquare(zinv, *barrett, zinv2) ||
+      !BigModMult(*P.x_, zinv2, *barrett, t)) {
+    LOG(ERROR) << "JacobianToAffine BigModMult failed\n";
+    return false;
+  }
+  P.x_->CopyFrom(t);
+  if (!BigModMult(zinv2, zinv, *barrett, t) ||
+      !BigModMult(*P.y_, t, *barrett, zinv2)) {
+    LOG(ERROR) << "JacobianToAffine BigModMult failed\n";
+    return false;
+  }
+  P.y_->CopyFrom(zinv2);
+  P.z_->CopyFrom(Big_One);
+  return true;
+}
+
+//  R= |x| P in Jacobian coordinates, left to right, doubling then mixed
+//  addition.
+bool JacobianPointMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R) {
+  if (x.IsZero() || P.z_->IsZero()) {
+    R.MakeZero();
+    return true;
+  }
+  CurvePoint base(P, 1 + 2 * c.p_->capacity_);
+  if (!ProjectiveToAffine(c, base) || !BigModNormalize(*base.x_, *c.p_) ||
+      !BigModNormalize(*base.y_, *c.p_)) {
+    LOG(ERROR) << "JacobianPointMult can't normalize P\n";
+    return false;
+  }
+  CurvePoint accum(1 + 2 * c.p_->capacity_);
+  accum.MakeZero();
+  for (int i = BigHighBit(x); i >= 1; i--) {
+    if (!JacobianDouble(c, accum, accum))
+      return false;
+    if (BigBitPositionOn(x, i) && !JacobianMixedAdd(c, accum, base, accum))
+      return false;
+  }
+  return accum.CopyTo(R);
+}
+
+//  Width w NAF of |x|: x= sum naf[i] 2^i, each digit zero or odd with
+//  |naf[i]| < 2^(w-1), and any w consecutive digits have at most one
+//  nonzero.  Returns the number of digits, at most BigHighBit(x)+1, or
+//  -1 if that exceeds max_len.
+int WNafRecode(BigNum& x, int w, int max_len, int* naf) {
+  if (w < 2 || w > 16)
+    return -1;
+  int n = x.size_ + 1;
+  uint64_t k[n];
+  int64_t mod = 1LL << w;
+  int64_t half = 1LL << (w - 1);
+  int len = 0;
+  int i;
+
+  for (i = 0; i < x.size_; i++)
+    k[i] = x.value_[i];
+  k[n - 1] = 0ULL;
+  while (!DigitArrayIsZero(n, k)) {
+    if (len >= max_len)
+      return -1;
+    int64_t d = 0;
+    if (k[0] & 1ULL) {
+      d = (int64_t)(k[0] & (uint64_t)(mod - 1));
+      if (d >= half)
+        d -= mod;
+      // k-= d, the low w bits of k become zero
+      if (d > 0) {
+        uint64_t borrow = (uint64_t)d;
+        for (i = 0; i < n && borrow != 0ULL; i++) {
+          uint64_t t = k[i];
+          k[i] = t - borrow;
+          borrow = t < borrow ? 1ULL : 0ULL;
+        }
+      } else {
+        uint64_t carry = (uint64_t)(-d);
+        for (i = 0; i < n && carry != 0ULL; i++) {
+          k[i] += carry;
+          carry = k[i] < carry ? 1ULL : 0ULL;
+        }
+      }
+    }
+    naf[len++] = (int)d;
+    for (i = 0; i < (n - 1); i++)
+      k[i] = (k[i] >> 1) | (k[i + 1] << 63);
+    k[n - 1] >>= 1;
+  }
+  return len;
+}
+
+//  Signed w bit windows of |x|: x= sum digits[i] 2^(w i) with each digit
+//  in [-(2^(w-1)-1), 2^(w-1)], computed without branches on x.  Fails if
+//  num_windows digits can't hold x.
+bool SignedWindowRecode(BigNum& x, int w, int num_windows, int* digits) {
+  if (w < 2 || w > 16 || BigHighBit(x) > w * num_windows)
+    return false;
+  int64_t half = 1LL << (w - 1);
+  uint64_t mask = (1ULL << w) - 1ULL;
+  int64_t carry = 0;
+
+  for (int i = 0; i < num_windows; i++) {
+    int pos = w * i;
+    int word = pos / NBITSINUINT64;
+    int shift = pos % NBITSINUINT64;
+    uint64_t bits = word < x.size_ ? x.value_[word] >> shift : 0ULL;
+    if (shift > (NBITSINUINT64 - w) && (word + 1) < x.size_)
+      bits |= x.value_[word + 1] << (NBITSINUINT64 - shift);
+    int64_t v = (int64_t)(bits & mask) + carry;
+    carry = (int64_t)((uint64_t)(half - v) >> 63);
+    digits[i] = (int)(v - (carry << w));
+  }
+  return carry == 0;
+}
+
+//  JacobianToAffine on n points with one inversion, see BigModInvBatch
+bool JacobianToAffineBatch(EccCurve& c, int n, CurvePoint** P) {
+  BarrettContext* barrett = c.BarrettCtx();
+  if (barrett == nullptr)
+    return false;
+  if (n <= 0)
+    return true;
+
+  int size = 1 + 2 * c.p_->size_;
+  BigNum** z = new BigNum*[n];
+  BigNum** zinv = new BigNum*[n];
+  int* index = new int[n];
+  ScratchFrame frame;
+  BigNum zinv2(size, frame);
+  BigNum t(size, frame);
+  bool ret = true;
+  int i;
+  int k = 0;
+
+  for (i = 0; i < n; i++) {
+    if (P[i]->z_->IsZero()) {
+      P[i]->MakeZero();
+      continue;
+    }
+    if (P[i]->z_->IsOne())
+      continue;
+    z[k] = P[i]->z_;
+    zinv[k] = new BigNum(size, frame);
+    index[k++] = i;
+  }
+  if (!BigModInvBatch(k, z, *c.p_, zinv, BIG_MODINV_CONSTTIME)) {
+    LOG(ERROR) << "JacobianToAffineBatch can't BigModInvBatch\n";
+    ret = false;
+    goto done;
+  }
+  for (i = 0; i < k; i++) {
+    CurvePoint* Q = P[index[i]];
+    zinv2.ZeroNum();
+    t.ZeroNum();
+    if (!BigModSquare(*zinv[i], *barrett, zinv2) ||
+        !BigModMult(*Q->x_, zinv2, *barrett, t)) {
+      LOG(ERROR) << "JacobianToAffineBatch BigModMult failed\n";
+      ret = false;
+      goto done;
+    }
+    Q->x_->CopyFrom(t);
+    t.ZeroNum();
+    if (!BigModMult(zinv2, *zinv[i], *barrett, t) ||
+        !BigModMult(*Q->y_, t, *barrett, zinv2)) {
+      LOG(ERROR) << "JacobianToAffineBatch BigModMult failed\n";
+      ret = false;
+      goto done;
+    }
+    Q->y_->CopyFrom(zinv2);
+    Q->z_->CopyFrom(Big_One);
+  }
+
+done:
+  for (i = 0; i < k; i++)
+    delete zinv[i];
+  delete []zinv;
+  delete []z;
+  delete []index;
+  return ret;
+}
+
+//  R= |x| P in Jacobian coordinates from the width w NAF of x.  The odd
+//  multiples P, 3P, ..., (2^(w-1)-1)P are made affine with one batch
+//  inversion, and -Q= (x, -y) so negative digits cost the same as
+//  positive ones: about n/(w+1) mixed additions against n/2 in
+//  JacobianPointMult.  w= 0 picks the width from the size of x.
+bool JacobianWNafMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R,
+                      int w) {
+  if (x.IsZero() || P.z_->IsZero()) {
+    R.MakeZero();
+    return true;
+  }
+  int bits = BigHighBit(x);
+  if (w == 0)
+    w = bits <= 64 ? 3 : (bits <= 192 ? 4 : 5);
+  if (w < 2 || w > 8) {
+    LOG(ERROR) << "JacobianWNafMult: bad width\n";
+    return false;
+  }
+
+  int capacity = 1 + 2 * c.p_->capacity_;
+  int num = 1 << (w - 2);
+  int naf[bits + 1];
+  int len = WNafRecode(x, w, bits + 1, naf);
+  if (len < 0)
+    return false;
+
+  std::vector<CurvePoint*> odd(num);
+  std::vector<CurvePoint*> neg(num);
+  CurvePoint twice(capacity);
+  CurvePoint accum(capacity);
+  BigNum t(capacity);
+  bool ret = false;
+  int i;
+
+  for (i = 0; i < num; i++) {
+    odd[i] = new CurvePoint(capacity);
+    neg[i] = new CurvePoint(capacity);
+  }
+  odd[0]->CopyFrom(P);
+  if (!ProjectiveToAffine(c, *odd[0]) ||
+      !BigModNormalize(*odd[0]->x_, *c.p_) ||
+      !BigModNormalize(*odd[0]->y_, *c.p_)) {
+    LOG(ERROR) << "JacobianWNafMult can't normalize P\n";
+    goto done;
+  }
+  if (num > 1 && !JacobianDouble(c, *odd[0], twice))
+    goto done;
+  for (i = 1; i < num; i++) {
+    if (!JacobianAdd(c, *odd[i - 1], twice, *odd[i]))
+      goto done;
+  }
+  if (!JacobianToAffineBatch(c, num - 1, odd.data() + 1))
+    goto done;
+  for (i = 0; i < num; i++) {
+    neg[i]->CopyFrom(*odd[i]);
+    if (!odd[i]->z_->IsZero()) {
+      t.ZeroNum();
+      if (!BigModNeg(*odd[i]->y_, *c.p_, t))
+        goto done;
+      neg[i]->y_->CopyFrom(t);
+    }
+  }
+
+  accum.MakeZero();
+  for (i = len - 1; i >= 0; i--) {
+    if (!accum.z_->IsZero() && !JacobianDouble(c, accum, accum))
+      goto done;
+    if (naf[i] > 0 && !JacobianMixedAdd(c, accum, *odd[naf[i] / 2], accum))
+      goto done;
+    if (naf[i] < 0 && !JacobianMixedAdd(c, accum, *neg[-naf[i] / 2], accum))
+      goto done;
+  }
+  ret = accum.CopyTo(R);
+
+done:
+  for (i = 0; i < num; i++) {
+    delete odd[i];
+    delete neg[i];
+  }
+  return ret;
+}
+
+//  Entry of P, Q, P+Q, P-Q, -P, -Q, -(P+Q), -(P-Q) for JSF column
+//  (du, dv), -1 for (0, 0)
+int JsfTableIndex(int du, int dv) {
+  static const int index[3][3] = {{6, 4, 7}, {5, -1, 1}, {3, 0, 2}};
+  return index[du + 1][dv + 1];
+}
+
+//  Joint sparse form of (u, v), Solinas: u= sum du[i] 2^i and
+//  v= sum dv[i] 2^i with digits in {-1, 0, 1}, and of any three
+//  consecutive columns at least one is all zero.  Returns the number of
+//  digits, at most max(bits)+1, or -1 if that exceeds max_len.
+int JsfRecode(BigNum& u, BigNum& v, int max_len, int* du, int* dv) {
+  int n = (u.size_ > v.size_ ? u.size_ : v.size_) + 1;
+  uint64_t k[2][n];
+  int d[2] = {0, 0};
+  int len = 0;
+  int i, j;
+
+  for (i = 0; i < n; i++) {
+    k[0][i] = i < u.size_ ? u.value_[i] : 0ULL;
+    k[1][i] = i < v.size_ ? v.value_[i] : 0ULL;
+  }
+  while (!DigitArrayIsZero(n, k[0]) || !DigitArrayIsZero(n, k[1]) ||
+         d[0] != 0 || d[1] != 0) {
+    if (len >= max_len)
+      return -1;
+    int l[2];
+    int digit[2];
+    for (j = 0; j < 2; j++)
+      l[j] = (int)((k[j][0] + (uint64_t)d[j]) & 7ULL);
+    for (j = 0; j < 2; j++) {
+      if ((l[j] & 1) == 0) {
+        digit[j] = 0;
+        continue;
+      }
+      digit[j] = (l[j] & 3) == 1 ? 1 : -1;
+      if ((l[j] == 3 || l[j] == 5) && (l[1 - j] & 3) == 2)
+        digit[j] = -digit[j];
+    }
+    for (j = 0; j < 2; j++) {
+      if (2 * d[j] == 1 + digit[j])
+        d[j] = 1 - d[j];
+      for (i = 0; i < (n - 1); i++)
+        k[j][i] = (k[j][i] >> 1) | (k[j][i + 1] << 63);
+      k[j][n - 1] >>= 1;
+    }
+    du[len] = digit[0];
+    dv[len++] = digit[1];
+  }
+  return len;
+}
+
+//  R= uP+vQ in affine coordinates for u, v >= 0, Shamir's trick over the
+//  joint sparse form: one doubling per bit and an addition of one of
+//  +-P, +-Q, +-(P+Q), +-(P-Q) for about half of them.  Not constant time,
+//  meant for public scalars as in signature verification.
+bool EccJointMult(EccCurve& c, BigNum& u, CurvePoint& P, BigNum& v,
+                  CurvePoint& Q, CurvePoint& R) {
+  if (u.IsNegative() || v.IsNegative()) {
+    LOG(ERROR) << "EccJointMult: negative scalar\n";
+    return false;
+  }
+  if (IsP256Curve(c) && u.size_ <= P256_DIGITS && v.size_ <= P256_DIGITS)
+    return P256JointMult(P, u, Q, v, R);
+
+  int max_len = (BigHighBit(u) > BigHighBit(v) ? BigHighBit(u) :
+                 BigHighBit(v)) + 1;
+  int du[max_len];
+  int dv[max_len];
+  int len = JsfRecode(u, v, max_len, du, dv);
+  if (len < 0)
+    return false;
+
+  int capacity = 1 + 2 * c.p_->capacity_;
+  CurvePoint* pts[8];
+  CurvePoint accum(capacity);
+  bool ret = false;
+  int i;
+
+  // pts[0..3]= P, Q, P+Q, P-Q, pts[4..7] their negatives
+  for (i = 0; i < 8; i++)
+    pts[i] = new CurvePoint(capacity);
+  pts[0]->CopyFrom(P);
+  pts[1]->CopyFrom(Q);
+  for (i = 0; i < 2; i++) {
+    if (!ProjectiveToAffine(c, *pts[i]) ||
+        !BigModNormalize(*pts[i]->x_, *c.p_) ||
+        !BigModNormalize(*pts[i]->y_, *c.p_)) {
+      LOG(ERROR) << "EccJointMult can't normalize inputs\n";
+      goto done;
+    }
+    pts[i + 4]->CopyFrom(*pts[i]);
+    if (!pts[i]->z_->IsZero()) {
+      pts[i + 4]->y_->ZeroNum();
+      if (!BigModNeg(*pts[i]->y_, *c.p_, *pts[i + 4]->y_))
+        goto done;
+    }
+  }
+  if (!JacobianAdd(c, *pts[0], *pts[1], *pts[2]) ||
+      !JacobianAdd(c, *pts[0], *pts[5], *pts[3]) ||
+      !JacobianToAffineBatch(c, 2, pts + 2))
+    goto done;
+  for (i = 2; i < 4; i++) {
+    pts[i + 4]->CopyFrom(*pts[i]);
+    if (!pts[i]->z_->IsZero()) {
+      pts[i + 4]->y_->ZeroNum();
+      if (!BigModNeg(*pts[i]->y_, *c.p_, *pts[i + 4]->y_))
+        goto done;
+    }
+  }
+
+  accum.MakeZero();
+  for (i = len - 1; i >= 0; i--) {
+    if (!accum.z_->IsZero() && !JacobianDouble(c, accum, accum))
+      goto done;
+    int index = JsfTableIndex(du[i], dv[i]);
+    if (index >= 0 && !JacobianMixedAdd(c, accum, *pts[index], accum))
+      goto done;
+  }
+  ret = accum.CopyTo(R) && JacobianToAffine(c, R);
+
+done:
+  for (i = 0; i < 8; i++)
+    delete pts[i];
+  return ret;
+}
+
+//  R= P+Q in homogeneous projective coordinates with the complete formulas
+//  of Renes, Costello and Batina (Algorithm 1, any a, b3= 3b).  No input,
+//  infinity or P= Q included, takes a different path.  R may be P or Q.
+static bool ProjectiveAddComplete(EccCurve& c, BarrettContext& barrett,
+                                  BigNum& b3, CurvePoint& P, CurvePoint& Q,
+                                  CurvePoint& R) {
+  ScratchFrame frame;
+  int size = 1 + 2 * c.p_->size_;
+  BigNum& p = *c.p_;
+  BigNum& a = *c.a_;
+  BigNum t0(size, frame);
+  BigNum t1(size, frame);
+  BigNum t2(size, frame);
+  BigNum t3(size, frame);
+  BigNum t4(size, frame);
+  BigNum t5(size, frame);
+  BigNum x3(size, frame);
+  BigNum y3(size, frame);
+  BigNum z3(size, frame);
+  BigNum u(size, frame);
+  BigNum v(size, frame);
+  BigNum w(size, frame);
+
+  // t3= X1 Y2 + X2 Y1, t4= X1 Z2 + X2 Z1, t5= Y1 Z2 + Y2 Z1
+  if (!BigModMult(*P.x_, *Q.x_, barrett, t0) ||
+      !BigModMult(*P.y_, *Q.y_, barrett, t1) ||
+      !BigModMult(*P.z_, *Q.z_, barrett, t2) ||
+      !BigModAdd(*P.x_, *P.y_, p, u) || !BigModAdd(*Q.x_, *Q.y_, p, v) ||
+      !BigModMult(u, v, barrett, w) || !BigModAdd(t0, t1, p, u) ||
+      !BigModSub(w, u, p, t3) ||
+      !BigModAdd(*P.x_, *P.z_, p, u) || !BigModAdd(*Q.x_, *Q.z_, p, v) ||
+      !BigModMult(u, v, barrett, w) || !BigModAdd(t0, t2, p, u) ||
+      !BigModSub(w, u, p, t4) ||
+      !BigModAdd(*P.y_, *P.z_, p, u) || !BigModAdd(*Q.y_, *Q.z_, p, v) ||
+      !BigModMult(u, v, barrett, w) || !BigModAdd(t1, t2, p, u) ||
+      !BigModSub(w, u, p, t5)) {
+    LOG(ERROR) << "ProjectiveAddComplete cross terms failed\n";
+    return false;
+  }
+  // x3= t1 - (a t4 + b3 t2), z3= t1 + (a t4 + b3 t2), y3= x3 z3
+  if (!BigModMult(a, t4, barrett, u) || !BigModMult(b3, t2, barrett, v) ||
+      !BigModAdd(u, v, p, w) || !BigModSub(t1, w, p, x3) ||
+      !BigModAdd(t1, w, p, z3) || !BigModMult(x3, z3, barrett, y3)) {
+    LOG(ERROR) << "ProjectiveAddComplete failed\n";
+    return false;
+  }
+  // t1= 3 t0 + a t2, t4= b3 t4 + a (t0 - a t2)
+  if (!BigModAdd(t0, t0, p, u) || !BigModAdd(u, t0, p, v) ||
+      !BigModMult(a, t2, barrett, w) || !BigModAdd(v, w, p, t1) ||
+      !BigModSub(t0, w, p, u) || !BigModMult(a, u, barrett, v) ||
+      !BigModMult(b3, t4, barrett, w) || !BigModAdd(w, v, p, t4)) {
+    LOG(ERROR) << "ProjectiveAddComplete failed\n";
+    return false;
+  }
+  // X3= t3 x3 - t5 t4, Y3= y3 + t1 t4, Z3= t5 z3 + t3 t1
+  if (!BigModMult(t1, t4, barrett, u) || !BigModAdd(y3, u, p, *R.y_) ||
+      !BigModMult(t3, x3, barrett, u) || !BigModMult(t5, t4, barrett, v) ||
+      !BigModSub(u, v, p, *R.x_) || !BigModMult(t5, z3, barrett, u) ||
+      !BigModMult(t3, t1, barrett, v) || !BigModAdd(u, v, p, *R.z_)) {
+    LOG(ERROR) << "ProjectiveAddComplete failed\n";
+    return false;
+  }
+  return true;
+}
+
+//  r= mask ? a : r on the low n digits, the same words are read either way
+static void BigMaskedCopy(uint64_t mask, int n, BigNum& a, BigNum& r) {
+  for (int i = 0; i < n; i++) {
+    uint64_t w = i < a.size_ ? a.value_[i] : 0ULL;
+    r.value_[i] = (r.value_[i] & ~mask) | (w & mask);
+  }
+  r.size_ = n;
+  r.sign_ = false;
+  r.Normalize();
+}
+
+EccBaseTable::EccBaseTable() {
+  window_bits_ = 0;
+  num_windows_ = 0;
+  entries_ = 0;
+  scalar_bits_ = 0;
+  p256_table_ = nullptr;
+  table_ = nullptr;
+}
+
+EccBaseTable::~EccBaseTable() {
+  Clear();
+}
+
+void EccBaseTable::Clear() {
+  if (p256_table_ != nullptr)
+    delete []p256_table_;
+  if (table_ != nullptr) {
+    for (int i = 0; i < num_windows_ * entries_; i++)
+      delete table_[i];
+    delete []table_;
+  }
+  p256_table_ = nullptr;
+  table_ = nullptr;
+  window_bits_ = 0;
+  num_windows_ = 0;
+  entries_ = 0;
+  scalar_bits_ = 0;
+}
+
+//  Tables for x up to scalar_bits bits, windows of window_bits bits
+bool EccBaseTable::Init(EccCurve& c, CurvePoint& G, int scalar_bits,
+                        int window_bits) {
+  Clear();
+  if (window_bits < 2 || window_bits > 8 || scalar_bits <= 0) {
+    LOG(ERROR) << "EccBaseTable::Init: bad size\n";
+    return false;
+  }
+  if (G.z_->IsZero()) {
+    LOG(ERROR) << "EccBaseTable::Init: G is infinity\n";
+    return false;
+  }
+  window_bits_ = window_bits;
+  // one more bit for the carry out of the top digit
+  num_windows_ = (scalar_bits + window_bits) / window_bits;
+  entries_ = 1 << (window_bits - 1);
+  scalar_bits_ = scalar_bits;
+  int n = num_windows_ * entries_;
+  int i, j;
+
+  if (IsP256Curve(c)) {
+    p256_table_ = new uint64_t[2 * P256_DIGITS * n];
+    if (!P256BaseTableInit(G, window_bits_, num_windows_, p256_table_)) {
+      Clear();
+      return false;
+    }
+    return true;
+  }
+
+  int capacity = 1 + 2 * c.p_->capacity_;
+  table_ = new CurvePoint*[n];
+  for (i = 0; i < n; i++)
+    table_[i] = new CurvePoint(capacity);
+  table_[0]->CopyFrom(G);
+  if (!ProjectiveToAffine(c, *table_[0]) ||
+      !BigModNormalize(*table_[0]->x_, *c.p_) ||
+      !BigModNormalize(*table_[0]->y_, *c.p_)) {
+    LOG(ERROR) << "EccBaseTable::Init can't normalize G\n";
+    Clear();
+    return false;
+  }
+  for (i = 0; i < num_windows_; i++) {
+    CurvePoint** row = table_ + i * entries_;
+    if ((i > 0 && !JacobianDouble(c, *row[-1], *row[0])) ||
+        (entries_ > 1 && !JacobianDouble(c, *row[0], *row[1]))) {
+      Clear();
+      return false;
+    }
+    for (j = 2; j < entries_; j++) {
+      if (!JacobianAdd(c, *row[j - 1], *row[0], *row[j])) {
+        Clear();
+        return false;
+      }
+    }
+  }
+  if (!JacobianToAffineBatch(c, n, table_)) {
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+//  R= xG in affine coordinates, |x| < 2^scalar_bits_
+bool EccBaseTable::Mult(EccCurve& c, BigNum& x, CurvePoint& R) {
+  if (num_windows_ == 0) {
+    LOG(ERROR) << "EccBaseTable::Mult: no table\n";
+    return false;
+  }
+  if (x.IsZero()) {
+    R.MakeZero();
+    return true;
+  }
+  if (BigHighBit(x) > scalar_bits_) {
+    LOG(ERROR) << "EccBaseTable::Mult: scalar too large\n";
+    return false;
+  }
+  if (p256_table_ != nullptr) {
+    if (!P256BaseTableMult(p256_table_, window_bits_, num_windows_, x, R))
+      return false;
+  } else {
+    // Every window reads the whole row and does one complete addition, a
+    // zero digit adds infinity, so the digits of x pick no branch
+    BarrettContext* barrett = c.BarrettCtx();
+    if (barrett == nullptr)
+      return false;
+    int n = c.p_->size_;
+    int capacity = 1 + 2 * c.p_->capacity_;
+    int digits[num_windows_];
+    CurvePoint accum(capacity);
+    CurvePoint entry(capacity);
+    BigNum neg_y(capacity);
+    BigNum b3(capacity);
+    int i, j;
+
+    if (!SignedWindowRecode(x, window_bits_, num_windows_, digits))
+      return false;
+    if (!BigModAdd(*c.b_, *c.b_, *c.p_, neg_y) ||
+        !BigModAdd(neg_y, *c.b_, *c.p_, b3))
+      return false;
+    accum.MakeZero();
+    for (i = 0; i < num_windows_; i++) {
+      CurvePoint** row = table_ + i * entries_;
+      uint64_t neg = (uint64_t)((int64_t)digits[i] >> 63);
+      uint64_t abs = ((uint64_t)(int64_t)digits[i] ^ neg) - neg;
+      entry.x_->ZeroNum();
+      entry.y_->ZeroNum();
+      entry.z_->ZeroNum();
+      for (j = 0; j < entries_; j++) {
+        uint64_t d = (uint64_t)(j + 1) ^ abs;
+        uint64_t mask = ((d | (0ULL - d)) >> 63) - 1ULL;
+        BigMaskedCopy(mask, n, *row[j]->x_, *entry.x_);
+        BigMaskedCopy(mask, n, *row[j]->y_, *entry.y_);
+      }
+      // (x, y, 1), or (0, 1, 0) for a zero digit
+      uint64_t nonzero = 0ULL - ((abs | (0ULL - abs)) >> 63);
+      BigMaskedCopy(~nonzero, n, Big_One, *entry.y_);
+      BigMaskedCopy(nonzero, n, Big_One, *entry.z_);
+      neg_y.ZeroNum();
+      if (!BigSub(*c.p_, *entry.y_, neg_y))
+        return false;
+      BigMaskedCopy(neg, n, neg_y, *entry.y_);
+      if (!ProjectiveAddComplete(c, *barrett, b3, accum, entry, accum))
+        return false;
+    }
+    for (i = 0; i < num_windows_; i++) digits[i] = 0;
+    if (!accum.CopyTo(R) || !ProjectiveToAffine(c, R))
+      return false;
+  }
+  if (x.IsNegative()) {
+    R.y_->ToggleSign();
+  }
+  return true;
+}
+
+int EccBaseTable::TableBytes() {
+  int n = num_windows_ * entries_;
+  if (p256_table_ != nullptr)
+    return 2 * P256_DIGITS * n * sizeof(uint64_t);
+  if (table_ == nullptr)
+    return 0;
+  return 2 * n * table_[0]->x_->capacity_ * sizeof(uint64_t);
+}
+
 bool EccMult(EccCurve& c, CurvePoint& P, BigNum& x, CurvePoint& R) {
   if (x.IsZero()) {
     R.MakeZero();
@@ -832,19 +1880,16 @@ bool EccMult(EccCurve& c, CurvePoint& P, BigNum& x, CurvePoint& R) {
   for (i = 1; i < k; i++) {
     if (BigBitPositionOn(x, i)) {
       EccAdd(c, accum_point, double_point, t1);
-      t1.CopyTo(accum_point);
-      t1.MakeZero();
+      accum_point.Swap(t1);
     }
     if (!EccDouble(c, double_point, t1)) {
       return false;
     }
-    t1.CopyTo(double_point);
-    t1.MakeZero();
+    double_point.Swap(t1);
   }
   if (BigBitPositionOn(x, i)) {
     EccAdd(c, accum_point, double_point, t1);
-    t1.CopyTo(accum_point);
-    t1.MakeZero();
+    accum_point.Swap(t1);
   }
   accum_point.CopyTo(R);
   if (x.IsNegative()) {
@@ -861,13 +1906,20 @@ bool FasterEccMult(EccCurve& c, CurvePoint& P, BigNum& x, CurvePoint& R) {
   if (x.IsOne()) {
     return R.CopyFrom(P);
   }
-  if (!ProjectivePointMult(c, x, P, R)) {
-    LOG(ERROR) << "ProjectivePointMult failed\n";
-    return false;
-  }
-  if (!ProjectiveToAffine(c, R)) {
-    LOG(ERROR) << "ProjectiveToAffine failed\n";
-    return false;
+  if (IsP256Curve(c) && x.size_ <= P256_DIGITS) {
+    if (!P256PointMult(P, x, R)) {
+      LOG(ERROR) << "P256PointMult failed\n";
+      return false;
+    }
+  } else {
+    if (!JacobianWNafMult(c, x, P, R)) {
+      LOG(ERROR) << "JacobianWNafMult failed\n";
+      return false;
+    }
+    if (!JacobianToAffine(c, R)) {
+      LOG(ERROR) << "JacobianToAffine failed\n";
+      return false;
+    }
   }
   if (x.IsNegative()) {
     R.y_->ToggleSign();
@@ -879,6 +1931,10 @@ EccKey::EccKey() {
   bit_size_modulus_ = 0;
   a_ = nullptr;
   order_of_g_ = nullptr;
+  table_window_bits_ = ECC_BASE_TABLE_BITS;
+  g_table_ = nullptr;
+  base_table_ = nullptr;
+  shared_g_table_ = nullptr;
 }
 
 EccKey::~EccKey() {
@@ -890,11 +1946,115 @@ EccKey::~EccKey() {
     order_of_g_->ZeroNum();
     delete order_of_g_;
   }
+  ClearBaseTables();
   c_.Clear();
   g_.Clear();
   base_.Clear();
 }
 
+//  A base table of G for c of the given width, nullptr on failure
+static EccBaseTable* NewEccBaseTable(EccCurve& c, CurvePoint& G,
+                                     int window_bits) {
+  EccBaseTable* table = new EccBaseTable();
+  if (!table->Init(c, G, BigHighBit(*c.p_), window_bits)) {
+    LOG(ERROR) << "Can't build EccBaseTable\n";
+    delete table;
+    return nullptr;
+  }
+  return table;
+}
+
+//  The built-in key with curve c and generator g, if there is one
+static EccKey* BuiltinEccKey(EccCurve& c, CurvePoint& g) {
+  if (c.a_ == nullptr || c.b_ == nullptr || g.y_ == nullptr ||
+      g.z_ == nullptr)
+    return nullptr;
+  EccKey* keys[3] = {P256_key_valid ? &P256_Key : nullptr,
+                     P384_key_valid ? &P384_Key : nullptr,
+                     P521_key_valid ? &P521_Key : nullptr};
+  for (int i = 0; i < 3; i++) {
+    EccKey* key = keys[i];
+    if (key != nullptr && BigCompare(*key->c_.p_, *c.p_) == 0 &&
+        BigCompare(*key->c_.a_, *c.a_) == 0 &&
+        BigCompare(*key->c_.b_, *c.b_) == 0 &&
+        BigCompare(*key->g_.x_, *g.x_) == 0 &&
+        BigCompare(*key->g_.y_, *g.y_) == 0 &&
+        BigCompare(*key->g_.z_, *g.z_) == 0)
+      return key;
+  }
+  return nullptr;
+}
+
+//  P256_Key, P384_Key and P521_Key once InitEccCurves has built them.
+//  Other keys share their generator tables, so their tables stay fixed.
+static bool IsBuiltinEccKey(EccKey* key) {
+  return key->key_valid_ && (key == &P256_Key || key == &P384_Key ||
+                             key == &P521_Key);
+}
+
+void EccKey::ClearBaseTables() {
+  if (g_table_ != nullptr) {
+    delete g_table_;
+    g_table_ = nullptr;
+  }
+  if (base_table_ != nullptr) {
+    delete base_table_;
+    base_table_ = nullptr;
+  }
+  shared_g_table_ = nullptr;
+}
+
+//  Rebuilds the tables for g_ and base_ at table_window_bits_, call
+//  whenever c_, g_ or base_ change.  g_ shares the built-in curve's table
+//  when it is that curve's generator and the widths agree.
+bool EccKey::InitBaseTables() {
+  if (IsBuiltinEccKey(this)) {
+    LOG(ERROR) << "InitBaseTables: built-in key tables are fixed\n";
+    return false;
+  }
+  ClearBaseTables();
+  if (table_window_bits_ == 0 || c_.p_ == nullptr)
+    return true;
+  if (g_.x_ != nullptr && g_.z_ != nullptr && !g_.z_->IsZero()) {
+    EccKey* builtin = BuiltinEccKey(c_, g_);
+    if (builtin != nullptr && builtin != this &&
+        builtin->g_table_ != nullptr &&
+        builtin->g_table_->window_bits_ == table_window_bits_) {
+      shared_g_table_ = builtin->g_table_;
+    } else {
+      g_table_ = NewEccBaseTable(c_, g_, table_window_bits_);
+      if (g_table_ == nullptr)
+        return false;
+    }
+  }
+  if (base_.x_ != nullptr && base_.z_ != nullptr && !base_.z_->IsZero()) {
+    base_table_ = NewEccBaseTable(c_, base_, table_window_bits_);
+    if (base_table_ == nullptr)
+      return false;
+  }
+  return true;
+}
+
+//  0 turns the tables off.  Fails on built-in keys.
+bool EccKey::SetTableWindowBits(int window_bits) {
+  if (IsBuiltinEccKey(this)) {
+    LOG(ERROR) << "SetTableWindowBits: built-in key tables are fixed\n";
+    return false;
+  }
+  table_window_bits_ = window_bits;
+  return InitBaseTables();
+}
+
+//  Table for g_, nullptr if there is none.  Only reads the key.
+EccBaseTable* EccKey::GeneratorTable() {
+  return g_table_ != nullptr ? g_table_ : shared_g_table_;
+}
+
+//  Table for base_, nullptr if there is none.  Only reads the key.
+EccBaseTable* EccKey::BaseTable() {
+  return base_table_;
+}
+
 bool EccKey::MakeEccKey(const char* name, const char* usage, const char* owner,
                         double secondstolive, EccCurve* c,
                         CurvePoint* g, CurvePoint* base, BigNum* order, BigNum* secret) {
@@ -923,6 +2083,7 @@ bool EccKey::MakeEccKey(const char* name, const char* usage, const char* owner,
     c_.a_ = new BigNum(*c->a_);
     c_.b_ = new BigNum(*c->b_);
     c_.p_ = new BigNum(*c->p_);
+    c_.InitContexts();
   } else {
     LOG(ERROR) << "EccKey::MakeECCKey: no curve\n";
     return false;
@@ -952,7 +2113,11 @@ bool EccKey::MakeEccKey(const char* name, const char* usage, const char* owner,
     a_ = new BigNum(*secret);
   }
   if (base == nullptr && secret != nullptr) {
-    EccMult(c_, g_, *secret, base_);
+    FasterEccMult(c_, g_, *secret, base_);
+  }
+  if (!InitBaseTables()) {
+    LOG(ERROR) << "EccKey::MakeECCKey: can't build base tables\n";
+    return false;
   }
   return true;
 }
@@ -1074,6 +2239,7 @@ bool EccCurve::DeserializeCurveFromMessage(crypto_ecc_curve_message& msg) {
   int k, len, bignum_size;
 
   if (msg.has_p()) {
+    ClearContexts();
     len = (6 * msg.p().size() + NBITSINBYTE - 1) / NBITSINBYTE;
     bignum_size = ((len + sizeof(uint64_t) - 1) / sizeof(uint64_t));
     p_ = new BigNum(bignum_size);
@@ -1085,6 +2251,8 @@ bool EccCurve::DeserializeCurveFromMessage(crypto_ecc_curve_message& msg) {
       return false;
     }
     p_->Normalize();
+    if (!InitContexts())
+      return false;
   }
   if (msg.has_a()) {
     len = (6 * msg.a().size() + NBITSINBYTE - 1) / NBITSINBYTE;
@@ -1200,6 +2368,11 @@ bool EccKey::DeserializeKeyFromMessage(crypto_ecc_key_message& msg) {
     crypto_point_message pm = msg.base_point();
     base_.DeserializePointFromMessage(pm);
   }
+  if (!InitBaseTables()) {
+    LOG(ERROR) << "EccKey::DeserializeKeyFromMessage: can't build base "
+                  "tables\n";
+    return false;
+  }
   return true;
 }
 
@@ -1333,6 +2506,7 @@ bool InitEccCurves() {
     P256_Key.c_.p_->value_[1] = 0x00000000ffffffffULL;
     P256_Key.c_.p_->value_[0] = 0xffffffffffffffffULL;
     P256_Key.c_.p_->Normalize();
+    P256_Key.c_.InitContexts();
 
     P256_Key.c_.a_ = new BigNum(4);
     P256_Key.c_.a_->value_[3] = 0xffffffff00000001ULL;
@@ -1375,6 +2549,11 @@ bool InitEccCurves() {
     P256_Key.base_.x_ = nullptr;
     P256_Key.base_.y_ = nullptr;
     P256_Key.base_.z_ = nullptr;
+    if (!P256_Key.InitBaseTables() ||
+        P256_Key.GeneratorTable() == nullptr) {
+      printf("Can't build P-256 generator table\n");
+      return false;
+    }
     P256_Key.key_valid_ = true;
   }
 
@@ -1407,14 +2586,16 @@ bool InitEccCurves() {
     P384_Key.c_.p_->value_[1] = 0xffffffff00000000ULL;
     P384_Key.c_.p_->value_[0] = 0x00000000ffffffffULL;
     P384_Key.c_.p_->Normalize();
+    P384_Key.c_.InitContexts();
 
     P384_Key.c_.a_ = new BigNum(6);
-    P384_Key.c_.a_->value_[5] = 0x79d1e655f868f02fULL;
-    P384_Key.c_.a_->value_[4] = 0xff48dcdee14151ddULL;
-    P384_Key.c_.a_->value_[3] = 0xb80643c1406d0ca1ULL;
-    P384_Key.c_.a_->value_[2] = 0x0dfe6fc52009540aULL;
-    P384_Key.c_.a_->value_[1] = 0x495e8042ea5f744fULL;
-    P384_Key.c_.a_->value_[0] = 0x6e184667cc722483ULL;
+    // a= p-3
+    P384_Key.c_.a_->value_[5] = 0xffffffffffffffffULL;
+    P384_Key.c_.a_->value_[4] = 0xffffffffffffffffULL;
+    P384_Key.c_.a_->value_[3] = 0xffffffffffffffffULL;
+    P384_Key.c_.a_->value_[2] = 0xfffffffffffffffeULL;
+    P384_Key.c_.a_->value_[1] = 0xffffffff00000000ULL;
+    P384_Key.c_.a_->value_[0] = 0x00000000fffffffcULL;
     P384_Key.c_.a_->Normalize();
 
     P384_Key.c_.b_ = new BigNum(6);
@@ -1458,6 +2639,11 @@ bool InitEccCurves() {
     P384_Key.base_.x_ = nullptr;
     P384_Key.base_.y_ = nullptr;
     P384_Key.base_.z_ = nullptr;
+    if (!P384_Key.InitBaseTables() ||
+        P384_Key.GeneratorTable() == nullptr) {
+      printf("Can't build P-384 generator table\n");
+      return false;
+    }
     P384_key_valid = true;
     P384_Key.key_valid_ = true;
   }
@@ -1493,17 +2679,19 @@ bool InitEccCurves() {
     P521_Key.c_.p_->value_[1] = 0xffffffffffffffffULL;
     P521_Key.c_.p_->value_[0] = 0xffffffffffffffffULL;
     P521_Key.c_.p_->Normalize();
+    P521_Key.c_.InitContexts();
 
     P521_Key.c_.a_ = new BigNum(9);
-    P521_Key.c_.a_->value_[8] = 0x0b4ULL;
-    P521_Key.c_.a_->value_[7] = 0x8bfa5f420a349495ULL;
-    P521_Key.c_.a_->value_[6] = 0x39d2bdfc264eeeebULL;
-    P521_Key.c_.a_->value_[5] = 0x077688e44fbf0ad8ULL;
-    P521_Key.c_.a_->value_[4] = 0xf6d0edb37bd6b533ULL;
-    P521_Key.c_.a_->value_[3] = 0x281000518e19f1b9ULL;
-    P521_Key.c_.a_->value_[2] = 0xffbe0fe9ed8a3c22ULL;
-    P521_Key.c_.a_->value_[1] = 0x00b8f875e523868cULL;
-    P521_Key.c_.a_->value_[0] = 0x70c1e5bf55bad637ULL;
+    // a= p-3
+    P521_Key.c_.a_->value_[8] = 0x1ffULL;
+    P521_Key.c_.a_->value_[7] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[6] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[5] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[4] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[3] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[2] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[1] = 0xffffffffffffffffULL;
+    P521_Key.c_.a_->value_[0] = 0xfffffffffffffffcULL;
     P521_Key.c_.a_->Normalize();
 
     P521_Key.c_.b_ = new BigNum(9);
@@ -1560,6 +2748,11 @@ bool InitEccCurves() {
     P521_Key.base_.x_ = nullptr;
     P521_Key.base_.y_ = nullptr;
     P521_Key.base_.z_ = nullptr;
+    if (!P521_Key.InitBaseTables() ||
+        P521_Key.GeneratorTable() == nullptr) {
+      printf("Can't build P-521 generator table\n");
+      return false;
+    }
     P521_key_valid = true;
     P521_Key.key_valid_ = true;
   }
@@ -1567,6 +2760,14 @@ bool InitEccCurves() {
   return true;
 }
 
+//  R= kP from P's table if there is one and k fits, else FasterEccMult
+bool FixedBaseMult(EccCurve& c, EccBaseTable* table, CurvePoint& P,
+                   BigNum& k, CurvePoint& R) {
+  if (table != nullptr && BigHighBit(k) <= table->scalar_bits_)
+    return table->Mult(c, k, R);
+  return FasterEccMult(c, P, k, R);
+}
+
 //  embed message into point M
 //  pick k at random
 //  send (kG, kBase+M)
@@ -1583,11 +2784,11 @@ bool EccKey::Encrypt(int size, byte* plain, BigNum& k, CurvePoint& pt1,
     return false;
   }
 #ifdef FASTECCMULT
-  if (!FasterEccMult(c_, g_, k, pt1)) {
+  if (!FixedBaseMult(c_, GeneratorTable(), g_, k, pt1)) {
     LOG(ERROR) << "EccMult error in EccKey::Encrypt\n";
     return false;
   }
-  if (!FasterEccMult(c_, base_, k, R)) {
+  if (!FixedBaseMult(c_, BaseTable(), base_, k, R)) {
     LOG(ERROR) << "EccMult error in EccKey::Encrypt\n";
     return false;
   }
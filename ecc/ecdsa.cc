@@ -0,0 +1,314 @@
+//
+// Copyright 2014 John Manferdelli, All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// or in the the file LICENSE-2.0.txt in the top level sourcedirectory
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+// Project: New Cloudproxy Crypto
+// File: ecdsa.cc
+
+#include "cryptotypes.h"
+#include "util.h"
+#include "bignum.h"
+#include "ecc.h"
+#include "keys.h"
+#include "hmac_sha256.h"
+#include "ecdsa.h"
+
+#include <string>
+
+using std::string;
+
+// r= the big endian integer in in[0, size)
+static bool BytesToBigNum(int size, byte* in, BigNum& r) {
+  if (size > r.Capacity() * (int)sizeof(uint64_t))
+    return false;
+  r.ZeroNum();
+  ReverseCpy(size, in, (byte*)r.value_);
+  r.Normalize();
+  return true;
+}
+
+// out= a as size big endian bytes, RFC 6979 int2octets
+static bool BigNumToBytes(BigNum& a, int size, byte* out) {
+  int n = a.size_ * sizeof(uint64_t);
+  byte* in = (byte*)a.value_;
+
+  while (n > size) {
+    if (in[n - 1] != 0)
+      return false;
+    n--;
+  }
+  memset(out, 0, size - n);
+  ReverseCpy(n, in, out + size - n);
+  return true;
+}
+
+// r= the leftmost qlen bits of in, RFC 6979 bits2int
+static bool Bits2Int(int size, byte* in, int qlen, BigNum& r) {
+  BigNum t(r.Capacity());
+
+  if (!BytesToBigNum(size, in, t))
+    return false;
+  r.ZeroNum();
+  if ((NBITSINBYTE * size) > qlen)
+    return BigShift(t, -(int64_t)(NBITSINBYTE * size - qlen), r);
+  return r.CopyFrom(t);
+}
+
+// out= HMAC-SHA256 of in under the 32 byte key
+static bool EcdsaHmac(byte* key, int size, byte* in, byte* out) {
+  HmacSha256 mac;
+
+  if (!mac.Init(HmacSha256::MACBYTESIZE, key))
+    return false;
+  mac.AddToInnerHash(size, in);
+  mac.Final();
+  return mac.GetHmac(HmacSha256::MACBYTESIZE, out);
+}
+
+//  RFC 6979 section 3.2 with HMAC-SHA256: k for secret x, order n and
+//  digest hash.  attempt > 0 skips to a later candidate, which signing
+//  needs only if r or s comes out zero.
+bool EcdsaNonce(BigNum& n, BigNum& x, int size_hash, byte* hash, int attempt,
+                BigNum& k) {
+  const int hlen = HmacSha256::MACBYTESIZE;
+  int qlen = BigHighBit(n);
+  int rlen = (qlen + NBITSINBYTE - 1) / NBITSINBYTE;
+  int tlen = ((rlen + hlen - 1) / hlen) * hlen;
+  int capacity = 1 + ((size_hash > tlen ? size_hash : tlen) + 7) / 8;
+  byte K[hlen];
+  byte V[hlen];
+  byte T[tlen];
+  byte msg[hlen + 1 + 2 * rlen];
+  BigNum h(capacity);
+  bool ret = false;
+  int i;
+
+  if (k.Capacity() < capacity) {
+    LOG(ERROR) << "EcdsaNonce: k too small\n";
+    return false;
+  }
+  // msg= V || 0x00 || int2octets(x) || bits2octets(hash)
+  if (!Bits2Int(size_hash, hash, qlen, h))
+    return false;
+  if (BigCompare(h, n) >= 0) {
+    k.ZeroNum();
+    if (!BigSub(h, n, k))
+      return false;
+    h.CopyFrom(k);
+  }
+  if (!BigNumToBytes(x, rlen, msg + hlen + 1) ||
+      !BigNumToBytes(h, rlen, msg + hlen + 1 + rlen)) {
+    LOG(ERROR) << "EcdsaNonce: secret too large\n";
+    return false;
+  }
+  memset(V, 0x01, hlen);
+  memset(K, 0x00, hlen);
+  for (i = 0; i < 2; i++) {
+    memcpy(msg, V, hlen);
+    msg[hlen] = (byte)i;
+    if (!EcdsaHmac(K, hlen + 1 + 2 * rlen, msg, K) ||
+        !EcdsaHmac(K, hlen, V, V))
+      goto done;
+  }
+  for (;;) {
+    for (i = 0; i < tlen; i += hlen) {
+      if (!EcdsaHmac(K, hlen, V, V))
+        goto done;
+      memcpy(T + i, V, hlen);
+    }
+    if (!Bits2Int(tlen, T, qlen, k))
+      goto done;
+    if (!k.IsZero() && BigCompare(k, n) < 0 && attempt-- == 0)
+      break;
+    memcpy(msg, V, hlen);
+    msg[hlen] = 0x00;
+    if (!EcdsaHmac(K, hlen + 1, msg, K) || !EcdsaHmac(K, hlen, V, V))
+      goto done;
+  }
+  ret = true;
+
+done:
+  memset(K, 0, hlen);
+  memset(V, 0, hlen);
+  memset(T, 0, tlen);
+  memset(msg, 0, sizeof(msg));
+  return ret;
+}
+
+//  (r, s)= (x(kG) mod n, (e + r a)/k mod n), e the digest truncated to
+//  the size of n.  kG comes from the key's generator table, or from one
+//  built for this call if the key has none wide enough for k, so k never
+//  reaches FasterEccMult.  The products with a and 1/k are
+//  BigModMultConstantTime.
+bool EcdsaSign(EccKey& key, int size_hash, byte* hash, BigNum& r, BigNum& s) {
+  if (key.a_ == nullptr || key.order_of_g_ == nullptr || key.c_.p_ == nullptr) {
+    LOG(ERROR) << "EcdsaSign: not a private key\n";
+    return false;
+  }
+  BigNum& n = *key.order_of_g_;
+  int qlen = BigHighBit(n);
+  int size = 2 * n.capacity_ + 1 + (size_hash + 7) / 8;
+  if (r.Capacity() < n.size_ || s.Capacity() < n.size_) {
+    LOG(ERROR) << "EcdsaSign: r or s too small\n";
+    return false;
+  }
+  BigNum e(size);
+  BigNum k(size);
+  BigNum k_inv(size);
+  BigNum x(*key.a_, size);
+  BigNum t(size);
+  BigNum u(size);
+  BigNum rr(size);
+  BigNum ss(size);
+  CurvePoint R(1 + 2 * key.c_.p_->capacity_);
+  MontgomeryContext n_mont;
+  EccBaseTable* g_table = key.GeneratorTable();
+  EccBaseTable call_table;
+  bool ret = false;
+
+  if (!Bits2Int(size_hash, hash, qlen, e) || !BigModNormalize(e, n) ||
+      !BigModNormalize(x, n) || !n_mont.Init(n))
+    return false;
+  if (g_table == nullptr || g_table->scalar_bits_ < qlen) {
+    // narrow windows, the table serves one signature
+    if (!call_table.Init(key.c_, key.g_, qlen, 4)) {
+      LOG(ERROR) << "EcdsaSign: can't build a generator table\n";
+      return false;
+    }
+    g_table = &call_table;
+  }
+  for (int attempt = 0; attempt < 8; attempt++) {
+    if (!EcdsaNonce(n, x, size_hash, hash, attempt, k) ||
+        !g_table->Mult(key.c_, k, R)) {
+      LOG(ERROR) << "EcdsaSign: can't compute kG\n";
+      break;
+    }
+    rr.ZeroNum();
+    if (!rr.CopyFrom(*R.x_) || !BigModNormalize(rr, n))
+      break;
+    if (rr.IsZero())
+      continue;
+    k_inv.ZeroNum();
+    t.ZeroNum();
+    u.ZeroNum();
+    ss.ZeroNum();
+    if (!BigModInv(k, n, k_inv, BIG_MODINV_CONSTTIME) ||
+        !BigModMultConstantTime(rr, x, n_mont, t) || !BigModAdd(e, t, n, u) ||
+        !BigModMultConstantTime(k_inv, u, n_mont, ss))
+      break;
+    if (ss.IsZero())
+      continue;
+    r.ZeroNum();
+    s.ZeroNum();
+    ret = r.CopyFrom(rr) && s.CopyFrom(ss);
+    break;
+  }
+  k.ZeroNum();
+  k_inv.ZeroNum();
+  x.ZeroNum();
+  t.ZeroNum();
+  u.ZeroNum();
+  return ret;
+}
+
+//  Accepts if x(u1 G + u2 base_) = r mod n, u1= e/s and u2= r/s, the two
+//  products in one pass of EccJointMult.
+bool EcdsaVerify(EccKey& key, int size_hash, byte* hash, BigNum& r,
+                 BigNum& s) {
+  if (key.order_of_g_ == nullptr || key.c_.p_ == nullptr ||
+      key.base_.x_ == nullptr) {
+    LOG(ERROR) << "EcdsaVerify: not a public key\n";
+    return false;
+  }
+  BigNum& n = *key.order_of_g_;
+  if (r.IsNegative() || s.IsNegative() || r.IsZero() || s.IsZero() ||
+      BigCompare(r, n) >= 0 || BigCompare(s, n) >= 0)
+    return false;
+  int qlen = BigHighBit(n);
+  int size = 2 * n.capacity_ + 1 + (size_hash + 7) / 8;
+  BigNum e(size);
+  BigNum w(size);
+  BigNum u1(size);
+  BigNum u2(size);
+  BigNum v(size);
+  CurvePoint X(1 + 2 * key.c_.p_->capacity_);
+
+  if (!Bits2Int(size_hash, hash, qlen, e) || !BigModNormalize(e, n) ||
+      !BigModInv(s, n, w) || !BigModMult(e, w, n, u1) ||
+      !BigModMult(r, w, n, u2))
+    return false;
+  if (!EccJointMult(key.c_, u1, key.g_, u2, key.base_, X)) {
+    LOG(ERROR) << "EcdsaVerify: EccJointMult failed\n";
+    return false;
+  }
+  if (X.IsZero())
+    return false;
+  if (!v.CopyFrom(*X.x_) || !BigModNormalize(v, n))
+    return false;
+  return BigCompare(v, r) == 0;
+}
+
+static string EcdsaAlgorithmName(EccKey& key, const char* hashalg) {
+  return string("ecdsa-") + std::to_string(key.bit_size_modulus_) + "-" +
+         hashalg;
+}
+
+bool EcdsaSignToSignature(EccKey& key, const char* hashalg, int size_hash,
+                          byte* hash, Signature& sig) {
+  if (key.order_of_g_ == nullptr)
+    return false;
+  if (sig.signature_ != nullptr || sig.encryption_alg_ != nullptr ||
+      sig.signer_name_ != nullptr) {
+    LOG(ERROR) << "EcdsaSignToSignature: signature already filled in\n";
+    return false;
+  }
+  int rlen = (BigHighBit(*key.order_of_g_) + NBITSINBYTE - 1) / NBITSINBYTE;
+  BigNum r(key.order_of_g_->capacity_);
+  BigNum s(key.order_of_g_->capacity_);
+
+  if (!EcdsaSign(key, size_hash, hash, r, s))
+    return false;
+  // sig is only touched once both halves are encoded
+  byte* out = new byte[2 * rlen];
+  if (!BigNumToBytes(r, rlen, out) || !BigNumToBytes(s, rlen, out + rlen)) {
+    delete []out;
+    return false;
+  }
+  sig.signature_ = out;
+  sig.size_signature_ = 2 * rlen;
+  sig.encryption_alg_ = strdup(EcdsaAlgorithmName(key, hashalg).c_str());
+  if (key.key_name_ != nullptr)
+    sig.signer_name_ = strdup(key.key_name_->c_str());
+  return true;
+}
+
+bool EcdsaVerifySignature(EccKey& key, const char* hashalg, int size_hash,
+                          byte* hash, Signature& sig) {
+  if (key.order_of_g_ == nullptr || sig.signature_ == nullptr ||
+      sig.encryption_alg_ == nullptr)
+    return false;
+  if (EcdsaAlgorithmName(key, hashalg) != sig.encryption_alg_) {
+    LOG(ERROR) << "EcdsaVerifySignature: wrong algorithm "
+               << sig.encryption_alg_ << "\n";
+    return false;
+  }
+  int rlen = (BigHighBit(*key.order_of_g_) + NBITSINBYTE - 1) / NBITSINBYTE;
+  if (sig.size_signature_ != 2 * rlen)
+    return false;
+  BigNum r(1 + 2 * key.order_of_g_->capacity_);
+  BigNum s(1 + 2 * key.order_of_g_->capacity_);
+
+  if (!BytesToBigNum(rlen, sig.signature_, r) ||
+      !BytesToBigNum(rlen, sig.signature_ + rlen, s))
+    return false;
+  return EcdsaVerify(key, size_hash, hash, r, s);
+}
@@ -0,0 +1,750 @@
+//
+// Copyright 2014 John Manferdelli, All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// or in the the file LICENSE-2.0.txt in the top level sourcedirectory
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+// Project: New Cloudproxy Crypto
+// File: p256.cc
+
+#include "cryptotypes.h"
+#include "bignum.h"
+#include "ecc.h"
+#include "p256.h"
+#include "fixed_arith.h"
+#include "util.h"
+
+static const uint64_t P256_p[P256_DIGITS] = {
+    0xffffffffffffffffULL, 0x00000000ffffffffULL, 0ULL, 0xffffffff00000001ULL};
+static const uint64_t P256_a[P256_DIGITS] = {
+    0xfffffffffffffffcULL, 0x00000000ffffffffULL, 0ULL, 0xffffffff00000001ULL};
+static const uint64_t P256_b[P256_DIGITS] = {
+    0x3bce3c3e27d2604bULL, 0x651d06b0cc53b0f6ULL, 0xb3ebbd55769886bcULL,
+    0x5ac635d8aa3a93e7ULL};
+
+// r= a if mask is all ones, b if mask is zero
+static inline void P256Select(uint64_t mask, const uint64_t* a,
+                              const uint64_t* b, uint64_t* r) {
+  for (int i = 0; i < P256_DIGITS; i++) r[i] = (a[i] & mask) | (b[i] & ~mask);
+}
+
+// all ones if a == 0
+static inline uint64_t P256ZeroMask(const uint64_t* a) {
+  uint64_t t = a[0] | a[1] | a[2] | a[3];
+  return ((t | (0ULL - t)) >> 63) - 1ULL;
+}
+
+// r= t - p if carry:t >= p, else t
+static inline void P256FinalSub(uint64_t carry, const uint64_t* t,
+                                uint64_t* r) {
+  uint64_t d[P256_DIGITS];
+  uint64_t borrow = FixedSub<P256_DIGITS>(t, P256_p, d);
+  uint64_t keep = 0ULL - (borrow & (carry ^ 1ULL));
+  P256Select(keep, t, d, r);
+}
+
+void P256Add(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  uint64_t t[P256_DIGITS];
+  uint64_t carry = FixedAdd<P256_DIGITS>(a, b, t);
+  P256FinalSub(carry, t, r);
+}
+
+void P256Sub(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  uint64_t t[P256_DIGITS];
+  uint64_t m[P256_DIGITS];
+  uint64_t mask = 0ULL - FixedSub<P256_DIGITS>(a, b, t);
+  for (int i = 0; i < P256_DIGITS; i++) m[i] = P256_p[i] & mask;
+  FixedAdd<P256_DIGITS>(t, m, r);
+}
+
+void P256Neg(const uint64_t* a, uint64_t* r) {
+  uint64_t zero[P256_DIGITS] = {0ULL, 0ULL, 0ULL, 0ULL};
+  P256Sub(zero, a, r);
+}
+
+//  r= t (mod p), t has 8 digits.  NIST Solinas reduction, FIPS 186-4
+//  D.2.3: with c0..c15 the 32 bit words of t,
+//    t= s1 + 2s2 + 2s3 + s4 + s5 - s6 - s7 - s8 - s9 (mod p)
+//  where each si is a 256 bit number made of words of t.  The terms are
+//  assembled as 64 bit digits and summed column by column with a signed
+//  carry, which is then folded back in.
+void P256Reduce(const uint64_t* t, uint64_t* r) {
+  const uint64_t lo = 0x00000000ffffffffULL;
+  const uint64_t hi = 0xffffffff00000000ULL;
+  uint64_t s2[P256_DIGITS] = {0ULL, t[5] & hi, t[6], t[7]};
+  uint64_t s3[P256_DIGITS] = {0ULL, t[6] << 32, (t[7] << 32) | (t[6] >> 32),
+                              t[7] >> 32};
+  uint64_t s4[P256_DIGITS] = {t[4], t[5] & lo, 0ULL, t[7]};
+  uint64_t s5[P256_DIGITS] = {(t[5] << 32) | (t[4] >> 32),
+                              (t[6] & hi) | (t[5] >> 32), t[7],
+                              (t[4] << 32) | (t[6] >> 32)};
+  uint64_t s6[P256_DIGITS] = {(t[6] << 32) | (t[5] >> 32), t[6] >> 32, 0ULL,
+                              (t[5] << 32) | (t[4] & lo)};
+  uint64_t s7[P256_DIGITS] = {t[6], t[7], 0ULL, (t[5] & hi) | (t[4] >> 32)};
+  uint64_t s8[P256_DIGITS] = {(t[7] << 32) | (t[6] >> 32),
+                              (t[4] << 32) | (t[7] >> 32),
+                              (t[5] << 32) | (t[4] >> 32), t[6] << 32};
+  uint64_t s9[P256_DIGITS] = {t[7], t[4] & hi, t[5], t[6] & hi};
+  uint64_t w[P256_DIGITS];
+  int128_t carry = 0;
+  int i;
+
+  for (i = 0; i < P256_DIGITS; i++) {
+    int128_t sum = carry + (int128_t)t[i] + 2 * (int128_t)s2[i] +
+                   2 * (int128_t)s3[i] + (int128_t)s4[i] + (int128_t)s5[i] -
+                   (int128_t)s6[i] - (int128_t)s7[i] - (int128_t)s8[i] -
+                   (int128_t)s9[i];
+    w[i] = (uint64_t)sum;
+    carry = sum >> 64;
+  }
+  // c 2^256= c (2^224 - 2^192 - 2^96 + 1) (mod p), -4 <= c <= 6, then
+  // -1 <= c <= 1 and then 0
+  for (int k = 0; k < 2; k++) {
+    int64_t c = (int64_t)carry;
+    int64_t c32 = c * (1LL << 32);
+    carry = (int128_t)w[0] + c;
+    w[0] = (uint64_t)carry;
+    carry = (carry >> 64) + (int128_t)w[1] - c32;
+    w[1] = (uint64_t)carry;
+    carry = (carry >> 64) + (int128_t)w[2];
+    w[2] = (uint64_t)carry;
+    carry = (carry >> 64) + (int128_t)w[3] + (c32 - c);
+    w[3] = (uint64_t)carry;
+    carry >>= 64;
+  }
+  P256FinalSub(0ULL, w, r);
+}
+
+void P256Mult(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  uint64_t t[2 * P256_DIGITS];
+  FixedMult<P256_DIGITS>(a, b, t);
+  P256Reduce(t, r);
+}
+
+void P256Square(const uint64_t* a, uint64_t* r) {
+  uint64_t t[2 * P256_DIGITS];
+  FixedSquare<P256_DIGITS>(a, t);
+  P256Reduce(t, r);
+}
+
+// r= a^(2^n)
+static void P256SquareN(const uint64_t* a, int n, uint64_t* r) {
+  P256Square(a, r);
+  for (int i = 1; i < n; i++) P256Square(r, r);
+}
+
+//  r= a^(p-2), 255 squares and 12 multiplies.  x_k below is a^(2^k-1);
+//  p-2= ffffffff 00000001 00000000 00000000 00000000 ffffffff ffffffff
+//  fffffffd in hex.
+void P256Inv(const uint64_t* a, uint64_t* r) {
+  uint64_t x2[P256_DIGITS];
+  uint64_t x3[P256_DIGITS];
+  uint64_t x6[P256_DIGITS];
+  uint64_t x12[P256_DIGITS];
+  uint64_t x15[P256_DIGITS];
+  uint64_t x30[P256_DIGITS];
+  uint64_t x32[P256_DIGITS];
+  uint64_t t[P256_DIGITS];
+
+  P256Square(a, t);
+  P256Mult(t, a, x2);
+  P256Square(x2, t);
+  P256Mult(t, a, x3);
+  P256SquareN(x3, 3, t);
+  P256Mult(t, x3, x6);
+  P256SquareN(x6, 6, t);
+  P256Mult(t, x6, x12);
+  P256SquareN(x12, 3, t);
+  P256Mult(t, x3, x15);
+  P256SquareN(x15, 15, t);
+  P256Mult(t, x15, x30);
+  P256SquareN(x30, 2, t);
+  P256Mult(t, x2, x32);
+
+  P256SquareN(x32, 32, t);
+  P256Mult(t, a, t);
+  P256SquareN(t, 128, t);
+  P256Mult(t, x32, t);
+  P256SquareN(t, 32, t);
+  P256Mult(t, x32, t);
+  P256SquareN(t, 30, t);
+  P256Mult(t, x30, t);
+  P256SquareN(t, 2, t);
+  P256Mult(t, a, r);
+}
+
+// r= a (mod p)
+bool P256FromBigNum(BigNum& a, uint64_t* r) {
+  int i;
+
+  if (a.sign_ || a.size_ > P256_DIGITS) {
+    BigNum p(P256_DIGITS);
+    BigNum t(a.Capacity() > P256_DIGITS ? a.Capacity() : P256_DIGITS);
+    for (i = 0; i < P256_DIGITS; i++) p.value_[i] = P256_p[i];
+    p.Normalize();
+    t.CopyFrom(a);
+    if (!BigModNormalize(t, p)) {
+      LOG(ERROR) << "P256FromBigNum: BigModNormalize failed\n";
+      return false;
+    }
+    return P256FromBigNum(t, r);
+  }
+  uint64_t t[P256_DIGITS];
+  for (i = 0; i < P256_DIGITS; i++) t[i] = i < a.size_ ? a.value_[i] : 0ULL;
+  P256FinalSub(0ULL, t, r);
+  return true;
+}
+
+bool P256ToBigNum(const uint64_t* a, BigNum& r) {
+  if (r.Capacity() < P256_DIGITS) {
+    LOG(ERROR) << "P256ToBigNum: result too small\n";
+    return false;
+  }
+  r.ZeroNum();
+  for (int i = 0; i < P256_DIGITS; i++) r.value_[i] = a[i];
+  r.Normalize();
+  return true;
+}
+
+void P256Point::MakeZero() {
+  for (int i = 0; i < P256_DIGITS; i++) {
+    x_[i] = 0ULL;
+    y_[i] = 0ULL;
+    z_[i] = 0ULL;
+  }
+  y_[0] = 1ULL;
+}
+
+static bool P256Equal(BigNum* a, const uint64_t* b) {
+  if (a == nullptr || a->sign_ || a->size_ > P256_DIGITS) return false;
+  for (int i = 0; i < P256_DIGITS; i++) {
+    if ((i < a->size_ ? a->value_[i] : 0ULL) != b[i]) return false;
+  }
+  return true;
+}
+
+// True if c is NIST P-256, a= -3
+bool IsP256Curve(EccCurve& c) {
+  return P256Equal(c.p_, P256_p) && P256Equal(c.a_, P256_a) &&
+         P256Equal(c.b_, P256_b);
+}
+
+//  Complete addition for a= -3, Renes, Costello, Batina, "Complete addition
+//  formulas for prime order elliptic curves", algorithm 4.  Correct for
+//  every pair of inputs, including P == Q and infinity, so a scalar
+//  multiply needs no special cases.  R may be P or Q.
+void P256PointAdd(const P256Point& P, const P256Point& Q, P256Point& R) {
+  uint64_t t0[P256_DIGITS], t1[P256_DIGITS], t2[P256_DIGITS];
+  uint64_t t3[P256_DIGITS], t4[P256_DIGITS];
+  uint64_t x3[P256_DIGITS], y3[P256_DIGITS], z3[P256_DIGITS];
+
+  P256Mult(P.x_, Q.x_, t0);
+  P256Mult(P.y_, Q.y_, t1);
+  P256Mult(P.z_, Q.z_, t2);
+  P256Add(P.x_, P.y_, t3);
+  P256Add(Q.x_, Q.y_, t4);
+  P256Mult(t3, t4, t3);
+  P256Add(t0, t1, t4);
+  P256Sub(t3, t4, t3);
+  P256Add(P.y_, P.z_, t4);
+  P256Add(Q.y_, Q.z_, x3);
+  P256Mult(t4, x3, t4);
+  P256Add(t1, t2, x3);
+  P256Sub(t4, x3, t4);
+  P256Add(P.x_, P.z_, x3);
+  P256Add(Q.x_, Q.z_, y3);
+  P256Mult(x3, y3, x3);
+  P256Add(t0, t2, y3);
+  P256Sub(x3, y3, y3);
+  P256Mult(P256_b, t2, z3);
+  P256Sub(y3, z3, x3);
+  P256Add(x3, x3, z3);
+  P256Add(x3, z3, x3);
+  P256Sub(t1, x3, z3);
+  P256Add(t1, x3, x3);
+  P256Mult(P256_b, y3, y3);
+  P256Add(t2, t2, t1);
+  P256Add(t1, t2, t2);
+  P256Sub(y3, t2, y3);
+  P256Sub(y3, t0, y3);
+  P256Add(y3, y3, t1);
+  P256Add(t1, y3, y3);
+  P256Add(t0, t0, t1);
+  P256Add(t1, t0, t0);
+  P256Sub(t0, t2, t0);
+  P256Mult(t4, y3, t1);
+  P256Mult(t0, y3, t2);
+  P256Mult(x3, z3, y3);
+  P256Add(y3, t2, y3);
+  P256Mult(t3, x3, x3);
+  P256Sub(x3, t1, x3);
+  P256Mult(t4, z3, z3);
+  P256Mult(t3, t0, t1);
+  P256Add(z3, t1, z3);
+
+  for (int i = 0; i < P256_DIGITS; i++) {
+    R.x_[i] = x3[i];
+    R.y_[i] = y3[i];
+    R.z_[i] = z3[i];
+  }
+}
+
+//  Complete doubling for a= -3, algorithm 6 of the same paper.  R may be P.
+void P256PointDouble(const P256Point& P, P256Point& R) {
+  uint64_t t0[P256_DIGITS], t1[P256_DIGITS], t2[P256_DIGITS];
+  uint64_t t3[P256_DIGITS];
+  uint64_t x3[P256_DIGITS], y3[P256_DIGITS], z3[P256_DIGITS];
+
+  P256Square(P.x_, t0);
+  P256Square(P.y_, t1);
+  P256Square(P.z_, t2);
+  P256Mult(P.x_, P.y_, t3);
+  P256Add(t3, t3, t3);
+  P256Mult(P.x_, P.z_, z3);
+  P256Add(z3, z3, z3);
+  P256Mult(P256_b, t2, y3);
+  P256Sub(y3, z3, y3);
+  P256Add(y3, y3, x3);
+  P256Add(x3, y3, y3);
+  P256Sub(t1, y3, x3);
+  P256Add(t1, y3, y3);
+  P256Mult(x3, y3, y3);
+  P256Mult(x3, t3, x3);
+  P256Add(t2, t2, t3);
+  P256Add(t2, t3, t2);
+  P256Mult(P256_b, z3, z3);
+  P256Sub(z3, t2, z3);
+  P256Sub(z3, t0, z3);
+  P256Add(z3, z3, t3);
+  P256Add(z3, t3, z3);
+  P256Add(t0, t0, t3);
+  P256Add(t3, t0, t0);
+  P256Sub(t0, t2, t0);
+  P256Mult(t0, z3, t0);
+  P256Add(y3, t0, y3);
+  P256Mult(P.y_, P.z_, t0);
+  P256Add(t0, t0, t0);
+  P256Mult(t0, z3, z3);
+  P256Sub(x3, z3, x3);
+  P256Mult(t0, t1, z3);
+  P256Add(z3, z3, z3);
+  P256Add(z3, z3, z3);
+
+  for (int i = 0; i < P256_DIGITS; i++) {
+    R.x_[i] = x3[i];
+    R.y_[i] = y3[i];
+    R.z_[i] = z3[i];
+  }
+}
+
+bool P256PointFromCurvePoint(CurvePoint& P, P256Point& R) {
+  if (P.z_->IsZero()) {
+    R.MakeZero();
+    return true;
+  }
+  return P256FromBigNum(*P.x_, R.x_) && P256FromBigNum(*P.y_, R.y_) &&
+         P256FromBigNum(*P.z_, R.z_);
+}
+
+bool P256PointToAffine(const P256Point& P, CurvePoint& R) {
+  uint64_t z_inv[P256_DIGITS];
+  uint64_t t[P256_DIGITS];
+
+  if (P256ZeroMask(P.z_) != 0ULL) {
+    R.MakeZero();
+    return true;
+  }
+  P256Inv(P.z_, z_inv);
+  P256Mult(P.x_, z_inv, t);
+  if (!P256ToBigNum(t, *R.x_)) return false;
+  P256Mult(P.y_, z_inv, t);
+  if (!P256ToBigNum(t, *R.y_)) return false;
+  R.z_->CopyFrom(Big_One);
+  return true;
+}
+
+
+//  Jacobian coordinates on the same field, x= x_/z_^2, y= y_/z_^3.  These
+//  use the a= -3 doubling dbl-2001-b (3M+5S) and add-2007-bl or
+//  madd-2007-bl, cheaper than the complete formulas above but with the
+//  usual exceptional case P= Q, which is handled by a branch.
+
+// R= 2P, R may be P
+void P256JacobianDouble(const P256Point& P, P256Point& R) {
+  uint64_t delta[P256_DIGITS], gamma[P256_DIGITS], beta[P256_DIGITS];
+  uint64_t alpha[P256_DIGITS], t1[P256_DIGITS], t2[P256_DIGITS];
+
+  P256Square(P.z_, delta);
+  P256Square(P.y_, gamma);
+  P256Mult(P.x_, gamma, beta);
+  // alpha= 3(x-delta)(x+delta)
+  P256Sub(P.x_, delta, t1);
+  P256Add(P.x_, delta, t2);
+  P256Mult(t1, t2, alpha);
+  P256Add(alpha, alpha, t1);
+  P256Add(t1, alpha, alpha);
+  // z3= (y+z)^2-gamma-delta
+  P256Add(P.y_, P.z_, t1);
+  P256Square(t1, t1);
+  P256Sub(t1, gamma, t1);
+  P256Sub(t1, delta, R.z_);
+  // x3= alpha^2-8 beta
+  P256Add(beta, beta, beta);
+  P256Add(beta, beta, beta);
+  P256Add(beta, beta, t2);
+  P256Square(alpha, t1);
+  P256Sub(t1, t2, R.x_);
+  // y3= alpha(4 beta-x3)-8 gamma^2
+  P256Sub(beta, R.x_, t1);
+  P256Mult(alpha, t1, t1);
+  P256Square(gamma, t2);
+  P256Add(t2, t2, t2);
+  P256Add(t2, t2, t2);
+  P256Add(t2, t2, t2);
+  P256Sub(t1, t2, R.y_);
+}
+
+// R= 2^n P
+void P256JacobianDoubleN(const P256Point& P, int n, P256Point& R) {
+  if (&R != &P) R = P;
+  for (int i = 0; i < n; i++) P256JacobianDouble(R, R);
+}
+
+//  R= P+Q, Q affine (z_= 1, or 0 for infinity) if mixed.  Infinity in
+//  either input is handled with masks; P= Q, which a scalar multiply
+//  only reaches on small multiples, branches to doubling.
+static inline void P256JacobianAddInternal(const P256Point& P,
+                                           const P256Point& Q, bool mixed,
+                                           P256Point& R) {
+  uint64_t z1z1[P256_DIGITS], z2z2[P256_DIGITS];
+  uint64_t u1[P256_DIGITS], u2[P256_DIGITS], s1[P256_DIGITS], s2[P256_DIGITS];
+  uint64_t h[P256_DIGITS], r[P256_DIGITS], i[P256_DIGITS], j[P256_DIGITS];
+  uint64_t v[P256_DIGITS], t1[P256_DIGITS];
+  P256Point S;
+
+  uint64_t p_zero = P256ZeroMask(P.z_);
+  uint64_t q_zero = P256ZeroMask(Q.z_);
+
+  P256Square(P.z_, z1z1);
+  P256Mult(Q.x_, z1z1, u2);
+  P256Mult(P.z_, z1z1, t1);
+  P256Mult(Q.y_, t1, s2);
+  if (mixed) {
+    for (int k = 0; k < P256_DIGITS; k++) {
+      u1[k] = P.x_[k];
+      s1[k] = P.y_[k];
+    }
+  } else {
+    P256Square(Q.z_, z2z2);
+    P256Mult(P.x_, z2z2, u1);
+    P256Mult(Q.z_, z2z2, t1);
+    P256Mult(P.y_, t1, s1);
+  }
+  P256Sub(u2, u1, h);
+  P256Sub(s2, s1, t1);
+  P256Add(t1, t1, r);
+  if ((P256ZeroMask(h) & ~p_zero & ~q_zero) != 0ULL) {
+    if (P256ZeroMask(r) != 0ULL) {
+      P256JacobianDouble(P, R);
+    } else {
+      R.MakeZero();
+    }
+    return;
+  }
+
+  // z3= ((z1+z2)^2-z1z1-z2z2)h, 2 z1 h if z2= 1
+  if (mixed) {
+    P256Add(P.z_, P.z_, t1);
+  } else {
+    P256Add(P.z_, Q.z_, t1);
+    P256Square(t1, t1);
+    P256Sub(t1, z1z1, t1);
+    P256Sub(t1, z2z2, t1);
+  }
+  P256Mult(t1, h, S.z_);
+  // i= (2h)^2, j= hi, v= u1 i
+  P256Add(h, h, t1);
+  P256Square(t1, i);
+  P256Mult(h, i, j);
+  P256Mult(u1, i, v);
+  // x3= r^2-j-2v
+  P256Square(r, t1);
+  P256Sub(t1, j, t1);
+  P256Sub(t1, v, t1);
+  P256Sub(t1, v, S.x_);
+  // y3= r(v-x3)-2 s1 j
+  P256Sub(v, S.x_, t1);
+  P256Mult(r, t1, t1);
+  P256Mult(s1, j, j);
+  P256Add(j, j, j);
+  P256Sub(t1, j, S.y_);
+
+  P256Select(p_zero, Q.x_, S.x_, S.x_);
+  P256Select(p_zero, Q.y_, S.y_, S.y_);
+  P256Select(p_zero, Q.z_, S.z_, S.z_);
+  P256Select(q_zero, P.x_, S.x_, R.x_);
+  P256Select(q_zero, P.y_, S.y_, R.y_);
+  P256Select(q_zero, P.z_, S.z_, R.z_);
+}
+
+// R= P+Q, R may be P or Q
+void P256JacobianAdd(const P256Point& P, const P256Point& Q, P256Point& R) {
+  P256JacobianAddInternal(P, Q, false, R);
+}
+
+// R= P+Q, Q affine, R may be P
+void P256JacobianMixedAdd(const P256Point& P, const P256Point& Q,
+                          P256Point& R) {
+  P256JacobianAddInternal(P, Q, true, R);
+}
+
+bool P256JacobianToAffine(const P256Point& P, CurvePoint& R) {
+  uint64_t z_inv[P256_DIGITS];
+  uint64_t z_inv2[P256_DIGITS];
+  uint64_t t[P256_DIGITS];
+
+  if (P256ZeroMask(P.z_) != 0ULL) {
+    R.MakeZero();
+    return true;
+  }
+  P256Inv(P.z_, z_inv);
+  P256Square(z_inv, z_inv2);
+  P256Mult(P.x_, z_inv2, t);
+  if (!P256ToBigNum(t, *R.x_)) return false;
+  P256Mult(z_inv2, z_inv, z_inv2);
+  P256Mult(P.y_, z_inv2, t);
+  if (!P256ToBigNum(t, *R.y_)) return false;
+  R.z_->CopyFrom(Big_One);
+  return true;
+}
+
+//  R= |x| P in affine coordinates, x < 2^256.  Signed 5 bit windows over
+//  a Jacobian table of P, 2P, ..., 16P: each window does five doublings
+//  and adds a table entry read by a full scan and negated with a mask,
+//  so the time does not depend on x.
+bool P256PointMult(CurvePoint& P, BigNum& x, CurvePoint& R) {
+  P256Point table[16];
+  P256Point accum;
+  P256Point entry;
+  uint64_t t[P256_DIGITS];
+  int digits[52];
+  int i, j;
+
+  if (x.size_ > P256_DIGITS || !SignedWindowRecode(x, 5, 52, digits)) {
+    LOG(ERROR) << "P256PointMult: scalar too large\n";
+    return false;
+  }
+
+  // homogeneous (X:Y:Z) is Jacobian (XZ:YZ^2:Z)
+  if (!P256PointFromCurvePoint(P, table[0])) return false;
+  P256Square(table[0].z_, t);
+  P256Mult(table[0].y_, t, table[0].y_);
+  P256Mult(table[0].x_, table[0].z_, table[0].x_);
+  for (i = 1; i < 16; i++) {
+    if (i & 1)
+      P256JacobianDouble(table[i / 2], table[i]);
+    else
+      P256JacobianAdd(table[i - 1], table[0], table[i]);
+  }
+
+  accum.MakeZero();
+  for (i = 51; i >= 0; i--) {
+    if (i != 51) P256JacobianDoubleN(accum, 5, accum);
+    uint64_t neg = (uint64_t)((int64_t)digits[i] >> 63);
+    uint64_t abs = ((uint64_t)(int64_t)digits[i] ^ neg) - neg;
+    entry.MakeZero();
+    for (j = 0; j < 16; j++) {
+      uint64_t d = (uint64_t)(j + 1) ^ abs;
+      uint64_t mask = ((d | (0ULL - d)) >> 63) - 1ULL;
+      P256Select(mask, table[j].x_, entry.x_, entry.x_);
+      P256Select(mask, table[j].y_, entry.y_, entry.y_);
+      P256Select(mask, table[j].z_, entry.z_, entry.z_);
+    }
+    P256Neg(entry.y_, t);
+    P256Select(neg, t, entry.y_, entry.y_);
+    P256JacobianAdd(accum, entry, accum);
+  }
+  for (i = 0; i < 52; i++) digits[i] = 0;
+  return P256JacobianToAffine(accum, R);
+}
+
+//  table gets j 2^(w i) G, j= 1, ..., 2^(w-1), for each window i as affine
+//  x, y pairs, 2^(w-1) pairs per window.  One inversion for all of them.
+bool P256BaseTableInit(CurvePoint& G, int w, int num_windows,
+                       uint64_t* table) {
+  int entries = 1 << (w - 1);
+  int n = entries * num_windows;
+  P256Point* pts = new P256Point[n];
+  uint64_t* prod = new uint64_t[P256_DIGITS * n];
+  uint64_t inv[P256_DIGITS];
+  uint64_t z_inv[P256_DIGITS];
+  uint64_t z_inv2[P256_DIGITS];
+  uint64_t t[P256_DIGITS];
+  bool ret = false;
+  int i, j;
+
+  if (!P256PointFromCurvePoint(G, pts[0]) || P256ZeroMask(pts[0].z_) != 0ULL) {
+    LOG(ERROR) << "P256BaseTableInit: bad G\n";
+    goto done;
+  }
+  // homogeneous (X:Y:Z) is Jacobian (XZ:YZ^2:Z)
+  P256Square(pts[0].z_, t);
+  P256Mult(pts[0].y_, t, pts[0].y_);
+  P256Mult(pts[0].x_, pts[0].z_, pts[0].x_);
+  for (i = 0; i < num_windows; i++) {
+    P256Point* row = pts + i * entries;
+    if (i > 0) P256JacobianDouble(row[-1], row[0]);
+    if (entries > 1) P256JacobianDouble(row[0], row[1]);
+    for (j = 2; j < entries; j++) P256JacobianAdd(row[j - 1], row[0], row[j]);
+  }
+
+  // Montgomery's trick: prod[i]= z_0 ... z_i
+  for (j = 0; j < P256_DIGITS; j++) prod[j] = pts[0].z_[j];
+  for (i = 1; i < n; i++)
+    P256Mult(prod + P256_DIGITS * (i - 1), pts[i].z_, prod + P256_DIGITS * i);
+  if (P256ZeroMask(prod + P256_DIGITS * (n - 1)) != 0ULL) {
+    LOG(ERROR) << "P256BaseTableInit: table entry at infinity\n";
+    goto done;
+  }
+  P256Inv(prod + P256_DIGITS * (n - 1), inv);
+  for (i = n - 1; i >= 0; i--) {
+    if (i > 0) {
+      P256Mult(inv, prod + P256_DIGITS * (i - 1), z_inv);
+      P256Mult(inv, pts[i].z_, inv);
+    } else {
+      for (j = 0; j < P256_DIGITS; j++) z_inv[j] = inv[j];
+    }
+    uint64_t* entry = table + 2 * P256_DIGITS * i;
+    P256Square(z_inv, z_inv2);
+    P256Mult(pts[i].x_, z_inv2, entry);
+    P256Mult(z_inv2, z_inv, z_inv2);
+    P256Mult(pts[i].y_, z_inv2, entry + P256_DIGITS);
+  }
+  ret = true;
+
+done:
+  delete []pts;
+  delete []prod;
+  return ret;
+}
+
+//  R= |x| G from a P256BaseTableInit table of G: one mixed addition per
+//  window of x and no doublings.  Each window's entries are all read and
+//  the one wanted kept with a mask, so time and memory access do not
+//  depend on x.
+bool P256BaseTableMult(const uint64_t* table, int w, int num_windows,
+                       BigNum& x, CurvePoint& R) {
+  int entries = 1 << (w - 1);
+  int digits[num_windows];
+  P256Point accum;
+  P256Point entry;
+  uint64_t t[P256_DIGITS];
+  int i, j;
+
+  if (!SignedWindowRecode(x, w, num_windows, digits)) {
+    LOG(ERROR) << "P256BaseTableMult: scalar too large\n";
+    return false;
+  }
+  accum.MakeZero();
+  for (i = 0; i < num_windows; i++) {
+    const uint64_t* row = table + 2 * P256_DIGITS * entries * i;
+    uint64_t neg = (uint64_t)((int64_t)digits[i] >> 63);
+    uint64_t abs = ((uint64_t)(int64_t)digits[i] ^ neg) - neg;
+    entry.MakeZero();
+    for (j = 0; j < entries; j++) {
+      uint64_t d = (uint64_t)(j + 1) ^ abs;
+      uint64_t mask = ((d | (0ULL - d)) >> 63) - 1ULL;
+      P256Select(mask, row + 2 * P256_DIGITS * j, entry.x_, entry.x_);
+      P256Select(mask, row + 2 * P256_DIGITS * j + P256_DIGITS, entry.y_,
+                 entry.y_);
+    }
+    // z= 1, or 0 (infinity) for a zero digit
+    entry.z_[0] = (abs | (0ULL - abs)) >> 63;
+    P256Neg(entry.y_, t);
+    P256Select(neg, t, entry.y_, entry.y_);
+    P256JacobianMixedAdd(accum, entry, accum);
+  }
+  for (i = 0; i < num_windows; i++) digits[i] = 0;
+  return P256JacobianToAffine(accum, R);
+}
+
+//  R= uP+vQ in affine coordinates, u, v < 2^256, over the joint sparse
+//  form as in EccJointMult.  P+Q and P-Q are made affine with one shared
+//  inversion.  Branches on u and v.
+bool P256JointMult(CurvePoint& P, BigNum& u, CurvePoint& Q, BigNum& v,
+                   CurvePoint& R) {
+  int du[P256_DIGITS * NBITSINUINT64 + 1];
+  int dv[P256_DIGITS * NBITSINUINT64 + 1];
+  int len = JsfRecode(u, v, P256_DIGITS * NBITSINUINT64 + 1, du, dv);
+  if (len < 0) {
+    LOG(ERROR) << "P256JointMult: scalar too large\n";
+    return false;
+  }
+
+  // pts[0..3]= P, Q, P+Q, P-Q, pts[4..7] their negatives, all affine
+  P256Point pts[8];
+  P256Point accum;
+  uint64_t z[2][P256_DIGITS];
+  uint64_t prod[P256_DIGITS];
+  uint64_t inv[P256_DIGITS];
+  uint64_t z_inv[P256_DIGITS];
+  uint64_t z_inv2[P256_DIGITS];
+  uint64_t one[P256_DIGITS] = {1ULL, 0ULL, 0ULL, 0ULL};
+  int i, j;
+
+  if (!P256PointFromCurvePoint(P, pts[0]) ||
+      !P256PointFromCurvePoint(Q, pts[1]))
+    return false;
+  for (i = 0; i < 2; i++) {
+    // homogeneous (X:Y:Z) to affine
+    if (P256ZeroMask(pts[i].z_) != 0ULL ||
+        memcmp(pts[i].z_, one, sizeof(one)) == 0)
+      continue;
+    P256Inv(pts[i].z_, z_inv);
+    P256Mult(pts[i].x_, z_inv, pts[i].x_);
+    P256Mult(pts[i].y_, z_inv, pts[i].y_);
+    for (j = 0; j < P256_DIGITS; j++) pts[i].z_[j] = j == 0 ? 1ULL : 0ULL;
+  }
+  pts[5] = pts[1];
+  P256Neg(pts[1].y_, pts[5].y_);
+  P256JacobianMixedAdd(pts[0], pts[1], pts[2]);
+  P256JacobianMixedAdd(pts[0], pts[5], pts[3]);
+
+  // one inversion for both z's, a zero z stands in as 1
+  for (i = 0; i < 2; i++)
+    P256Select(P256ZeroMask(pts[i + 2].z_), one, pts[i + 2].z_, z[i]);
+  P256Mult(z[0], z[1], prod);
+  P256Inv(prod, inv);
+  for (i = 0; i < 2; i++) {
+    P256Point& S = pts[i + 2];
+    P256Mult(inv, z[1 - i], z_inv);
+    P256Square(z_inv, z_inv2);
+    P256Mult(S.x_, z_inv2, S.x_);
+    P256Mult(z_inv2, z_inv, z_inv2);
+    P256Mult(S.y_, z_inv2, S.y_);
+    if (P256ZeroMask(S.z_) != 0ULL)
+      S.MakeZero();
+    else
+      for (j = 0; j < P256_DIGITS; j++) S.z_[j] = one[j];
+  }
+  for (i = 0; i < 4; i++) {
+    if (i == 1) continue;
+    pts[i + 4] = pts[i];
+    P256Neg(pts[i].y_, pts[i + 4].y_);
+  }
+
+  accum.MakeZero();
+  for (i = len - 1; i >= 0; i--) {
+    P256JacobianDouble(accum, accum);
+    int index = JsfTableIndex(du[i], dv[i]);
+    if (index >= 0) P256JacobianMixedAdd(accum, pts[index], accum);
+  }
+  return P256JacobianToAffine(accum, R);
+}
@@ -56,7 +56,7 @@ endif
 dobj=	$(O)/polynomial.o $(O)/rational.o $(O)/schooftest.o $(O)/util.o \
 	$(O)/bignum.o $(O)/globals.o $(O)/basic_arith.o $(O)/number_theory.o $(O)/arith64.o \
 	$(O)/intel64_arith.o $(O)/smallprimes.o $(O)/conversions.o $(O)/ecc_symbolic.o \
-	$(O)/rsa.o $(O)/keys.o $(O)/keys.pb.o $(O)/ecc.o $(O)/schoof.o $(O)/bsgs.o
+	$(O)/rsa.o $(O)/keys.o $(O)/keys.pb.o $(O)/ecc.o $(O)/p256.o $(O)/schoof.o $(O)/bsgs.o
 
 all:	schooftest.exe
 clean:
@@ -81,6 +81,10 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
 $(O)/ecc_symbolic.o: $(SRC_DIR)/ecc/ecc_symbolic.cc
 	@echo "compiling ecc_symbolic.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc_symbolic.o $(SRC_DIR)/ecc/ecc_symbolic.cc
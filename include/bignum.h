@@ -21,6 +21,7 @@
 #include <string>
 #include <memory>
 #include <iostream>
+#include <atomic>
 
 #include "cryptotypes.h"
 
@@ -29,6 +30,71 @@
 
 using std::string;
 
+class WriteFile;
+
+//  Per thread bump allocator for temporaries.  Digits are handed out in
+//  stack order from a list of blocks and given back by rewinding to a
+//  mark, normally through a ScratchFrame.  Blocks are kept for reuse
+//  until the thread exits.
+class ScratchArena {
+ public:
+  struct Mark {
+    int block_;
+    int used_;
+    int64_t in_use_;
+  };
+
+  ScratchArena();
+  ~ScratchArena();
+
+  uint64_t* Alloc(int num_digits);  // not zeroed
+  Mark GetMark();
+  void Release(Mark& mark);
+
+  int64_t InUse() { return in_use_; }
+  int64_t PeakInUse() { return peak_in_use_; }  // digits
+  int64_t BlockDigits() { return block_digits_; }
+  int NumBlocks() { return num_blocks_; }
+  void ResetPeak() { peak_in_use_ = in_use_; }
+
+ private:
+  struct Block {
+    uint64_t* digits_;
+    int size_;
+    int used_;
+  };
+  Block* blocks_;
+  int num_blocks_;
+  int max_blocks_;
+  int current_;
+  int64_t in_use_;
+  int64_t peak_in_use_;
+  int64_t block_digits_;
+};
+
+//  The calling thread's arena.
+ScratchArena& ThreadScratchArena();
+
+//  Temporaries drawn from the arena while a frame is live are released
+//  when it goes out of scope.  Declare the frame before the BigNums.
+class ScratchFrame {
+ public:
+  ScratchFrame();
+  ~ScratchFrame();
+  uint64_t* Alloc(int num_digits);
+
+ private:
+  ScratchArena& arena_;
+  ScratchArena::Mark mark_;
+};
+
+//  Numbers with capacity up to BIGNUM_INLINE_DIGITS live in inline_ and
+//  need no allocation.  That covers the 1+2*size temporaries of P-521.
+//  Several asm loops store their final carry at value_[capacity_], so
+//  every BigNum keeps one spare digit past capacity_, whether its digits
+//  are inline, from new or from an arena.
+#define BIGNUM_INLINE_DIGITS 20
+
 //  num= value_[0]+ 2^64 value_[1] + ... + 2^(64n) value_[n]
 class BigNum {
  public:
@@ -36,13 +102,21 @@ class BigNum {
   __attribute__((aligned(4))) int capacity_;
   __attribute__((aligned(4))) int size_;
   __attribute__((aligned(8))) uint64_t* value_;
+  bool allocated_;  // value_ came from new
+  ScratchFrame* frame_;  // frame the number was made in, or nullptr
+  __attribute__((aligned(8))) uint64_t inline_[BIGNUM_INLINE_DIGITS + 1];
 
   BigNum(int size);
+  BigNum(int size, ScratchFrame& frame);  // digits from frame if not inline
   BigNum(BigNum& n);
   BigNum(BigNum& n, int capacity);
+  BigNum(BigNum&& n);
   BigNum(int size, uint64_t);  // BigNum with one initialized digit
   ~BigNum();
 
+  BigNum& operator=(BigNum&& n);
+  BigNum& operator=(const BigNum& n) = delete;
+
   int Capacity();  // total number of digits (64 bits) allocated
   int Size();      // number of digit required to hold current value
   uint64_t* ValuePtr();
@@ -56,6 +130,12 @@ class BigNum {
   void ZeroNum();
   bool CopyFrom(BigNum&);
   bool CopyTo(BigNum&);
+  bool Swap(BigNum&);  // exchanges values and, if it can, capacities
+
+ private:
+  bool IsInline() { return value_ == inline_; }
+  bool IsBorrowed() { return !allocated_ && !IsInline(); }  // frame digits
+  void Allocate(int capacity);
 };
 
 // Support functions
@@ -76,6 +156,10 @@ bool DigitArrayConvertToDecimal(int size_a, uint64_t* a, int* size_s, char* s);
 bool DigitArrayConvertToHex(int size_a, uint64_t* a, int* size_s, char* s);
 int DigitArrayConvertFromHex(const char* s, int size_a, uint64_t* a);
 int DigitArrayConvertFromDecimal(const char* s, int size_a, uint64_t* a);
+bool DigitArrayConvertToDecimalFile(int size_a, uint64_t* a, WriteFile* out);
+bool DigitArrayUseAvx2();
+bool DigitArrayMontExpBatch4(int size_m, uint64_t* m, uint64_t** b,
+                             int* size_e, uint64_t** e, uint64_t** out);
 int DigitArrayAdd(int size_a, uint64_t* a, int size_b, uint64_t* b,
                   int size_result, uint64_t* result);
 int DigitArraySub(int size_a, uint64_t* a, int size_b, uint64_t* b,
@@ -86,6 +170,13 @@ void Uint64AddStep(uint64_t a, uint64_t b, uint64_t* result, uint64_t* carry);
 void Uint64MultStep(uint64_t a, uint64_t b, uint64_t* result, uint64_t* carry);
 void Uint64DivStep(uint64_t a, uint64_t b, uint64_t c, uint64_t* result,
                    uint64_t* carry);
+uint64_t Uint64Reciprocal(uint64_t d);
+uint64_t Uint64Reciprocal3By2(uint64_t d1, uint64_t d0);
+void Uint64DivStep2By1(uint64_t u1, uint64_t u0, uint64_t d, uint64_t v,
+                       uint64_t* q, uint64_t* r);
+void Uint64DivStep3By2(uint64_t u2, uint64_t u1, uint64_t u0, uint64_t d1,
+                       uint64_t d0, uint64_t v, uint64_t* q, uint64_t* r1,
+                       uint64_t* r0);
 void Uint64AddWithCarryStep(uint64_t a, uint64_t b, uint64_t carry_in,
                             uint64_t* result, uint64_t* carry_out);
 void Uint64SubWithBorrowStep(uint64_t a, uint64_t b, uint64_t borrow_in,
@@ -97,7 +188,33 @@ int DigitArrayMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
                    int size_result, uint64_t* result);
 int DigitArraySquare(int size_a, uint64_t* a, int size_result,
                      uint64_t* result);
+int DigitArrayKaratsubaMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                            int size_result, uint64_t* result);
+int DigitArrayToom3Mult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                        int size_result, uint64_t* result);
+extern int karatsuba_mult_threshold;
+extern int toom3_mult_threshold;
+extern int newton_division_threshold;
+extern int radix_conversion_threshold;
+extern int digit_array_use_mulx;
+extern int digit_array_use_avx2;
+extern int digit_array_use_fixed;
+bool FixedSizeAdd(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* carry);
+bool FixedSizeSub(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* borrow);
+bool FixedSizeMult(int n, uint64_t* a, uint64_t* b, uint64_t* r);
+bool FixedSizeSquare(int n, uint64_t* a, uint64_t* r);
+bool FixedSizeMontMult(int n, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* r);
+bool FixedSizeMontReduce(int n, uint64_t* t, uint64_t* m, uint64_t m_prime,
+                         uint64_t* r);
+int DigitArrayMontMult(int size_m, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* t, uint64_t* result);
+int DigitArrayMontReduce(int size_m, uint64_t* t, uint64_t* m,
+                         uint64_t m_prime, uint64_t* result);
 int DigitArrayMultBy(int capacity_a, int size_a, uint64_t* a, uint64_t x);
+uint64_t DigitArrayMultAdd(uint64_t x, int n, uint64_t* a, uint64_t* r);
 int DigitArrayAddTo(int capacity_a, int size_a, uint64_t* a, int size_b,
                     uint64_t* b);
 int DigitArraySubFrom(int capacity_a, int size_a, uint64_t* a, int size_b,
@@ -113,6 +230,7 @@ int BigCompare(BigNum& l, BigNum& r);
 
 string* BigConvertToDecimal(BigNum& a);
 BigNum* BigConvertFromDecimal(const char* in);
+bool BigConvertToDecimalFile(BigNum& a, WriteFile* out);
 string* BigConvertToHex(BigNum& a);
 BigNum* BigConvertFromHex(const char* in);
 
@@ -153,9 +271,20 @@ bool BigModSub(BigNum& a, BigNum& b, BigNum& m, BigNum& r);
 bool BigModNeg(BigNum& a, BigNum& m, BigNum& r);
 bool BigModMult(BigNum& a, BigNum& b, BigNum& m, BigNum& r);
 bool BigModSquare(BigNum& a, BigNum& m, BigNum& r);
-bool BigModInv(BigNum& a, BigNum& m, BigNum& r);
+// BigModInv algorithms
+#define BIG_MODINV_EUCLID 0     // BigExtendedGCD, a division per step
+#define BIG_MODINV_LEHMER 1     // BigLehmerExtendedGCD
+#define BIG_MODINV_CONSTTIME 2  // safegcd divsteps, odd m, secret a
+bool BigModInv(BigNum& a, BigNum& m, BigNum& r,
+               int mode = BIG_MODINV_LEHMER);
+bool BigModInvConstantTime(BigNum& a, BigNum& m, BigNum& r);
+bool BigModInvBatch(int n, BigNum** in, BigNum& m, BigNum** out,
+                    int mode = BIG_MODINV_LEHMER);
 bool BigModDiv(BigNum& a, BigNum& b, BigNum& m, BigNum& r);
 bool BigModExp(BigNum& b, BigNum& e, BigNum& m, BigNum& r);
+int BigExpWindowWidth(int num_bits);
+bool BigModExpWindowed(BigNum& b, BigNum& e, BigNum& m, BigNum& r,
+                       int width = 0, bool sliding = true);
 
 bool BigMakeMont(BigNum& a, int r, BigNum& p, BigNum& mont_a);
 bool BigMontReduce(BigNum& a, int r, BigNum& m, BigNum& m_prime, BigNum& out);
@@ -165,11 +294,89 @@ bool BigMontMult(BigNum& aR, BigNum& bR, BigNum& m, uint64_t r, BigNum& m_prime,
 bool BigMontExp(BigNum& b, BigNum& e, int r, BigNum& m, BigNum& m_prime,
                 BigNum& out);
 
+// Montgomery parameters cached for a fixed odd modulus, R= 2^(64*size_)
+class MontgomeryContext {
+ public:
+  int size_;           // digits in m
+  uint64_t m_prime_;   // -m^(-1) (mod 2^64)
+  BigNum* m_;
+  BigNum* r_mod_m_;    // R (mod m), the Montgomery form of 1
+  BigNum* r2_mod_m_;   // R^2 (mod m)
+
+  MontgomeryContext();
+  ~MontgomeryContext();
+
+  bool Init(BigNum& m);
+  bool IsValid();
+  void Clear();
+  bool ToMont(BigNum& a, BigNum& aR);
+  bool FromMont(BigNum& aR, BigNum& a);
+  bool MontMult(BigNum& aR, BigNum& bR, BigNum& abR);
+  bool MontSquare(BigNum& aR, BigNum& aaR);
+};
+
+bool BigMontExp(BigNum& b, BigNum& e, MontgomeryContext& ctx, BigNum& out);
+bool BigMontExpWindowed(BigNum& b, BigNum& e, MontgomeryContext& ctx,
+                        BigNum& out, int width = 0, bool sliding = true);
+bool BigMontExpConstantTime(BigNum& b, BigNum& e, MontgomeryContext& ctx,
+                            BigNum& out, int width = 0);
+bool BigModMultConstantTime(BigNum& a, BigNum& b, MontgomeryContext& ctx,
+                            BigNum& r);
+bool BigMontExpBatch(int num, BigNum** b, BigNum** e, MontgomeryContext& ctx,
+                     BigNum** out);
+
+// Barrett parameters cached for a fixed modulus, any parity
+class BarrettContext {
+ public:
+  int size_;      // k, digits in m
+  int mu_size_;   // digits in mu
+  BigNum* m_;
+  BigNum* mu_;    // floor(2^(128k)/m)
+
+  BarrettContext();
+  ~BarrettContext();
+
+  bool Init(BigNum& m);
+  bool IsValid();
+  void Clear();
+  bool Reduce(int size_x, uint64_t* x, BigNum& r);  // x < 2^(128k)
+};
+
+bool BigMod(BigNum& a, BarrettContext& ctx, BigNum& r);
+bool BigModMult(BigNum& a, BigNum& b, BarrettContext& ctx, BigNum& r);
+bool BigModSquare(BigNum& a, BarrettContext& ctx, BigNum& r);
+
+//  Products of powers, b[0]^e[0] ... b[n-1]^e[n-1] (mod m), with one chain
+//  of squarings.  Straus keeps a table of powers per base, Pippenger sorts
+//  the bases into buckets by exponent digit and is cheaper for many bases.
+//  AUTO picks by operation count.
+#define BIG_MULTIEXP_AUTO 0
+#define BIG_MULTIEXP_STRAUS 1
+#define BIG_MULTIEXP_PIPPENGER 2
+bool BigModMultiExp(int n, BigNum** b, BigNum** e, BigNum& m, BigNum& r,
+                    int mode = BIG_MULTIEXP_AUTO);
+bool BigMontMultiExp(int n, BigNum** b, BigNum** e, MontgomeryContext& ctx,
+                     BigNum& r, int mode = BIG_MULTIEXP_AUTO);
+
 bool BigExtendedGCD(BigNum& a, BigNum& b, BigNum& x, BigNum& y, BigNum& g);
+bool BigLehmerExtendedGCD(BigNum& a, BigNum& b, BigNum& x, BigNum& y,
+                          BigNum& g);
 bool BigCRT(BigNum& s1, BigNum& s2, BigNum& m1, BigNum& m2, BigNum& r);
-bool BigGenPrime(BigNum& p, uint64_t num_bits);
-bool BigIsPrime(BigNum& n);
+bool BigCRTGarner(BigNum& s1, BigNum& s2, BigNum& m1, BigNum& m2,
+                  BigNum& m2_inv, BigNum& r);
+//  Random prime with exactly num_bits bits, the top two set.  Searches on
+//  num_threads threads and gives up when *cancel is set.
+bool BigGenPrime(BigNum& p, uint64_t num_bits, int num_threads = 1,
+                 std::atomic<bool>* cancel = nullptr);
+// BigIsPrime tests, after trial division
+#define BIG_PRIME_MILLER_RABIN 0  // 20 fixed base rounds
+#define BIG_PRIME_BPSW 1          // Baillie-PSW
+bool BigIsPrime(BigNum& n, int mode = BIG_PRIME_MILLER_RABIN,
+                int extra_rounds = 0);
 bool BigMillerRabin(BigNum& n, BigNum** a, int trys = 20);
+bool BigStrongProbablePrime(BigNum& n, BigNum& a);
+bool BigStrongLucasProbablePrime(BigNum& n);
+bool BigBailliePSW(BigNum& n, int extra_rounds = 0);
 bool BigModIsSquare(BigNum& n, BigNum& p);
 bool BigModSquareRoot(BigNum& n, BigNum& p, BigNum& r);
 bool BigModTonelliShanks(BigNum& n, BigNum& p, BigNum& s);
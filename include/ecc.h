@@ -32,13 +32,18 @@ class CurvePoint {
   CurvePoint(BigNum& x, BigNum& y);
   CurvePoint(CurvePoint& P);
   CurvePoint(CurvePoint& P, int capacity);
+  CurvePoint(CurvePoint&& P);
   ~CurvePoint();
 
+  CurvePoint& operator=(CurvePoint&& P);
+  CurvePoint& operator=(const CurvePoint& P) = delete;
+
   bool IsZero();
   void Clear();
   void MakeZero();
   bool CopyFrom(CurvePoint& P);
   bool CopyTo(CurvePoint& P);
+  void Swap(CurvePoint& P);  // exchanges coordinates, no copying
   bool Normalize(BigNum& p);
   bool SerializePointToMessage(crypto_point_message&);
   bool DeserializePointFromMessage(crypto_point_message&);
@@ -51,6 +56,8 @@ class EccCurve {
   BigNum* a_;
   BigNum* b_;
   BigNum* p_;
+  MontgomeryContext* mont_;  // for p_, see InitContexts
+  BarrettContext* barrett_;  // for p_, see InitContexts
 
   EccCurve();
   EccCurve(int size);
@@ -58,6 +65,10 @@ class EccCurve {
   ~EccCurve();
 
   void Clear();
+  void ClearContexts();
+  bool InitContexts();
+  MontgomeryContext* MontContext();
+  BarrettContext* BarrettCtx();
   bool SerializeCurveToMessage(crypto_ecc_curve_message&);
   bool DeserializeCurveFromMessage(crypto_ecc_curve_message&);
   void PrintCurve();
@@ -73,8 +84,55 @@ bool EccDouble(EccCurve& c, CurvePoint& P, CurvePoint& R);
 bool EccMult(EccCurve& c, CurvePoint& P, BigNum& x, CurvePoint& R);
 bool FasterEccMult(EccCurve& c, CurvePoint& P, BigNum& x, CurvePoint& R);
 bool ProjectiveToAffine(EccCurve& c, CurvePoint& P);
+bool ProjectiveToAffineBatch(EccCurve& c, int n, CurvePoint** P);
 bool ProjectiveAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R);
 bool ProjectiveDouble(EccCurve& c, CurvePoint& P, CurvePoint& R);
 bool ProjectivePointMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R);
+bool JacobianToAffine(EccCurve& c, CurvePoint& P);
+bool JacobianAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q, CurvePoint& R);
+bool JacobianMixedAdd(EccCurve& c, CurvePoint& P, CurvePoint& Q,
+                      CurvePoint& R);
+bool JacobianDouble(EccCurve& c, CurvePoint& P, CurvePoint& R);
+bool JacobianDoubleN(EccCurve& c, CurvePoint& P, int n, CurvePoint& R);
+bool JacobianPointMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R);
+int WNafRecode(BigNum& x, int w, int max_len, int* naf);
+bool JacobianToAffineBatch(EccCurve& c, int n, CurvePoint** P);
+bool JacobianWNafMult(EccCurve& c, BigNum& x, CurvePoint& P, CurvePoint& R,
+                      int w = 0);
+bool SignedWindowRecode(BigNum& x, int w, int num_windows, int* digits);
+int JsfTableIndex(int du, int dv);
+int JsfRecode(BigNum& u, BigNum& v, int max_len, int* du, int* dv);
+bool EccJointMult(EccCurve& c, BigNum& u, CurvePoint& P, BigNum& v,
+                  CurvePoint& Q, CurvePoint& R);
+
+//  Window width of fixed-base tables unless a key asks for another.  A
+//  table holds about (bits/w) 2^(w-1) affine points; for P-256 that is
+//  32KB at w= 4, 88KB at w= 6 and 150KB at w= 7.
+#define ECC_BASE_TABLE_BITS 6
+
+//  Multiples of a fixed point G so that xG takes no doublings: entry j-1
+//  of window i is j 2^(w i) G, j= 1, ..., 2^(w-1), in affine form, and
+//  xG is one mixed addition per signed w bit digit of x.  On P-256 the
+//  entries are field elements read by a full scan of the window.
+class EccBaseTable {
+ public:
+  int window_bits_;
+  int num_windows_;
+  int entries_;            // per window, 2^(window_bits_-1)
+  int scalar_bits_;        // largest x is 2^scalar_bits_-1
+  uint64_t* p256_table_;   // x, y pairs, P-256 only
+  CurvePoint** table_;     // other curves
+
+  EccBaseTable();
+  ~EccBaseTable();
+
+  void Clear();
+  bool Init(EccCurve& c, CurvePoint& G, int scalar_bits, int window_bits);
+  bool Mult(EccCurve& c, BigNum& x, CurvePoint& R);
+  int TableBytes();
+};
+
+bool FixedBaseMult(EccCurve& c, EccBaseTable* table, CurvePoint& P,
+                   BigNum& k, CurvePoint& R);
 
 #endif
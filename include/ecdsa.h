@@ -0,0 +1,42 @@
+//
+// Copyright 2014 John Manferdelli, All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// or in the the file LICENSE-2.0.txt in the top level sourcedirectory
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+// Project: New Cloudproxy Crypto
+// File: ecdsa.h
+
+#include "cryptotypes.h"
+#include "bignum.h"
+#include "ecc.h"
+#include "keys.h"
+
+#ifndef _CRYPTO_ECDSA_H__
+#define _CRYPTO_ECDSA_H__
+
+//  ECDSA, FIPS 186-4, with an EccKey: generator g_ of order order_of_g_,
+//  secret a_ and public base_.  hash is the message digest, big endian.
+//  Nonces are deterministic, RFC 6979 with HMAC-SHA256.
+
+bool EcdsaNonce(BigNum& n, BigNum& x, int size_hash, byte* hash, int attempt,
+                BigNum& k);
+bool EcdsaSign(EccKey& key, int size_hash, byte* hash, BigNum& r, BigNum& s);
+bool EcdsaVerify(EccKey& key, int size_hash, byte* hash, BigNum& r,
+                 BigNum& s);
+
+//  Signature holds r || s, each as many big endian bytes as the order,
+//  under the algorithm name "ecdsa-<bits>-<hashalg>", e.g.
+//  "ecdsa-256-sha-256".
+bool EcdsaSignToSignature(EccKey& key, const char* hashalg, int size_hash,
+                          byte* hash, Signature& sig);
+bool EcdsaVerifySignature(EccKey& key, const char* hashalg, int size_hash,
+                          byte* hash, Signature& sig);
+#endif
@@ -0,0 +1,253 @@
+//
+// Copyright 2014 John Manferdelli, All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// or in the the file LICENSE-2.0.txt in the top level sourcedirectory
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+// Project: New Cloudproxy Crypto
+// File: fixed_arith.h
+
+#include "cryptotypes.h"
+
+#ifndef _CRYPTO_FIXED_ARITH_H__
+#define _CRYPTO_FIXED_ARITH_H__
+
+//  Digit array kernels for a digit count N known at compile time.
+//  All loop bounds are constants, so the compiler unrolls them and there
+//  are no data dependent branches.  N >= 32 multiplies and squares split
+//  once more with Karatsuba on N/2 digit halves.
+//  Instantiated for N= 4, 6, 8 (P-256, P-384, 512 bits) and 16, 32, 64
+//  (RSA-1024, 2048, 4096 halves), see FixedSizeMult and friends in
+//  arith64.cc.
+
+typedef unsigned __int128 uint128_t;
+typedef __int128 int128_t;
+
+//  Largest digit count for which DigitArrayMult, DigitArraySquare and the
+//  Montgomery routines use these kernels.  From 8 digits up the mulx rows
+//  in intel64_arith.cc are as fast or faster (fixed_kernel_time_test).
+#define FIXED_MULT_MAX_DIGITS 6
+
+// r= a+b, returns the carry.  r may be a or b.
+template <int N>
+inline uint64_t FixedAdd(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  uint64_t carry = 0ULL;
+  for (int i = 0; i < N; i++) {
+    uint128_t t = (uint128_t)a[i] + b[i] + carry;
+    r[i] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+  return carry;
+}
+
+// r= a-b, returns the borrow.  r may be a or b.
+template <int N>
+inline uint64_t FixedSub(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  uint64_t borrow = 0ULL;
+  for (int i = 0; i < N; i++) {
+    uint128_t t = (uint128_t)a[i] - b[i] - borrow;
+    r[i] = (uint64_t)t;
+    borrow = (uint64_t)(t >> 64) & 1ULL;
+  }
+  return borrow;
+}
+
+// r[0, 2N)= a*b, one row of multiply-accumulate per digit of a
+template <int N>
+inline void FixedMultSchoolbook(const uint64_t* a, const uint64_t* b,
+                                uint64_t* r) {
+  uint64_t carry = 0ULL;
+  for (int j = 0; j < N; j++) {
+    uint128_t t = (uint128_t)a[0] * b[j] + carry;
+    r[j] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+  r[N] = carry;
+  for (int i = 1; i < N; i++) {
+    carry = 0ULL;
+    for (int j = 0; j < N; j++) {
+      uint128_t t = (uint128_t)a[i] * b[j] + r[i + j] + carry;
+      r[i + j] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    r[i + N] = carry;
+  }
+}
+
+// r[0, 2N)= a*a, cross products once, doubled, then the diagonal
+template <int N>
+inline void FixedSquareSchoolbook(const uint64_t* a, uint64_t* r) {
+  uint64_t carry;
+  for (int i = 0; i < 2 * N; i++) r[i] = 0ULL;
+  for (int i = 0; i < (N - 1); i++) {
+    carry = 0ULL;
+    for (int j = i + 1; j < N; j++) {
+      uint128_t t = (uint128_t)a[i] * a[j] + r[i + j] + carry;
+      r[i + j] = (uint64_t)t;
+      carry = (uint64_t)(t >> 64);
+    }
+    r[i + N] = carry;
+  }
+  uint64_t top = 0ULL;
+  for (int i = 0; i < 2 * N; i++) {
+    uint64_t next = r[i] >> 63;
+    r[i] = (r[i] << 1) | top;
+    top = next;
+  }
+  carry = 0ULL;
+  for (int i = 0; i < N; i++) {
+    uint128_t sq = (uint128_t)a[i] * a[i];
+    uint128_t t = (uint128_t)r[2 * i] + (uint64_t)sq + carry;
+    r[2 * i] = (uint64_t)t;
+    t = (uint128_t)r[2 * i + 1] + (uint64_t)(sq >> 64) + (uint64_t)(t >> 64);
+    r[2 * i + 1] = (uint64_t)t;
+    carry = (uint64_t)(t >> 64);
+  }
+}
+
+// r[0, n)+= x, carries stop at r[n-1]
+template <int N>
+inline void FixedPropagate(uint64_t* r, uint64_t x) {
+  for (int i = 0; i < N; i++) {
+    uint128_t t = (uint128_t)r[i] + x;
+    r[i] = (uint64_t)t;
+    x = (uint64_t)(t >> 64);
+  }
+}
+
+template <int N, bool kSplit = (N >= 32 && (N % 2) == 0)>
+struct FixedMultImpl {
+  static inline void Mult(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+    FixedMultSchoolbook<N>(a, b, r);
+  }
+  static inline void Square(const uint64_t* a, uint64_t* r) {
+    FixedSquareSchoolbook<N>(a, r);
+  }
+};
+
+//  One Karatsuba level, a= a1 B^H + a0.  The carries out of a0+a1 and
+//  b0+b1 are folded in with masks rather than branches.
+template <int N>
+struct FixedMultImpl<N, true> {
+  static const int H = N / 2;
+
+  // r[H, 2N)+= z1, z1 has N+1 digits
+  static inline void AddMiddle(uint64_t* z1, uint64_t* r) {
+    uint64_t c = FixedAdd<N>(r + H, z1, r + H);
+    FixedPropagate<H>(r + H + N, z1[N] + c);
+  }
+
+  static inline void Mult(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+    uint64_t sa[H];
+    uint64_t sb[H];
+    uint64_t t[H];
+    uint64_t z1[N + 1];
+
+    FixedMultImpl<H>::Mult(a, b, r);
+    FixedMultImpl<H>::Mult(a + H, b + H, r + N);
+    uint64_t ca = FixedAdd<H>(a, a + H, sa);
+    uint64_t cb = FixedAdd<H>(b, b + H, sb);
+    FixedMultImpl<H>::Mult(sa, sb, z1);
+
+    // (sa + ca B^H)(sb + cb B^H)= sa sb + (ca sb + cb sa) B^H + ca cb B^N
+    uint64_t mask_a = 0ULL - ca;
+    uint64_t mask_b = 0ULL - cb;
+    uint64_t top = ca & cb;
+    for (int i = 0; i < H; i++) t[i] = sb[i] & mask_a;
+    top += FixedAdd<H>(z1 + H, t, z1 + H);
+    for (int i = 0; i < H; i++) t[i] = sa[i] & mask_b;
+    top += FixedAdd<H>(z1 + H, t, z1 + H);
+    z1[N] = top;
+
+    z1[N] -= FixedSub<N>(z1, r, z1);
+    z1[N] -= FixedSub<N>(z1, r + N, z1);
+    AddMiddle(z1, r);
+  }
+
+  static inline void Square(const uint64_t* a, uint64_t* r) {
+    uint64_t sa[H];
+    uint64_t t[H];
+    uint64_t z1[N + 1];
+
+    FixedMultImpl<H>::Square(a, r);
+    FixedMultImpl<H>::Square(a + H, r + N);
+    uint64_t ca = FixedAdd<H>(a, a + H, sa);
+    FixedMultImpl<H>::Square(sa, z1);
+
+    // (sa + ca B^H)^2= sa^2 + 2 ca sa B^H + ca B^N
+    uint64_t mask_a = 0ULL - ca;
+    uint64_t top = ca;
+    for (int i = 0; i < H; i++) t[i] = sa[i] & mask_a;
+    top += FixedAdd<H>(z1 + H, t, z1 + H);
+    top += FixedAdd<H>(z1 + H, t, z1 + H);
+    z1[N] = top;
+
+    z1[N] -= FixedSub<N>(z1, r, z1);
+    z1[N] -= FixedSub<N>(z1, r + N, z1);
+    AddMiddle(z1, r);
+  }
+};
+
+template <int N>
+inline void FixedMult(const uint64_t* a, const uint64_t* b, uint64_t* r) {
+  FixedMultImpl<N>::Mult(a, b, r);
+}
+
+template <int N>
+inline void FixedSquare(const uint64_t* a, uint64_t* r) {
+  FixedMultImpl<N>::Square(a, r);
+}
+
+//  r= t R^(-1) (mod m), R= 2^(64N), t < mR has 2N digits and is destroyed.
+//  The carry out of each row is held in top and added with the next row,
+//  and the final subtraction is selected with a mask.
+template <int N>
+inline void FixedMontReduce(uint64_t* t, const uint64_t* m, uint64_t m_prime,
+                            uint64_t* r) {
+  uint64_t top = 0ULL;
+  for (int i = 0; i < N; i++) {
+    uint64_t u = t[i] * m_prime;
+    uint64_t carry = 0ULL;
+    for (int j = 0; j < N; j++) {
+      uint128_t s = (uint128_t)u * m[j] + t[i + j] + carry;
+      t[i + j] = (uint64_t)s;
+      carry = (uint64_t)(s >> 64);
+    }
+    uint128_t s = (uint128_t)t[i + N] + carry + top;
+    t[i + N] = (uint64_t)s;
+    top = (uint64_t)(s >> 64);
+  }
+
+  uint64_t d[N];
+  uint64_t borrow = FixedSub<N>(t + N, m, d);
+  // keep t+N only if it is below m: no top carry and a borrow
+  uint64_t keep = 0ULL - (borrow & (top ^ 1ULL));
+  for (int i = 0; i < N; i++) r[i] = (t[N + i] & keep) | (d[i] & ~keep);
+}
+
+// r= a b R^(-1) (mod m), a, b < m
+template <int N>
+inline void FixedMontMult(const uint64_t* a, const uint64_t* b,
+                          const uint64_t* m, uint64_t m_prime, uint64_t* r) {
+  uint64_t t[2 * N];
+  FixedMult<N>(a, b, t);
+  FixedMontReduce<N>(t, m, m_prime, r);
+}
+
+// r= a a R^(-1) (mod m), a < m
+template <int N>
+inline void FixedMontSquare(const uint64_t* a, const uint64_t* m,
+                            uint64_t m_prime, uint64_t* r) {
+  uint64_t t[2 * N];
+  FixedSquare<N>(a, t);
+  FixedMontReduce<N>(t, m, m_prime, r);
+}
+
+#endif
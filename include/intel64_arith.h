@@ -48,6 +48,13 @@ void Uint64SubStep(uint64_t a, uint64_t b, uint64_t* result, uint64_t* borrow);
 void Uint64MultStep(uint64_t a, uint64_t b, uint64_t* result, uint64_t* carry);
 void Uint64DivStep(uint64_t a, uint64_t b, uint64_t c, uint64_t* result,
                    uint64_t* carry);
+uint64_t Uint64Reciprocal(uint64_t d);
+uint64_t Uint64Reciprocal3By2(uint64_t d1, uint64_t d0);
+void Uint64DivStep2By1(uint64_t u1, uint64_t u0, uint64_t d, uint64_t v,
+                       uint64_t* q, uint64_t* r);
+void Uint64DivStep3By2(uint64_t u2, uint64_t u1, uint64_t u0, uint64_t d1,
+                       uint64_t d0, uint64_t v, uint64_t* q, uint64_t* r1,
+                       uint64_t* r0);
 void Uint64AddWithCarryStep(uint64_t a, uint64_t b, uint64_t carry_in,
                             uint64_t* result, uint64_t* carry_out);
 void Uint64SubWithBorrowStep(uint64_t a, uint64_t b, uint64_t borrow_in,
@@ -63,8 +70,32 @@ int DigitArrayMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
                    int size_result, uint64_t* result);
 int DigitArraySquare(int size_a, uint64_t* a, int size_result,
                      uint64_t* result);
+int DigitArrayKaratsubaMult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                            int size_result, uint64_t* result);
+int DigitArrayToom3Mult(int size_a, uint64_t* a, int size_b, uint64_t* b,
+                        int size_result, uint64_t* result);
+extern int karatsuba_mult_threshold;
+extern int toom3_mult_threshold;
+extern int newton_division_threshold;
+extern int digit_array_use_mulx;
+extern int digit_array_use_fixed;
+bool FixedSizeAdd(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* carry);
+bool FixedSizeSub(int n, uint64_t* a, uint64_t* b, uint64_t* r,
+                  uint64_t* borrow);
+bool FixedSizeMult(int n, uint64_t* a, uint64_t* b, uint64_t* r);
+bool FixedSizeSquare(int n, uint64_t* a, uint64_t* r);
+bool FixedSizeMontMult(int n, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* r);
+bool FixedSizeMontReduce(int n, uint64_t* t, uint64_t* m, uint64_t m_prime,
+                         uint64_t* r);
+int DigitArrayMontMult(int size_m, uint64_t* a, uint64_t* b, uint64_t* m,
+                       uint64_t m_prime, uint64_t* t, uint64_t* result);
 
+int DigitArrayMontReduce(int size_m, uint64_t* t, uint64_t* m,
+                         uint64_t m_prime, uint64_t* result);
 int DigitArrayMultBy(int capacity_a, int size_a, uint64_t* a, uint64_t x);
+uint64_t DigitArrayMultAdd(uint64_t x, int n, uint64_t* a, uint64_t* r);
 int DigitArrayAddTo(int capacity_a, int size_a, uint64_t* a, int size_b,
                     uint64_t* b);
 int DigitArraySubFrom(int capacity_a, int size_a, uint64_t* a, int size_b,
@@ -78,5 +109,9 @@ bool DigitArrayDivisionAlgorithm(int size_a, uint64_t* a, int size_b,
 bool DigitArrayConvertToDecimal(int size_a, uint64_t* a, int* size_s, char* s);
 bool DigitArrayConvertToHex(int size_a, uint64_t* a, int* size_s, char* s);
 int DigitArrayConvertFromDecimal(const char* s, int size_a, uint64_t* a);
+bool DigitArrayConvertToDecimalFile(int size_a, uint64_t* a, WriteFile* out);
+bool DigitArrayUseAvx2();
+bool DigitArrayMontExpBatch4(int size_m, uint64_t* m, uint64_t** b,
+                             int* size_e, uint64_t** e, uint64_t** out);
 int DigitArrayConvertFromHex(const char* s, int size_a, uint64_t* a);
 #endif
@@ -20,6 +20,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 #include <cmath>
 #include <iostream>
@@ -96,6 +97,9 @@ class SymmetricKey : public CryptoKey {
   void PrintKey();
 };
 
+// p, q and up to RSA_MAX_PRIMES - 2 other primes
+#define RSA_MAX_PRIMES 5
+
 class RsaKey : public CryptoKey {
  public:
   int bit_size_modulus_;
@@ -110,17 +114,34 @@ class RsaKey : public CryptoKey {
   BigNum* m_prime_;
   BigNum* p_prime_;
   BigNum* q_prime_;
+  BigNum* q_inv_;  // q^(-1) (mod p)
+  MontgomeryContext* m_mont_;
+  MontgomeryContext* p_mont_;
+  MontgomeryContext* q_mont_;
+
+  //  Primes after p and q (RFC 8017 OtherPrimeInfo): the prime r_i,
+  //  d (mod r_i - 1) and (p q r_1 ... r_(i-1))^(-1) (mod r_i).
+  std::vector<BigNum*> other_primes_;
+  std::vector<BigNum*> other_exponents_;
+  std::vector<BigNum*> other_coefficients_;
+  std::vector<MontgomeryContext*> other_mont_;
 
   RsaKey();
   ~RsaKey();
 
   bool GenerateRsaKey(const char* name, const char* usage, const char* owner,
-                      int num_bits, double seconds_to_live);
+                      int num_bits, double seconds_to_live,
+                      int num_primes = 2);
   bool MakeRsaKey(const char* name, const char* usage, const char* owner,
                   int num_bits, double secondstolive, BigNum& m, BigNum& e,
                   BigNum& p, BigNum& q);
 
   bool ComputeFastDecryptParameters();
+  bool ComputeOtherPrimeParameters();
+  bool InitMontgomeryContexts();
+  bool InitCrtParameters();
+  bool HasCrtParameters();
+  bool CrtDecrypt(BigNum& in, BigNum& out, bool parallel);
   bool ReadKey(string& filename);
   bool SaveKey(string& filename);
 
@@ -129,7 +150,7 @@ class RsaKey : public CryptoKey {
   void PrintKey();
 
   bool Encrypt(int size_in, byte* in, int* size_out, byte* out, int speed = 0);
-  bool Decrypt(int size_in, byte* in, int* size_out, byte* out, int speed = 0);
+  bool Decrypt(int size_in, byte* in, int* size_out, byte* out, int speed = 3);
 };
 
 class EccKey : public CryptoKey {
@@ -140,10 +161,19 @@ class EccKey : public CryptoKey {
   CurvePoint g_;
   BigNum* order_of_g_;
   CurvePoint base_;  // base_ = a_ * g_
+  int table_window_bits_;     // fixed-base table width, 0 for none
+  EccBaseTable* g_table_;     // see InitBaseTables
+  EccBaseTable* base_table_;
+  EccBaseTable* shared_g_table_;  // a built-in key's, not owned
 
   EccKey();
   ~EccKey();
 
+  bool InitBaseTables();
+  bool SetTableWindowBits(int window_bits);
+  EccBaseTable* GeneratorTable();
+  EccBaseTable* BaseTable();
+
   bool MakeEccKey(const char* name, const char* usage, const char* owner,
                   double secondstolive, EccCurve* c, CurvePoint* g,
                   CurvePoint* base, BigNum* order, BigNum* secret);
@@ -159,6 +189,9 @@ class EccKey : public CryptoKey {
   bool Encrypt(int size, byte* plain, BigNum& k, CurvePoint& pt1,
                CurvePoint& pt2);
   bool Decrypt(CurvePoint& pt1, CurvePoint& pt2, int* size, byte* plain);
+
+ private:
+  void ClearBaseTables();
 };
 
 class KeyStore {
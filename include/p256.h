@@ -0,0 +1,71 @@
+//
+// Copyright 2014 John Manferdelli, All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//     http://www.apache.org/licenses/LICENSE-2.0
+// or in the the file LICENSE-2.0.txt in the top level sourcedirectory
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License
+// Project: New Cloudproxy Crypto
+// File: p256.h
+
+#include "cryptotypes.h"
+#include "bignum.h"
+#include "ecc.h"
+
+#ifndef _CRYPTO_P256_H__
+#define _CRYPTO_P256_H__
+
+//  Arithmetic mod the NIST P-256 prime p= 2^256-2^224+2^192+2^96-1.
+//  Field elements are 4 little endian digits, always fully reduced.
+//  None of the routines branch on or index by the values of elements.
+
+#define P256_DIGITS 4
+
+void P256Add(const uint64_t* a, const uint64_t* b, uint64_t* r);
+void P256Sub(const uint64_t* a, const uint64_t* b, uint64_t* r);
+void P256Neg(const uint64_t* a, uint64_t* r);
+void P256Reduce(const uint64_t* t, uint64_t* r);
+void P256Mult(const uint64_t* a, const uint64_t* b, uint64_t* r);
+void P256Square(const uint64_t* a, uint64_t* r);
+void P256Inv(const uint64_t* a, uint64_t* r);
+bool P256FromBigNum(BigNum& a, uint64_t* r);
+bool P256ToBigNum(const uint64_t* a, BigNum& r);
+
+//  Projective point.  The P256Point routines use homogeneous coordinates,
+//  x= x_/z_, y= y_/z_, the P256Jacobian ones x= x_/z_^2, y= y_/z_^3.
+//  z_= 0 is infinity in both.
+class P256Point {
+ public:
+  uint64_t x_[P256_DIGITS];
+  uint64_t y_[P256_DIGITS];
+  uint64_t z_[P256_DIGITS];
+
+  void MakeZero();
+};
+
+bool IsP256Curve(EccCurve& c);
+void P256PointAdd(const P256Point& P, const P256Point& Q, P256Point& R);
+void P256PointDouble(const P256Point& P, P256Point& R);
+bool P256PointFromCurvePoint(CurvePoint& P, P256Point& R);
+bool P256PointToAffine(const P256Point& P, CurvePoint& R);
+bool P256PointMult(CurvePoint& P, BigNum& x, CurvePoint& R);
+void P256JacobianDouble(const P256Point& P, P256Point& R);
+void P256JacobianDoubleN(const P256Point& P, int n, P256Point& R);
+void P256JacobianAdd(const P256Point& P, const P256Point& Q, P256Point& R);
+void P256JacobianMixedAdd(const P256Point& P, const P256Point& Q,
+                          P256Point& R);
+bool P256JacobianToAffine(const P256Point& P, CurvePoint& R);
+bool P256BaseTableInit(CurvePoint& G, int w, int num_windows,
+                       uint64_t* table);
+bool P256BaseTableMult(const uint64_t* table, int w, int num_windows,
+                       BigNum& x, CurvePoint& R);
+bool P256JointMult(CurvePoint& P, BigNum& u, CurvePoint& Q, BigNum& v,
+                   CurvePoint& R);
+
+#endif
@@ -109,6 +109,8 @@ void ReverseCpy(int size, byte* in, byte* out);
 void PrintBytes(int n, byte* in);
 bool HaveRdRand();
 bool HaveAesNi();
+bool HaveBmi2Adx();
+bool HaveAvx2();
 bool InitCrypto();
 void CloseCrypto();
 bool GetCryptoRand(int num_bits, byte* buf);
@@ -92,6 +92,10 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
 $(O)/globals.o: $(SRC_DIR)/bignum/globals.cc
 	@echo "compiling globals.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/globals.o $(SRC_DIR)/bignum/globals.cc
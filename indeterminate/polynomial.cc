@@ -202,14 +202,17 @@ bool PolyMult(Polynomial& a, Polynomial& b, Polynomial& c) {
   if ((a.Degree() + b.Degree()) >= c.num_c_) return false;
 
   int i, j, k;
-  BigNum t(2 * a.m_->Size() + 1);
-  BigNum r(2 * a.m_->Size() + 1);
+  ScratchFrame frame;
+  BigNum t(2 * a.m_->Size() + 1, frame);
+  BigNum r(2 * a.m_->Size() + 1, frame);
+  BarrettContext ctx;
 
+  if (!ctx.Init(*a.m_)) return false;
   ZeroPoly(c);
   for (i = 0; i <= a.Degree(); i++) {
     for (j = 0; j <= b.Degree(); j++) {
       k = i + j;
-      if (!BigModMult(*a.c_[i], *b.c_[j], *a.m_, t)) return false;
+      if (!BigModMult(*a.c_[i], *b.c_[j], ctx, t)) return false;
       if (!BigModAdd(t, *c.c_[k], *a.m_, r)) return false;
       r.CopyTo(*c.c_[k]);
     }
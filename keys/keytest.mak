@@ -58,7 +58,7 @@ else
 endif
 
 dobj=	$(O)/keytest.o $(O)/keys.o $(O)/keys.pb.o $(O)/util.o $(O)/conversions.o \
-        $(O)/rsa.o $(O)/ecc.o $(O)/bignum.o $(O)/basic_arith.o $(O)/arith64.o \
+        $(O)/rsa.o $(O)/ecc.o $(O)/p256.o $(O)/bignum.o $(O)/basic_arith.o $(O)/arith64.o \
 	$(O)/number_theory.o $(O)/intel64_arith.o $(O)/globals.o  $(O)/smallprimes.o
 
 all:	keytest.exe
@@ -103,6 +103,10 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
 $(O)/globals.o: $(SRC_DIR)/bignum/globals.cc
 	@echo "compiling globals.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/globals.o $(SRC_DIR)/bignum/globals.cc
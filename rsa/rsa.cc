@@ -19,12 +19,81 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include "bignum.h"
 #include "conversions.h"
 #include "intel64_arith.h"
 #include "keys.pb.h"
 #include "keys.h"
 
+//  Persistent workers for the q half of Decrypt speed 4.  A job is only
+//  queued while more workers are idle than jobs are waiting, otherwise the
+//  caller runs it itself, so under load requests fall back to sequential.
+class CrtWorkerPool {
+ public:
+  explicit CrtWorkerPool(int num_workers);
+  bool TrySubmit(std::function<void()> job);
+
+ private:
+  std::mutex lock_;
+  std::condition_variable ready_;
+  std::deque<std::function<void()>> jobs_;
+  int idle_;
+
+  void Worker();
+};
+
+CrtWorkerPool::CrtWorkerPool(int num_workers) : idle_(0) {
+  for (int i = 0; i < num_workers; i++)
+    std::thread(&CrtWorkerPool::Worker, this).detach();
+}
+
+bool CrtWorkerPool::TrySubmit(std::function<void()> job) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if ((int)jobs_.size() >= idle_)
+    return false;
+  jobs_.push_back(job);
+  ready_.notify_one();
+  return true;
+}
+
+void CrtWorkerPool::Worker() {
+  std::unique_lock<std::mutex> guard(lock_);
+  for (;;) {
+    idle_++;
+    ready_.wait(guard, [this]() { return !jobs_.empty(); });
+    idle_--;
+    std::function<void()> job = jobs_.front();
+    jobs_.pop_front();
+    guard.unlock();
+    job();
+    guard.lock();
+  }
+}
+
+// never destroyed, the workers outlive any key
+static CrtWorkerPool* RsaCrtPool() {
+  static CrtWorkerPool* pool = new CrtWorkerPool(
+      std::thread::hardware_concurrency() > 1
+          ? (int)std::thread::hardware_concurrency() - 1 : 1);
+  return pool;
+}
+
+// zeroes and frees a key's numbers
+static void DeleteNums(std::vector<BigNum*>& nums) {
+  for (int i = 0; i < (int)nums.size(); i++) {
+    if (nums[i] != nullptr) {
+      nums[i]->ZeroNum();
+      delete nums[i];
+    }
+  }
+  nums.clear();
+}
+
 RsaKey::RsaKey() {
   bit_size_modulus_ = 0;
   m_ = nullptr;
@@ -37,6 +106,10 @@ RsaKey::RsaKey() {
   m_prime_ = nullptr;
   p_prime_ = nullptr;
   q_prime_ = nullptr;
+  q_inv_ = nullptr;
+  m_mont_ = nullptr;
+  p_mont_ = nullptr;
+  q_mont_ = nullptr;
 }
 
 RsaKey::~RsaKey() {
@@ -81,6 +154,11 @@ RsaKey::~RsaKey() {
     delete q_prime_;
     q_prime_ = nullptr;
   }
+  if (q_inv_ != nullptr) {
+    q_inv_->ZeroNum();
+    delete q_inv_;
+    q_inv_ = nullptr;
+  }
   if (m_prime_ != nullptr) {
     m_prime_->ZeroNum();
     delete m_prime_;
@@ -91,6 +169,220 @@ RsaKey::~RsaKey() {
     delete p_prime_;
     p_prime_ = nullptr;
   }
+  if (m_mont_ != nullptr) {
+    delete m_mont_;
+    m_mont_ = nullptr;
+  }
+  if (p_mont_ != nullptr) {
+    delete p_mont_;
+    p_mont_ = nullptr;
+  }
+  if (q_mont_ != nullptr) {
+    delete q_mont_;
+    q_mont_ = nullptr;
+  }
+  DeleteNums(other_primes_);
+  DeleteNums(other_exponents_);
+  DeleteNums(other_coefficients_);
+  for (int i = 0; i < (int)other_mont_.size(); i++) delete other_mont_[i];
+  other_mont_.clear();
+}
+
+//  Montgomery contexts are not serialized, they are rebuilt from m, p and q
+//  when the key is made or loaded.  Encrypt and Decrypt only read them, so
+//  threads can share a key.
+bool RsaKey::InitMontgomeryContexts() {
+  MontgomeryContext** ctxs[3] = {&m_mont_, &p_mont_, &q_mont_};
+  for (int i = 0; i < 3; i++) {
+    if (*ctxs[i] != nullptr) {
+      delete *ctxs[i];
+      *ctxs[i] = nullptr;
+    }
+  }
+  if (m_ != nullptr) {
+    m_mont_ = new MontgomeryContext();
+    if (!m_mont_->Init(*m_)) {
+      LOG(ERROR) << "RsaKey::InitMontgomeryContexts: bad modulus\n";
+      delete m_mont_;
+      m_mont_ = nullptr;
+      return false;
+    }
+  }
+  if (p_ != nullptr) {
+    p_mont_ = new MontgomeryContext();
+    if (!p_mont_->Init(*p_)) {
+      LOG(ERROR) << "RsaKey::InitMontgomeryContexts: bad p\n";
+      delete p_mont_;
+      p_mont_ = nullptr;
+      return false;
+    }
+  }
+  if (q_ != nullptr) {
+    q_mont_ = new MontgomeryContext();
+    if (!q_mont_->Init(*q_)) {
+      LOG(ERROR) << "RsaKey::InitMontgomeryContexts: bad q\n";
+      delete q_mont_;
+      q_mont_ = nullptr;
+      return false;
+    }
+  }
+  return m_mont_ != nullptr;
+}
+
+//  q_inv_ and the other prime contexts for BigCRTGarner, after
+//  InitMontgomeryContexts.  q_inv_ is serialized, keys saved without it get
+//  it computed here.
+bool RsaKey::InitCrtParameters() {
+  for (int i = 0; i < (int)other_mont_.size(); i++) delete other_mont_[i];
+  other_mont_.clear();
+  if (p_ == nullptr || q_ == nullptr || dp_ == nullptr || dq_ == nullptr ||
+      p_mont_ == nullptr || q_mont_ == nullptr)
+    return false;
+  if (q_inv_ == nullptr) {
+    // BigModInv reduces its argument in place
+    BigNum q(q_->capacity_);
+    q.CopyFrom(*q_);
+    q_inv_ = new BigNum(p_->capacity_ + 1);
+    if (!BigModInv(q, *p_, *q_inv_)) {
+      LOG(ERROR) << "RsaKey::InitCrtParameters: cant invert q\n";
+      delete q_inv_;
+      q_inv_ = nullptr;
+      return false;
+    }
+  }
+  int num_other = (int)other_primes_.size();
+  if ((int)other_exponents_.size() != num_other ||
+      (int)other_coefficients_.size() != num_other)
+    return false;
+  for (int i = 0; i < num_other; i++) {
+    MontgomeryContext* ctx = new MontgomeryContext();
+    if (!ctx->Init(*other_primes_[i])) {
+      LOG(ERROR) << "RsaKey::InitCrtParameters: bad prime\n";
+      delete ctx;
+      return false;
+    }
+    other_mont_.push_back(ctx);
+  }
+  return true;
+}
+
+//  True if InitCrtParameters built everything CrtDecrypt reads
+bool RsaKey::HasCrtParameters() {
+  return p_mont_ != nullptr && q_mont_ != nullptr && q_inv_ != nullptr &&
+         dp_ != nullptr && dq_ != nullptr &&
+         other_mont_.size() == other_primes_.size() &&
+         other_exponents_.size() == other_primes_.size();
+}
+
+//  out= in^d (mod m) with one constant time exponentiation per prime.  If
+//  parallel, every prime after p goes to a free pool worker.  The residues
+//  are combined with Garner, p and q first, then one prime at a time.
+bool RsaKey::CrtDecrypt(BigNum& in, BigNum& out, bool parallel) {
+  int num = 2 + (int)other_primes_.size();
+  int size = 2 * m_->capacity_ + 2;
+  std::vector<BigNum*> primes(num);
+  std::vector<BigNum*> exps(num);
+  std::vector<MontgomeryContext*> ctxs(num);
+  std::vector<BigNum*> outs(num);
+  std::vector<char> ok(num, 0);
+  std::mutex lock;
+  std::condition_variable done;
+  int pending = 0;
+  int j;
+
+  primes[0] = p_;
+  exps[0] = dp_;
+  ctxs[0] = p_mont_;
+  primes[1] = q_;
+  exps[1] = dq_;
+  ctxs[1] = q_mont_;
+  for (j = 2; j < num; j++) {
+    primes[j] = other_primes_[j - 2];
+    exps[j] = other_exponents_[j - 2];
+    ctxs[j] = other_mont_[j - 2];
+  }
+  for (j = 0; j < num; j++) outs[j] = new BigNum(size);
+
+  std::vector<bool> handed_off(num, false);
+  for (j = 1; parallel && j < num; j++) {
+    std::lock_guard<std::mutex> guard(lock);
+    handed_off[j] = RsaCrtPool()->TrySubmit([&, j]() {
+      bool result = BigMontExpConstantTime(in, *exps[j], *ctxs[j], *outs[j]);
+      std::lock_guard<std::mutex> guard(lock);
+      ok[j] = result;
+      pending--;
+      done.notify_one();
+    });
+    if (handed_off[j])
+      pending++;
+  }
+  for (j = 0; j < num; j++) {
+    if (!handed_off[j])
+      ok[j] = BigMontExpConstantTime(in, *exps[j], *ctxs[j], *outs[j]);
+  }
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [&]() { return pending == 0; });
+  }
+
+  bool ret = true;
+  for (j = 0; j < num; j++) ret = ret && ok[j];
+  BigNum x(size);
+  BigNum r(size);
+  BigNum t(size);
+  if (ret)
+    ret = BigCRTGarner(*outs[0], *outs[1], *p_, *q_, *q_inv_, x) &&
+          BigMult(*p_, *q_, r);
+  for (j = 2; ret && j < num; j++) {
+    t.ZeroNum();
+    ret = BigCRTGarner(*outs[j], x, *primes[j], r,
+                       *other_coefficients_[j - 2], t) &&
+          x.CopyFrom(t);
+    t.ZeroNum();
+    ret = ret && BigMult(r, *primes[j], t) && r.CopyFrom(t);
+  }
+  if (ret) {
+    out.ZeroNum();
+    ret = out.CopyFrom(x);
+  }
+  for (j = 0; j < num; j++) {
+    outs[j]->ZeroNum();
+    delete outs[j];
+  }
+  return ret;
+}
+
+//  other_exponents_[i]= d (mod r_i - 1) and
+//  other_coefficients_[i]= (p q r_1 ... r_(i-1))^(-1) (mod r_i)
+bool RsaKey::ComputeOtherPrimeParameters() {
+  DeleteNums(other_exponents_);
+  DeleteNums(other_coefficients_);
+  if (other_primes_.empty())
+    return true;
+  BigNum r(2 * m_->capacity_ + 1);
+  BigNum t(2 * m_->capacity_ + 1);
+
+  if (!BigMult(*p_, *q_, r))
+    return false;
+  for (int i = 0; i < (int)other_primes_.size(); i++) {
+    BigNum& prime = *other_primes_[i];
+    BigNum prime_minus_1(prime.capacity_ + 1);
+    BigNum* exponent = new BigNum(prime.capacity_ + 1);
+    BigNum* coefficient = new BigNum(prime.capacity_ + 1);
+    other_exponents_.push_back(exponent);
+    other_coefficients_.push_back(coefficient);
+    if (!BigSub(prime, Big_One, prime_minus_1) ||
+        !BigMod(*d_, prime_minus_1, *exponent))
+      return false;
+    // BigModInv reduces its argument in place
+    t.ZeroNum();
+    if (!BigMod(r, prime, t) || !BigModInv(t, prime, *coefficient))
+      return false;
+    t.ZeroNum();
+    if (!BigMult(r, prime, t) || !r.CopyFrom(t))
+      return false;
+  }
+  return true;
 }
 
 bool RsaKey::ComputeFastDecryptParameters() {
@@ -116,6 +408,15 @@ bool RsaKey::ComputeFastDecryptParameters() {
     LOG(ERROR) << "RsaKey::ComputeFastDecryptParameters: bad mult\n";
     return false;
   }
+  for (int i = 0; i < (int)other_primes_.size(); i++) {
+    BigNum r_minus_1(other_primes_[i]->capacity_ + 1);
+    if (!BigSub(*other_primes_[i], Big_One, r_minus_1) ||
+        !BigMult(t, r_minus_1, y) || !t.CopyFrom(y)) {
+      LOG(ERROR) << "RsaKey::ComputeFastDecryptParameters: bad mult\n";
+      return false;
+    }
+    y.ZeroNum();
+  }
   if (!BigExtendedGCD(t, *e_, y, *d_, g)) {
     LOG(ERROR) << "RsaKey::ComputeFastDecryptParameters: GCD 1\n";
     return false;
@@ -147,6 +448,10 @@ bool RsaKey::ComputeFastDecryptParameters() {
                   "exponent\n";
     return false;
   }
+  if (!ComputeOtherPrimeParameters()) {
+    LOG(ERROR) << "RsaKey::ComputeFastDecryptParameters: bad other primes\n";
+    return false;
+  }
   r_ = BigHighBit(*m_);
   if (!BigMontParams(*m_, r_, *m_prime_)) {
     LOG(ERROR)
@@ -165,6 +470,17 @@ bool RsaKey::ComputeFastDecryptParameters() {
         << "RsaKey::ComputeFastDecryptParameters: cant compute BigMontParams\n";
     return false;
   }
+  // q_inv_ belongs to the old p and q if the key object is reused
+  if (q_inv_ != nullptr) {
+    q_inv_->ZeroNum();
+    delete q_inv_;
+    q_inv_ = nullptr;
+  }
+  if (!InitMontgomeryContexts() || !InitCrtParameters()) {
+    LOG(ERROR) << "RsaKey::ComputeFastDecryptParameters: cant compute "
+                  "CRT parameters\n";
+    return false;
+  }
   return true;
 }
 
@@ -237,6 +553,34 @@ bool RsaKey::SerializeKeyToMessage(crypto_rsa_key_message& msg) {
     msg.set_q_prime(*s);
     delete s;
   }
+  if (q_inv_ != nullptr) {
+    string* s = ByteToBase64RightToLeft(q_inv_->size_ * sizeof(uint64_t),
+                                        (byte*)q_inv_->value_);
+    msg.set_q_inv(*s);
+    delete s;
+  }
+  for (int i = 0; i < (int)other_primes_.size(); i++) {
+    crypto_rsa_other_prime_message* other = msg.add_other_primes();
+    string* s = ByteToBase64RightToLeft(other_primes_[i]->size_ *
+                                        sizeof(uint64_t),
+                                        (byte*)other_primes_[i]->value_);
+    other->set_prime(*s);
+    delete s;
+    if (i < (int)other_exponents_.size()) {
+      s = ByteToBase64RightToLeft(other_exponents_[i]->size_ *
+                                  sizeof(uint64_t),
+                                  (byte*)other_exponents_[i]->value_);
+      other->set_exponent(*s);
+      delete s;
+    }
+    if (i < (int)other_coefficients_.size()) {
+      s = ByteToBase64RightToLeft(other_coefficients_[i]->size_ *
+                                  sizeof(uint64_t),
+                                  (byte*)other_coefficients_[i]->value_);
+      other->set_coefficient(*s);
+      delete s;
+    }
+  }
   return true;
 }
 
@@ -369,29 +713,148 @@ bool RsaKey::DeserializeKeyFromMessage(crypto_rsa_key_message& msg) {
     }
     q_prime_->Normalize();
   }
+  if (msg.has_q_inv()) {
+    if (q_inv_ == nullptr) {
+      q_inv_ = new BigNum(bignum_size);
+    }
+    k = Base64ToByteRightToLeft((char*)(msg.q_inv().data()),
+                                bignum_size * sizeof(uint64_t),
+                                (byte*)q_inv_->value_);
+    if (k < 0) {
+      LOG(ERROR) << "RsaKey::DeserializeKeyFromMessage: cant encode\n";
+    }
+    q_inv_->Normalize();
+  } else if (q_inv_ != nullptr) {
+    q_inv_->ZeroNum();
+    delete q_inv_;
+    q_inv_ = nullptr;
+  }
+  if (msg.other_primes_size() > 0) {
+    DeleteNums(other_primes_);
+    DeleteNums(other_exponents_);
+    DeleteNums(other_coefficients_);
+    for (int i = 0; i < (int)other_mont_.size(); i++) delete other_mont_[i];
+    other_mont_.clear();
+  }
+  for (int i = 0; i < msg.other_primes_size(); i++) {
+    const crypto_rsa_other_prime_message& other = msg.other_primes(i);
+    const string* fields[3] = {&other.prime(), &other.exponent(),
+                               &other.coefficient()};
+    std::vector<BigNum*>* nums[3] = {&other_primes_, &other_exponents_,
+                                     &other_coefficients_};
+    // a missing field leaves the lists uneven and disables CRT
+    for (int j = 0; j < 3; j++) {
+      if (fields[j]->empty())
+        continue;
+      BigNum* n = new BigNum(bignum_size);
+      k = Base64ToByteRightToLeft((char*)(fields[j]->data()),
+                                  bignum_size * sizeof(uint64_t),
+                                  (byte*)n->value_);
+      if (k < 0) {
+        LOG(ERROR) << "RsaKey::DeserializeKeyFromMessage: cant encode\n";
+      }
+      n->Normalize();
+      nums[j]->push_back(n);
+    }
+  }
+  // public keys only get m_mont_, keys without p and q decrypt with d_
+  if (m_ != nullptr && !InitMontgomeryContexts()) {
+    LOG(ERROR) << "RsaKey::DeserializeKeyFromMessage: bad modulus\n";
+    return false;
+  }
+  if (p_ != nullptr && q_ != nullptr && dp_ != nullptr && dq_ != nullptr &&
+      !InitCrtParameters())
+    LOG(ERROR) << "RsaKey::DeserializeKeyFromMessage: no CRT parameters\n";
   return true;
 }
 
 bool RsaKey::GenerateRsaKey(const char* name, const char* usage,
                             const char* owner, int num_bits,
-                            double seconds_to_live) {
+                            double seconds_to_live, int num_primes) {
+  if (num_primes < 2 || num_primes > RSA_MAX_PRIMES ||
+      num_bits / num_primes < 128) {
+    LOG(ERROR) << "RsaKey::GenerateRsaKey: bad number of primes\n";
+    return false;
+  }
   BigNum m(1 + 2 * num_bits / NBITSINUINT64);
+  BigNum t(1 + 2 * num_bits / NBITSINUINT64);
   BigNum p(1 + num_bits / NBITSINUINT64);
   BigNum q(1 + num_bits / NBITSINUINT64);
   BigNum e(1, 0x010001ULL);
+  std::atomic<bool> cancel(false);
+  bool q_ok = false;
+  int bits[RSA_MAX_PRIMES];
+  int i, j;
 
-  if (!BigGenPrime(p, num_bits / 2)) {
+  // the first num_bits % num_primes primes get one more bit
+  for (i = 0; i < num_primes; i++)
+    bits[i] = num_bits / num_primes + (i < num_bits % num_primes ? 1 : 0);
+
+  // p and q are searched concurrently, each on half the cores
+  int cores = (int)std::thread::hardware_concurrency();
+  if (cores < 1)
+    cores = 1;
+  int threads = cores / 2;
+  if (threads < 1)
+    threads = 1;
+  std::thread q_thread([&]() {
+    q_ok = BigGenPrime(q, bits[1], threads, &cancel);
+  });
+  bool p_ok = BigGenPrime(p, bits[0], threads);
+  if (!p_ok)
+    cancel.store(true);
+  q_thread.join();
+  if (!p_ok) {
     LOG(ERROR) << "RsaKey::GenerateRsaKey: can't generate p\n";
     return false;
   }
-  if (!BigGenPrime(q, num_bits / 2)) {
+  if (!q_ok) {
     LOG(ERROR) << "RsaKey::GenerateRsaKey: can't generate q\n";
     return false;
   }
+  if (BigCompare(p, q) == 0) {
+    LOG(ERROR) << "RsaKey::GenerateRsaKey: p == q\n";
+    return false;
+  }
   if (!BigMult(p, q, m)) {
     LOG(ERROR) << "RsaKey::GenerateRsaKey: can't multiply p and q\n";
     return false;
   }
+
+  //  The other primes one at a time on all the cores.  With more than two
+  //  primes the product can come up a bit short, the last prime is then
+  //  drawn again.
+  DeleteNums(other_primes_);
+  for (i = 2; i < num_primes; i++) {
+    BigNum* r = new BigNum(1 + num_bits / NBITSINUINT64);
+    bool distinct = false;
+    // if the earlier primes came up short no last prime of bits[i] can
+    // reach num_bits
+    if (i == (num_primes - 1) && BigHighBit(m) + bits[i] < num_bits)
+      bits[i] = num_bits - BigHighBit(m);
+    while (!distinct) {
+      r->ZeroNum();
+      if (!BigGenPrime(*r, bits[i], cores)) {
+        LOG(ERROR) << "RsaKey::GenerateRsaKey: can't generate prime\n";
+        delete r;
+        return false;
+      }
+      distinct = BigCompare(*r, p) != 0 && BigCompare(*r, q) != 0;
+      for (j = 0; j < (int)other_primes_.size(); j++)
+        distinct = distinct && BigCompare(*r, *other_primes_[j]) != 0;
+      t.ZeroNum();
+      if (!BigMult(m, *r, t)) {
+        LOG(ERROR) << "RsaKey::GenerateRsaKey: can't multiply primes\n";
+        delete r;
+        return false;
+      }
+      if (i == (num_primes - 1) && BigHighBit(t) != num_bits)
+        distinct = false;
+    }
+    other_primes_.push_back(r);
+    m.ZeroNum();
+    m.CopyFrom(t);
+  }
   return MakeRsaKey(name, usage, owner, num_bits, seconds_to_live, m, e, p, q);
 }
 
@@ -483,6 +946,16 @@ void RsaKey::PrintKey() {
     PrintNumToConsole(*q_prime_, 10ULL);
     printf("\n");
   }
+  if (q_inv_ != nullptr) {
+    printf("q_inv: ");
+    PrintNumToConsole(*q_inv_, 10ULL);
+    printf("\n");
+  }
+  for (int i = 0; i < (int)other_primes_.size(); i++) {
+    printf("r[%d]: ", i);
+    PrintNumToConsole(*other_primes_[i], 10ULL);
+    printf("\n");
+  }
 }
 
 bool RsaKey::Encrypt(int size_in, byte* in, int* size_out, byte* out,
@@ -497,21 +970,29 @@ bool RsaKey::Encrypt(int size_in, byte* in, int* size_out, byte* out,
 
   int new_byte_size = (size_in + bytes_in_block - 1) / bytes_in_block;
   new_byte_size *= bytes_in_block;
-  BigNum int_in(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_inp(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_inq(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_out(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_outp(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_outq(1 + 4 * new_byte_size / sizeof(uint64_t));
+  ScratchFrame frame;
+  BigNum int_in(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_inp(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_inq(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_out(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_outp(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_outq(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
   ReverseCpy(new_byte_size, in, (byte*)int_in.value_);
   int_in.Normalize();
+  // the CRT speeds only cover p and q
+  if ((speed == 2 || speed == 3) && !other_primes_.empty())
+    speed = 1;
   if (speed == 0) {
     if (!BigModExp(int_in, *e_, *m_, int_out)) {
       LOG(ERROR) << "BigModExp failed in RSAKey::Encrypt\n";
       return false;
     }
   } else if (speed == 1) {
-    if (!BigMontExp(int_in, *e_, r_, *m_, *m_prime_, int_out)) {
+    if (m_mont_ == nullptr) {
+      LOG(ERROR) << "no Montgomery context in RSAKey::Encrypt\n";
+      return false;
+    }
+    if (!BigMontExp(int_in, *e_, *m_mont_, int_out)) {
       LOG(ERROR) << "BigMontExp failed in RSAKey::Encrypt\n";
       return false;
     }
@@ -537,11 +1018,10 @@ bool RsaKey::Encrypt(int size_in, byte* in, int* size_out, byte* out,
       return false;
     }
   } else if (speed == 3) {
-    if (p_prime_ == nullptr || p_prime_ == nullptr) {
-      LOG(ERROR) << "uncalculated p_prime_ in RSAKey::Encrypt\n";
+    if (p_mont_ == nullptr || q_mont_ == nullptr) {
+      LOG(ERROR) << "no Montgomery context in RSAKey::Encrypt\n";
       return false;
     }
-    int t = BigHighBit(*p_);
     if (!BigMod(int_in, *p_, int_inp)) {
       LOG(ERROR) << "BigMod(p) failed in RSAKey::Encrypt\n";
       return false;
@@ -550,11 +1030,11 @@ bool RsaKey::Encrypt(int size_in, byte* in, int* size_out, byte* out,
       LOG(ERROR) << "BigMod(q) failed in RSAKey::Encrypt\n";
       return false;
     }
-    if (!BigMontExp(int_inp, *e_, t, *p_, *p_prime_, int_outp)) {
+    if (!BigMontExp(int_inp, *e_, *p_mont_, int_outp)) {
       LOG(ERROR) << "BigMontExp failed in RSAKey::Encrypt\n";
       return false;
     }
-    if (!BigMontExp(int_inq, *e_, t, *q_, *q_prime_, int_outq)) {
+    if (!BigMontExp(int_inq, *e_, *q_mont_, int_outq)) {
       LOG(ERROR) << "BigMontExp failed in RSAKey::Encrypt\n";
       return false;
     }
@@ -583,12 +1063,13 @@ bool RsaKey::Decrypt(int size_in, byte* in, int* size_out, byte* out,
   int new_byte_size = (size_in + bytes_in_block - 1) / bytes_in_block;
   new_byte_size *= bytes_in_block;
 
-  BigNum int_in(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_inp(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_inq(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_out(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_outp(1 + 4 * new_byte_size / sizeof(uint64_t));
-  BigNum int_outq(1 + 4 * new_byte_size / sizeof(uint64_t));
+  ScratchFrame frame;
+  BigNum int_in(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_inp(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_inq(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_out(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_outp(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
+  BigNum int_outq(1 + 4 * new_byte_size / sizeof(uint64_t), frame);
   ReverseCpy(new_byte_size, in, (byte*)int_in.value_);
   int_in.Normalize();
   if (speed == 0) {
@@ -597,34 +1078,19 @@ bool RsaKey::Decrypt(int size_in, byte* in, int* size_out, byte* out,
       return false;
     }
   } else if (speed == 1) {
-    if (!BigMontExp(int_in, *d_, r_, *m_, *m_prime_, int_out)) {
-      LOG(ERROR) << "BigMontExp failed in RSAKey::Encrypt\n";
-      return false;
-    }
-  } else if (speed == 2) {
-    if (!BigMod(int_in, *p_, int_inp)) {
-      LOG(ERROR) << "BigMod(p) failed in RSAKey::Decrypt\n";
-      return false;
-    }
-    if (!BigModExp(int_inp, *dp_, *p_, int_outp)) {
-      LOG(ERROR) << "BigModExp failed in RSAKey::Decrypt\n";
-      return false;
-    }
-    if (!BigModExp(int_inq, *dq_, *q_, int_outq)) {
-      LOG(ERROR) << "BigModExp failed in RSAKey::Decrypt " << size_in << " "
-                 << bytes_in_block << "\n";
+    if (m_mont_ == nullptr) {
+      LOG(ERROR) << "no Montgomery context in RSAKey::Decrypt\n";
       return false;
     }
-    if (!BigCRT(int_outp, int_outq, *p_, *q_, int_out)) {
-      LOG(ERROR) << "BigCRT failed in RSAKey::Decrypt\n";
+    if (!BigMontExpConstantTime(int_in, *d_, *m_mont_, int_out)) {
+      LOG(ERROR) << "BigMontExpConstantTime failed in RSAKey::Decrypt\n";
       return false;
     }
-  } else if (speed == 3) {
-    if (p_prime_ == nullptr || p_prime_ == nullptr) {
-      LOG(ERROR) << "uncalculated p_prime_ in RSAKey::Decrypt\n";
+  } else if (speed == 2) {
+    if (!HasCrtParameters()) {
+      LOG(ERROR) << "no CRT parameters in RSAKey::Decrypt\n";
       return false;
     }
-    int t = BigHighBit(*p_);
     if (!BigMod(int_in, *p_, int_inp)) {
       LOG(ERROR) << "BigMod(p) failed in RSAKey::Decrypt\n";
       return false;
@@ -633,18 +1099,62 @@ bool RsaKey::Decrypt(int size_in, byte* in, int* size_out, byte* out,
       LOG(ERROR) << "BigMod(q) failed in RSAKey::Decrypt\n";
       return false;
     }
-    if (!BigMontExp(int_inp, *dp_, t, *p_, *p_prime_, int_outp)) {
-      LOG(ERROR) << "BigMontExp failed in RSAKey::Decrypt\n";
+    if (!BigMontExpConstantTime(int_inp, *dp_, *p_mont_, int_outp)) {
+      LOG(ERROR) << "BigMontExpConstantTime failed in RSAKey::Decrypt\n";
       return false;
     }
-    if (!BigMontExp(int_inq, *dq_, t, *q_, *q_prime_, int_outq)) {
-      LOG(ERROR) << "BigMontExp failed in RSAKey::Decrypt\n";
+    if (!BigMontExpConstantTime(int_inq, *dq_, *q_mont_, int_outq)) {
+      LOG(ERROR) << "BigMontExpConstantTime failed in RSAKey::Decrypt "
+                 << size_in << " " << bytes_in_block << "\n";
       return false;
     }
     if (!BigCRT(int_outp, int_outq, *p_, *q_, int_out)) {
       LOG(ERROR) << "BigCRT failed in RSAKey::Decrypt\n";
       return false;
     }
+    if (!other_primes_.empty()) {
+      // fold in the other primes one at a time, int_inq holds p q r_1 ...
+      if (!BigMult(*p_, *q_, int_inq)) {
+        LOG(ERROR) << "BigMult failed in RSAKey::Decrypt\n";
+        return false;
+      }
+      for (int i = 0; i < (int)other_primes_.size(); i++) {
+        int_outp.ZeroNum();
+        int_outq.ZeroNum();
+        if (!BigMontExpConstantTime(int_in, *other_exponents_[i],
+                                    *other_mont_[i], int_outp) ||
+            !BigCRT(int_out, int_outp, int_inq, *other_primes_[i],
+                    int_outq)) {
+          LOG(ERROR) << "BigCRT failed in RSAKey::Decrypt\n";
+          return false;
+        }
+        int_out.ZeroNum();
+        int_out.CopyFrom(int_outq);
+        int_inp.ZeroNum();
+        if (!BigMult(int_inq, *other_primes_[i], int_inp)) {
+          LOG(ERROR) << "BigMult failed in RSAKey::Decrypt\n";
+          return false;
+        }
+        int_inq.ZeroNum();
+        int_inq.CopyFrom(int_inp);
+      }
+    }
+  } else if (speed == 3 || speed == 4) {
+    // Garner with the stored coefficients, speed 4 on several threads.
+    // Keys without p and q use d_.
+    if (!HasCrtParameters()) {
+      if (m_mont_ == nullptr || d_ == nullptr) {
+        LOG(ERROR) << "no Montgomery context in RSAKey::Decrypt\n";
+        return false;
+      }
+      if (!BigMontExpConstantTime(int_in, *d_, *m_mont_, int_out)) {
+        LOG(ERROR) << "BigMontExpConstantTime failed in RSAKey::Decrypt\n";
+        return false;
+      }
+    } else if (!CrtDecrypt(int_in, int_out, speed == 4)) {
+      LOG(ERROR) << "CrtDecrypt failed in RSAKey::Decrypt\n";
+      return false;
+    }
   } else {
     LOG(ERROR) << "RsaKey::Decrypt, bad speed parameter " << speed << "\n";
     return false;
@@ -58,7 +58,7 @@ endif
 dobj=	$(O)/symmetrictest.o $(O)/symmetric_cipher.o $(O)/aes.o $(O)/util.o \
 	$(O)/conversions.o $(O)/aesni.o $(O)/hash.o $(O)/hmac_sha256.o \
 	$(O)/encryption_algorithm.o $(O)/sha256.o $(O)/aescbchmac256sympad.o \
-	$(O)/keys.o $(O)/keys.pb.o $(O)/rsa.o $(O)/ecc.o $(O)/arith64.o $(O)/intel64_arith.o \
+	$(O)/keys.o $(O)/keys.pb.o $(O)/rsa.o $(O)/ecc.o $(O)/p256.o $(O)/arith64.o $(O)/intel64_arith.o \
 	$(O)/bignum.o $(O)/number_theory.o $(O)/smallprimes.o $(O)/globals.o \
 	$(O)/basic_arith.o $(O)/twofish.o $(O)/aesctrhmac256sympad.o $(O)/rc4.o \
 	$(O)/tea.o $(O)/simonspeck.o $(O)/ghash.o $(O)/cmac.o $(O)/aesgcm.o $(O)/aessiv.o
@@ -170,6 +170,10 @@ $(O)/ecc.o: $(SRC_DIR)/ecc/ecc.cc
 	@echo "compiling ecc.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/ecc.o $(SRC_DIR)/ecc/ecc.cc
 
+$(O)/p256.o: $(SRC_DIR)/ecc/p256.cc
+	@echo "compiling p256.cc"
+	$(CC) $(CFLAGS) -c -o $(O)/p256.o $(SRC_DIR)/ecc/p256.cc
+
 $(O)/globals.o: $(SRC_DIR)/bignum/globals.cc
 	@echo "compiling globals.cc"
 	$(CC) $(CFLAGS) -c -o $(O)/globals.o $(SRC_DIR)/bignum/globals.cc